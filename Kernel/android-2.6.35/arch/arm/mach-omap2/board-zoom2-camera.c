@@ -186,12 +186,12 @@ static int imx046_sensor_power_set(struct v4l2_int_device *s, enum v4l2_power po
 		printk(KERN_DEBUG "imx046_sensor_power_set(ON)\n");
 
 		/*
-		 * Through-put requirement:
-		 * Set max OCP freq for 3630 is 200 MHz through-put
-		 * is in KByte/s so 200000 KHz * 4 = 800000 KByte/s
+		 * Through-put requirement: what the ISP writes to memory
+		 * for the configured format at the requested frame rate
 		 */
-		omap_pm_set_min_bus_tput(vdev->cam->isp,
-					 OCP_INITIATOR_AGENT, 800000);
+		omap_pm_set_min_bus_tput(vdev->cam->isp, OCP_INITIATOR_AGENT,
+			isp_capture_bus_tput(vdev->cam->isp,
+					     &vdev->want_timeperframe));
 
 		/* Hold a constraint to keep MPU in C1 */
 		omap_pm_set_max_mpu_wakeup_lat(&qos_request, 12);
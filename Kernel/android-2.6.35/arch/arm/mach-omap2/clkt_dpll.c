@@ -18,6 +18,7 @@
 #include <linux/errno.h>
 #include <linux/clk.h>
 #include <linux/io.h>
+#include <linux/string.h>
 
 #include <asm/div64.h>
 
@@ -281,9 +282,54 @@ int omap2_dpll_set_rate_tolerance(struct clk *clk, unsigned int tolerance)
 
 	clk->dpll_data->rate_tolerance = tolerance;
 
+	/* cached M/N were chosen under the old tolerance */
+	memset(clk->dpll_data->rate_cache, 0,
+	       sizeof(clk->dpll_data->rate_cache));
+	clk->dpll_data->rate_cache_next = 0;
+
 	return 0;
 }
 
+/*
+ * Rounded M/N settings are remembered per DPLL, so that switching back
+ * and forth between a few OPP rates does not repeat the divider search
+ * on every DVFS transition.
+ */
+static bool _dpll_rate_cache_lookup(struct dpll_data *dd,
+				    unsigned long target_rate)
+{
+	struct dpll_rate_cache *rc;
+	int i;
+
+	for (i = 0; i < DPLL_RATE_CACHE_SIZE; i++) {
+		rc = &dd->rate_cache[i];
+		if (rc->rate && rc->target_rate == target_rate &&
+		    rc->ref_rate == dd->clk_ref->rate) {
+			dd->last_rounded_m = rc->m;
+			dd->last_rounded_n = rc->n;
+			dd->last_rounded_rate = rc->rate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void _dpll_rate_cache_add(struct dpll_data *dd,
+				 unsigned long target_rate)
+{
+	struct dpll_rate_cache *rc;
+
+	rc = &dd->rate_cache[dd->rate_cache_next];
+	dd->rate_cache_next = (dd->rate_cache_next + 1) % DPLL_RATE_CACHE_SIZE;
+
+	rc->target_rate = target_rate;
+	rc->ref_rate = dd->clk_ref->rate;
+	rc->rate = dd->last_rounded_rate;
+	rc->m = dd->last_rounded_m;
+	rc->n = dd->last_rounded_n;
+}
+
 /**
  * omap2_dpll_round_rate - round a target rate for an OMAP DPLL
  * @clk: struct clk * for a DPLL
@@ -312,6 +358,9 @@ long omap2_dpll_round_rate(struct clk *clk, unsigned long target_rate)
 
 	dd = clk->dpll_data;
 
+	if (_dpll_rate_cache_lookup(dd, target_rate))
+		return dd->last_rounded_rate;
+
 	pr_debug("clock: starting DPLL round_rate for clock %s, target rate "
 		 "%ld\n", clk->name, target_rate);
 
@@ -383,6 +432,8 @@ long omap2_dpll_round_rate(struct clk *clk, unsigned long target_rate)
 	pr_debug("clock: final rate: %ld  (target rate: %ld)\n",
 		 dd->last_rounded_rate, target_rate);
 
+	_dpll_rate_cache_add(dd, target_rate);
+
 	return dd->last_rounded_rate;
 }
 
@@ -23,6 +23,7 @@
 #include "cm.h"
 #include "prm.h"
 #include "sdrc.h"
+#include "mux34xx.h"
 #include "pm.h"
 
 static void __iomem *omap2_ctrl_base;
@@ -176,18 +177,59 @@ u32 omap_ctrl_readl(u16 offset)
 	return __raw_readl(OMAP_CTRL_REGADDR(offset));
 }
 
+/*
+ * Set whenever a core padconf register is written, cleared once the
+ * hardware padconf save for CORE OFF has run.  While it stays clear the
+ * copy in the wakeup domain is still current and the save is skipped.
+ */
+static int omap3_padconf_dirty = 1;
+
+static inline void omap_ctrl_padconf_touch(u16 offset)
+{
+	/* SDRC_D0..GPMC_A11 below GENERAL, SDRC_BA0..ETK_D15 above it */
+	if ((offset >= OMAP2_CONTROL_PADCONFS &&
+	     offset < OMAP2_CONTROL_GENERAL) ||
+	    (offset >= OMAP2_CONTROL_PADCONFS +
+			OMAP3_CONTROL_PADCONF_SDRC_BA0_OFFSET &&
+	     offset <= OMAP2_CONTROL_PADCONFS +
+			OMAP3_CONTROL_PADCONF_ETK_D15_OFFSET))
+		omap3_padconf_dirty = 1;
+}
+
+void omap3_control_padconf_mark_dirty(void)
+{
+	omap3_padconf_dirty = 1;
+}
+
+/**
+ * omap3_control_padconf_need_save - test and clear the padconf dirty flag
+ *
+ * Returns 1 if a padconf register changed since the last call, in which
+ * case the caller must trigger START_PADCONF_SAVE before CORE OFF.
+ */
+int omap3_control_padconf_need_save(void)
+{
+	int dirty = omap3_padconf_dirty;
+
+	omap3_padconf_dirty = 0;
+	return dirty;
+}
+
 void omap_ctrl_writeb(u8 val, u16 offset)
 {
+	omap_ctrl_padconf_touch(offset);
 	__raw_writeb(val, OMAP_CTRL_REGADDR(offset));
 }
 
 void omap_ctrl_writew(u16 val, u16 offset)
 {
+	omap_ctrl_padconf_touch(offset);
 	__raw_writew(val, OMAP_CTRL_REGADDR(offset));
 }
 
 void omap_ctrl_writel(u32 val, u16 offset)
 {
+	omap_ctrl_padconf_touch(offset);
 	__raw_writel(val, OMAP_CTRL_REGADDR(offset));
 }
 
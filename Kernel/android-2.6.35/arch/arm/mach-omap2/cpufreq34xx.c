@@ -197,6 +197,25 @@ static unsigned long omap3_l3_get_rate(struct device *dev)
 	return dpll3_clk->rate / l3_div;
 }
 
+/*
+ * Round every OPP rate of @dev once at boot, so that the DPLL M/N
+ * settings for each OPP are already in the DPLL's rate cache when a
+ * DVFS transition asks for them.
+ */
+static void __init omap3_opp_precompute_dpll(struct device *dev,
+					     struct clk *dpll)
+{
+	unsigned long freq = 0;
+
+	if (!dev || IS_ERR(dpll))
+		return;
+
+	while (!IS_ERR(opp_find_freq_ceil(dev, &freq))) {
+		clk_round_rate(dpll, freq);
+		freq++;
+	}
+}
+
 /* Temp variable to allow multiple calls */
 static u8 __initdata omap3_table_init;
 
@@ -234,14 +253,18 @@ int __init omap3_pm_init_opp_table(void)
 
 	/* Populate the set rate and get rate for mpu, iva and l3 device */
 	dev = omap2_get_mpuss_device();
-	if (dev)
+	if (dev) {
 		opp_populate_rate_fns(dev, omap3_mpu_set_rate,
 				omap3_mpu_get_rate);
+		omap3_opp_precompute_dpll(dev, dpll1_clk);
+	}
 
 	dev = omap2_get_iva_device();
-	if (dev)
+	if (dev) {
 		opp_populate_rate_fns(dev, omap3_iva_set_rate,
 				omap3_iva_get_rate);
+		omap3_opp_precompute_dpll(dev, dpll2_clk);
+	}
 
 	dev = omap2_get_l3_device();
 	if (dev)
@@ -24,6 +24,9 @@
 
 #include <linux/sched.h>
 #include <linux/cpuidle.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/pm_qos_params.h>
 
 #include <plat/prcm.h>
 #include <plat/irqs.h>
@@ -36,6 +39,12 @@
 
 #ifdef CONFIG_CPU_IDLE
 
+#if defined(CONFIG_OMAP3_CPUIDLE_PREDICT) && defined(CONFIG_PM_DEBUG)
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <plat/voltage.h>
+#endif
+
 #define OMAP3_MAX_STATES 7
 #define OMAP3_STATE_C1 0 /* C1 - MPU WFI + Core active */
 #define OMAP3_STATE_C2 1 /* C2 - MPU WFI + Core inactive */
@@ -62,6 +71,41 @@ struct omap3_processor_cx omap3_power_states[OMAP3_MAX_STATES];
 struct omap3_processor_cx current_cx_state;
 struct powerdomain *mpu_pd, *core_pd;
 
+#ifdef CONFIG_OMAP3_CPUIDLE_PREDICT
+/* Wakeup source classes tracked by the omap3_predict governor */
+enum omap3_wake_src {
+	OMAP3_WAKE_TIMER,
+	OMAP3_WAKE_GPIO,
+	OMAP3_WAKE_MMC,
+	OMAP3_WAKE_USB,
+	OMAP3_WAKE_OTHER,
+	OMAP3_WAKE_NR,
+};
+
+/* Source of the interrupt that ended the last idle period */
+static int omap3_idle_wake_src = OMAP3_WAKE_OTHER;
+
+static int omap3_wake_src_of(int irq)
+{
+	switch (irq) {
+	case INT_24XX_GPTIMER1 ... INT_24XX_GPTIMER12:
+	case INT_34XX_GPT12_IRQ:
+		return OMAP3_WAKE_TIMER;
+	case INT_34XX_GPIO_BANK1 ... INT_34XX_GPIO_BANK6:
+		return OMAP3_WAKE_GPIO;
+	case INT_24XX_MMC_IRQ:
+	case INT_24XX_MMC2_IRQ:
+	case INT_34XX_MMC3_IRQ:
+		return OMAP3_WAKE_MMC;
+	case INT_243X_HS_USB_MC:
+	case INT_243X_HS_USB_DMA:
+		return OMAP3_WAKE_USB;
+	default:
+		return OMAP3_WAKE_OTHER;
+	}
+}
+#endif
+
 /*
  * The latencies/thresholds for various C states have
  * to be configured from the respective board files.
@@ -155,6 +199,10 @@ return_sleep_time:
 	getnstimeofday(&ts_postidle);
 	ts_idle = timespec_sub(ts_postidle, ts_preidle);
 
+#ifdef CONFIG_OMAP3_CPUIDLE_PREDICT
+	omap3_idle_wake_src = omap3_wake_src_of(omap_irq_pending_nr());
+#endif
+
 	local_irq_enable();
 	local_fiq_enable();
 
@@ -245,6 +293,226 @@ static int omap3_enter_idle_bm(struct cpuidle_device *dev,
 	return omap3_enter_idle(dev, new_state);
 }
 
+#ifdef CONFIG_OMAP3_CPUIDLE_PREDICT
+/*
+ * omap3_predict - cpuidle governor driven by wakeup source history
+ *
+ * An idle period ends either on the next timer event, which
+ * tick_nohz_get_sleep_length() knows exactly, or on a device interrupt,
+ * which it does not.  Device interrupts come in bursts (touch reports,
+ * MMC transfers, USB traffic), so how long the next idle period lasts
+ * depends mostly on what ended the previous one.
+ *
+ * For each wakeup source class a decaying log2 histogram of the
+ * residency of the idle period that followed it is kept.  The deepest
+ * state is chosen whose target residency fits before the next timer,
+ * whose exit latency fits PM_QOS_CPU_DMA_LATENCY (which is what
+ * omap_pm_set_max_mpu_wakeup_lat() sets) and for which no more than
+ * PREDICT_EARLY_PCT of the history ended before its target residency.
+ */
+#define PREDICT_BUCKETS		16	/* < 16us, doubling up to >= 256ms */
+#define PREDICT_MIN_SHIFT	4
+#define PREDICT_WEIGHT		16
+#define PREDICT_MAX_TOTAL	(PREDICT_WEIGHT * 256)
+#define PREDICT_MIN_SAMPLES	(PREDICT_WEIGHT * 8)
+#define PREDICT_EARLY_PCT	20
+
+struct omap3_predict_stats {
+	u32 wakeups;
+	u32 hit;
+	u32 too_deep;
+	u32 too_shallow;
+};
+
+static struct {
+	u32 hist[OMAP3_WAKE_NR][PREDICT_BUCKETS];
+	u32 total[OMAP3_WAKE_NR];
+	struct omap3_predict_stats stats[OMAP3_WAKE_NR];
+	int last_src;
+	int state_idx;
+	int allowed_idx;
+} omap3_predict;
+
+static inline int predict_bucket(u32 us)
+{
+	if (!(us >> PREDICT_MIN_SHIFT))
+		return 0;
+	return min(fls(us >> PREDICT_MIN_SHIFT), PREDICT_BUCKETS - 1);
+}
+
+static inline u32 predict_bucket_start(int b)
+{
+	return b ? 1 << (PREDICT_MIN_SHIFT + b - 1) : 0;
+}
+
+static int omap3_predict_select(struct cpuidle_device *dev)
+{
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	int src = omap3_predict.last_src;
+	u32 *hist = omap3_predict.hist[src];
+	u32 total = omap3_predict.total[src];
+	u32 early = 0, limit = total * PREDICT_EARLY_PCT / 100;
+	s64 sleep_us;
+	u32 expected_us;
+	int i, b = 0;
+
+	omap3_predict.state_idx = 0;
+	omap3_predict.allowed_idx = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	sleep_us = ktime_to_us(tick_nohz_get_sleep_length());
+	expected_us = min_t(s64, sleep_us, UINT_MAX);
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+		struct omap3_processor_cx *cx = cpuidle_get_statedata(s);
+
+		if (!cx->valid)
+			continue;
+		if (s->target_residency > expected_us)
+			break;
+		if (s->exit_latency > latency_req)
+			break;
+		omap3_predict.allowed_idx = i;
+
+		if (total >= PREDICT_MIN_SAMPLES) {
+			while (b < PREDICT_BUCKETS &&
+			       predict_bucket_start(b) < s->target_residency)
+				early += hist[b++];
+			if (early > limit)
+				break;
+		}
+		omap3_predict.state_idx = i;
+	}
+
+	return omap3_predict.state_idx;
+}
+
+static void omap3_predict_reflect(struct cpuidle_device *dev)
+{
+	u32 us = cpuidle_get_last_residency(dev);
+	int src = omap3_predict.last_src;
+	int idx = omap3_predict.state_idx;
+	struct omap3_predict_stats *st = &omap3_predict.stats[src];
+	u32 *hist = omap3_predict.hist[src];
+	int i;
+
+	/* Score the prediction made from this source's history */
+	if (idx && us < dev->states[idx].target_residency) {
+		st->too_deep++;
+	} else {
+		for (i = idx + 1; i <= omap3_predict.allowed_idx; i++) {
+			struct omap3_processor_cx *cx =
+				cpuidle_get_statedata(&dev->states[i]);
+
+			if (cx->valid)
+				break;
+		}
+		if (i <= omap3_predict.allowed_idx &&
+		    us >= dev->states[i].target_residency)
+			st->too_shallow++;
+		else
+			st->hit++;
+	}
+
+	/* Learn, halving the history once it has enough weight */
+	hist[predict_bucket(us)] += PREDICT_WEIGHT;
+	omap3_predict.total[src] += PREDICT_WEIGHT;
+	if (omap3_predict.total[src] >= PREDICT_MAX_TOTAL) {
+		omap3_predict.total[src] = 0;
+		for (i = 0; i < PREDICT_BUCKETS; i++) {
+			hist[i] >>= 1;
+			omap3_predict.total[src] += hist[i];
+		}
+	}
+
+	omap3_predict.last_src = omap3_idle_wake_src;
+	omap3_predict.stats[omap3_idle_wake_src].wakeups++;
+}
+
+static int omap3_predict_enable(struct cpuidle_device *dev)
+{
+	memset(&omap3_predict, 0, sizeof(omap3_predict));
+	omap3_predict.last_src = OMAP3_WAKE_OTHER;
+
+	return 0;
+}
+
+static struct cpuidle_governor omap3_predict_governor = {
+	.name =		"omap3_predict",
+	.rating =	30,
+	.enable =	omap3_predict_enable,
+	.select =	omap3_predict_select,
+	.reflect =	omap3_predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+#ifdef CONFIG_PM_DEBUG
+static const char *omap3_wake_src_name[OMAP3_WAKE_NR] = {
+	[OMAP3_WAKE_TIMER]	= "timer",
+	[OMAP3_WAKE_GPIO]	= "gpio",
+	[OMAP3_WAKE_MMC]	= "mmc",
+	[OMAP3_WAKE_USB]	= "usb",
+	[OMAP3_WAKE_OTHER]	= "other",
+};
+
+static int omap3_predict_dbg_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "%-8s %10s %10s %10s %10s\n", "source", "wakeups",
+		   "hit", "too_deep", "too_shallow");
+	for (i = 0; i < OMAP3_WAKE_NR; i++) {
+		struct omap3_predict_stats *st = &omap3_predict.stats[i];
+
+		seq_printf(s, "%-8s %10u %10u %10u %10u\n",
+			   omap3_wake_src_name[i], st->wakeups, st->hit,
+			   st->too_deep, st->too_shallow);
+	}
+
+	return 0;
+}
+
+static int omap3_predict_dbg_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap3_predict_dbg_show, inode->i_private);
+}
+
+/* Any write clears the counters, the learned history is kept */
+static ssize_t omap3_predict_dbg_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	memset(omap3_predict.stats, 0, sizeof(omap3_predict.stats));
+	return count;
+}
+
+static const struct file_operations omap3_predict_dbg_fops = {
+	.open		= omap3_predict_dbg_open,
+	.read		= seq_read,
+	.write		= omap3_predict_dbg_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static void __init omap3_predict_init(void)
+{
+	if (cpuidle_register_governor(&omap3_predict_governor))
+		pr_err("%s: unable to register omap3_predict governor\n",
+		       __func__);
+#ifdef CONFIG_PM_DEBUG
+	(void) debugfs_create_file("cpuidle_predict", S_IRUGO | S_IWUSR,
+				   pm_dbg_main_dir, NULL,
+				   &omap3_predict_dbg_fops);
+#endif
+}
+#else
+static inline void omap3_predict_init(void) { }
+#endif
+
 DEFINE_PER_CPU(struct cpuidle_device, omap3_idle_dev);
 
 /**
@@ -431,6 +699,7 @@ int __init omap3_idle_init(void)
 
 	omap_init_power_states();
 	cpuidle_register_driver(&omap3_idle_driver);
+	omap3_predict_init();
 
 	dev = &per_cpu(omap3_idle_dev, smp_processor_id());
 
@@ -108,10 +108,19 @@ static u32 gpmc_read_reg(int idx)
 	return __raw_readl(gpmc_base + idx);
 }
 
+/*
+ * Set by gpmc_cs_write_reg() so that the chip-select timings, which are
+ * programmed once by the board code, are only re-read for CORE OFF
+ * when one of them actually changed.
+ */
+static int gpmc_cs_context_dirty = 1;
+
 void gpmc_cs_write_reg(int cs, int idx, u32 val)
 {
 	void __iomem *reg_addr;
 
+	gpmc_cs_context_dirty = 1;
+
 	reg_addr = gpmc_base + GPMC_CS0 + (cs * GPMC_CS_SIZE) + idx;
 	__raw_writel(val, reg_addr);
 }
@@ -563,6 +572,8 @@ void omap3_gpmc_save_context(void)
 	gpmc_context.prefetch_config1 = gpmc_read_reg(GPMC_PREFETCH_CONFIG1);
 	gpmc_context.prefetch_config2 = gpmc_read_reg(GPMC_PREFETCH_CONFIG2);
 	gpmc_context.prefetch_control = gpmc_read_reg(GPMC_PREFETCH_CONTROL);
+	if (!gpmc_cs_context_dirty)
+		return;
 	for (i = 0; i < GPMC_CS_NUM; i++) {
 		gpmc_context.cs_context[i].is_valid = gpmc_cs_mem_enabled(i);
 		if (gpmc_context.cs_context[i].is_valid) {
@@ -582,6 +593,7 @@ void omap3_gpmc_save_context(void)
 				gpmc_cs_read_reg(i, GPMC_CS_CONFIG7);
 		}
 	}
+	gpmc_cs_context_dirty = 0;
 }
 
 void omap3_gpmc_restore_context(void)
@@ -613,5 +625,7 @@ void omap3_gpmc_restore_context(void)
 				gpmc_context.cs_context[i].config7);
 		}
 	}
+	/* the registers now match the saved copy again */
+	gpmc_cs_context_dirty = 0;
 }
 #endif /* CONFIG_ARCH_OMAP3 */
@@ -64,6 +64,13 @@ struct omap3_intc_regs {
 
 static struct omap3_intc_regs intc_context[ARRAY_SIZE(irq_banks)];
 
+/*
+ * Nothing reprograms the ILR priorities after boot except the OFF
+ * restore path, which writes back the saved copy, so they only need to
+ * be read out once instead of on every CORE OFF entry.
+ */
+static int intc_ilr_saved;
+
 /* INTC bank register get/set */
 
 static void intc_bank_write_reg(u32 val, struct omap_irq_bank *bank, u16 reg)
@@ -187,6 +194,42 @@ int omap_irq_pending(void)
 	return 0;
 }
 
+/*
+ * The PRCM interrupt fires for every wakeup event and sDMA completions
+ * follow whatever started the transfer, so neither tells what woke the
+ * MPU. Being low numbered, they would otherwise hide the GPIO bank or
+ * timer interrupt pending next to them.
+ */
+#define OMAP_IRQ_PENDING_SKIP	((1 << INT_34XX_PRCM_MPU_IRQ) |		\
+				 (0xf << INT_24XX_SDMA_IRQ0))
+
+/*
+ * Return the lowest numbered pending (unmasked) interrupt other than the
+ * PRCM and sDMA ones, or -1 if none is pending.  Used by the idle path
+ * to find its wakeup source while interrupts are still disabled at the
+ * MPU.
+ */
+int omap_irq_pending_nr(void)
+{
+	int i, base = 0;
+
+	for (i = 0; i < ARRAY_SIZE(irq_banks); i++) {
+		struct omap_irq_bank *bank = irq_banks + i;
+		int irq;
+
+		for (irq = 0; irq < bank->nr_irqs; irq += 32) {
+			u32 pending = intc_bank_read_reg(bank,
+					INTC_PENDING_IRQ0 + ((irq >> 5) << 5));
+			if (!base && !irq)
+				pending &= ~OMAP_IRQ_PENDING_SKIP;
+			if (pending)
+				return base + irq + __ffs(pending);
+		}
+		base += bank->nr_irqs;
+	}
+	return -1;
+}
+
 void __init omap_init_irq(void)
 {
 	unsigned long nr_of_irqs = 0;
@@ -241,14 +284,17 @@ void omap_intc_save_context(void)
 			intc_bank_read_reg(bank, INTC_IDLE);
 		intc_context[ind].threshold =
 			intc_bank_read_reg(bank, INTC_THRESHOLD);
-		for (i = 0; i < INTCPS_NR_IRQS; i++)
-			intc_context[ind].ilr[i] =
-				intc_bank_read_reg(bank, (0x100 + 0x4*i));
+		if (!intc_ilr_saved)
+			for (i = 0; i < INTCPS_NR_IRQS; i++)
+				intc_context[ind].ilr[i] =
+					intc_bank_read_reg(bank,
+							(0x100 + 0x4*i));
 		for (i = 0; i < INTCPS_NR_MIR_REGS; i++)
 			intc_context[ind].mir[i] =
 				intc_bank_read_reg(&irq_banks[0], INTC_MIR0 +
 				(0x20 * i));
 	}
+	intc_ilr_saved = 1;
 }
 
 void omap_intc_restore_context(void)
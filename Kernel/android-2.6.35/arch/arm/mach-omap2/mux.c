@@ -60,6 +60,7 @@ static u16 omap_mux_read(struct omap_mux_partition *partition, u16 reg)
 static void omap_mux_write(struct omap_mux_partition *partition, u16 val,
 			   u16 reg)
 {
+	omap3_control_padconf_mark_dirty();
 	if (partition->flags & OMAP_MUX_REG_8BIT)
 		__raw_writeb(val, partition->base + reg);
 	else
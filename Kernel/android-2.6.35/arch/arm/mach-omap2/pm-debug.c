@@ -414,6 +414,48 @@ void pm_dbg_update_time(struct powerdomain *pwrdm, int prev)
 	pwrdm->timer = t;
 }
 
+/*
+ * Per-phase cost of the context save/restore around CORE OFF, fed by
+ * omap_sram_idle() once the restore side of a transition completes.
+ */
+static struct {
+	u32 count;
+	u32 last[OFF_PHASE_MAX];
+	u32 max[OFF_PHASE_MAX];
+	u64 total[OFF_PHASE_MAX];
+	u32 skipped[OFF_PHASE_MAX];
+} off_mode_stats;
+static DEFINE_SPINLOCK(off_mode_stats_lock);
+
+static const char *off_phase_names[OFF_PHASE_MAX] = {
+	[OFF_PHASE_PADCONF]		= "padconf",
+	[OFF_PHASE_CORE_SAVE]		= "core_save",
+	[OFF_PHASE_PRCM_SAVE]		= "prcm_save",
+	[OFF_PHASE_MUSB_SAVE]		= "musb_save",
+	[OFF_PHASE_SECURE_SAVE]		= "secure_save",
+	[OFF_PHASE_CORE_RESTORE]	= "core_restore",
+	[OFF_PHASE_PRCM_RESTORE]	= "prcm_restore",
+	[OFF_PHASE_MUSB_RESTORE]	= "musb_restore",
+};
+
+void pm_dbg_off_mode_time(const u32 *phase_ns, u32 skipped)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&off_mode_stats_lock, flags);
+	off_mode_stats.count++;
+	for (i = 0; i < OFF_PHASE_MAX; i++) {
+		off_mode_stats.last[i] = phase_ns[i];
+		off_mode_stats.total[i] += phase_ns[i];
+		if (phase_ns[i] > off_mode_stats.max[i])
+			off_mode_stats.max[i] = phase_ns[i];
+		if (skipped & (1 << i))
+			off_mode_stats.skipped[i]++;
+	}
+	spin_unlock_irqrestore(&off_mode_stats_lock, flags);
+}
+
 void omap2_pm_wakeup_on_timer(u32 seconds, u32 milliseconds)
 {
 	u32 tick_rate, cycles;
@@ -517,6 +559,62 @@ static int pm_dbg_show_timers(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int pm_dbg_show_off_mode_time(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	u32 count, last, max, skipped;
+	u64 avg;
+	int i;
+
+	seq_printf(s, "transitions: %u\n", off_mode_stats.count);
+	seq_printf(s, "%-13s %10s %10s %10s %8s\n",
+		   "phase", "last(us)", "avg(us)", "max(us)", "skipped");
+	for (i = 0; i < OFF_PHASE_MAX; i++) {
+		spin_lock_irqsave(&off_mode_stats_lock, flags);
+		count = off_mode_stats.count;
+		last = off_mode_stats.last[i];
+		max = off_mode_stats.max[i];
+		avg = off_mode_stats.total[i];
+		skipped = off_mode_stats.skipped[i];
+		spin_unlock_irqrestore(&off_mode_stats_lock, flags);
+
+		if (count)
+			do_div(avg, count);
+		seq_printf(s, "%-13s %10u %10u %10u %8u\n",
+			   off_phase_names[i], last / 1000,
+			   (u32)avg / 1000, max / 1000,
+			   skipped);
+	}
+
+	return 0;
+}
+
+static int pm_dbg_off_mode_time_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_dbg_show_off_mode_time, inode->i_private);
+}
+
+static ssize_t pm_dbg_off_mode_time_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	/* any write clears the statistics */
+	spin_lock_irqsave(&off_mode_stats_lock, flags);
+	memset(&off_mode_stats, 0, sizeof(off_mode_stats));
+	spin_unlock_irqrestore(&off_mode_stats_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations off_mode_time_fops = {
+	.open           = pm_dbg_off_mode_time_open,
+	.read           = seq_read,
+	.write          = pm_dbg_off_mode_time_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int pm_dbg_open(struct inode *inode, struct file *file)
 {
 	switch ((int)inode->i_private) {
@@ -814,6 +912,9 @@ static int __init pm_dbg_init(void)
 		d, (void *)DEBUG_FILE_COUNTERS, &debug_fops);
 	(void) debugfs_create_file("time", S_IRUGO,
 		d, (void *)DEBUG_FILE_TIMERS, &debug_fops);
+	if (cpu_is_omap34xx())
+		(void) debugfs_create_file("off_mode_time", S_IRUGO | S_IWUSR,
+			d, NULL, &off_mode_time_fops);
 
 	pwrdm_for_each(pwrdms_setup, (void *)d);
 
@@ -95,14 +95,29 @@ extern int omap2_pm_debug;
 extern void omap3_cpuidle_update_states(void);
 #endif
 
+/* Context save/restore phases of an OMAP3 CORE OFF transition */
+enum omap3_off_phase {
+	OFF_PHASE_PADCONF,
+	OFF_PHASE_CORE_SAVE,
+	OFF_PHASE_PRCM_SAVE,
+	OFF_PHASE_MUSB_SAVE,
+	OFF_PHASE_SECURE_SAVE,
+	OFF_PHASE_CORE_RESTORE,
+	OFF_PHASE_PRCM_RESTORE,
+	OFF_PHASE_MUSB_RESTORE,
+	OFF_PHASE_MAX,
+};
+
 #if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
 extern void pm_dbg_update_time(struct powerdomain *pwrdm, int prev);
 extern int pm_dbg_regset_save(int reg_set);
 extern int pm_dbg_regset_init(int reg_set);
+extern void pm_dbg_off_mode_time(const u32 *phase_ns, u32 skipped);
 #else
 #define pm_dbg_update_time(pwrdm, prev) do {} while (0);
 #define pm_dbg_regset_save(reg_set) do {} while (0);
 #define pm_dbg_regset_init(reg_set) do {} while (0);
+#define pm_dbg_off_mode_time(phase_ns, skipped) do {} while (0);
 #endif /* CONFIG_PM_DEBUG */
 
 extern void omap24xx_idle_loop_suspend(void);
@@ -95,6 +95,48 @@ static struct powerdomain *mpu_pwrdm, *neon_pwrdm;
 static struct powerdomain *core_pwrdm, *per_pwrdm;
 static struct powerdomain *cam_pwrdm, *dss_pwrdm;
 
+#if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
+static u32 off_phase_ns[OFF_PHASE_MAX];
+static u32 off_phase_skipped;
+static u64 off_phase_stamp;
+
+static inline void off_phase_begin(void)
+{
+	off_phase_stamp = sched_clock();
+}
+
+/* start of the save side; drops what an aborted transition left */
+static inline void off_phase_start(void)
+{
+	off_phase_skipped = 0;
+	off_phase_begin();
+}
+
+static inline void off_phase_end(int phase)
+{
+	u64 now = sched_clock();
+
+	off_phase_ns[phase] = now - off_phase_stamp;
+	off_phase_stamp = now;
+}
+
+static inline void off_phase_skip(int phase)
+{
+	off_phase_skipped |= 1 << phase;
+}
+
+static inline void off_phase_commit(void)
+{
+	pm_dbg_off_mode_time(off_phase_ns, off_phase_skipped);
+}
+#else
+static inline void off_phase_begin(void) { }
+static inline void off_phase_start(void) { }
+static inline void off_phase_end(int phase) { }
+static inline void off_phase_skip(int phase) { }
+static inline void off_phase_commit(void) { }
+#endif
+
 static void omap3_enable_io_chain(void)
 {
 	int timeout = 0;
@@ -128,21 +170,32 @@ static void omap3_core_save_context(void)
 {
 	u32 control_padconf_off;
 
-	/* Save the padconf registers */
-	control_padconf_off = omap_ctrl_readl(OMAP343X_CONTROL_PADCONF_OFF);
-	control_padconf_off |= START_PADCONF_SAVE;
-	omap_ctrl_writel(control_padconf_off, OMAP343X_CONTROL_PADCONF_OFF);
-	/* wait for the save to complete */
-	while (!(omap_ctrl_readl(OMAP343X_CONTROL_GENERAL_PURPOSE_STATUS)
-			& PADCONF_SAVE_DONE))
-		udelay(1);
-
 	/*
-	 * Force write last pad into memory, as this can fail in some
-	 * cases according to erratas 1.157, 1.185
+	 * Save the padconf registers, unless none of them was written
+	 * since the last save: the copy in the wakeup domain is kept
+	 * across OFF and is still current then.
 	 */
-	omap_ctrl_writel(omap_ctrl_readl(OMAP343X_PADCONF_ETK_D14),
-		OMAP343X_CONTROL_MEM_WKUP + 0x2a0);
+	if (omap3_control_padconf_need_save()) {
+		control_padconf_off =
+			omap_ctrl_readl(OMAP343X_CONTROL_PADCONF_OFF);
+		control_padconf_off |= START_PADCONF_SAVE;
+		omap_ctrl_writel(control_padconf_off,
+				OMAP343X_CONTROL_PADCONF_OFF);
+		/* wait for the save to complete */
+		while (!(omap_ctrl_readl(OMAP343X_CONTROL_GENERAL_PURPOSE_STATUS)
+				& PADCONF_SAVE_DONE))
+			udelay(1);
+
+		/*
+		 * Force write last pad into memory, as this can fail in some
+		 * cases according to erratas 1.157, 1.185
+		 */
+		omap_ctrl_writel(omap_ctrl_readl(OMAP343X_PADCONF_ETK_D14),
+			OMAP343X_CONTROL_MEM_WKUP + 0x2a0);
+	} else {
+		off_phase_skip(OFF_PHASE_PADCONF);
+	}
+	off_phase_end(OFF_PHASE_PADCONF);
 
 	/* Save the Interrupt controller context */
 	omap_intc_save_context();
@@ -182,12 +235,6 @@ int __init omap3_secure_copy_data_set(struct omap3_secure_copy_data *data)
 	return 0;
 }
 
-/*
- * FIXME: This function should be called before entering off-mode after
- * OMAP3 secure services have been accessed. Currently it is only called
- * once during boot sequence, but this works as we are not using secure
- * services.
- */
 static void omap3_save_secure_ram_context(u32 target_mpu_state)
 {
 	u32 ret;
@@ -618,12 +665,25 @@ void omap_sram_idle(void)
 					     OMAP3430_GR_MOD,
 					     OMAP3_PRM_VOLTCTRL_OFFSET);
 //&*&*&*BC1_110602: keep on uart clocks to fix the issue that BT can not pair with other BT device
+			off_phase_start();
 			omap3_core_save_context();
+			off_phase_end(OFF_PHASE_CORE_SAVE);
 			omap3_prcm_save_context();
+			off_phase_end(OFF_PHASE_PRCM_SAVE);
 			/* Save MUSB context */
 			musb_context_save_restore(save_context);
+			off_phase_end(OFF_PHASE_MUSB_SAVE);
+			/*
+			 * Secure services (PPA, and the secure drivers loaded
+			 * outside this tree) may change secure RAM at any time
+			 * and nothing tells us when, so it is saved on every
+			 * CORE OFF.
+			 */
 			if (omap_type() != OMAP2_DEVICE_TYPE_GP)
 				omap3_save_secure_ram_context(mpu_next_state);
+			else
+				off_phase_skip(OFF_PHASE_SECURE_SAVE);
+			off_phase_end(OFF_PHASE_SECURE_SAVE);
 		} else {
 //&*&*&*BC1_110817: for omap3 retention mode
 			if(g_enter_suspend)
@@ -680,12 +740,17 @@ void omap_sram_idle(void)
 	if (core_next_state < PWRDM_POWER_ON) {
 		core_prev_state = pwrdm_read_prev_pwrst(core_pwrdm);
 		if (core_prev_state == PWRDM_POWER_OFF) {
+			off_phase_begin();
 			omap3_core_restore_context();
+			off_phase_end(OFF_PHASE_CORE_RESTORE);
 			omap3_prcm_restore_context();
 			omap3_sram_restore_context();
 			omap2_sms_restore_context();
+			off_phase_end(OFF_PHASE_PRCM_RESTORE);
 			/* Restore MUSB context */
 			musb_context_save_restore(restore_context);
+			off_phase_end(OFF_PHASE_MUSB_RESTORE);
+			off_phase_commit();
 		} else {
 			musb_context_save_restore(enable_clk);
 		}
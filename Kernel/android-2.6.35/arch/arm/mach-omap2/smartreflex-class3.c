@@ -11,21 +11,273 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/kobject.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+
 #include <plat/smartreflex.h>
+#include <plat/voltage.h>
 
 #include "smartreflex-class3.h"
 
+#define MAX_VDDS 3
+
+/*
+ * After SR is enabled by an OPP transition the VP voltage is sampled
+ * until it has not moved for SR3_STABLE_SAMPLES samples in a row; that
+ * voltage is remembered for the OPP and the next transition to the OPP
+ * scales straight to it instead of to the nominal voltage, so the loop
+ * has little left to do. SR being switched off and on around idle does
+ * not change the OPP and does not start sampling.
+ */
+#define SR3_SAMPLING_DELAY_MS	2
+#define SR3_STABLE_SAMPLES	4
+#define SR3_MAX_SAMPLES		100
+
+/*
+ * Head room kept above a learned voltage when scaling to it, so a die
+ * warmer than when the voltage was learned is not short of voltage
+ * while the loop catches up. One TWL4030 SMPS step.
+ */
+#define SR3_RESTART_MARGIN_UV	12500
+
+/* Imported voltages further below nominal than this are refused */
+#define SR3_MAX_IMPORT_DROP_UV	200000
+
+/**
+ * struct sr_class3_opp - what the SR loop learned about one OPP
+ * @learned_uv:		VP voltage the loop last settled at, 0 if none
+ * @settled:		transitions after which the loop settled
+ * @unsettled:		transitions that ended, or timed out, before that
+ * @conv_last_us:	SR enable to last VP step, latest settled transition
+ * @conv_max_us:	worst of the above
+ * @conv_total_us:	sum of the above, for the average
+ */
+struct sr_class3_opp {
+	u32 learned_uv;
+	u32 settled;
+	u32 unsettled;
+	u32 conv_last_us;
+	u32 conv_max_us;
+	u64 conv_total_us;
+};
+
+/**
+ * struct sr_class3_vdd - class 3 state of one voltage domain
+ * @work:		VP sampling while the loop settles
+ * @lock:		protects the sampling state against the idle path
+ * @voltdm:		voltage domain
+ * @volt_data:		voltage table of the domain
+ * @volt_count:		entries in @volt_data and @opp
+ * @opp:		learned state, indexed like @volt_data
+ * @vdata:		OPP being sampled, NULL when not sampling
+ * @start:		time SR was enabled
+ * @last_change:	time the VP voltage last moved
+ * @last_uv:		VP voltage at the previous sample
+ * @samples:		samples taken since @start
+ * @stable:		consecutive samples without a VP step
+ * @sample_next:	sample after the next enable, set by OPP transitions
+ * @active:		class started for this domain
+ */
+struct sr_class3_vdd {
+	struct delayed_work work;
+	spinlock_t lock;
+	struct voltagedomain *voltdm;
+	struct omap_volt_data *volt_data;
+	int volt_count;
+	struct sr_class3_opp *opp;
+	struct omap_volt_data *vdata;
+	ktime_t start;
+	ktime_t last_change;
+	unsigned long last_uv;
+	u16 samples;
+	u8 stable;
+	bool sample_next;
+	bool active;
+};
+
+static struct sr_class3_vdd sr3_vdds[MAX_VDDS];
+static bool sr3_registered;
+
+static struct sr_class3_vdd *sr3_get_vdd(struct voltagedomain *voltdm)
+{
+	int idx;
+
+	for (idx = 0; idx < MAX_VDDS; idx++)
+		if (sr3_vdds[idx].voltdm == voltdm)
+			return &sr3_vdds[idx];
+	return NULL;
+}
+
+static struct sr_class3_vdd *sr3_get_vdd_by_name(const char *name)
+{
+	int idx;
+
+	for (idx = 0; idx < MAX_VDDS; idx++)
+		if (sr3_vdds[idx].voltdm &&
+		    !strcmp(sr3_vdds[idx].voltdm->name, name))
+			return &sr3_vdds[idx];
+	return NULL;
+}
+
+static struct sr_class3_opp *sr3_get_opp(struct sr_class3_vdd *v,
+					 struct omap_volt_data *vdata)
+{
+	int idx;
+
+	if (IS_ERR_OR_NULL(vdata))
+		return NULL;
+	idx = vdata - v->volt_data;
+	if (idx < 0 || idx >= v->volt_count)
+		return NULL;
+	return &v->opp[idx];
+}
+
+/* Make the next scaling to @vdata go to what was learned for it */
+static void sr3_apply(struct omap_volt_data *vdata, struct sr_class3_opp *opp)
+{
+	u32 uv = 0;
+
+	if (opp->learned_uv) {
+		uv = opp->learned_uv + SR3_RESTART_MARGIN_UV;
+		if (uv >= vdata->volt_nominal)
+			uv = 0;
+	}
+	vdata->volt_calibrated = uv;
+}
+
+static void sr3_settled(struct sr_class3_vdd *v, unsigned long uv)
+{
+	struct sr_class3_opp *opp = sr3_get_opp(v, v->vdata);
+	u32 us = ktime_us_delta(v->last_change, v->start);
+
+	opp->learned_uv = uv;
+	opp->settled++;
+	opp->conv_last_us = us;
+	opp->conv_total_us += us;
+	if (us > opp->conv_max_us)
+		opp->conv_max_us = us;
+	sr3_apply(v->vdata, opp);
+	v->vdata = NULL;
+}
+
+/*
+ * The loop did not settle. If it had to go above what was learned,
+ * start higher next time; never learn a lower voltage from this.
+ */
+static void sr3_unsettled(struct sr_class3_vdd *v, unsigned long uv)
+{
+	struct sr_class3_opp *opp = sr3_get_opp(v, v->vdata);
+
+	opp->unsettled++;
+	if (opp->learned_uv && uv > opp->learned_uv) {
+		opp->learned_uv = uv;
+		sr3_apply(v->vdata, opp);
+	}
+	v->vdata = NULL;
+}
+
+static void sr3_sample(struct work_struct *work)
+{
+	struct sr_class3_vdd *v =
+		container_of(work, struct sr_class3_vdd, work.work);
+	unsigned long uv;
+
+	spin_lock_irq(&v->lock);
+	/* SR was disabled while this was already running */
+	if (!v->vdata)
+		goto out;
+
+	uv = omap_vp_get_curr_volt(v->voltdm);
+	v->samples++;
+	if (uv != v->last_uv) {
+		v->last_uv = uv;
+		v->last_change = ktime_get();
+		v->stable = 0;
+	} else if (++v->stable >= SR3_STABLE_SAMPLES) {
+		sr3_settled(v, uv);
+		goto out;
+	}
+
+	if (v->samples >= SR3_MAX_SAMPLES) {
+		sr3_unsettled(v, uv);
+		goto out;
+	}
+	schedule_delayed_work(&v->work,
+			      msecs_to_jiffies(SR3_SAMPLING_DELAY_MS));
+out:
+	spin_unlock_irq(&v->lock);
+}
+
+/*
+ * Called with interrupts off from the idle path, so the work is only
+ * cancelled, not waited for; sr3_sample() sees @vdata cleared instead.
+ * Sampling cut short by idle is redone on the next enable, one cut
+ * short by an OPP change counts as unsettled.
+ */
+static void sr3_stop_sampling(struct sr_class3_vdd *v, int opp_change)
+{
+	unsigned long flags;
+
+	cancel_delayed_work(&v->work);
+	spin_lock_irqsave(&v->lock, flags);
+	if (v->vdata) {
+		if (opp_change) {
+			sr3_unsettled(v, omap_vp_get_curr_volt(v->voltdm));
+		} else {
+			v->vdata = NULL;
+			v->sample_next = true;
+		}
+	}
+	if (opp_change)
+		v->sample_next = true;
+	spin_unlock_irqrestore(&v->lock, flags);
+}
+
 static int sr_class3_enable(struct voltagedomain *voltdm,
 		struct omap_volt_data *volt_data)
 {
+	struct sr_class3_vdd *v = sr3_get_vdd(voltdm);
+	unsigned long flags;
+	int r;
+
 	omap_vp_enable(voltdm);
-	return sr_enable(voltdm, volt_data);
+	r = sr_enable(voltdm, volt_data);
+	if (r || !v || !sr3_get_opp(v, volt_data))
+		return r;
+
+	spin_lock_irqsave(&v->lock, flags);
+	if (v->sample_next) {
+		v->sample_next = false;
+		v->vdata = volt_data;
+		v->start = ktime_get();
+		v->last_change = v->start;
+		v->last_uv = omap_vp_get_curr_volt(voltdm);
+		v->samples = 0;
+		v->stable = 0;
+		schedule_delayed_work(&v->work,
+				      msecs_to_jiffies(SR3_SAMPLING_DELAY_MS));
+	}
+	spin_unlock_irqrestore(&v->lock, flags);
+	return 0;
 }
 
 static int sr_class3_disable(struct voltagedomain *voltdm,
 				struct omap_volt_data *vdata,
 				int is_volt_reset)
 {
+	struct sr_class3_vdd *v = sr3_get_vdd(voltdm);
+
+	/* Only OPP transitions and SR teardown ask for the voltage reset */
+	if (v)
+		sr3_stop_sampling(v, is_volt_reset);
 	omap_vp_disable(voltdm);
 	sr_disable(voltdm);
 	if (is_volt_reset)
@@ -39,17 +291,218 @@ static int sr_class3_configure(struct voltagedomain *voltdm)
 	return sr_configure_errgen(voltdm);
 }
 
+/*
+ * The learned voltages are kept for the life of the system, so the
+ * domain state is set up on the first start only and just re-applied
+ * on the next ones.
+ */
+static int sr_class3_start(struct voltagedomain *voltdm,
+			   void *class_priv_data)
+{
+	struct sr_class3_vdd *v = sr3_get_vdd(voltdm);
+	int idx;
+
+	if (!v) {
+		v = sr3_get_vdd(NULL);
+		if (!v) {
+			pr_err("%s: no more space for domain %s\n",
+			       __func__, voltdm->name);
+			return -ENOMEM;
+		}
+		v->volt_count = omap_voltage_get_volttable(voltdm,
+							   &v->volt_data);
+		if (!v->volt_count || !v->volt_data)
+			return -ENODATA;
+		v->opp = kcalloc(v->volt_count, sizeof(*v->opp), GFP_KERNEL);
+		if (!v->opp)
+			return -ENOMEM;
+		INIT_DELAYED_WORK_DEFERRABLE(&v->work, sr3_sample);
+		spin_lock_init(&v->lock);
+		v->voltdm = voltdm;
+	}
+
+	for (idx = 0; idx < v->volt_count; idx++)
+		sr3_apply(&v->volt_data[idx], &v->opp[idx]);
+	v->sample_next = true;
+	v->active = true;
+	return 0;
+}
+
+/* Without SR running the nominal voltages have to be used again */
+static int sr_class3_stop(struct voltagedomain *voltdm,
+			  void *class_priv_data)
+{
+	struct sr_class3_vdd *v = sr3_get_vdd(voltdm);
+
+	if (!v)
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&v->work);
+	spin_lock_irq(&v->lock);
+	if (v->vdata)
+		sr3_unsettled(v, omap_vp_get_curr_volt(v->voltdm));
+	v->sample_next = false;
+	spin_unlock_irq(&v->lock);
+	v->active = false;
+	omap_voltage_calib_reset(voltdm);
+	omap_voltage_reset(voltdm);
+	return 0;
+}
+
 /* SR class3 structure */
 static struct omap_smartreflex_class_data class3_data = {
 	.enable = sr_class3_enable,
 	.disable = sr_class3_disable,
 	.configure = sr_class3_configure,
+	.start = sr_class3_start,
+	.stop = sr_class3_stop,
 	.class_type = SR_CLASS3,
 };
 
+/*
+ * /sys/power/sr_class3_volts lists "<vdd> <nominal uV> <learned uV>" per
+ * OPP. Writing lines in the same format back, e.g. from a copy saved on
+ * the previous boot, seeds the learned voltages so the first transitions
+ * after boot do not have to start from nominal.
+ */
+static ssize_t sr3_volts_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	struct sr_class3_vdd *v;
+	char *p = buf;
+	int i, idx;
+
+	for (i = 0; i < MAX_VDDS; i++) {
+		v = &sr3_vdds[i];
+		if (!v->voltdm)
+			continue;
+		for (idx = 0; idx < v->volt_count; idx++)
+			p += scnprintf(p, buf + PAGE_SIZE - p, "%s %u %u\n",
+				       v->voltdm->name,
+				       v->volt_data[idx].volt_nominal,
+				       v->opp[idx].learned_uv);
+	}
+	return p - buf;
+}
+
+static int sr3_import(const char *name, u32 nominal, u32 learned)
+{
+	struct sr_class3_vdd *v = sr3_get_vdd_by_name(name);
+	int idx;
+
+	if (!v)
+		return -ENODEV;
+	if (learned && (learned > nominal ||
+			learned + SR3_MAX_IMPORT_DROP_UV < nominal))
+		return -ERANGE;
+
+	for (idx = 0; idx < v->volt_count; idx++) {
+		if (v->volt_data[idx].volt_nominal != nominal)
+			continue;
+		omap_vscale_pause(v->voltdm, false);
+		v->opp[idx].learned_uv = learned;
+		if (v->active)
+			sr3_apply(&v->volt_data[idx], &v->opp[idx]);
+		omap_vscale_unpause(v->voltdm);
+		return 0;
+	}
+	return -ENOENT;
+}
+
+static ssize_t sr3_volts_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t n)
+{
+	const char *p = buf, *end = buf + n;
+	char name[16];
+	u32 nominal, learned;
+	int r;
+
+	while (p < end) {
+		if (sscanf(p, "%15s %u %u", name, &nominal, &learned) != 3)
+			return -EINVAL;
+		r = sr3_import(name, nominal, learned);
+		if (r)
+			return r;
+		p = memchr(p, '\n', end - p);
+		if (!p)
+			break;
+		p++;
+	}
+	return n;
+}
+
+static struct kobj_attribute sr3_volts_attr =
+	__ATTR(sr_class3_volts, 0644, sr3_volts_show, sr3_volts_store);
+
+#ifdef CONFIG_PM_DEBUG
+static int sr3_stats_show(struct seq_file *s, void *unused)
+{
+	struct sr_class3_vdd *v;
+	struct sr_class3_opp *opp;
+	int i, idx;
+
+	seq_printf(s, "%-5s %10s %10s %8s %9s %8s %8s %8s\n", "vdd",
+		   "nominal", "learned", "settled", "unsettled",
+		   "last(us)", "avg(us)", "max(us)");
+	for (i = 0; i < MAX_VDDS; i++) {
+		v = &sr3_vdds[i];
+		if (!v->voltdm)
+			continue;
+		for (idx = 0; idx < v->volt_count; idx++) {
+			opp = &v->opp[idx];
+			seq_printf(s, "%-5s %10u %10u %8u %9u %8u %8u %8u\n",
+				   v->voltdm->name,
+				   v->volt_data[idx].volt_nominal,
+				   opp->learned_uv, opp->settled,
+				   opp->unsettled, opp->conv_last_us,
+				   opp->settled ? (u32)div_u64(
+					opp->conv_total_us, opp->settled) : 0,
+				   opp->conv_max_us);
+		}
+	}
+	return 0;
+}
+
+static int sr3_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sr3_stats_show, NULL);
+}
+
+static const struct file_operations sr3_stats_fops = {
+	.open		= sr3_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static int __init sr_class3_late_init(void)
+{
+	int r;
+
+	if (!sr3_registered)
+		return 0;
+
+	r = sysfs_create_file(power_kobj, &sr3_volts_attr.attr);
+	if (r)
+		pr_err("%s: sysfs_create_file failed: %d\n", __func__, r);
+#ifdef CONFIG_PM_DEBUG
+	if (sr_dbg_dir)
+		(void) debugfs_create_file("class3_stats", S_IRUGO, sr_dbg_dir,
+					   NULL, &sr3_stats_fops);
+#endif
+	return 0;
+}
+late_initcall(sr_class3_late_init);
+
 /* Smartreflex CLASS3 init API to be called from board file */
 int __init sr_class3_init(void)
 {
+	int r;
+
 	pr_info("SmartReflex CLASS3 initialized\n");
-	return omap_sr_register_class(&class3_data);
+	r = omap_sr_register_class(&class3_data);
+	sr3_registered = !r;
+	return r;
 }
@@ -65,7 +65,47 @@ static const char name[] = "musb_hdrc";
 
 static struct omap_hwmod *oh_p;
 
+/*
+ * Same 16KB budget as the core's fifo_mode 4, but the first three bulk
+ * endpoint pairs (which the android composite functions claim first:
+ * mass storage, adb, rndis) get double-buffered FIFOs so the Inventra
+ * DMA engine can fill one packet while the other is on the wire.  The
+ * 3KB this costs comes out of the large shared FIFO on ep13, which
+ * keeps room for one 1024 byte packet like ep14 and ep15.
+ */
+static struct musb_fifo_cfg musb_fifo_cfg[] = {
+{ .hw_ep_num =  1, .style = FIFO_TX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  1, .style = FIFO_RX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  2, .style = FIFO_TX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  2, .style = FIFO_RX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  3, .style = FIFO_TX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  3, .style = FIFO_RX,   .mode = BUF_DOUBLE, .maxpacket = 512, },
+{ .hw_ep_num =  4, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  4, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num =  5, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  5, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num =  6, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  6, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num =  7, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  7, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num =  8, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  8, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num =  9, .style = FIFO_TX,   .maxpacket = 512, },
+{ .hw_ep_num =  9, .style = FIFO_RX,   .maxpacket = 512, },
+{ .hw_ep_num = 10, .style = FIFO_TX,   .maxpacket = 256, },
+{ .hw_ep_num = 10, .style = FIFO_RX,   .maxpacket = 64, },
+{ .hw_ep_num = 11, .style = FIFO_TX,   .maxpacket = 256, },
+{ .hw_ep_num = 11, .style = FIFO_RX,   .maxpacket = 64, },
+{ .hw_ep_num = 12, .style = FIFO_TX,   .maxpacket = 256, },
+{ .hw_ep_num = 12, .style = FIFO_RX,   .maxpacket = 64, },
+{ .hw_ep_num = 13, .style = FIFO_RXTX, .maxpacket = 1024, },
+{ .hw_ep_num = 14, .style = FIFO_RXTX, .maxpacket = 1024, },
+{ .hw_ep_num = 15, .style = FIFO_RXTX, .maxpacket = 1024, },
+};
+
 static struct musb_hdrc_config musb_config = {
+	.fifo_cfg	= musb_fifo_cfg,
+	.fifo_cfg_size	= ARRAY_SIZE(musb_fifo_cfg),
 	.multipoint	= 1,
 	.dyn_fifo	= 1,
 	.num_eps	= 16,
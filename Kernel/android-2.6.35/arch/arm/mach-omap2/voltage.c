@@ -57,7 +57,22 @@
 
 #ifdef CONFIG_PM_DEBUG
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
 static struct dentry *voltage_dir;
+
+/*
+ * DVFS latency histogram: bucket 0 counts transitions below 32us, each
+ * following bucket doubles the limit and the last one collects >= 8ms.
+ */
+#define DVFS_LAT_BUCKETS	10
+#define DVFS_LAT_MIN_SHIFT	5
+
+struct omap_dvfs_lat_hist {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+	u32 bucket[DVFS_LAT_BUCKETS];
+};
 #endif
 
 /* VP SR debug support */
@@ -213,6 +228,11 @@ struct omap_vdd_info{
 	u8 prm_irqst_reg;
 	struct omap_volt_pmic_info *pmic;
 	struct device vdd_device;
+#ifdef CONFIG_PM_DEBUG
+	struct omap_dvfs_lat_hist lat_total;
+	struct omap_dvfs_lat_hist lat_volt;
+	struct omap_dvfs_lat_hist lat_rate;
+#endif
 };
 static struct omap_vdd_info *vdd_info;
 #ifdef CONFIG_OMAP_ABB
@@ -621,6 +641,91 @@ static const struct file_operations volt_users_dbg_fops = {
 	.release        = single_release,
 };
 
+static void dvfs_lat_record(struct omap_dvfs_lat_hist *hist, ktime_t start)
+{
+	u32 us = (u32) ktime_to_us(ktime_sub(ktime_get(), start));
+	int idx = 0;
+
+	if (us >> DVFS_LAT_MIN_SHIFT)
+		idx = min(fls(us >> DVFS_LAT_MIN_SHIFT), DVFS_LAT_BUCKETS - 1);
+
+	hist->bucket[idx]++;
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+static void dvfs_lat_show_hist(struct seq_file *s, const char *name,
+			       struct omap_dvfs_lat_hist *hist)
+{
+	u64 avg = hist->total_us;
+	int i;
+
+	if (hist->count)
+		do_div(avg, hist->count);
+
+	seq_printf(s, "%-6s count=%u avg=%lluus max=%uus\n", name,
+		   hist->count, avg, hist->max_us);
+	for (i = 0; i < DVFS_LAT_BUCKETS; i++) {
+		if (i < DVFS_LAT_BUCKETS - 1)
+			seq_printf(s, "\t< %5uus: %u\n",
+				   1 << (DVFS_LAT_MIN_SHIFT + i),
+				   hist->bucket[i]);
+		else
+			seq_printf(s, "\t>=%5uus: %u\n",
+				   1 << (DVFS_LAT_MIN_SHIFT + i - 1),
+				   hist->bucket[i]);
+	}
+}
+
+static int dvfs_lat_dbg_show(struct seq_file *s, void *unused)
+{
+	struct omap_vdd_info *vdd = s->private;
+
+	mutex_lock(&vdd->scaling_mutex);
+	dvfs_lat_show_hist(s, "total", &vdd->lat_total);
+	dvfs_lat_show_hist(s, "volt", &vdd->lat_volt);
+	dvfs_lat_show_hist(s, "rate", &vdd->lat_rate);
+	mutex_unlock(&vdd->scaling_mutex);
+
+	return 0;
+}
+
+static int dvfs_lat_dbg_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dvfs_lat_dbg_show, inode->i_private);
+}
+
+/* Any write clears the histograms */
+static ssize_t dvfs_lat_dbg_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct omap_vdd_info *vdd =
+		((struct seq_file *)file->private_data)->private;
+
+	mutex_lock(&vdd->scaling_mutex);
+	memset(&vdd->lat_total, 0, sizeof(vdd->lat_total));
+	memset(&vdd->lat_volt, 0, sizeof(vdd->lat_volt));
+	memset(&vdd->lat_rate, 0, sizeof(vdd->lat_rate));
+	mutex_unlock(&vdd->scaling_mutex);
+
+	return count;
+}
+
+static const struct file_operations dvfs_lat_dbg_fops = {
+	.open		= dvfs_lat_dbg_open,
+	.read		= seq_read,
+	.write		= dvfs_lat_dbg_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#define dvfs_lat_start(t)		((t) = ktime_get())
+#define dvfs_lat_end(vdd, hist, t)	dvfs_lat_record(&(vdd)->hist, t)
+#else
+#define dvfs_lat_start(t)		do { (void)(t); } while (0)
+#define dvfs_lat_end(vdd, hist, t)	do { } while (0)
 #endif
 
 static unsigned char omap_vdd_id(char *vdm)
@@ -1575,6 +1680,8 @@ static void __init vdd_data_configure(struct omap_vdd_info *vdd)
 				(void *) vdd, &dyn_volt_debug_fops);
 	(void) debugfs_create_file("curr_calibrated_volt", S_IRUGO, vdd_debug,
 				(void *) vdd, &calib_volt_debug_fops);
+	(void) debugfs_create_file("dvfs_latency", S_IRUGO | S_IWUSR,
+				vdd_debug, (void *) vdd, &dvfs_lat_dbg_fops);
 #ifdef CONFIG_OMAP_ABB
 	if (cpu_is_omap44xx() && !strcmp("vdd_iva", name))
 		(void) debugfs_create_u8("fbb_enable", S_IRUGO | S_IWUGO,
@@ -2500,12 +2607,14 @@ struct voltagedomain *omap_voltage_domain_get(char *name)
  */
 int omap_voltage_scale(struct voltagedomain *voltdm)
 {
+	struct omap_volt_data *curr_vdata;
 	unsigned long curr_volt;
 	int is_volt_scaled = 0, i;
 	bool is_sr_disabled = false;
 	struct omap_vdd_info *vdd;
 	struct plist_node *node;
 	unsigned long volt;
+	ktime_t t_total, t_step;
 
 	if (!voltdm || IS_ERR(voltdm)) {
 		pr_warning("%s: VDD specified does not exist!\n", __func__);
@@ -2515,9 +2624,14 @@ int omap_voltage_scale(struct voltagedomain *voltdm)
 	vdd = container_of(voltdm, struct omap_vdd_info, voltdm);
 
 	mutex_lock(&vdd->scaling_mutex);
+	dvfs_lat_start(t_total);
 
-	curr_volt = omap_get_operation_voltage(
-			omap_voltage_get_nom_volt(voltdm));
+	/*
+	 * User requests are nominal voltages; compare against the nominal
+	 * of the current OPP, not the calibrated voltage it may run at.
+	 */
+	curr_vdata = omap_voltage_get_nom_volt(voltdm);
+	curr_volt = IS_ERR_OR_NULL(curr_vdata) ? 0 : curr_vdata->volt_nominal;
 
 	/* Find the highest voltage for this vdd */
 	node = plist_last(&vdd->user_list);
@@ -2532,8 +2646,10 @@ int omap_voltage_scale(struct voltagedomain *voltdm)
 	if (curr_volt == volt) {
 		is_volt_scaled = 1;
 	} else if (curr_volt < volt) {
+		dvfs_lat_start(t_step);
 		omap_voltage_scale_vdd(voltdm,
 				omap_voltage_get_voltdata(voltdm, volt));
+		dvfs_lat_end(vdd, lat_volt, t_step);
 		is_volt_scaled = 1;
 	}
 
@@ -2553,17 +2669,23 @@ int omap_voltage_scale(struct voltagedomain *voltdm)
 		if (freq == opp_get_rate(vdd->dev_list[i]))
 			continue;
 
+		dvfs_lat_start(t_step);
 		opp_set_rate(vdd->dev_list[i], freq);
+		dvfs_lat_end(vdd, lat_rate, t_step);
 	}
 
-	if (!is_volt_scaled)
+	if (!is_volt_scaled) {
+		dvfs_lat_start(t_step);
 		omap_voltage_scale_vdd(voltdm,
 				omap_voltage_get_voltdata(voltdm, volt));
+		dvfs_lat_end(vdd, lat_volt, t_step);
+	}
 
 	/* Enable Smartreflex module */
 	if (is_sr_disabled)
 		omap_smartreflex_enable(voltdm);
 
+	dvfs_lat_end(vdd, lat_total, t_total);
 	mutex_unlock(&vdd->scaling_mutex);
 
 	/* calculate the voltages for dependent vdd's */
@@ -176,6 +176,10 @@ struct chnl_irp {
 	u32 byte_size;		/* Bytes transferred. */
 	u32 buf_size;		/* Actual buffer size when allocated. */
 	u32 status;		/* Status of IO completion. */
+	/* Pinned pages of a user buffer, copied to/from by the DPC */
+	struct page **pages;
+	u32 num_pages;
+	u32 page_offset;	/* Offset of the buffer in pages[0] */
 };
 
 #endif /* _CHNL_SM_ */
@@ -47,6 +47,9 @@ extern int dmm_reserve_memory(struct dmm_object *dmm_mgr,
 extern int dmm_un_reserve_memory(struct dmm_object *dmm_mgr,
 					u32 rsv_addr);
 
+extern int dmm_get_reserved_size(struct dmm_object *dmm_mgr,
+					u32 rsv_addr, u32 *psize);
+
 extern int dmm_map_memory(struct dmm_object *dmm_mgr, u32 addr,
 				 u32 size);
 
@@ -160,6 +160,11 @@ struct process_context {
 
 	/* Stream resources */
 	struct idr *strm_idp;
+
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	/* DSP mappings kept across proc_un_map(), see proc.c */
+	struct proc_map_cache *map_cache;
+#endif
 };
 
 /*
@@ -514,4 +519,7 @@ extern void mem_free_phys_mem(void *pVirtualAddress,
  */
 #define MEM_UNMAP_LINEAR_ADDRESS(pBaseAddr) {}
 
+/* Parent of the bridge debugfs entries, NULL if debugfs is unavailable */
+extern struct dentry *bridge_debugfs_dir;
+
 #endif /* DRV_ */
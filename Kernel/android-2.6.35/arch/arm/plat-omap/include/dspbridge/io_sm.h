@@ -292,6 +292,15 @@ extern void io_and_set_value(struct wmd_dev_context *hDevContext,
 
 extern void io_intr_dsp2(IN struct io_mgr *pio_mgr, IN u16 mb_val);
 
+/*
+ *  ======== io_post_dsp_intr ========
+ *  Purpose:
+ *      Request a processor-copy interrupt to the DSP. Requests are
+ *      coalesced into one mailbox message sent at the end of the next DPC,
+ *      so the caller must schedule one (iosm_schedule).
+ */
+extern void io_post_dsp_intr(struct io_mgr *pio_mgr);
+
 extern void io_sm_init(void);
 
 /*
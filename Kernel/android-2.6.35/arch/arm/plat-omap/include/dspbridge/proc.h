@@ -598,4 +598,20 @@ extern int proc_un_reserve_memory(void *hprocessor,
 					 void *prsv_addr,
 					 struct process_context *pr_ctxt);
 
+/*
+ *  ======== proc_map_cache_destroy ========
+ *  Purpose:
+ *      Remove the DSP mappings proc_un_map() kept cached for a process
+ *      context. Called on release, after all mappings were unmapped.
+ *  Parameters:
+ *      pr_ctxt     :   The process context.
+ */
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+extern void proc_map_cache_destroy(struct process_context *pr_ctxt);
+#else
+static inline void proc_map_cache_destroy(struct process_context *pr_ctxt)
+{
+}
+#endif
+
 #endif /* PROC_ */
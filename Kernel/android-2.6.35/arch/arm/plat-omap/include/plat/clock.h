@@ -91,6 +91,25 @@ struct clksel {
 	const struct clksel_rate *rates;
 };
 
+/* Number of rounded rates remembered per DPLL, see omap2_dpll_round_rate() */
+#define DPLL_RATE_CACHE_SIZE	6
+
+/**
+ * struct dpll_rate_cache - precomputed DPLL settings for one target rate
+ * @target_rate: rate that was asked for
+ * @ref_rate: reference clock rate the settings were computed against
+ * @rate: rate actually produced by @m and @n
+ * @m: DPLL multiplier
+ * @n: DPLL divider
+ */
+struct dpll_rate_cache {
+	unsigned long		target_rate;
+	unsigned long		ref_rate;
+	unsigned long		rate;
+	u16			m;
+	u8			n;
+};
+
 /**
  * struct dpll_data - DPLL registers and integration data
  * @mult_div1_reg: register containing the DPLL M and N bitfields
@@ -108,6 +127,8 @@ struct clksel {
  * @min_divider: minimum valid non-bypass divider value (actual)
  * @max_divider: maximum valid non-bypass divider value (actual)
  * @modes: possible values of @enable_mask
+ * @rate_cache_next: slot of @rate_cache to replace next
+ * @rate_cache: recently rounded rates, flushed when @rate_tolerance changes
  * @autoidle_reg: register containing the DPLL autoidle mode bitfield
  * @idlest_reg: register containing the DPLL idle status bitfield
  * @autoidle_mask: mask of the DPLL autoidle mode bitfield in @autoidle_reg
@@ -150,6 +171,8 @@ struct dpll_data {
 	u8			min_divider;
 	u8			max_divider;
 	u8			modes;
+	u8			rate_cache_next;
+	struct dpll_rate_cache	rate_cache[DPLL_RATE_CACHE_SIZE];
 #if defined(CONFIG_ARCH_OMAP3) || defined(CONFIG_ARCH_OMAP4)
 	void __iomem		*autoidle_reg;
 	void __iomem		*idlest_reg;
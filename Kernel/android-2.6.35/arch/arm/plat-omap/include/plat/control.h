@@ -414,6 +414,8 @@ extern u32 *get_es3_restore_pointer(void);
 extern u32 omap3_arm_context[128];
 extern void omap3_control_save_context(void);
 extern void omap3_control_restore_context(void);
+extern void omap3_control_padconf_mark_dirty(void);
+extern int omap3_control_padconf_need_save(void);
 
 #else
 #define omap_ctrl_base_get()		0
@@ -425,6 +427,7 @@ extern void omap3_control_restore_context(void);
 #define omap_ctrl_writew(x, y)		WARN_ON(1)
 #define omap_ctrl_writel(x, y)		WARN_ON(1)
 #define omap4_ctrl_pad_writel(x, y)	WARN_ON(1)
+#define omap3_control_padconf_mark_dirty()	do {} while (0)
 #endif
 #endif	/* __ASSEMBLY__ */
 
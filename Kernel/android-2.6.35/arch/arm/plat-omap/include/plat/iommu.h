@@ -42,6 +42,9 @@ struct iommu {
 	u32		*iopgd;
 	spinlock_t	page_table_lock; /* protect iopgd */
 	int		nr_tlb_entries;
+	/* stored pagetable entries, indexed by MMU_CAM_PGSZ_* */
+	unsigned int	nr_iopte[4];
+	unsigned int	nr_faults;
 
 	struct list_head	mmap;
 	struct mutex		mmap_lock; /* protect mmap */
@@ -189,5 +192,6 @@ extern int foreach_iommu_device(void *data,
 
 extern ssize_t iommu_dump_ctx(struct iommu *obj, char *buf, ssize_t len);
 extern size_t dump_tlb_entries(struct iommu *obj, char *buf, ssize_t len);
+extern int iotlb_count_entries(struct iommu *obj, unsigned int *nr);
 extern int iommu_get_plat_data_size(void);
 #endif /* __MACH_IOMMU_H */
@@ -77,6 +77,9 @@ extern struct iovm_struct *find_iovm_area(struct iommu *obj, u32 da);
 extern u32 iommu_vmap(struct iommu *obj, u32 da,
 			const struct sg_table *sgt, u32 flags);
 extern struct sg_table *iommu_vunmap(struct iommu *obj, u32 da);
+extern u32 iommu_vmap_pages(struct iommu *obj, u32 da, struct page **pages,
+			    unsigned int nr_pages, u32 flags);
+extern void iommu_vunmap_pages(struct iommu *obj, u32 da);
 extern u32 iommu_vmalloc(struct iommu *obj, u32 da, size_t bytes,
 			   u32 flags);
 extern void iommu_vfree(struct iommu *obj, const u32 da);
@@ -88,4 +91,15 @@ extern u32 iommu_kmalloc(struct iommu *obj, u32 da, size_t bytes,
 extern void iommu_kfree(struct iommu *obj, u32 da);
 
 extern void *da_to_va(struct iommu *obj, u32 da);
+
+/* One run of iovmm_bench(), with superpages on or off */
+struct iovmm_bench_result {
+	unsigned int	map_us;		/* map all frames */
+	unsigned int	resize_us;	/* remap every frame at 3/4 size */
+	unsigned int	unmap_us;	/* unmap all frames */
+	unsigned int	nr_iopte[4];	/* entries the frames took, by pgsz */
+};
+
+extern int iovmm_bench(struct iommu *obj, unsigned int frames,
+		       size_t frame_bytes, struct iovmm_bench_result res[2]);
 #endif /* __IOMMU_MMAP_H */
@@ -13,6 +13,7 @@
 
 extern int __init omap_sram_init(void);
 extern void * omap_sram_push(void * start, unsigned long size);
+extern void *omap_sram_alloc(unsigned long size, unsigned long *phys);
 extern void omap_sram_reprogram_clock(u32 dpllctl, u32 ckctl);
 
 extern void omap2_sram_ddr_init(u32 *slow_dll_ctrl, u32 fast_dll_ctrl,
@@ -91,6 +91,117 @@ static ssize_t debug_read_tlb(struct file *file, char __user *userbuf,
 	return bytes;
 }
 
+/*
+ * The MMU has no hit/miss counters: report what the mappings cost in
+ * entries, and how much address space the TLB currently covers.
+ */
+static ssize_t debug_read_tlbstat(struct file *file, char __user *userbuf,
+				  size_t count, loff_t *ppos)
+{
+	struct iommu *obj = file->private_data;
+	unsigned int tlb[4] = { 0, };
+	unsigned int pte[4];
+	char buf[4 * MAXCOLUMN], *p = buf;
+	u32 reach = 0, mapped = 0;
+	int i, valid;
+
+	mutex_lock(&iommu_debug_lock);
+
+	spin_lock(&obj->page_table_lock);
+	memcpy(pte, obj->nr_iopte, sizeof(pte));
+	spin_unlock(&obj->page_table_lock);
+	valid = iotlb_count_entries(obj, tlb);
+
+	for (i = 0; i < ARRAY_SIZE(pte); i++) {
+		mapped += pte[i] * (iopgsz_to_bytes(i) / SZ_1K);
+		reach += tlb[i] * (iopgsz_to_bytes(i) / SZ_1K);
+	}
+
+	p += sprintf(p, "%-8s %6s %6s %6s %6s %10s\n", "", "16M", "1M",
+		     "64K", "4K", "KB");
+	p += sprintf(p, "%-8s %6u %6u %6u %6u %10u\n", "pte",
+		     pte[MMU_CAM_PGSZ_16M], pte[MMU_CAM_PGSZ_1M],
+		     pte[MMU_CAM_PGSZ_64K], pte[MMU_CAM_PGSZ_4K], mapped);
+	p += sprintf(p, "%-8s %6u %6u %6u %6u %10u\n", "tlb",
+		     tlb[MMU_CAM_PGSZ_16M], tlb[MMU_CAM_PGSZ_1M],
+		     tlb[MMU_CAM_PGSZ_64K], tlb[MMU_CAM_PGSZ_4K], reach);
+	p += sprintf(p, "tlb entries in use: %d/%d\n", valid,
+		     obj->nr_tlb_entries);
+	p += sprintf(p, "faults: %u\n", obj->nr_faults);
+
+	mutex_unlock(&iommu_debug_lock);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, p - buf);
+}
+
+/* Last iovmm_bench() report, protected by iommu_debug_lock */
+static char bench_buf[4 * MAXCOLUMN];
+static size_t bench_len;
+
+static ssize_t debug_read_bench(struct file *file, char __user *userbuf,
+				size_t count, loff_t *ppos)
+{
+	ssize_t bytes;
+
+	mutex_lock(&iommu_debug_lock);
+	bytes = simple_read_from_buffer(userbuf, count, ppos, bench_buf,
+					bench_len);
+	mutex_unlock(&iommu_debug_lock);
+
+	return bytes;
+}
+
+/*
+ * "<frames> [<frame KB>]": map that many frames with superpages on and
+ * then off, timing map, remap at a new size and unmap of all of them.
+ * This is the CPU side only; no device streams through the mappings, so
+ * the report says nothing about IOTLB misses during device traffic.
+ */
+static ssize_t debug_write_bench(struct file *file,
+		     const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	struct iommu *obj = file->private_data;
+	struct iovmm_bench_result res[2];
+	unsigned int frames, kb = 600;
+	char buf[MAXCOLUMN], *p = bench_buf;
+	int i, err;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u", &frames, &kb) < 1 ||
+	    !frames || frames > 256 || !kb || kb > SZ_16K)
+		return -EINVAL;
+
+	mutex_lock(&iommu_debug_lock);
+	err = iovmm_bench(obj, frames, kb * SZ_1K, res);
+	if (err) {
+		mutex_unlock(&iommu_debug_lock);
+		return err;
+	}
+
+	p += sprintf(p, "%u frames of %u KB, CPU side only "
+		     "(no device traffic measured)\n", frames, kb);
+	p += sprintf(p, "%-6s %9s %9s %9s %6s %6s %6s %6s\n", "super",
+		     "map(us)", "resz(us)", "unmap(us)", "16M", "1M", "64K",
+		     "4K");
+	for (i = 0; i < ARRAY_SIZE(res); i++)
+		p += sprintf(p, "%-6s %9u %9u %9u %6u %6u %6u %6u\n",
+			     i ? "off" : "on", res[i].map_us,
+			     res[i].resize_us, res[i].unmap_us,
+			     res[i].nr_iopte[MMU_CAM_PGSZ_16M],
+			     res[i].nr_iopte[MMU_CAM_PGSZ_1M],
+			     res[i].nr_iopte[MMU_CAM_PGSZ_64K],
+			     res[i].nr_iopte[MMU_CAM_PGSZ_4K]);
+	bench_len = p - bench_buf;
+	mutex_unlock(&iommu_debug_lock);
+
+	return count;
+}
+
 static ssize_t debug_write_pagetable(struct file *file,
 		     const char __user *userbuf, size_t count, loff_t *ppos)
 {
@@ -340,6 +451,8 @@ static int debug_open_generic(struct inode *inode, struct file *file)
 DEBUG_FOPS_RO(ver);
 DEBUG_FOPS_RO(regs);
 DEBUG_FOPS_RO(tlb);
+DEBUG_FOPS_RO(tlbstat);
+DEBUG_FOPS(bench);
 DEBUG_FOPS(pagetable);
 DEBUG_FOPS_RO(mmap);
 DEBUG_FOPS(mem);
@@ -378,6 +491,8 @@ static int iommu_debug_register(struct device *dev, void *data)
 	DEBUG_ADD_FILE_RO(ver);
 	DEBUG_ADD_FILE_RO(regs);
 	DEBUG_ADD_FILE_RO(tlb);
+	DEBUG_ADD_FILE_RO(tlbstat);
+	DEBUG_ADD_FILE(bench);
 	DEBUG_ADD_FILE(pagetable);
 	DEBUG_ADD_FILE_RO(mmap);
 	DEBUG_ADD_FILE(mem);
@@ -506,6 +506,32 @@ size_t dump_tlb_entries(struct iommu *obj, char *buf, ssize_t bytes)
 }
 EXPORT_SYMBOL_GPL(dump_tlb_entries);
 
+/**
+ * iotlb_count_entries - count valid tlb entries by page size
+ * @obj:	target iommu
+ * @nr:		counters indexed by MMU_CAM_PGSZ_*, incremented
+ *
+ * Returns the number of valid tlb entries.
+ **/
+int iotlb_count_entries(struct iommu *obj, unsigned int *nr)
+{
+	int i, valid = 0;
+	struct iotlb_lock saved;
+	struct cr_regs cr;
+
+	iotlb_lock_get(obj, &saved);
+	for_each_iotlb_cr(obj, obj->nr_tlb_entries, i, cr) {
+		if (!iotlb_cr_valid(&cr))
+			continue;
+		nr[cr.cam & MMU_CAM_PGSZ_MASK]++;
+		valid++;
+	}
+	iotlb_lock_set(obj, &saved);
+
+	return valid;
+}
+EXPORT_SYMBOL_GPL(iotlb_count_entries);
+
 int foreach_iommu_device(void *data, int (*fn)(struct device *, void *))
 {
 	return driver_for_each_device(&omap_iommu_driver.driver,
@@ -677,6 +703,8 @@ static int iopgtable_store_entry_core(struct iommu *obj, struct iotlb_entry *e)
 
 	spin_lock(&obj->page_table_lock);
 	err = fn(obj, e->da, e->pa, prot);
+	if (!err)
+		obj->nr_iopte[e->pgsz]++;
 	spin_unlock(&obj->page_table_lock);
 
 	return err;
@@ -742,6 +770,9 @@ static size_t iopgtable_clear_entry_core(struct iommu *obj, u32 da)
 			nent *= 16;
 			/* rewind to the 1st entry */
 			iopte = iopte_offset(iopgd, (da & IOLARGE_MASK));
+			obj->nr_iopte[MMU_CAM_PGSZ_64K]--;
+		} else if (*iopte) {
+			obj->nr_iopte[MMU_CAM_PGSZ_4K]--;
 		}
 		bytes *= nent;
 		memset(iopte, 0, nent * sizeof(*iopte));
@@ -763,6 +794,9 @@ static size_t iopgtable_clear_entry_core(struct iommu *obj, u32 da)
 			nent *= 16;
 			/* rewind to the 1st entry */
 			iopgd = iopgd_offset(obj, (da & IOSUPER_MASK));
+			obj->nr_iopte[MMU_CAM_PGSZ_16M]--;
+		} else {
+			obj->nr_iopte[MMU_CAM_PGSZ_1M]--;
 		}
 		bytes *= nent;
 	}
@@ -814,6 +848,7 @@ void iopgtable_clear_entry_all(struct iommu *obj)
 		*iopgd = 0;
 		flush_iopgd_range(iopgd, iopgd + 1);
 	}
+	memset(obj->nr_iopte, 0, sizeof(obj->nr_iopte));
 
 	flush_iotlb_all(obj);
 
@@ -863,6 +898,7 @@ static irqreturn_t iommu_fault_handler(int irq, void *data)
 	if (!obj->refcount)
 		return IRQ_NONE;
 
+	obj->nr_faults++;
 	eventfd_notification(obj);
 	/* Dynamic loading TLB or PTE */
 	err = iommu_notify_event(obj, IOMMU_FAULT, data);
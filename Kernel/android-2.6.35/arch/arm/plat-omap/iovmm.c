@@ -11,10 +11,15 @@
  */
 
 #include <linux/err.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/device.h>
 #include <linux/scatterlist.h>
+#include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/rwsem.h>
 
 #include <asm/cacheflush.h>
 #include <asm/mach/map.h>
@@ -38,8 +43,8 @@
  *  ---------------------------------------------------------------------------
  *  1 | c	c	c	 1 - 1 - 1	  _kmap() / _kunmap()	s
  *  2 | c	c,a	c	 1 - 1 - 1	_kmalloc()/ _kfree()	s
- *  3 | c	d	c	 1 - n - 1	  _vmap() / _vunmap()	s
- *  4 | c	d,a	c	 1 - n - 1	_vmalloc()/ _vfree()	n*
+ *  3 | c	d	c	 1 - n - 1	  _vmap() / _vunmap()	s*
+ *  4 | c	d,a	c	 1 - n - 1	_vmalloc()/ _vfree()	s*
  *
  *
  *	'iova':	device iommu virtual address
@@ -55,9 +60,26 @@
  *	'n':	a normal page(4KB) size is used.
  *	's':	multiple iommu superpage(16MB, 1MB, 64KB, 4KB) size is used.
  *
- *	'*':	not yet, but feasible.
+ *	'*':	superpages are used for the physically contiguous runs
+ *		of pages found in the buffer, if any.
  */
 static struct kmem_cache *iovm_area_cachep;
+
+/*
+ * Merge physically contiguous sg entries into the largest iommu pages
+ * both 'da' and 'pa' are aligned to. Off maps every sg entry on its own,
+ * which is handy for comparing the tlb pressure of the two.
+ */
+static bool iovmm_superpages = true;
+module_param_named(superpages, iovmm_superpages, bool, 0644);
+MODULE_PARM_DESC(superpages, "map contiguous runs with iommu superpages");
+
+/*
+ * Held for reading by every mapping, so iovmm_bench() can switch
+ * 'iovmm_superpages' while holding it for writing without changing the
+ * mode under someone else's mapping
+ */
+static DECLARE_RWSEM(iovmm_mode_sem);
 /* return total bytes of sg buffers */
 static size_t sgtable_len(const struct sg_table *sgt)
 {
@@ -273,7 +295,8 @@ static struct iovm_struct *alloc_iovm_area(struct iommu *obj, u32 da,
 		 * Reserve the first page for NULL
 		 */
 		start = PAGE_SIZE;
-		if (flags & IOVMF_LINEAR)
+		/* leave room for superpages over contiguous runs */
+		if ((flags & IOVMF_LINEAR) || iovmm_superpages)
 			alignement = iopgsz_max(bytes);
 		start = roundup(start, alignement);
 	}
@@ -379,7 +402,8 @@ static void sgtable_fill_vmalloc(struct sg_table *sgt, void *_va)
 		const size_t bytes = PAGE_SIZE;
 
 		/*
-		 * iommu 'superpage' isn't supported with 'iommu_vmalloc()'
+		 * one entry per page: map_iovm_area() merges the pages
+		 * which happen to be physically contiguous
 		 */
 		pg = vmalloc_to_page(va);
 		BUG_ON(!pg);
@@ -434,60 +458,49 @@ static inline void sgtable_drain_kmalloc(struct sg_table *sgt)
 	BUG_ON(!sgt);
 }
 
-/* create 'da' <-> 'pa' mapping from 'sgt' */
-static int map_iovm_area(struct iommu *obj, struct iovm_struct *new,
-			 const struct sg_table *sgt, u32 flags)
+/* the largest iommu page mapping 'da' to 'pa' within 'len' bytes */
+static size_t iopgsz_fit(u32 da, u32 pa, size_t len)
 {
-	int err = 0;
-	unsigned int i, j;
-	struct scatterlist *sg;
-	u32 da = new->da_start;
+	int i;
+	const size_t pagesize[] = { SZ_16M, SZ_1M, SZ_64K, SZ_4K, };
 
-	if (!obj || !sgt)
-		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(pagesize); i++)
+		if ((len >= pagesize[i]) && IS_ALIGNED(da | pa, pagesize[i]))
+			return pagesize[i];
 
-	BUG_ON(!sgtable_ok(sgt));
+	return 0;
+}
 
-	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
-		u32 pa;
-		int pgsz;
+/* store the entries for a physically contiguous run */
+static int map_iovm_run(struct iommu *obj, u32 da, u32 pa, size_t len,
+			u32 flags)
+{
+	int err;
+
+	while (len) {
 		size_t bytes;
 		struct iotlb_entry e;
 
-		pa = sg_phys(sg);
-		bytes = sg_dma_len(sg);
+		bytes = iopgsz_fit(da, pa, len);
+		if (!bytes)
+			return -EINVAL;
 
 		flags &= ~IOVMF_PGSZ_MASK;
-		pgsz = bytes_to_iopgsz(bytes);
-		if (pgsz < 0)
-			goto err_out;
-		flags |= pgsz;
+		flags |= bytes_to_iopgsz(bytes);
 
-		pr_debug("%s: [%d] %08x %08x(%x)\n", __func__,
-			 i, da, pa, bytes);
+		pr_debug("%s: %08x %08x(%x)\n", __func__, da, pa, bytes);
 
 		iotlb_init_entry(&e, da, pa, flags);
 		err = iopgtable_store_entry(obj, &e);
 		if (err)
-			goto err_out;
+			return err;
 
 		da += bytes;
+		pa += bytes;
+		len -= bytes;
 	}
-	return 0;
-
-err_out:
-	da = new->da_start;
 
-	for_each_sg(sgt->sgl, sg, i, j) {
-		size_t bytes;
-
-		bytes = iopgtable_clear_entry(obj, da);
-
-		BUG_ON(!iopgsz_ok(bytes));
-
-		da += bytes;
-	}
-	return err;
+	return 0;
 }
 
 /* release 'da' <-> 'pa' mapping */
@@ -517,6 +530,60 @@ static void unmap_iovm_area(struct iommu *obj, struct iovm_struct *area)
 	BUG_ON(total);
 }
 
+/* create 'da' <-> 'pa' mapping from 'sgt' */
+static int map_iovm_area(struct iommu *obj, struct iovm_struct *new,
+			 const struct sg_table *sgt, u32 flags)
+{
+	int err = 0;
+	unsigned int i;
+	struct scatterlist *sg;
+	u32 da = new->da_start;
+	u32 run_da = da, run_pa = 0;
+	size_t run_len = 0;
+
+	if (!obj || !sgt)
+		return -EINVAL;
+
+	BUG_ON(!sgtable_ok(sgt));
+
+	for_each_sg(sgt->sgl, sg, sgt->nents, i) {
+		u32 pa;
+		size_t bytes;
+
+		pa = sg_phys(sg);
+		bytes = sg_dma_len(sg);
+
+		pr_debug("%s: [%d] %08x %08x(%x)\n", __func__,
+			 i, da, pa, bytes);
+
+		if (run_len && iovmm_superpages && (pa == run_pa + run_len)) {
+			run_len += bytes;
+		} else {
+			if (run_len) {
+				err = map_iovm_run(obj, run_da, run_pa,
+						   run_len, flags);
+				if (err)
+					goto err_out;
+			}
+			run_da = da;
+			run_pa = pa;
+			run_len = bytes;
+		}
+
+		da += bytes;
+	}
+
+	err = map_iovm_run(obj, run_da, run_pa, run_len, flags);
+	if (err)
+		goto err_out;
+
+	return 0;
+
+err_out:
+	unmap_iovm_area(obj, new);
+	return err;
+}
+
 /* template function for all unmapping */
 static struct sg_table *unmap_vm_area(struct iommu *obj, const u32 da,
 				      void (*fn)(const void *), u32 flags)
@@ -559,7 +626,7 @@ out:
 	return sgt;
 }
 
-static u32 map_iommu_region(struct iommu *obj, u32 da,
+static u32 __map_iommu_region(struct iommu *obj, u32 da,
 	      const struct sg_table *sgt, void *va, size_t bytes, u32 flags)
 {
 	int err = -ENOMEM;
@@ -592,6 +659,18 @@ err_alloc_iovma:
 	return err;
 }
 
+static u32 map_iommu_region(struct iommu *obj, u32 da,
+	      const struct sg_table *sgt, void *va, size_t bytes, u32 flags)
+{
+	u32 ret;
+
+	down_read(&iovmm_mode_sem);
+	ret = __map_iommu_region(obj, da, sgt, va, bytes, flags);
+	up_read(&iovmm_mode_sem);
+
+	return ret;
+}
+
 static inline u32 __iommu_vmap(struct iommu *obj, u32 da,
 		 const struct sg_table *sgt, void *va, size_t bytes, u32 flags)
 {
@@ -662,6 +741,234 @@ struct sg_table *iommu_vunmap(struct iommu *obj, u32 da)
 }
 EXPORT_SYMBOL_GPL(iommu_vunmap);
 
+/*
+ * @mode_held is set by iovmm_bench(), which already holds iovmm_mode_sem
+ * for writing
+ */
+static u32 __iommu_vmap_pages(struct iommu *obj, u32 da, struct page **pages,
+			      unsigned int nr_pages, u32 flags, bool mode_held)
+{
+	unsigned int i;
+	size_t bytes;
+	struct sg_table *sgt;
+	struct scatterlist *sg;
+
+	if (!obj || !obj->dev || !pages || !nr_pages)
+		return -EINVAL;
+
+	bytes = nr_pages * PAGE_SIZE;
+	flags &= IOVMF_HW_MASK;
+
+	sgt = sgtable_alloc(bytes, flags);
+	if (IS_ERR(sgt))
+		return PTR_ERR(sgt);
+
+	for_each_sg(sgt->sgl, sg, sgt->nents, i)
+		sg_set_page(sg, pages[i], PAGE_SIZE, 0);
+
+	flags |= IOVMF_DISCONT;
+	flags |= IOVMF_MMIO;
+	flags |= (da ? IOVMF_DA_FIXED : IOVMF_DA_ANON);
+
+	if (mode_held)
+		da = __map_iommu_region(obj, da, sgt, NULL, bytes, flags);
+	else
+		da = __iommu_vmap(obj, da, sgt, NULL, bytes, flags);
+	if (IS_ERR_VALUE(da))
+		sgtable_free(sgt);
+
+	return da;
+}
+
+/**
+ * iommu_vmap_pages  -  (d)-(p) address mapper for pinned pages
+ * @obj:	objective iommu
+ * @da:		iommu device virtual address, or 0 for any
+ * @pages:	pages to map, already pinned by the caller
+ * @nr_pages:	number of @pages
+ * @flags:	iovma and page property
+ *
+ * Creates a 1-n mapping of @pages, in order, and returns @da. Runs of
+ * physically contiguous pages get iommu superpages. The pages stay owned
+ * by the caller; release the mapping with 'iommu_vunmap_pages()'.
+ */
+u32 iommu_vmap_pages(struct iommu *obj, u32 da, struct page **pages,
+		     unsigned int nr_pages, u32 flags)
+{
+	return __iommu_vmap_pages(obj, da, pages, nr_pages, flags, false);
+}
+EXPORT_SYMBOL_GPL(iommu_vmap_pages);
+
+/**
+ * iommu_vunmap_pages  -  release mapping obtained by 'iommu_vmap_pages()'
+ * @obj:	objective iommu
+ * @da:		iommu device virtual address
+ *
+ * The pages themselves are left to the caller to unpin.
+ */
+void iommu_vunmap_pages(struct iommu *obj, u32 da)
+{
+	sgtable_free(iommu_vunmap(obj, da));
+}
+EXPORT_SYMBOL_GPL(iommu_vunmap_pages);
+
+/* Largest chunk iovmm_bench() allocates its frame from: 1MB */
+#define IOVMM_BENCH_MAX_ORDER	(20 - PAGE_SHIFT)
+
+/*
+ * Back one frame with chunks as large as the page allocator gives, so
+ * superpages have contiguous runs to work with; split into single
+ * pages so each can be freed on its own.
+ */
+static struct page **iovmm_bench_alloc(unsigned int nr_pages)
+{
+	struct page **pages, *page;
+	unsigned int i = 0, j;
+	int order;
+
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return NULL;
+
+	while (i < nr_pages) {
+		order = min_t(int, ilog2(nr_pages - i), IOVMM_BENCH_MAX_ORDER);
+		do {
+			page = alloc_pages(GFP_KERNEL |
+					   (order ? __GFP_NOWARN : 0), order);
+		} while (!page && order-- > 0);
+		if (!page)
+			goto err;
+		split_page(page, order);
+		for (j = 0; j < (1 << order); j++)
+			pages[i++] = page + j;
+	}
+	return pages;
+
+err:
+	while (i--)
+		__free_page(pages[i]);
+	kfree(pages);
+	return NULL;
+}
+
+static void iovmm_bench_free(struct page **pages, unsigned int nr_pages)
+{
+	while (nr_pages--)
+		__free_page(pages[nr_pages]);
+	kfree(pages);
+}
+
+static void iovmm_bench_iopte(struct iommu *obj, unsigned int *nr)
+{
+	spin_lock(&obj->page_table_lock);
+	memcpy(nr, obj->nr_iopte, sizeof(obj->nr_iopte));
+	spin_unlock(&obj->page_table_lock);
+}
+
+static int iovmm_bench_run(struct iommu *obj, u32 *da, unsigned int frames,
+			   struct page **pages, unsigned int nr_pages,
+			   struct iovmm_bench_result *res)
+{
+	const u32 flags = IOVMF_ENDIAN_LITTLE | IOVMF_ELSZ_8;
+	unsigned int before[4], after[4];
+	unsigned int i, f;
+	ktime_t t;
+	int err = 0;
+
+	iovmm_bench_iopte(obj, before);
+	t = ktime_get();
+	for (f = 0; f < frames; f++) {
+		da[f] = __iommu_vmap_pages(obj, 0, pages, nr_pages, flags,
+					   true);
+		if (IS_ERR_VALUE(da[f])) {
+			err = da[f];
+			goto out;
+		}
+	}
+	res->map_us = ktime_us_delta(ktime_get(), t);
+	iovmm_bench_iopte(obj, after);
+	for (i = 0; i < ARRAY_SIZE(after); i++)
+		res->nr_iopte[i] = after[i] - before[i];
+
+	/* What a new output size costs: drop each frame, map it smaller */
+	t = ktime_get();
+	for (f = 0; f < frames; f++) {
+		iommu_vunmap_pages(obj, da[f]);
+		da[f] = __iommu_vmap_pages(obj, 0, pages,
+					   max(nr_pages * 3 / 4, 1U), flags,
+					   true);
+		if (IS_ERR_VALUE(da[f])) {
+			err = da[f];
+			goto out;
+		}
+	}
+	res->resize_us = ktime_us_delta(ktime_get(), t);
+
+	t = ktime_get();
+	for (f = 0; f < frames; f++)
+		iommu_vunmap_pages(obj, da[f]);
+	res->unmap_us = ktime_us_delta(ktime_get(), t);
+	return 0;
+
+out:
+	while (f--)
+		iommu_vunmap_pages(obj, da[f]);
+	return err;
+}
+
+/**
+ * iovmm_bench  -  time mapping frames with and without superpages
+ * @obj:	objective iommu
+ * @frames:	number of frames mapped at a time
+ * @frame_bytes: size of each frame
+ * @res:	results, [0] with superpages and [1] without
+ *
+ * All frames alias one buffer allocated in chunks of up to 1MB, so the
+ * runs are as contiguous as a real frame from the page allocator would
+ * be. Only the CPU side is measured: map, remap and unmap time and the
+ * iopte sizes used. No device traffic goes through the mappings, so the
+ * IOTLB miss rate of a streaming device is not part of the result.
+ *
+ * The 'superpages' parameter is switched and restored with every other
+ * mapper held off, so they keep mapping in the configured mode.
+ */
+int iovmm_bench(struct iommu *obj, unsigned int frames, size_t frame_bytes,
+		struct iovmm_bench_result res[2])
+{
+	unsigned int nr_pages = PAGE_ALIGN(frame_bytes) >> PAGE_SHIFT;
+	bool saved;
+	struct page **pages;
+	u32 *da;
+	int err = -ENOMEM;
+
+	if (!obj || !frames || !nr_pages)
+		return -EINVAL;
+
+	memset(res, 0, 2 * sizeof(*res));
+	da = kcalloc(frames, sizeof(*da), GFP_KERNEL);
+	pages = iovmm_bench_alloc(nr_pages);
+	if (!da || !pages)
+		goto out;
+
+	down_write(&iovmm_mode_sem);
+	saved = iovmm_superpages;
+	iovmm_superpages = true;
+	err = iovmm_bench_run(obj, da, frames, pages, nr_pages, &res[0]);
+	if (!err) {
+		iovmm_superpages = false;
+		err = iovmm_bench_run(obj, da, frames, pages, nr_pages,
+				      &res[1]);
+	}
+	iovmm_superpages = saved;
+	up_write(&iovmm_mode_sem);
+out:
+	if (pages)
+		iovmm_bench_free(pages, nr_pages);
+	kfree(da);
+	return err;
+}
+EXPORT_SYMBOL_GPL(iovmm_bench);
+
 /**
  * iommu_vmalloc  -  (d)-(p)-(v) address allocator and mapper
  * @obj:	objective iommu
@@ -686,6 +686,37 @@ int omap_mcbsp_get_dma_op_mode(unsigned int id)
 }
 EXPORT_SYMBOL(omap_mcbsp_get_dma_op_mode);
 
+/*
+ * omap_mcbsp_set_dma_op_mode selects how the McBSP raises DMA requests,
+ * like the dma_op_mode sysfs attribute. It can only be changed while
+ * the port is not in use.
+ */
+int omap_mcbsp_set_dma_op_mode(unsigned int id, int dma_op_mode)
+{
+	struct omap_mcbsp *mcbsp;
+	int ret = 0;
+
+	if (!omap_mcbsp_check_valid_id(id)) {
+		printk(KERN_ERR "%s: Invalid id (%u)\n", __func__, id + 1);
+		return -ENODEV;
+	}
+	mcbsp = id_to_mcbsp_ptr(id);
+
+	if (dma_op_mode < MCBSP_DMA_MODE_ELEMENT ||
+	    dma_op_mode > MCBSP_DMA_MODE_FRAME)
+		return -EINVAL;
+
+	spin_lock_irq(&mcbsp->lock);
+	if (!mcbsp->free)
+		ret = -EBUSY;
+	else
+		mcbsp->dma_op_mode = dma_op_mode;
+	spin_unlock_irq(&mcbsp->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(omap_mcbsp_set_dma_op_mode);
+
 static inline void omap34xx_mcbsp_request(struct omap_mcbsp *mcbsp)
 {
 	/*
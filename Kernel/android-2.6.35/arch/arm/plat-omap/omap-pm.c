@@ -25,9 +25,16 @@
 /* Interface documentation is in mach/omap-pm.h */
 #include <plat/omap-pm.h>
 #include <plat/omap_device.h>
+#include <plat/common.h>
 #include <plat/powerdomain.h>
 #include <plat/clockdomain.h>
 
+#ifdef CONFIG_PM_DEBUG
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <plat/voltage.h>
+#endif
+
 static struct clk *mpu_clk = NULL;
 #define MPU_CLK         "arm_fck"
 struct cpufreq_frequency_table *mpu_freq_table = NULL;
@@ -40,6 +47,12 @@ static struct cpufreq_frequency_table *dsp_freq_table = NULL;
 static unsigned int dsp_req_id = 0;
 static unsigned int mpu_req_id = 0;
 static int ft_count = 0;
+
+/*
+ * DSP cycles per byte of L3 traffic used to turn the DSP OPP request
+ * into a bus throughput constraint for the IVA.
+ */
+#define DSP_L3_CYCLES_PER_BYTE	4
 #endif
 
 static DEFINE_MUTEX(bus_tput_mutex);
@@ -287,15 +300,72 @@ int omap_pm_set_max_mpu_wakeup_lat(struct pm_qos_request_list **qos_request,
 	return 0;
 }
 
-//&*&*&*HC1_20110720, temporarily fix L3 bus clock to 200 MHz (VDD2@1.2V)
-#if 0
-int omap_pm_set_min_bus_tput(struct device *dev, u8 agent_id, long r)
+/*
+ * L3 bandwidth governor
+ *
+ * Throughput constraints are summed over all devices in bus_tput. The
+ * aggregate (in KiB/s) is converted into an L3 clock rate assuming a
+ * 4-byte wide interconnect, and the lowest L3 OPP at or above that
+ * rate is selected.  VDD2 is only rescaled when the selected L3 OPP
+ * actually changes.
+ */
+static struct device dummy_l3_dev;
+static unsigned long bus_tput_l3_rate;
+
+static unsigned long bus_tput_to_l3_rate(struct device *l3_dev,
+					 unsigned long tput)
 {
+	unsigned long rate;
 
-	int ret;
+	/* Convert the throughput(in KiB/s) into Hz. */
+	if (tput > ULONG_MAX / 1000)
+		rate = ULONG_MAX;
+	else
+		rate = (tput * 1000) / 4;
+
+	if (IS_ERR(opp_find_freq_ceil(l3_dev, &rate))) {
+		rate = ULONG_MAX;
+		if (IS_ERR(opp_find_freq_floor(l3_dev, &rate)))
+			return 0;
+	}
+
+	return rate;
+}
+
+/* Must be called with bus_tput_mutex held */
+static int bus_tput_update(void)
+{
 	struct device *l3_dev;
-	static struct device dummy_l3_dev;
-	unsigned long target_level = 0;
+	unsigned long rate;
+	int ret;
+
+	l3_dev = omap2_get_l3_device();
+	if (!l3_dev) {
+		pr_err("Unable to get l3 device pointer");
+		return -EINVAL;
+	}
+
+	rate = bus_tput_to_l3_rate(l3_dev, bus_tput->target_level);
+	if (!rate || rate == bus_tput_l3_rate)
+		return 0;
+
+	ret = omap_device_set_rate(&dummy_l3_dev, l3_dev, rate);
+	if (ret) {
+		pr_err("Unable to change level for interconnect bandwidth "
+			"to %ld\n", rate);
+		return ret;
+	}
+
+	pr_debug("OMAP PM: L3 rate %lu Hz for %lu KiB/s\n", rate,
+		 bus_tput->target_level);
+	bus_tput_l3_rate = rate;
+
+	return 0;
+}
+
+int omap_pm_set_min_bus_tput(struct device *dev, u8 agent_id, long r)
+{
+	int ret;
 
 	if (!dev || (agent_id != OCP_INITIATOR_AGENT &&
 	    agent_id != OCP_TARGET_AGENT)) {
@@ -303,70 +373,80 @@ int omap_pm_set_min_bus_tput(struct device *dev, u8 agent_id, long r)
 		return -EINVAL;
 	};
 
+	if (!bus_tput)
+		return -ENODEV;
+
 	mutex_lock(&bus_tput_mutex);
 
-	l3_dev = omap2_get_l3_device();
-	if (!l3_dev) {
-		pr_err("Unable to get l3 device pointer");
-		ret = -EINVAL;
-		goto unlock;
-	}
-	if (r == -1) {
+	/* Both 0 and -1 are used by drivers to drop their constraint */
+	if (r <= 0) {
 		pr_debug("OMAP PM: remove min bus tput constraint for: "
 			"interconnect dev %s for agent_id %d\n", dev_name(dev),
 				agent_id);
-		target_level = remove_req_tput(dev, bus_tput);
+		if (user_lookup(dev, bus_tput))
+			remove_req_tput(dev, bus_tput);
 	} else {
 		pr_debug("OMAP PM: add min bus tput constraint for: "
 			"interconnect dev %s for agent_id %d: rate %ld KiB\n",
 				dev_name(dev), agent_id, r);
-		target_level = add_req_tput(dev, r, bus_tput);
+		add_req_tput(dev, r, bus_tput);
 	}
 
-	/* Convert the throughput(in KiB/s) into Hz. */
-	target_level = (target_level * 1000)/4;
-	ret = omap_device_set_rate(&dummy_l3_dev, l3_dev, target_level);
+	ret = bus_tput_update();
 
-	if (ret)
-		pr_err("Unable to change level for interconnect bandwidth to %ld\n",
-			target_level);
-unlock:
 	mutex_unlock(&bus_tput_mutex);
 	return ret;
 }
 
-#else
+#ifdef CONFIG_PM_DEBUG
+static int bus_tput_dbg_show(struct seq_file *s, void *unused)
+{
+	struct users *user;
 
-int omap_pm_set_min_bus_tput(struct device *dev, u8 agent_id, long r)
+	mutex_lock(&bus_tput_mutex);
+	seq_printf(s, "total %lu KiB/s, l3 %lu Hz\n",
+		   bus_tput->target_level, bus_tput_l3_rate);
+	list_for_each_entry(user, &bus_tput->users_list, node)
+		seq_printf(s, "%-24s %u KiB/s\n", dev_name(user->dev),
+			   user->level);
+	mutex_unlock(&bus_tput_mutex);
+
+	return 0;
+}
+
+static int bus_tput_dbg_open(struct inode *inode, struct file *file)
 {
+	return single_open(file, bus_tput_dbg_show, inode->i_private);
+}
 
-	if (!dev || (agent_id != OCP_INITIATOR_AGENT &&
-	    agent_id != OCP_TARGET_AGENT)) {
-		WARN(1, "OMAP PM: %s: invalid parameter(s)", __func__);
-		return -EINVAL;
-	};
+static const struct file_operations bus_tput_dbg_fops = {
+	.open		= bus_tput_dbg_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
 
-	if (r == 0)
-		pr_debug("OMAP PM: remove min bus tput constraint: "
-			 "dev %s for agent_id %d\n", dev_name(dev), agent_id);
-	else
-		pr_debug("OMAP PM: add min bus tput constraint: "
-			 "dev %s for agent_id %d: rate %ld KiB\n",
-			 dev_name(dev), agent_id, r);
+/*
+ * Apply the aggregate once the drivers have registered their boot time
+ * constraints, so L3 leaves the bootloader rate if nobody needs it.
+ */
+static int __init omap_pm_bus_tput_init(void)
+{
+	if (!bus_tput)
+		return 0;
 
-	/*
-	 * This code should model the interconnect and compute the
-	 * required clock frequency, convert that to a VDD2 OPP ID, then
-	 * set the VDD2 OPP appropriately.
-	 *
-	 * TI CDP code can call constraint_set here on the VDD2 OPP.
-	 */
+	mutex_lock(&bus_tput_mutex);
+	bus_tput_update();
+	mutex_unlock(&bus_tput_mutex);
 
+#ifdef CONFIG_PM_DEBUG
+	(void) debugfs_create_file("bus_tput", S_IRUGO, pm_dbg_main_dir,
+				   NULL, &bus_tput_dbg_fops);
+#endif
 	return 0;
 }
-
-#endif
-//&*&*&*HC2_20110720, temporarily fix L3 bus clock to 200 MHz (VDD2@1.2V)
+late_initcall(omap_pm_bus_tput_init);
 
 int omap_pm_set_max_dev_wakeup_lat(struct device *req_dev, struct device *dev,
 				   long t)
@@ -597,6 +677,14 @@ void omap_pm_dsp_set_min_opp(u8 opp_id)
 		if (initialize_tables())
 			return;
 
+	/*
+	 * The DSP asks for its lowest OPP when idle or about to
+	 * hibernate, so only hold an L3 constraint above that.
+	 */
+	omap_pm_set_min_bus_tput(iva_dev, OCP_INITIATOR_AGENT, dsp_req_id ?
+			(dsp_freq_table[dsp_req_id].frequency * 1000 /
+			 DSP_L3_CYCLES_PER_BYTE) / 1024 : -1);
+
 	/*
 	 *
 	 * For l-o dev tree, our VDD1 clk is keyed on OPP ID, so we
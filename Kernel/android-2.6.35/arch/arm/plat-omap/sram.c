@@ -78,6 +78,7 @@ static unsigned long omap_sram_start;
 static unsigned long omap_sram_base;
 static unsigned long omap_sram_size;
 static unsigned long omap_sram_ceil;
+static unsigned long omap_sram_floor;
 
 extern unsigned long omapfb_reserve_sram(unsigned long sram_pstart,
 					 unsigned long sram_vstart,
@@ -201,6 +202,7 @@ static void __init omap_detect_sram(void)
 	omap_sram_size -= reserved;
 
 	omap_sram_ceil = omap_sram_base + omap_sram_size;
+	omap_sram_floor = omap_sram_base + SRAM_BOOTLOADER_SZ;
 }
 
 static struct map_desc omap_sram_io_desc[] __initdata = {
@@ -278,7 +280,7 @@ static void __init omap_map_sram(void)
 
 void * omap_sram_push(void * start, unsigned long size)
 {
-	if (size > (omap_sram_ceil - (omap_sram_base + SRAM_BOOTLOADER_SZ))) {
+	if (size > (omap_sram_ceil - omap_sram_floor)) {
 		printk(KERN_ERR "Not enough space in SRAM\n");
 		return NULL;
 	}
@@ -292,6 +294,29 @@ void * omap_sram_push(void * start, unsigned long size)
 	return (void *)omap_sram_ceil;
 }
 
+/*
+ * Data buffers are carved from the bottom of SRAM, while code is pushed
+ * down from the top, so omap3_sram_restore_context() can re-push code
+ * without touching them. They are page aligned so that they can be
+ * mapped to user space. The space is never given back, and its contents
+ * are lost whenever CORE goes OFF.
+ */
+void *omap_sram_alloc(unsigned long size, unsigned long *phys)
+{
+	unsigned long addr = PAGE_ALIGN(omap_sram_floor);
+
+	if (!size || addr + size > omap_sram_ceil) {
+		printk(KERN_ERR "Not enough space in SRAM\n");
+		return NULL;
+	}
+
+	omap_sram_floor = addr + size;
+	*phys = omap_sram_start + (addr - omap_sram_base);
+
+	return (void *)addr;
+}
+EXPORT_SYMBOL(omap_sram_alloc);
+
 #ifdef CONFIG_ARCH_OMAP1
 
 static void (*_omap_sram_reprogram_clock)(u32 dpllctl, u32 ckctl);
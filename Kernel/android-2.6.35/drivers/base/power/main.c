@@ -523,6 +523,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
+	ktime_t starttime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
@@ -530,6 +531,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	if (dev->parent && (dev->parent->power.status >= DPM_OFF ||
 			    dev->parent->power.status == DPM_RESUMING))
 		dpm_wait(dev->parent, async);
+	starttime = dpm_timeline_start();
 	device_lock(dev);
 
 	dev->power.status = DPM_RESUMING;
@@ -567,6 +569,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  End:
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
+	dpm_timeline_record(dev, "resume", starttime, error, async);
 
 	TRACE_RESUME(error);
 	return error;
@@ -884,8 +887,10 @@ static int async_error;
 static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
+	ktime_t starttime;
 
 	dpm_wait_for_children(dev, async);
+	starttime = dpm_timeline_start();
 	device_lock(dev);
 
 	if (async_error)
@@ -928,6 +933,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
  End:
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
+	dpm_timeline_record(dev, "suspend", starttime, error, async);
 
 	return error;
 }
@@ -1112,6 +1118,7 @@ int dpm_suspend_start(pm_message_t state)
 	int error;
 
 	might_sleep();
+	dpm_timeline_reset();
 	error = dpm_prepare(state);
 	if (!error)
 		error = dpm_suspend(state);
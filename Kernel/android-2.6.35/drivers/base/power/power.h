@@ -30,6 +30,31 @@ extern void device_pm_move_before(struct device *, struct device *);
 extern void device_pm_move_after(struct device *, struct device *);
 extern void device_pm_move_last(struct device *);
 
+#ifdef CONFIG_PM_SLEEP_TIMELINE
+
+/* drivers/base/power/timeline.c */
+extern void dpm_timeline_reset(void);
+extern void dpm_timeline_record(struct device *dev, const char *phase,
+				ktime_t start, int error, bool async);
+
+static inline ktime_t dpm_timeline_start(void)
+{
+	return ktime_get();
+}
+
+#else /* !CONFIG_PM_SLEEP_TIMELINE */
+
+static inline void dpm_timeline_reset(void) {}
+static inline void dpm_timeline_record(struct device *dev, const char *phase,
+				       ktime_t start, int error, bool async) {}
+
+static inline ktime_t dpm_timeline_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+#endif /* !CONFIG_PM_SLEEP_TIMELINE */
+
 #else /* !CONFIG_PM_SLEEP */
 
 static inline void device_pm_init(struct device *dev)
@@ -0,0 +1,143 @@
+/*
+ * drivers/base/power/timeline.c
+ *
+ * Per-device suspend/resume timeline.  Every device handled by
+ * dpm_suspend()/dpm_resume() logs when its callbacks started and
+ * finished, relative to the start of the transition, and on which
+ * thread, so that serialisation between drivers and the effect of
+ * asynchronous suspend/resume can be read from
+ * /sys/kernel/debug/pm_timeline after a suspend cycle.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/device.h>
+#include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+
+#include "power.h"
+
+#define DPM_TIMELINE_ENTRIES	1024
+#define DPM_TIMELINE_NAME_LEN	24
+
+struct dpm_timeline_entry {
+	char		name[DPM_TIMELINE_NAME_LEN];
+	const char	*phase;
+	s64		start_us;
+	s64		end_us;
+	pid_t		pid;
+	int		error;
+	bool		async;
+};
+
+static struct dpm_timeline_entry dpm_timeline[DPM_TIMELINE_ENTRIES];
+static unsigned int dpm_timeline_len;
+static unsigned int dpm_timeline_dropped;
+static ktime_t dpm_timeline_base;
+static DEFINE_SPINLOCK(dpm_timeline_lock);
+
+/**
+ * dpm_timeline_reset - Start a new timeline.
+ *
+ * Called when a system sleep transition begins; all later timestamps
+ * are relative to this point.
+ */
+void dpm_timeline_reset(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_timeline_lock, flags);
+	dpm_timeline_len = 0;
+	dpm_timeline_dropped = 0;
+	dpm_timeline_base = ktime_get();
+	spin_unlock_irqrestore(&dpm_timeline_lock, flags);
+}
+
+/**
+ * dpm_timeline_record - Log one device callback.
+ * @dev: Device that was handled.
+ * @phase: Name of the PM phase.
+ * @start: Time the callbacks were entered, from dpm_timeline_start().
+ * @error: Return value of the callbacks.
+ * @async: Whether the device was handled asynchronously.
+ */
+void dpm_timeline_record(struct device *dev, const char *phase,
+			 ktime_t start, int error, bool async)
+{
+	struct dpm_timeline_entry *e;
+	ktime_t end = ktime_get();
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_timeline_lock, flags);
+	if (dpm_timeline_len >= DPM_TIMELINE_ENTRIES) {
+		dpm_timeline_dropped++;
+		goto out;
+	}
+	e = &dpm_timeline[dpm_timeline_len++];
+	strlcpy(e->name, dev_name(dev), sizeof(e->name));
+	e->phase = phase;
+	e->start_us = ktime_to_us(ktime_sub(start, dpm_timeline_base));
+	e->end_us = ktime_to_us(ktime_sub(end, dpm_timeline_base));
+	e->pid = task_pid_nr(current);
+	e->error = error;
+	e->async = async;
+ out:
+	spin_unlock_irqrestore(&dpm_timeline_lock, flags);
+}
+
+static int dpm_timeline_show(struct seq_file *s, void *unused)
+{
+	struct dpm_timeline_entry e;
+	unsigned int i;
+	unsigned long flags;
+
+	seq_printf(s, "%10s %10s %8s %6s %5s %-8s %s\n", "start(us)",
+		   "end(us)", "dur(us)", "pid", "async", "phase", "device");
+
+	for (i = 0; ; i++) {
+		spin_lock_irqsave(&dpm_timeline_lock, flags);
+		if (i >= dpm_timeline_len) {
+			spin_unlock_irqrestore(&dpm_timeline_lock, flags);
+			break;
+		}
+		e = dpm_timeline[i];
+		spin_unlock_irqrestore(&dpm_timeline_lock, flags);
+
+		seq_printf(s, "%10lld %10lld %8lld %6d %5c %-8s %s",
+			   e.start_us, e.end_us, e.end_us - e.start_us,
+			   e.pid, e.async ? 'y' : 'n', e.phase, e.name);
+		if (e.error)
+			seq_printf(s, " (error %d)", e.error);
+		seq_printf(s, "\n");
+	}
+
+	if (dpm_timeline_dropped)
+		seq_printf(s, "%u entries dropped\n", dpm_timeline_dropped);
+
+	return 0;
+}
+
+static int dpm_timeline_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_timeline_show, NULL);
+}
+
+static const struct file_operations dpm_timeline_fops = {
+	.open		= dpm_timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_timeline_init(void)
+{
+	debugfs_create_file("pm_timeline", S_IRUGO, NULL, NULL,
+			    &dpm_timeline_fops);
+	return 0;
+}
+late_initcall(dpm_timeline_init);
@@ -0,0 +1,538 @@
+/*
+ * CPUFreq interactive governor
+ *
+ * Jumps straight to a high speed when a CPU comes out of a long idle
+ * period busy, or when the user touches the screen, and holds the raised
+ * speed for a minimum time before stepping back down by sampled load.
+ *
+ * Based on the ondemand and hotplug governors
+ * Copyright (C)  2001 Russell King
+ *           (C)  2003 Venkatesh Pallipadi <venkatesh.pallipadi@intel.com>,
+ *                     Jun Nakajima <jun.nakajima@intel.com>
+ *           (C)  2010 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/input.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_interactive.h>
+
+/* at or above this load a CPU below hispeed_freq jumps straight to it */
+#define DEFAULT_GO_HISPEED_LOAD			(85)
+
+/* below hispeed_freq, pick the lowest frequency that keeps load under this */
+#define DEFAULT_TARGET_LOAD			(70)
+
+/* normal sampling period (uSec) */
+#define DEFAULT_TIMER_RATE			(20000)
+
+/* short sampling window (uSec) used right after a deferred idle exit */
+#define DEFAULT_FAST_RATE			(5000)
+
+/* minimum time (uSec) a raised frequency is held before stepping down */
+#define DEFAULT_MIN_SAMPLE_TIME			(80000)
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+		unsigned int event);
+static int interactive_boost(struct cpufreq_policy *policy);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_interactive = {
+	.name			= "interactive",
+	.governor		= cpufreq_governor_interactive,
+	.boost_cpu_freq		= interactive_boost,
+	.owner			= THIS_MODULE,
+};
+
+struct interactive_cpuinfo {
+	u64 prev_idle;
+	u64 prev_wall;
+	/* wall time (uSec) before which the frequency is not lowered */
+	u64 floor_until;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	struct delayed_work work;
+	int cpu;
+	unsigned int fast_path:1;
+	/*
+	 * percpu mutex that serializes governor start/stop and limit
+	 * changes with the sampling and input boost work.
+	 */
+	struct mutex timer_mutex;
+};
+static DEFINE_PER_CPU(struct interactive_cpuinfo, interactive_cpuinfo);
+
+static unsigned int interactive_enable;	/* number of CPUs using this policy */
+
+/*
+ * interactive_mutex protects the tunables against concurrent changes and
+ * interactive_enable in governor start/stop.
+ */
+static DEFINE_MUTEX(interactive_mutex);
+
+static struct workqueue_struct *kinteractive_wq;
+
+static void interactive_input_boost(struct work_struct *work);
+static DECLARE_WORK(input_boost_work, interactive_input_boost);
+static unsigned long input_boost_next;
+
+static struct interactive_tuners {
+	unsigned int hispeed_freq;
+	unsigned int go_hispeed_load;
+	unsigned int target_load;
+	unsigned int timer_rate;
+	unsigned int fast_rate;
+	unsigned int min_sample_time;
+	unsigned int input_boost;
+} tuners = {
+	.hispeed_freq =		0,	/* policy->max */
+	.go_hispeed_load =	DEFAULT_GO_HISPEED_LOAD,
+	.target_load =		DEFAULT_TARGET_LOAD,
+	.timer_rate =		DEFAULT_TIMER_RATE,
+	.fast_rate =		DEFAULT_FAST_RATE,
+	.min_sample_time =	DEFAULT_MIN_SAMPLE_TIME,
+	.input_boost =		1,
+};
+
+/************************** sysfs interface ************************/
+
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", tuners.object);			\
+}
+
+#define store_one(file_name, object, min, max)				\
+static ssize_t store_##file_name					\
+(struct kobject *a, struct attribute *b, const char *buf, size_t count)	\
+{									\
+	unsigned int input;						\
+	int ret;							\
+	ret = sscanf(buf, "%u", &input);				\
+	if (ret != 1 || input < (min) || input > (max))			\
+		return -EINVAL;						\
+									\
+	mutex_lock(&interactive_mutex);					\
+	tuners.object = input;						\
+	mutex_unlock(&interactive_mutex);				\
+									\
+	return count;							\
+}
+
+show_one(hispeed_freq, hispeed_freq);
+show_one(go_hispeed_load, go_hispeed_load);
+show_one(target_load, target_load);
+show_one(timer_rate, timer_rate);
+show_one(fast_rate, fast_rate);
+show_one(min_sample_time, min_sample_time);
+show_one(input_boost, input_boost);
+
+store_one(hispeed_freq, hispeed_freq, 0, UINT_MAX);
+store_one(go_hispeed_load, go_hispeed_load, 1, 100);
+store_one(target_load, target_load, 1, 100);
+store_one(timer_rate, timer_rate, 1000, 1000000);
+store_one(fast_rate, fast_rate, 1000, 1000000);
+store_one(min_sample_time, min_sample_time, 0, 10000000);
+store_one(input_boost, input_boost, 0, 1);
+
+define_one_global_rw(hispeed_freq);
+define_one_global_rw(go_hispeed_load);
+define_one_global_rw(target_load);
+define_one_global_rw(timer_rate);
+define_one_global_rw(fast_rate);
+define_one_global_rw(min_sample_time);
+define_one_global_rw(input_boost);
+
+static struct attribute *interactive_attributes[] = {
+	&hispeed_freq.attr,
+	&go_hispeed_load.attr,
+	&target_load.attr,
+	&timer_rate.attr,
+	&fast_rate.attr,
+	&min_sample_time.attr,
+	&input_boost.attr,
+	NULL
+};
+
+static struct attribute_group interactive_attr_group = {
+	.attrs = interactive_attributes,
+	.name = "interactive",
+};
+
+/************************** sysfs end ************************/
+
+static unsigned int interactive_hispeed(struct cpufreq_policy *policy)
+{
+	if (!tuners.hispeed_freq || tuners.hispeed_freq > policy->max)
+		return policy->max;
+	return tuners.hispeed_freq;
+}
+
+/* Caller holds info->timer_mutex */
+static void interactive_set_freq(struct interactive_cpuinfo *info,
+		unsigned int load, unsigned int freq, unsigned int reason)
+{
+	struct cpufreq_policy *policy = info->policy;
+	unsigned int index;
+
+	if (cpufreq_frequency_table_target(policy, info->freq_table, freq,
+				CPUFREQ_RELATION_L, &index))
+		return;
+
+	freq = info->freq_table[index].frequency;
+	if (freq == policy->cur)
+		return;
+
+	trace_cpufreq_interactive_target(info->cpu, load, policy->cur, freq,
+			reason);
+	__cpufreq_driver_target(policy, freq, CPUFREQ_RELATION_L);
+}
+
+/* Caller holds info->timer_mutex */
+static void interactive_boost_locked(struct interactive_cpuinfo *info,
+		unsigned int freq, unsigned int reason)
+{
+	info->floor_until = ktime_to_us(ktime_get()) + tuners.min_sample_time;
+	if (info->policy->cur < freq)
+		interactive_set_freq(info, 0, freq, reason);
+}
+
+static void interactive_sample(struct interactive_cpuinfo *info)
+{
+	struct cpufreq_policy *policy = info->policy;
+	unsigned int wall_time, idle_time, load, target, reason;
+	u64 idle, now;
+
+	idle = get_cpu_idle_time_us(info->cpu, &now);
+	wall_time = (unsigned int)(now - info->prev_wall);
+	idle_time = (unsigned int)(idle - info->prev_idle);
+	info->prev_wall = now;
+	info->prev_idle = idle;
+
+	/*
+	 * The sampling work is deferrable, so a sample that arrives much
+	 * later than scheduled means the CPU has only just left idle.  The
+	 * long idle period says nothing about the work that woke it, so
+	 * look at a short window of the wakeup itself before deciding.
+	 */
+	if (!info->fast_path && wall_time > 2 * tuners.timer_rate) {
+		info->fast_path = 1;
+		return;
+	}
+
+	if (!wall_time || idle_time >= wall_time)
+		load = 0;
+	else
+		load = 100 * (wall_time - idle_time) / wall_time;
+
+	if (load >= tuners.go_hispeed_load) {
+		info->floor_until = now + tuners.min_sample_time;
+		target = max(interactive_hispeed(policy),
+			     policy->cur * load / tuners.target_load);
+		reason = info->fast_path ? CPUFREQ_INTERACTIVE_IDLE_EXIT :
+			CPUFREQ_INTERACTIVE_RAMP_UP;
+	} else {
+		target = policy->cur * load / tuners.target_load;
+		reason = target > policy->cur ? CPUFREQ_INTERACTIVE_RAMP_UP :
+			CPUFREQ_INTERACTIVE_RAMP_DOWN;
+	}
+	info->fast_path = 0;
+
+	if (target < policy->cur && now < info->floor_until) {
+		trace_cpufreq_interactive_target(info->cpu, load, policy->cur,
+				target, CPUFREQ_INTERACTIVE_HOLD);
+		return;
+	}
+
+	interactive_set_freq(info, load, target, reason);
+}
+
+static void interactive_timer(struct work_struct *work)
+{
+	struct interactive_cpuinfo *info =
+		container_of(work, struct interactive_cpuinfo, work.work);
+	unsigned int delay;
+
+	mutex_lock(&info->timer_mutex);
+	if (!info->policy) {
+		mutex_unlock(&info->timer_mutex);
+		return;
+	}
+
+	interactive_sample(info);
+
+	delay = info->fast_path ? tuners.fast_rate : tuners.timer_rate;
+	queue_delayed_work_on(info->cpu, kinteractive_wq, &info->work,
+			usecs_to_jiffies(delay));
+	mutex_unlock(&info->timer_mutex);
+}
+
+static void interactive_input_boost(struct work_struct *work)
+{
+	struct interactive_cpuinfo *info;
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		info = &per_cpu(interactive_cpuinfo, cpu);
+
+		mutex_lock(&info->timer_mutex);
+		if (info->policy)
+			interactive_boost_locked(info,
+					interactive_hispeed(info->policy),
+					CPUFREQ_INTERACTIVE_INPUT);
+		mutex_unlock(&info->timer_mutex);
+	}
+}
+
+static int interactive_boost(struct cpufreq_policy *policy)
+{
+	struct interactive_cpuinfo *info;
+
+	info = &per_cpu(interactive_cpuinfo, policy->cpu);
+
+	mutex_lock(&info->timer_mutex);
+	if (info->policy)
+		interactive_boost_locked(info, policy->max,
+				CPUFREQ_INTERACTIVE_BOOST);
+	mutex_unlock(&info->timer_mutex);
+
+	return 0;
+}
+
+/************************** input boost ************************/
+
+/*
+ * Touch events arrive in atomic context every few milliseconds while a
+ * finger is down; kick the boost work at most once per sampling period.
+ */
+static void interactive_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	if (!interactive_enable || !tuners.input_boost)
+		return;
+
+	if (time_before(jiffies, input_boost_next))
+		return;
+	input_boost_next = jiffies + usecs_to_jiffies(tuners.timer_rate);
+
+	queue_work(kinteractive_wq, &input_boost_work);
+}
+
+static int interactive_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	/* Touch panels report a touch key; sensors reporting ABS_X do not */
+	if (!test_bit(EV_KEY, dev->evbit))
+		return -ENODEV;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free_handle;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister_handle;
+
+	return 0;
+
+ err_unregister_handle:
+	input_unregister_handle(handle);
+ err_free_handle:
+	kfree(handle);
+	return error;
+}
+
+static void interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* eGalax and EETI panels report ABS_MT_POSITION_X and/or ABS_X */
+static const struct input_device_id interactive_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	{ },
+};
+
+static struct input_handler interactive_input_handler = {
+	.event		= interactive_input_event,
+	.connect	= interactive_input_connect,
+	.disconnect	= interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= interactive_input_ids,
+};
+
+/************************** governor ************************/
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	unsigned int cpu = policy->cpu;
+	struct interactive_cpuinfo *info;
+	int rc;
+
+	info = &per_cpu(interactive_cpuinfo, cpu);
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if ((!cpu_online(cpu)) || (!policy->cur))
+			return -EINVAL;
+
+		info->freq_table = cpufreq_frequency_get_table(cpu);
+		if (!info->freq_table)
+			return -EINVAL;
+
+		mutex_lock(&interactive_mutex);
+		if (!interactive_enable) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&interactive_attr_group);
+			if (rc) {
+				mutex_unlock(&interactive_mutex);
+				return rc;
+			}
+		}
+		interactive_enable++;
+		mutex_unlock(&interactive_mutex);
+
+		mutex_lock(&info->timer_mutex);
+		info->cpu = cpu;
+		info->policy = policy;
+		info->fast_path = 0;
+		info->prev_idle = get_cpu_idle_time_us(cpu, &info->prev_wall);
+		info->floor_until = info->prev_wall + tuners.min_sample_time;
+		queue_delayed_work_on(cpu, kinteractive_wq, &info->work,
+				usecs_to_jiffies(tuners.timer_rate));
+		mutex_unlock(&info->timer_mutex);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&info->timer_mutex);
+		info->policy = NULL;
+		mutex_unlock(&info->timer_mutex);
+		cancel_delayed_work_sync(&info->work);
+
+		mutex_lock(&interactive_mutex);
+		interactive_enable--;
+		if (!interactive_enable)
+			sysfs_remove_group(cpufreq_global_kobject,
+					   &interactive_attr_group);
+		mutex_unlock(&interactive_mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&info->timer_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+				CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+				CPUFREQ_RELATION_L);
+		mutex_unlock(&info->timer_mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_gov_interactive_init(void)
+{
+	struct interactive_cpuinfo *info;
+	unsigned int cpu;
+	u64 wall;
+	int err;
+
+	if (get_cpu_idle_time_us(0, &wall) == -1ULL) {
+		pr_err("cpufreq-interactive: %s: assumes CONFIG_NO_HZ\n",
+				__func__);
+		return -EINVAL;
+	}
+
+	for_each_possible_cpu(cpu) {
+		info = &per_cpu(interactive_cpuinfo, cpu);
+		mutex_init(&info->timer_mutex);
+		INIT_DELAYED_WORK_DEFERRABLE(&info->work, interactive_timer);
+	}
+
+	/* Frequency changes wait on the voltage regulator; run them RT */
+	kinteractive_wq = create_rt_workqueue("kinteractive");
+	if (!kinteractive_wq) {
+		pr_err("Creation of kinteractive failed\n");
+		return -EFAULT;
+	}
+
+	err = input_register_handler(&interactive_input_handler);
+	if (err)
+		goto err_destroy_wq;
+
+	err = cpufreq_register_governor(&cpufreq_gov_interactive);
+	if (err)
+		goto err_unregister_input;
+
+	return 0;
+
+ err_unregister_input:
+	input_unregister_handler(&interactive_input_handler);
+ err_destroy_wq:
+	destroy_workqueue(kinteractive_wq);
+	return err;
+}
+
+static void __exit cpufreq_gov_interactive_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_interactive);
+	input_unregister_handler(&interactive_input_handler);
+	destroy_workqueue(kinteractive_wq);
+}
+
+MODULE_DESCRIPTION("'cpufreq_interactive' - cpufreq governor for latency sensitive, touch driven workloads");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+fs_initcall(cpufreq_gov_interactive_init);
+#else
+module_init(cpufreq_gov_interactive_init);
+#endif
+module_exit(cpufreq_gov_interactive_exit);
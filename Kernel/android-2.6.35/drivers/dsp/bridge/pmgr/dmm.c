@@ -23,6 +23,11 @@
 
 /*  ----------------------------------- Host OS */
 #include <dspbridge/host_os.h>
+#include <linux/rbtree.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/random.h>
+#include <linux/uaccess.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
 #include <dspbridge/std.h>
@@ -37,75 +42,180 @@
 /*  ----------------------------------- Platform Manager */
 #include <dspbridge/dev.h>
 #include <dspbridge/proc.h>
+#include <dspbridge/drv.h>
 
 /*  ----------------------------------- This */
 #include <dspbridge/dmm.h>
 
 /*  ----------------------------------- Defines, Data Structures, Typedefs */
-#define DMM_ADDR_VIRTUAL(a) \
-	(((struct map_page *)(a) - virtual_mapping_table) * PG_SIZE4K +\
-	dyn_mem_map_beg)
-#define DMM_ADDR_TO_INDEX(a) (((a) - dyn_mem_map_beg) / PG_SIZE4K)
+/*
+ * The DSP virtual address pool is split into regions, each either free or
+ * reserved, kept in an rbtree by address so that neighbours can be found
+ * for coalescing. Free regions are also kept in a second rbtree ordered by
+ * size, then address, which gives the best fit for a reservation in
+ * O(log n). Mapped blocks inside reserved regions live in a third tree,
+ * by address.
+ */
+struct dmm_region {
+	struct rb_node addr_node;	/* in region_root */
+	struct rb_node free_node;	/* in free_root while free */
+	u32 start;
+	u32 size;			/* bytes, page multiple */
+	bool reserved;
+};
+
+struct dmm_map {
+	struct rb_node node;		/* in map_root */
+	u32 start;
+	u32 size;
+};
 
 /* DMM Mgr */
 struct dmm_object {
 	/* Dmm Lock is used to serialize access mem manager for
 	 * multi-threads. */
 	spinlock_t dmm_lock;	/* Lock to access dmm mgr */
+	struct rb_root region_root;
+	struct rb_root free_root;
+	struct rb_root map_root;
+	u32 pool_start;		/* The Beginning of dynamic memory mapping */
+	u32 pool_size;
+	u32 free_bytes;
+	u32 num_regions;
+	u32 num_maps;
+	struct dentry *debugfs;
 };
 
 /*  ----------------------------------- Globals */
 static u32 refs;		/* module reference count */
-struct map_page {
-	u32 region_size:31;
-	u32 reserved:1;
-	u32 mapped_size:31;
-	u32 mapped:1;
-};
-
-/*  Create the free list */
-static struct map_page *virtual_mapping_table;
-static u32 free_region;		/* The index of free region */
-static u32 free_size;
-static u32 dyn_mem_map_beg;	/* The Beginning of dynamic memory mapping */
-static u32 table_size;		/* The size of virt and phys pages tables */
 
 /*  ----------------------------------- Function Prototypes */
-static struct map_page *get_region(u32 addr);
-static struct map_page *get_free_region(u32 aSize);
-static struct map_page *get_mapped_region(u32 aAddr);
+static struct dmm_region *get_region(struct dmm_object *dmm_obj, u32 addr);
+static struct dmm_region *get_free_region(struct dmm_object *dmm_obj,
+					  u32 size);
+static struct dmm_map *get_mapped_region(struct dmm_object *dmm_obj,
+					 u32 addr);
+static const struct file_operations dmm_debugfs_fops;
 #ifdef DSP_DMM_DEBUG
 u32 dmm_mem_map_dump(struct dmm_object *dmm_mgr);
 #endif
 
+static void region_insert(struct dmm_object *dmm_obj, struct dmm_region *r)
+{
+	struct rb_node **p = &dmm_obj->region_root.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (r->start < rb_entry(parent, struct dmm_region,
+					addr_node)->start)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&r->addr_node, parent, p);
+	rb_insert_color(&r->addr_node, &dmm_obj->region_root);
+	dmm_obj->num_regions++;
+}
+
+static void region_erase(struct dmm_object *dmm_obj, struct dmm_region *r)
+{
+	rb_erase(&r->addr_node, &dmm_obj->region_root);
+	dmm_obj->num_regions--;
+}
+
+static void free_insert(struct dmm_object *dmm_obj, struct dmm_region *r)
+{
+	struct rb_node **p = &dmm_obj->free_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct dmm_region *e;
+
+	while (*p) {
+		parent = *p;
+		e = rb_entry(parent, struct dmm_region, free_node);
+		if (r->size < e->size ||
+		    (r->size == e->size && r->start < e->start))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&r->free_node, parent, p);
+	rb_insert_color(&r->free_node, &dmm_obj->free_root);
+	dmm_obj->free_bytes += r->size;
+}
+
+static void free_erase(struct dmm_object *dmm_obj, struct dmm_region *r)
+{
+	rb_erase(&r->free_node, &dmm_obj->free_root);
+	dmm_obj->free_bytes -= r->size;
+}
+
+/* First mapped block at or above addr */
+static struct dmm_map *map_first_from(struct dmm_object *dmm_obj, u32 addr)
+{
+	struct rb_node *n = dmm_obj->map_root.rb_node;
+	struct dmm_map *m, *found = NULL;
+
+	while (n) {
+		m = rb_entry(n, struct dmm_map, node);
+		if (m->start >= addr) {
+			found = m;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	return found;
+}
+
+static void map_insert(struct dmm_object *dmm_obj, struct dmm_map *m)
+{
+	struct rb_node **p = &dmm_obj->map_root.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (m->start < rb_entry(parent, struct dmm_map, node)->start)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&m->node, parent, p);
+	rb_insert_color(&m->node, &dmm_obj->map_root);
+	dmm_obj->num_maps++;
+}
+
+static void map_erase(struct dmm_object *dmm_obj, struct dmm_map *m)
+{
+	rb_erase(&m->node, &dmm_obj->map_root);
+	dmm_obj->num_maps--;
+}
+
 /*  ======== dmm_create_tables ========
  *  Purpose:
- *      Create table to hold the information of physical address
- *      the buffer pages that is passed by the user, and the table
- *      to hold the information of the virtual memory that is reserved
- *      for DSP.
+ *      Create the region tree covering the DSP virtual address space
+ *      [addr, addr + size), initially one free region.
  */
 int dmm_create_tables(struct dmm_object *dmm_mgr, u32 addr, u32 size)
 {
 	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
+	struct dmm_region *r;
 	int status = 0;
 
 	status = dmm_delete_tables(dmm_obj);
 	if (DSP_SUCCEEDED(status)) {
-		dyn_mem_map_beg = addr;
-		table_size = PG_ALIGN_HIGH(size, PG_SIZE4K) / PG_SIZE4K;
-		/*  Create the free list */
-		virtual_mapping_table = __vmalloc(table_size *
-				sizeof(struct map_page), GFP_KERNEL |
-				__GFP_HIGHMEM | __GFP_ZERO, PAGE_KERNEL);
-		if (virtual_mapping_table == NULL)
+		r = kzalloc(sizeof(*r), GFP_KERNEL);
+		if (r == NULL) {
 			status = -ENOMEM;
-		else {
-			/* On successful allocation,
-			 * all entries are zero ('free') */
-			free_region = 0;
-			free_size = table_size * PG_SIZE4K;
-			virtual_mapping_table[0].region_size = table_size;
+		} else {
+			r->start = addr;
+			r->size = PG_ALIGN_HIGH(size, PG_SIZE4K);
+			spin_lock(&dmm_obj->dmm_lock);
+			dmm_obj->pool_start = r->start;
+			dmm_obj->pool_size = r->size;
+			region_insert(dmm_obj, r);
+			free_insert(dmm_obj, r);
+			spin_unlock(&dmm_obj->dmm_lock);
 		}
 	}
 
@@ -134,6 +244,14 @@ int dmm_create(OUT struct dmm_object **phDmmMgr,
 	dmm_obj = kzalloc(sizeof(struct dmm_object), GFP_KERNEL);
 	if (dmm_obj != NULL) {
 		spin_lock_init(&dmm_obj->dmm_lock);
+		dmm_obj->region_root = RB_ROOT;
+		dmm_obj->free_root = RB_ROOT;
+		dmm_obj->map_root = RB_ROOT;
+		dmm_obj->debugfs = debugfs_create_file("dmm",
+						       S_IRUGO | S_IWUSR,
+						       bridge_debugfs_dir,
+						       dmm_obj,
+						       &dmm_debugfs_fops);
 		*phDmmMgr = dmm_obj;
 	} else {
 		status = -ENOMEM;
@@ -155,8 +273,11 @@ int dmm_destroy(struct dmm_object *dmm_mgr)
 	DBC_REQUIRE(refs > 0);
 	if (dmm_mgr) {
 		status = dmm_delete_tables(dmm_obj);
-		if (DSP_SUCCEEDED(status))
+		if (DSP_SUCCEEDED(status)) {
+			if (!IS_ERR_OR_NULL(dmm_obj->debugfs))
+				debugfs_remove(dmm_obj->debugfs);
 			kfree(dmm_obj);
+		}
 	} else
 		status = -EFAULT;
 
@@ -170,13 +291,28 @@ int dmm_destroy(struct dmm_object *dmm_mgr)
  */
 int dmm_delete_tables(struct dmm_object *dmm_mgr)
 {
+	struct rb_node *n;
 	int status = 0;
 
 	DBC_REQUIRE(refs > 0);
 	/* Delete all DMM tables */
-	if (dmm_mgr)
-		vfree(virtual_mapping_table);
-	else
+	if (dmm_mgr) {
+		spin_lock(&dmm_mgr->dmm_lock);
+		while ((n = rb_first(&dmm_mgr->map_root))) {
+			map_erase(dmm_mgr, rb_entry(n, struct dmm_map, node));
+			kfree(rb_entry(n, struct dmm_map, node));
+		}
+		while ((n = rb_first(&dmm_mgr->region_root))) {
+			region_erase(dmm_mgr, rb_entry(n, struct dmm_region,
+						       addr_node));
+			kfree(rb_entry(n, struct dmm_region, addr_node));
+		}
+		dmm_mgr->free_root = RB_ROOT;
+		dmm_mgr->free_bytes = 0;
+		dmm_mgr->pool_start = 0;
+		dmm_mgr->pool_size = 0;
+		spin_unlock(&dmm_mgr->dmm_lock);
+	} else
 		status = -EFAULT;
 	return status;
 }
@@ -236,9 +372,6 @@ bool dmm_init(void)
 
 	DBC_ENSURE((ret && (refs > 0)) || (!ret && (refs >= 0)));
 
-	virtual_mapping_table = NULL;
-	table_size = 0;
-
 	return ret;
 }
 
@@ -246,30 +379,39 @@ bool dmm_init(void)
  *  ======== dmm_map_memory ========
  *  Purpose:
  *      Add a mapping block to the reserved chunk. DMM assumes that this block
- *  will be mapped in the DSP/IVA's address space. DMM returns an error if a
- *  mapping overlaps another one. This function stores the info that will be
- *  required later while unmapping the block.
+ *  will be mapped in the DSP/IVA's address space. This function stores the
+ *  info that will be required later while unmapping the block; mapping the
+ *  same address again replaces the stored size.
  */
 int dmm_map_memory(struct dmm_object *dmm_mgr, u32 addr, u32 size)
 {
 	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
-	struct map_page *chunk;
+	struct dmm_map *map, *new_map;
 	int status = 0;
 
+	new_map = kzalloc(sizeof(*new_map), GFP_KERNEL);
+	if (new_map == NULL)
+		return -ENOMEM;
+
 	spin_lock(&dmm_obj->dmm_lock);
-	/* Find the Reserved memory chunk containing the DSP block to
-	 * be mapped */
-	chunk = (struct map_page *)get_region(addr);
-	if (chunk != NULL) {
-		/* Mark the region 'mapped', leave the 'reserved' info as-is */
-		chunk->mapped = true;
-		chunk->mapped_size = (size / PG_SIZE4K);
-	} else
+	if (addr < dmm_obj->pool_start ||
+	    addr - dmm_obj->pool_start >= dmm_obj->pool_size) {
 		status = -ENOENT;
+	} else {
+		map = get_mapped_region(dmm_obj, addr);
+		if (map == NULL) {
+			map = new_map;
+			new_map = NULL;
+			map->start = addr;
+			map_insert(dmm_obj, map);
+		}
+		map->size = size;
+	}
 	spin_unlock(&dmm_obj->dmm_lock);
+	kfree(new_map);
 
-	dev_dbg(bridge, "%s dmm_mgr %p, addr %x, size %x\n\tstatus %i, "
-		"chunk %p", __func__, dmm_mgr, addr, size, status, chunk);
+	dev_dbg(bridge, "%s dmm_mgr %p, addr %x, size %x\n\tstatus %i\n",
+		__func__, dmm_mgr, addr, size, status);
 
 	return status;
 }
@@ -284,33 +426,31 @@ int dmm_reserve_memory(struct dmm_object *dmm_mgr, u32 size,
 {
 	int status = 0;
 	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
-	struct map_page *node;
+	struct dmm_region *node, *rest;
 	u32 rsv_addr = 0;
-	u32 rsv_size = 0;
+
+	/* The remainder of a split free region needs a node of its own */
+	rest = kzalloc(sizeof(*rest), GFP_KERNEL);
+	if (rest == NULL)
+		return -ENOMEM;
 
 	spin_lock(&dmm_obj->dmm_lock);
 
-	/* Try to get a DSP chunk from the free list */
-	node = get_free_region(size);
+	/* Smallest free region the chunk fits in */
+	node = get_free_region(dmm_obj, size);
 	if (node != NULL) {
-		/*  DSP chunk of given size is available. */
-		rsv_addr = DMM_ADDR_VIRTUAL(node);
-		/* Calculate the number entries to use */
-		rsv_size = size / PG_SIZE4K;
-		if (rsv_size < node->region_size) {
-			/* Mark remainder of free region */
-			node[rsv_size].mapped = false;
-			node[rsv_size].reserved = false;
-			node[rsv_size].region_size =
-			    node->region_size - rsv_size;
-			node[rsv_size].mapped_size = 0;
+		free_erase(dmm_obj, node);
+		if (size < node->size) {
+			/* The tail of the free region stays free */
+			rest->start = node->start + size;
+			rest->size = node->size - size;
+			region_insert(dmm_obj, rest);
+			free_insert(dmm_obj, rest);
+			rest = NULL;
+			node->size = size;
 		}
-		/*  get_region will return first fit chunk. But we only use what
-		   is requested. */
-		node->mapped = false;
 		node->reserved = true;
-		node->region_size = rsv_size;
-		node->mapped_size = 0;
+		rsv_addr = node->start;
 		/* Return the chunk's starting address */
 		*prsv_addr = rsv_addr;
 	} else
@@ -318,10 +458,11 @@ int dmm_reserve_memory(struct dmm_object *dmm_mgr, u32 size,
 		status = -ENOMEM;
 
 	spin_unlock(&dmm_obj->dmm_lock);
+	kfree(rest);
 
 	dev_dbg(bridge, "%s dmm_mgr %p, size %x, prsv_addr %p\n\tstatus %i, "
-		"rsv_addr %x, rsv_size %x\n", __func__, dmm_mgr, size,
-		prsv_addr, status, rsv_addr, rsv_size);
+		"rsv_addr %x\n", __func__, dmm_mgr, size, prsv_addr, status,
+		rsv_addr);
 
 	return status;
 }
@@ -334,24 +475,46 @@ int dmm_reserve_memory(struct dmm_object *dmm_mgr, u32 size,
 int dmm_un_map_memory(struct dmm_object *dmm_mgr, u32 addr, u32 *psize)
 {
 	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
-	struct map_page *chunk;
+	struct dmm_map *map;
 	int status = 0;
 
 	spin_lock(&dmm_obj->dmm_lock);
-	chunk = get_mapped_region(addr);
-	if (chunk == NULL)
+	map = get_mapped_region(dmm_obj, addr);
+	if (map == NULL) {
 		status = -ENOENT;
-
-	if (DSP_SUCCEEDED(status)) {
+	} else {
 		/* Unmap the region */
-		*psize = chunk->mapped_size * PG_SIZE4K;
-		chunk->mapped = false;
-		chunk->mapped_size = 0;
+		*psize = map->size;
+		map_erase(dmm_obj, map);
 	}
 	spin_unlock(&dmm_obj->dmm_lock);
+	kfree(map);
+
+	dev_dbg(bridge, "%s: dmm_mgr %p, addr %x, psize %p\n\tstatus %i\n",
+		__func__, dmm_mgr, addr, psize, status);
+
+	return status;
+}
+
+/*
+ *  ======== dmm_get_reserved_size ========
+ *  Purpose:
+ *      Return the size in bytes of the chunk reserved at rsv_addr.
+ */
+int dmm_get_reserved_size(struct dmm_object *dmm_mgr, u32 rsv_addr,
+			  u32 *psize)
+{
+	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
+	struct dmm_region *chunk;
+	int status = 0;
 
-	dev_dbg(bridge, "%s: dmm_mgr %p, addr %x, psize %p\n\tstatus %i, "
-		"chunk %p\n", __func__, dmm_mgr, addr, psize, status, chunk);
+	spin_lock(&dmm_obj->dmm_lock);
+	chunk = get_region(dmm_obj, rsv_addr);
+	if (chunk && chunk->reserved && chunk->start == rsv_addr)
+		*psize = chunk->size;
+	else
+		status = -ENOENT;
+	spin_unlock(&dmm_obj->dmm_lock);
 
 	return status;
 }
@@ -359,48 +522,59 @@ int dmm_un_map_memory(struct dmm_object *dmm_mgr, u32 addr, u32 *psize)
 /*
  *  ======== dmm_un_reserve_memory ========
  *  Purpose:
- *      Free a chunk of reserved DSP/IVA address space.
+ *      Free a chunk of reserved DSP/IVA address space, merging it with
+ *      free neighbours.
  */
 int dmm_un_reserve_memory(struct dmm_object *dmm_mgr, u32 rsv_addr)
 {
 	struct dmm_object *dmm_obj = (struct dmm_object *)dmm_mgr;
-	struct map_page *chunk;
-	u32 i;
+	struct dmm_region *chunk, *nb;
+	struct dmm_map *map;
+	struct rb_node *n;
 	int status = 0;
-	u32 chunk_size;
+	u32 end;
 
 	spin_lock(&dmm_obj->dmm_lock);
 
 	/* Find the chunk containing the reserved address */
-	chunk = get_mapped_region(rsv_addr);
-	if (chunk == NULL)
+	chunk = get_region(dmm_obj, rsv_addr);
+	if (chunk == NULL || !chunk->reserved || chunk->start != rsv_addr)
 		status = -ENOENT;
 
 	if (DSP_SUCCEEDED(status)) {
-		/* Free all the mapped pages for this reserved region */
-		i = 0;
-		while (i < chunk->region_size) {
-			if (chunk[i].mapped) {
-				/* Remove mapping from the page tables. */
-				chunk_size = chunk[i].mapped_size;
-				/* Clear the mapping flags */
-				chunk[i].mapped = false;
-				chunk[i].mapped_size = 0;
-				i += chunk_size;
-			} else
-				i++;
+		/* Forget all the mapped blocks of this reserved region */
+		end = chunk->start + chunk->size;
+		while ((map = map_first_from(dmm_obj, chunk->start)) &&
+		       map->start < end) {
+			map_erase(dmm_obj, map);
+			kfree(map);
 		}
-		/* Clear the flags (mark the region 'free') */
+		/* Mark the region 'free' and coalesce it with free
+		 * neighbours */
 		chunk->reserved = false;
-		/* NOTE: We do NOT coalesce free regions here.
-		 * Free regions are coalesced in get_region(), as it traverses
-		 *the whole mapping table
-		 */
+		n = rb_prev(&chunk->addr_node);
+		nb = n ? rb_entry(n, struct dmm_region, addr_node) : NULL;
+		if (nb && !nb->reserved) {
+			free_erase(dmm_obj, nb);
+			nb->size += chunk->size;
+			region_erase(dmm_obj, chunk);
+			kfree(chunk);
+			chunk = nb;
+		}
+		n = rb_next(&chunk->addr_node);
+		nb = n ? rb_entry(n, struct dmm_region, addr_node) : NULL;
+		if (nb && !nb->reserved) {
+			free_erase(dmm_obj, nb);
+			chunk->size += nb->size;
+			region_erase(dmm_obj, nb);
+			kfree(nb);
+		}
+		free_insert(dmm_obj, chunk);
 	}
 	spin_unlock(&dmm_obj->dmm_lock);
 
-	dev_dbg(bridge, "%s: dmm_mgr %p, rsv_addr %x\n\tstatus %i chunk %p",
-		__func__, dmm_mgr, rsv_addr, status, chunk);
+	dev_dbg(bridge, "%s: dmm_mgr %p, rsv_addr %x\n\tstatus %i\n",
+		__func__, dmm_mgr, rsv_addr, status);
 
 	return status;
 }
@@ -408,130 +582,252 @@ int dmm_un_reserve_memory(struct dmm_object *dmm_mgr, u32 rsv_addr)
 /*
  *  ======== get_region ========
  *  Purpose:
- *      Returns a region containing the specified memory region
+ *      Returns the region containing the specified address
  */
-static struct map_page *get_region(u32 aAddr)
+static struct dmm_region *get_region(struct dmm_object *dmm_obj, u32 addr)
 {
-	struct map_page *curr_region = NULL;
-	u32 i = 0;
-
-	if (virtual_mapping_table != NULL) {
-		/* find page mapped by this address */
-		i = DMM_ADDR_TO_INDEX(aAddr);
-		if (i < table_size)
-			curr_region = virtual_mapping_table + i;
+	struct rb_node *n = dmm_obj->region_root.rb_node;
+	struct dmm_region *r;
+
+	while (n) {
+		r = rb_entry(n, struct dmm_region, addr_node);
+		if (addr < r->start)
+			n = n->rb_left;
+		else if (addr - r->start >= r->size)
+			n = n->rb_right;
+		else
+			return r;
 	}
-
-	dev_dbg(bridge, "%s: curr_region %p, free_region %d, free_size %d\n",
-		__func__, curr_region, free_region, free_size);
-	return curr_region;
+	return NULL;
 }
 
 /*
  *  ======== get_free_region ========
  *  Purpose:
- *  Returns the requested free region
+ *      Returns the smallest free region of at least size bytes, the lowest
+ *      one among equals
  */
-static struct map_page *get_free_region(u32 aSize)
+static struct dmm_region *get_free_region(struct dmm_object *dmm_obj,
+					  u32 size)
 {
-	struct map_page *curr_region = NULL;
-	u32 i = 0;
-	u32 region_size = 0;
-	u32 next_i = 0;
-
-	if (virtual_mapping_table == NULL)
-		return curr_region;
-	if (aSize > free_size) {
-		/* Find the largest free region
-		 * (coalesce during the traversal) */
-		while (i < table_size) {
-			region_size = virtual_mapping_table[i].region_size;
-			next_i = i + region_size;
-			if (virtual_mapping_table[i].reserved == false) {
-				/* Coalesce, if possible */
-				if (next_i < table_size &&
-				    virtual_mapping_table[next_i].reserved
-				    == false) {
-					virtual_mapping_table[i].region_size +=
-					    virtual_mapping_table
-					    [next_i].region_size;
-					continue;
-				}
-				region_size *= PG_SIZE4K;
-				if (region_size > free_size) {
-					free_region = i;
-					free_size = region_size;
-				}
-			}
-			i = next_i;
+	struct rb_node *n = dmm_obj->free_root.rb_node;
+	struct dmm_region *r, *best = NULL;
+
+	while (n) {
+		r = rb_entry(n, struct dmm_region, free_node);
+		if (r->size >= size) {
+			best = r;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
 		}
 	}
-	if (aSize <= free_size) {
-		curr_region = virtual_mapping_table + free_region;
-		free_region += (aSize / PG_SIZE4K);
-		free_size -= aSize;
-	}
-	return curr_region;
+	return best;
 }
 
 /*
  *  ======== get_mapped_region ========
  *  Purpose:
- *  Returns the requestedmapped region
+ *      Returns the block mapped at the specified address
+ */
+static struct dmm_map *get_mapped_region(struct dmm_object *dmm_obj,
+					 u32 addr)
+{
+	struct dmm_map *map = map_first_from(dmm_obj, addr);
+
+	return (map && map->start == addr) ? map : NULL;
+}
+
+/*
+ * /sys/kernel/debug/dspbridge/dmm: DSP virtual address space usage.
+ * Writing a number runs the allocator self test, see dmm_selftest().
+ */
+static int dmm_debugfs_show(struct seq_file *s, void *unused)
+{
+	struct dmm_object *dmm_obj = s->private;
+	struct dmm_region *r, *largest = NULL;
+	struct dmm_map *map;
+	struct rb_node *n;
+	u32 end;
+
+	spin_lock(&dmm_obj->dmm_lock);
+	n = rb_last(&dmm_obj->free_root);
+	if (n)
+		largest = rb_entry(n, struct dmm_region, free_node);
+	seq_printf(s, "pool 0x%08x-0x%08x: %u KB free in %u regions, "
+		   "largest %u KB, %u maps\n", dmm_obj->pool_start,
+		   dmm_obj->pool_start + dmm_obj->pool_size,
+		   dmm_obj->free_bytes >> 10, dmm_obj->num_regions,
+		   largest ? largest->size >> 10 : 0, dmm_obj->num_maps);
+
+	for (n = rb_first(&dmm_obj->region_root); n; n = rb_next(n)) {
+		r = rb_entry(n, struct dmm_region, addr_node);
+		end = r->start + r->size;
+		seq_printf(s, "0x%08x-0x%08x %8u KB %s\n", r->start, end,
+			   r->size >> 10, r->reserved ? "reserved" : "free");
+		if (!r->reserved)
+			continue;
+		for (map = map_first_from(dmm_obj, r->start);
+		     map && map->start < end;
+		     map = rb_next(&map->node) ?
+		     rb_entry(rb_next(&map->node), struct dmm_map, node) :
+		     NULL)
+			seq_printf(s, "  map 0x%08x-0x%08x %8u KB\n",
+				   map->start, map->start + map->size,
+				   map->size >> 10);
+	}
+	spin_unlock(&dmm_obj->dmm_lock);
+
+	return 0;
+}
+
+/* Live reservations the self test keeps at a time */
+#define DMM_TEST_SLOTS		64
+/* Largest reservation the self test makes, in pages */
+#define DMM_TEST_MAX_PAGES	256
+
+/*
+ * Run iterations random reserve/map/unreserve steps on a scratch manager
+ * covering the same pool as dmm_obj, then release everything and check
+ * that the pool is back to a single free region. The live pool is not
+ * touched, so this is safe while the DSP is in use.
  */
-static struct map_page *get_mapped_region(u32 aAddr)
+static int dmm_selftest(struct dmm_object *dmm_obj, u32 iterations)
 {
-	u32 i = 0;
-	struct map_page *curr_region = NULL;
+	struct dmm_object *t;
+	u32 *addr, *size;
+	u32 pool_start, pool_size, got, i, slot;
+	int status;
+
+	spin_lock(&dmm_obj->dmm_lock);
+	pool_start = dmm_obj->pool_start;
+	pool_size = dmm_obj->pool_size;
+	spin_unlock(&dmm_obj->dmm_lock);
+	if (!pool_size)
+		return -ENODEV;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	addr = kcalloc(DMM_TEST_SLOTS, sizeof(*addr), GFP_KERNEL);
+	size = kcalloc(DMM_TEST_SLOTS, sizeof(*size), GFP_KERNEL);
+	if (!t || !addr || !size) {
+		status = -ENOMEM;
+		goto out;
+	}
+	spin_lock_init(&t->dmm_lock);
+	t->region_root = RB_ROOT;
+	t->free_root = RB_ROOT;
+	t->map_root = RB_ROOT;
+	status = dmm_create_tables(t, pool_start, pool_size);
+	if (DSP_FAILED(status))
+		goto out;
+
+	for (i = 0; i < iterations && DSP_SUCCEEDED(status); i++) {
+		slot = random32() % DMM_TEST_SLOTS;
+		if (size[slot]) {
+			status = dmm_un_reserve_memory(t, addr[slot]);
+			size[slot] = 0;
+			continue;
+		}
+		size[slot] = (random32() % DMM_TEST_MAX_PAGES + 1) * PG_SIZE4K;
+		if (DSP_FAILED(dmm_reserve_memory(t, size[slot],
+						  &addr[slot]))) {
+			/* Pool exhausted or too fragmented: not an error */
+			size[slot] = 0;
+			continue;
+		}
+		if (addr[slot] < pool_start || addr[slot] + size[slot] >
+		    pool_start + pool_size ||
+		    DSP_FAILED(dmm_get_reserved_size(t, addr[slot], &got)) ||
+		    got != size[slot]) {
+			pr_err("%s: bad reservation 0x%x size 0x%x\n",
+			       __func__, addr[slot], size[slot]);
+			status = -EFAULT;
+			break;
+		}
+		/* A block at the start and one in the second half */
+		status = dmm_map_memory(t, addr[slot], PG_SIZE4K);
+		if (DSP_SUCCEEDED(status) && size[slot] > PG_SIZE4K)
+			status = dmm_map_memory(t, addr[slot] +
+						(size[slot] / 2 & ~(PG_SIZE4K - 1)),
+						PG_SIZE4K);
+	}
+
+	for (slot = 0; slot < DMM_TEST_SLOTS; slot++)
+		if (size[slot] && DSP_FAILED(dmm_un_reserve_memory(t,
+							addr[slot])))
+			status = -EFAULT;
 
-	if (virtual_mapping_table == NULL)
-		return curr_region;
+	if (DSP_SUCCEEDED(status) && (t->free_bytes != pool_size ||
+				      t->num_regions != 1 || t->num_maps)) {
+		pr_err("%s: pool not restored: %u of %u bytes free in %u "
+		       "regions, %u maps\n", __func__, t->free_bytes,
+		       pool_size, t->num_regions, t->num_maps);
+		status = -EFAULT;
+	}
+	pr_info("%s: %u iterations, status %i\n", __func__, i, status);
+	dmm_delete_tables(t);
+out:
+	kfree(size);
+	kfree(addr);
+	kfree(t);
+	return status;
+}
+
+/* Writing N runs dmm_selftest() for N iterations */
+static ssize_t dmm_debugfs_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	char str[16];
+	unsigned long iterations;
+	int status;
+
+	if (count >= sizeof(str))
+		return -EINVAL;
+	if (copy_from_user(str, buf, count))
+		return -EFAULT;
+	str[count] = '\0';
+	if (strict_strtoul(strstrip(str), 0, &iterations) || !iterations)
+		return -EINVAL;
+
+	status = dmm_selftest(s->private, iterations);
+	return DSP_SUCCEEDED(status) ? count : status;
+}
 
-	i = DMM_ADDR_TO_INDEX(aAddr);
-	if (i < table_size && (virtual_mapping_table[i].mapped ||
-			       virtual_mapping_table[i].reserved))
-		curr_region = virtual_mapping_table + i;
-	return curr_region;
+static int dmm_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dmm_debugfs_show, inode->i_private);
 }
 
+static const struct file_operations dmm_debugfs_fops = {
+	.open		= dmm_debugfs_open,
+	.read		= seq_read,
+	.write		= dmm_debugfs_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 #ifdef DSP_DMM_DEBUG
 u32 dmm_mem_map_dump(struct dmm_object *dmm_mgr)
 {
-	struct map_page *curr_node = NULL;
-	u32 i;
-	u32 freemem = 0;
+	struct rb_node *n;
+	u32 freemem;
 	u32 bigsize = 0;
+	u32 pool_size;
 
 	spin_lock(&dmm_mgr->dmm_lock);
-
-	if (virtual_mapping_table != NULL) {
-		for (i = 0; i < table_size; i +=
-		     virtual_mapping_table[i].region_size) {
-			curr_node = virtual_mapping_table + i;
-			if (curr_node->reserved == TRUE) {
-				/*printk("RESERVED size = 0x%x, "
-				   "Map size = 0x%x\n",
-				   (curr_node->region_size * PG_SIZE4K),
-				   (curr_node->mapped == false) ? 0 :
-				   (curr_node->mapped_size * PG_SIZE4K));
-				 */
-			} else {
-/*				printk("UNRESERVED size = 0x%x\n",
-					(curr_node->region_size * PG_SIZE4K));
- */
-				freemem += (curr_node->region_size * PG_SIZE4K);
-				if (curr_node->region_size > bigsize)
-					bigsize = curr_node->region_size;
-			}
-		}
-	}
+	freemem = dmm_mgr->free_bytes;
+	pool_size = dmm_mgr->pool_size;
+	n = rb_last(&dmm_mgr->free_root);
+	if (n)
+		bigsize = rb_entry(n, struct dmm_region, free_node)->size;
 	spin_unlock(&dmm_mgr->dmm_lock);
 	printk(KERN_INFO "Total DSP VA FREE memory = %d Mbytes\n",
 	       freemem / (1024 * 1024));
 	printk(KERN_INFO "Total DSP VA USED memory= %d Mbytes\n",
-	       (((table_size * PG_SIZE4K) - freemem)) / (1024 * 1024));
+	       (pool_size - freemem) / (1024 * 1024));
 	printk(KERN_INFO "DSP VA - Biggest FREE block = %d Mbytes\n\n",
-	       (bigsize * PG_SIZE4K / (1024 * 1024)));
+	       bigsize / (1024 * 1024));
 
 	return 0;
 }
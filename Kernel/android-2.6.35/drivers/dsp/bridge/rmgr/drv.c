@@ -157,6 +157,7 @@ int drv_remove_all_dmm_res_elements(bhandle hPCtxt)
 			pr_err("%s: proc_un_map failed!"
 			       " status = %i\n", __func__, status);
 	}
+	proc_map_cache_destroy(ctxt);
 
 	/* Free DMM reserved memory resources */
 	list_for_each_entry_safe(rsv_obj, temp_rsv, &ctxt->dmm_rsv_list, link) {
@@ -30,6 +30,7 @@
 #include <linux/init.h>
 #include <linux/moduleparam.h>
 #include <linux/cdev.h>
+#include <linux/debugfs.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
 #include <dspbridge/std.h>
@@ -103,6 +104,9 @@ static DECLARE_COMPLETION(bridge_open_comp);
 static bool recover;
 #endif
 
+/* Root of the bridge's debugfs files: /sys/kernel/debug/dspbridge */
+struct dentry *bridge_debugfs_dir;
+
 static void bridge_create_sysfs(void);
 static void bridge_destroy_sysfs(void);
 
@@ -320,6 +324,11 @@ static int __devinit omap34_xx_bridge_probe(struct platform_device *pdev)
 	/* Global bridge device */
 	bridge = &omap_dspbridge_dev->dev;
 
+	/* Needed before startup: the driver layers add their entries there */
+	bridge_debugfs_dir = debugfs_create_dir("dspbridge", NULL);
+	if (IS_ERR(bridge_debugfs_dir))
+		bridge_debugfs_dir = NULL;
+
 	/* Bridge low level initializations */
 	status = omap3_bridge_startup(pdev);
 	if (status)
@@ -361,6 +370,8 @@ static int __devinit omap34_xx_bridge_probe(struct platform_device *pdev)
 err2:
 	unregister_chrdev_region(dev, 1);
 err1:
+	debugfs_remove_recursive(bridge_debugfs_dir);
+	bridge_debugfs_dir = NULL;
 	return status;
 }
 
@@ -399,6 +410,8 @@ func_cont:
 	services_exit();
 
 	bridge_destroy_sysfs();
+	debugfs_remove_recursive(bridge_debugfs_dir);
+	bridge_debugfs_dir = NULL;
 
 	devno = MKDEV(driver_major, 0);
 	cdev_del(&bridge_cdev);
@@ -18,6 +18,12 @@
 
 /* ------------------------------------ Host OS */
 #include <dspbridge/host_os.h>
+#include <linux/mmu_notifier.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
 #include <dspbridge/std.h>
@@ -109,6 +115,459 @@ static s32 get_envp_count(char **envp);
 static char **prepend_envp(char **new_envp, char **envp, s32 envp_elems,
 			   s32 cnew_envp, char *szVar);
 
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+/*
+ * Mapping cache.
+ *
+ * Media frameworks map and unmap the same recycled buffers on every frame.
+ * proc_un_map() of a user buffer therefore only gives back the DMM region
+ * and leaves the DSP MMU entries, and the page pins behind them, in place;
+ * a later proc_map() of the same user range at the same DSP address with
+ * the same attributes reuses them without any page table work.
+ *
+ * An MMU notifier on the owning mm marks entries stale when the user range
+ * is unmapped or its pages change. Stale entries are never reused; they
+ * and idle entries in the way of a new mapping, of an unreserve or beyond
+ * MAP_CACHE_IDLE_MAX are torn down under proc_lock by the next call that
+ * finds them. Before the DSP page tables are wiped all idle entries are
+ * torn down, as nothing could release their pages afterwards.
+ */
+#define MAP_CACHE_IDLE_MAX	16
+
+struct map_cache_entry {
+	struct list_head link;	/* most recently used first */
+	u32 mpu_addr;		/* page aligned user address */
+	u32 dsp_addr;		/* page aligned DSP address */
+	u32 size;
+	u32 map_attr;
+	u32 gen;		/* map_cache_gen when it was mapped */
+	bool in_use;		/* between proc_map() and proc_un_map() */
+	bool stale;		/* user range changed since it was mapped */
+};
+
+struct proc_map_cache {
+	struct mmu_notifier mn;
+	struct mm_struct *mm;
+	struct process_context *pr_ctxt;
+	struct list_head node;	/* on map_caches, under proc_lock */
+	spinlock_t lock;	/* entries list, stale flags, inval_seq */
+	struct list_head entries;
+	u32 idle;		/* entries not in use */
+	u32 inval_seq;		/* bumped by every invalidation */
+};
+
+/*
+ * Bumped whenever the DSP page tables are wiped (processor stop/reload);
+ * entries of an older generation no longer have page table entries.
+ */
+static u32 map_cache_gen;
+
+/* All caches, for map_cache_flush(); protected by proc_lock */
+static LIST_HEAD(map_caches);
+
+static struct {
+	u32 hits;
+	u32 misses;
+	u32 invalidations;
+	u32 evictions;
+} map_cache_stats;
+
+static struct dentry *map_cache_dentry;
+
+static void map_cache_invalidate(struct proc_map_cache *cache,
+				 unsigned long start, unsigned long end)
+{
+	struct map_cache_entry *e;
+
+	spin_lock(&cache->lock);
+	cache->inval_seq++;
+	list_for_each_entry(e, &cache->entries, link) {
+		if (!e->stale && e->mpu_addr < end &&
+		    start < e->mpu_addr + e->size) {
+			e->stale = true;
+			map_cache_stats.invalidations++;
+		}
+	}
+	spin_unlock(&cache->lock);
+}
+
+static void map_cache_invalidate_page(struct mmu_notifier *mn,
+				      struct mm_struct *mm,
+				      unsigned long address)
+{
+	map_cache_invalidate(container_of(mn, struct proc_map_cache, mn),
+			     address, address + PAGE_SIZE);
+}
+
+static void map_cache_invalidate_range_start(struct mmu_notifier *mn,
+					     struct mm_struct *mm,
+					     unsigned long start,
+					     unsigned long end)
+{
+	map_cache_invalidate(container_of(mn, struct proc_map_cache, mn),
+			     start, end);
+}
+
+static void map_cache_mm_release(struct mmu_notifier *mn,
+				 struct mm_struct *mm)
+{
+	map_cache_invalidate(container_of(mn, struct proc_map_cache, mn),
+			     0, ULONG_MAX);
+}
+
+static const struct mmu_notifier_ops map_cache_mmu_ops = {
+	.release		= map_cache_mm_release,
+	.invalidate_page	= map_cache_invalidate_page,
+	.invalidate_range_start	= map_cache_invalidate_range_start,
+};
+
+static inline void map_cache_invalidate_all(void)
+{
+	map_cache_gen++;
+}
+
+/* Whether a user mapping with these attributes may be cached */
+static inline bool map_cache_allowed(u32 map_attr)
+{
+	return !(map_attr & (DSP_MAPPHYSICALADDR | DSP_MAPVMALLOCADDR));
+}
+
+/*
+ *  ======== map_cache_get ========
+ *      Return the cache of the calling process, creating it on first use.
+ *      Called with proc_lock held and mmap_sem not held.
+ */
+static struct proc_map_cache *map_cache_get(struct process_context *pr_ctxt)
+{
+	struct proc_map_cache *cache = pr_ctxt->map_cache;
+	struct mm_struct *mm = current->mm;
+
+	if (cache)
+		return cache->mm == mm ? cache : NULL;
+	if (!mm)
+		return NULL;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return NULL;
+
+	spin_lock_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->entries);
+	cache->mn.ops = &map_cache_mmu_ops;
+	cache->mm = mm;
+	cache->pr_ctxt = pr_ctxt;
+	if (mmu_notifier_register(&cache->mn, mm)) {
+		kfree(cache);
+		return NULL;
+	}
+	/* Keep the mm_struct around for mmu_notifier_unregister() */
+	atomic_inc(&mm->mm_count);
+	pr_ctxt->map_cache = cache;
+	list_add(&cache->node, &map_caches);
+
+	return cache;
+}
+
+/*
+ *  ======== map_cache_sweep ========
+ *      Move idle entries that can no longer be reused, and the least
+ *      recently used idle entries over MAP_CACHE_IDLE_MAX, to drop.
+ *      Called with cache->lock held.
+ */
+static void map_cache_sweep(struct proc_map_cache *cache,
+			    struct list_head *drop)
+{
+	struct map_cache_entry *e, *tmp;
+
+	list_for_each_entry_safe_reverse(e, tmp, &cache->entries, link) {
+		if (e->in_use)
+			continue;
+		if (e->stale || e->gen != map_cache_gen ||
+		    cache->idle > MAP_CACHE_IDLE_MAX) {
+			list_move(&e->link, drop);
+			cache->idle--;
+		}
+	}
+}
+
+/*
+ *  ======== map_cache_drop ========
+ *      Tear down the DSP mappings of the entries on drop and free them.
+ *      Called with proc_lock held.
+ */
+static void map_cache_drop(struct proc_object *p_proc_object,
+			   struct list_head *drop)
+{
+	struct map_cache_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, drop, link) {
+		if (e->gen == map_cache_gen)
+			(*p_proc_object->intf_fxns->pfn_brd_mem_un_map)
+			    (p_proc_object->hwmd_context, e->dsp_addr,
+			     e->size);
+		map_cache_stats.evictions++;
+		list_del(&e->link);
+		kfree(e);
+	}
+}
+
+/*
+ *  ======== map_cache_lookup ========
+ *      Called with proc_lock held before [dsp_addr, dsp_addr + size) is
+ *      mapped. Returns true if an idle entry already maps this very buffer
+ *      there; otherwise idle entries in the way are torn down. *seq gets
+ *      the invalidation count for map_cache_insert().
+ */
+static bool map_cache_lookup(struct process_context *pr_ctxt,
+			     struct proc_object *p_proc_object,
+			     u32 mpu_addr, u32 dsp_addr, u32 size,
+			     u32 map_attr, u32 *seq)
+{
+	struct proc_map_cache *cache = map_cache_get(pr_ctxt);
+	struct map_cache_entry *e, *tmp, *hit = NULL;
+	LIST_HEAD(drop);
+
+	if (!cache)
+		return false;
+
+	spin_lock(&cache->lock);
+	*seq = cache->inval_seq;
+	map_cache_sweep(cache, &drop);
+	list_for_each_entry_safe(e, tmp, &cache->entries, link) {
+		if (e->in_use)
+			continue;
+		if (e->mpu_addr == mpu_addr && e->dsp_addr == dsp_addr &&
+		    e->size == size && e->map_attr == map_attr) {
+			hit = e;
+		} else if (e->dsp_addr < dsp_addr + size &&
+			   dsp_addr < e->dsp_addr + e->size) {
+			list_move(&e->link, &drop);
+			cache->idle--;
+		}
+	}
+	if (hit) {
+		hit->in_use = true;
+		list_move(&hit->link, &cache->entries);
+		cache->idle--;
+	}
+	spin_unlock(&cache->lock);
+
+	map_cache_drop(p_proc_object, &drop);
+	if (hit)
+		map_cache_stats.hits++;
+	else
+		map_cache_stats.misses++;
+
+	return hit != NULL;
+}
+
+/*
+ *  ======== map_cache_insert ========
+ *      Remember a mapping just made by the WMD. seq is the value returned
+ *      by map_cache_lookup() before mapping; if the user range may have
+ *      changed since, the entry starts out stale.
+ */
+static void map_cache_insert(struct process_context *pr_ctxt, u32 mpu_addr,
+			     u32 dsp_addr, u32 size, u32 map_attr, u32 seq)
+{
+	struct proc_map_cache *cache = map_cache_get(pr_ctxt);
+	struct map_cache_entry *e;
+
+	if (!cache)
+		return;
+
+	e = kzalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return;
+
+	e->mpu_addr = mpu_addr;
+	e->dsp_addr = dsp_addr;
+	e->size = size;
+	e->map_attr = map_attr;
+	e->gen = map_cache_gen;
+	e->in_use = true;
+
+	spin_lock(&cache->lock);
+	if (cache->inval_seq != seq)
+		e->stale = true;
+	list_add(&e->link, &cache->entries);
+	spin_unlock(&cache->lock);
+}
+
+/*
+ *  ======== map_cache_put ========
+ *      Called with proc_lock held when the mapping at dsp_addr is unmapped.
+ *      Returns true if the mapping was kept for reuse, false if the caller
+ *      has to remove it from the page tables.
+ */
+static bool map_cache_put(struct process_context *pr_ctxt,
+			  struct proc_object *p_proc_object, u32 dsp_addr)
+{
+	struct proc_map_cache *cache = pr_ctxt->map_cache;
+	struct map_cache_entry *e, *found = NULL;
+	LIST_HEAD(drop);
+
+	if (!cache)
+		return false;
+
+	spin_lock(&cache->lock);
+	list_for_each_entry(e, &cache->entries, link) {
+		if (e->in_use && e->dsp_addr == dsp_addr) {
+			found = e;
+			break;
+		}
+	}
+	if (!found) {
+		spin_unlock(&cache->lock);
+		return false;
+	}
+	if (found->stale || found->gen != map_cache_gen) {
+		list_del(&found->link);
+		spin_unlock(&cache->lock);
+		kfree(found);
+		return false;
+	}
+	found->in_use = false;
+	cache->idle++;
+	map_cache_sweep(cache, &drop);
+	spin_unlock(&cache->lock);
+
+	map_cache_drop(p_proc_object, &drop);
+
+	return true;
+}
+
+/*
+ *  ======== map_cache_evict_range ========
+ *      Tear down idle entries inside [dsp_addr, dsp_addr + size), e.g.
+ *      before the reservation holding them is released. Called with
+ *      proc_lock held.
+ */
+static void map_cache_evict_range(struct process_context *pr_ctxt,
+				  struct proc_object *p_proc_object,
+				  u32 dsp_addr, u32 size)
+{
+	struct proc_map_cache *cache = pr_ctxt->map_cache;
+	struct map_cache_entry *e, *tmp;
+	LIST_HEAD(drop);
+
+	if (!cache)
+		return;
+
+	spin_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->entries, link) {
+		if (!e->in_use && e->dsp_addr < dsp_addr + size &&
+		    dsp_addr < e->dsp_addr + e->size) {
+			list_move(&e->link, &drop);
+			cache->idle--;
+		}
+	}
+	spin_unlock(&cache->lock);
+
+	map_cache_drop(p_proc_object, &drop);
+}
+
+/*
+ *  ======== map_cache_flush ========
+ *      Tear down the idle entries of every process attached to the device
+ *      of p_proc_object. Called before its DSP page tables are wiped, as
+ *      the pages of entries left behind could not be released anymore.
+ */
+static void map_cache_flush(struct proc_object *p_proc_object)
+{
+	struct proc_map_cache *cache;
+	struct proc_object *owner;
+	struct map_cache_entry *e, *tmp;
+	LIST_HEAD(drop);
+
+	mutex_lock(&proc_lock);
+	list_for_each_entry(cache, &map_caches, node) {
+		owner = cache->pr_ctxt->hprocessor;
+		if (!owner || owner->hdev_obj != p_proc_object->hdev_obj)
+			continue;
+		spin_lock(&cache->lock);
+		list_for_each_entry_safe(e, tmp, &cache->entries, link) {
+			if (!e->in_use) {
+				list_move(&e->link, &drop);
+				cache->idle--;
+			}
+		}
+		spin_unlock(&cache->lock);
+	}
+	map_cache_drop(p_proc_object, &drop);
+	mutex_unlock(&proc_lock);
+}
+
+/*
+ *  ======== proc_map_cache_destroy ========
+ *  Purpose:
+ *      Tear down all cached mappings of a process context and drop its
+ *      MMU notifier. Called on release once the mappings have been unmapped,
+ *      and by proc_detach() while the processor is still known, so the
+ *      idle entries can always be unmapped and their pages released.
+ */
+void proc_map_cache_destroy(struct process_context *pr_ctxt)
+{
+	struct proc_map_cache *cache = pr_ctxt->map_cache;
+	struct map_cache_entry *e, *tmp;
+	LIST_HEAD(drop);
+
+	if (!cache)
+		return;
+
+	mutex_lock(&proc_lock);
+	spin_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->entries, link) {
+		if (e->in_use) {
+			/* Still mapped: left to proc_un_map()/proc_stop() */
+			list_del(&e->link);
+			kfree(e);
+		} else {
+			list_move(&e->link, &drop);
+		}
+	}
+	spin_unlock(&cache->lock);
+	/* Only a context that never attached has no processor, and no maps */
+	if (pr_ctxt->hprocessor)
+		map_cache_drop(pr_ctxt->hprocessor, &drop);
+	list_del(&cache->node);
+	pr_ctxt->map_cache = NULL;
+	mutex_unlock(&proc_lock);
+
+	mmu_notifier_unregister(&cache->mn, cache->mm);
+	mmdrop(cache->mm);
+	kfree(cache);
+}
+
+static int map_cache_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "hits %u misses %u invalidations %u evictions %u\n",
+		   map_cache_stats.hits, map_cache_stats.misses,
+		   map_cache_stats.invalidations, map_cache_stats.evictions);
+	return 0;
+}
+
+static int map_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, map_cache_show, NULL);
+}
+
+static const struct file_operations map_cache_fops = {
+	.open		= map_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#else
+static inline void map_cache_invalidate_all(void)
+{
+}
+
+static inline void map_cache_flush(struct proc_object *p_proc_object)
+{
+}
+#endif /* CONFIG_BRIDGE_MAP_CACHE */
+
 /*
  *  ======== proc_attach ========
  *  Purpose:
@@ -396,6 +855,7 @@ int proc_detach(struct process_context *pr_ctxt)
 	p_proc_object = (struct proc_object *)pr_ctxt->hprocessor;
 
 	if (p_proc_object) {
+		proc_map_cache_destroy(pr_ctxt);
 		if (p_proc_object->ntfy_obj) {
 			/* Notify the Client */
 			ntfy_notify(p_proc_object->ntfy_obj,
@@ -455,13 +915,89 @@ int proc_enum_nodes(void *hprocessor, void **node_tab,
 	return status;
 }
 
+/*
+ * Cache maintenance for buffers handed between the MPU and the DSP.
+ *
+ * The user range is resolved to pages and maintained one physically
+ * contiguous run at a time, so both the L1 and the outer cache see one
+ * ranged operation per run instead of one per page. Buffers the MPU maps
+ * uncached or write-combined have nothing to maintain and are skipped.
+ * Above sync_whole_size bytes cleaning the whole cache by set/way is
+ * cheaper than walking the range line by line; the crossover is measured
+ * when the driver loads and can be changed through debugfs. Invalidate-only
+ * requests always stay ranged: a whole-cache operation would have to clean
+ * too, and dirty lines must not be written over data the DSP produced.
+ */
+#define SYNC_CAL_SIZE		(64 * 1024)
+#define SYNC_WHOLE_MIN		(64 * 1024)
+#define SYNC_WHOLE_MAX		(4 * 1024 * 1024)
+#define SYNC_FLUSH_ALL		3	/* legacy flag: whole cache */
+
+static u32 sync_whole_size = 512 * 1024;
+
+static DEFINE_SPINLOCK(sync_stats_lock);
+static struct {
+	u32 ops[PROC_WRITEBACK_INVALIDATE_MEM + 1];
+	u64 bytes[PROC_WRITEBACK_INVALIDATE_MEM + 1];
+	u32 runs;
+	u32 whole;
+	u32 uncached;
+	u64 uncached_bytes;
+} sync_stats;
+
+static struct dentry *sync_dentry;
+
+static const char *const sync_names[] = {
+	[PROC_INVALIDATE_MEM] = "invalidate",
+	[PROC_WRITEBACK_MEM] = "clean",
+	[PROC_WRITEBACK_INVALIDATE_MEM] = "flush",
+};
+
+struct sync_run {
+	void *kaddr;
+	unsigned long pa;
+	u32 len;
+	u32 count;
+};
+
+static void sync_range(void *kaddr, unsigned long pa, u32 len,
+		       enum dsp_flushtype ftype)
+{
+	switch (ftype) {
+	case PROC_INVALIDATE_MEM:
+		dmac_inv_range(kaddr, kaddr + len);
+		outer_inv_range(pa, pa + len);
+		break;
+	case PROC_WRITEBACK_MEM:
+		dmac_clean_range(kaddr, kaddr + len);
+		outer_clean_range(pa, pa + len);
+		break;
+	case PROC_WRITEBACK_INVALIDATE_MEM:
+		dmac_flush_range(kaddr, kaddr + len);
+		outer_flush_range(pa, pa + len);
+		break;
+	default:
+		break;
+	}
+}
+
+static void sync_run_flush(struct sync_run *run, enum dsp_flushtype ftype)
+{
+	if (!run->len)
+		return;
+	sync_range(run->kaddr, run->pa, run->len, ftype);
+	run->count++;
+	run->len = 0;
+}
+
 /* Cache operation against kernel address instead of users */
 static int memory_sync_page(struct vm_area_struct *vma, unsigned long start,
-			    ssize_t len, enum dsp_flushtype ftype)
+			    ssize_t len, enum dsp_flushtype ftype,
+			    struct sync_run *run)
 {
 	struct page *page;
 	void *kaddr;
-	unsigned long offset;
+	unsigned long offset, pa;
 	ssize_t rest;
 
 	while (len) {
@@ -476,11 +1012,28 @@ static int memory_sync_page(struct vm_area_struct *vma, unsigned long start,
 		}
 
 		offset = start & ~PAGE_MASK;
-		kaddr = kmap(page) + offset;
 		rest = min_t(ssize_t, PAGE_SIZE - offset, len);
-		mem_flush_cache(kaddr, rest, ftype);
+		pa = page_to_phys(page) + offset;
+
+		if (PageHighMem(page)) {
+			/* No linear address: maintain it on its own */
+			sync_run_flush(run, ftype);
+			kaddr = kmap(page) + offset;
+			sync_range(kaddr, pa, rest, ftype);
+			kunmap(page);
+			run->count++;
+		} else {
+			kaddr = page_address(page) + offset;
+			if (run->len && run->kaddr + run->len == kaddr) {
+				run->len += rest;
+			} else {
+				sync_run_flush(run, ftype);
+				run->kaddr = kaddr;
+				run->pa = pa;
+				run->len = rest;
+			}
+		}
 
-		kunmap(page);
 		put_page(page);
 		len -= rest;
 		start += rest;
@@ -489,9 +1042,21 @@ static int memory_sync_page(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
-/* Check if the given area blongs to process virtul memory address space */
+static bool vma_uncached(struct vm_area_struct *vma)
+{
+	unsigned long mt = pgprot_val(vma->vm_page_prot) & L_PTE_MT_MASK;
+
+	return mt == L_PTE_MT_UNCACHED || mt == L_PTE_MT_BUFFERABLE;
+}
+
+/*
+ * Check if the given area blongs to process virtul memory address space.
+ * With pcached set only the cacheable bytes are counted; otherwise they
+ * are maintained.
+ */
 static int memory_sync_vma(unsigned long start, u32 len,
-			   enum dsp_flushtype ftype)
+			   enum dsp_flushtype ftype, u32 *pcached,
+			   struct sync_run *run)
 {
 	int err = 0;
 	unsigned long end;
@@ -504,16 +1069,21 @@ static int memory_sync_vma(unsigned long start, u32 len,
 	while ((vma = find_vma(current->mm, start)) != NULL) {
 		ssize_t size;
 
-		if (vma->vm_flags & (VM_IO | VM_PFNMAP))
-			return -EINVAL;
-
 		if (vma->vm_start > start)
 			return -EINVAL;
 
 		size = min_t(ssize_t, vma->vm_end - start, len);
-		err = memory_sync_page(vma, start, size, ftype);
-		if (err)
-			break;
+		if (vma_uncached(vma)) {
+			/* Nothing of it can be in the cache */
+		} else if (vma->vm_flags & (VM_IO | VM_PFNMAP)) {
+			return -EINVAL;
+		} else if (pcached) {
+			*pcached += size;
+		} else {
+			err = memory_sync_page(vma, start, size, ftype, run);
+			if (err)
+				break;
+		}
 
 		if (end <= vma->vm_end)
 			break;
@@ -525,6 +1095,9 @@ static int memory_sync_vma(unsigned long start, u32 len,
 	if (!vma)
 		err = -EINVAL;
 
+	if (!pcached)
+		sync_run_flush(run, ftype);
+
 	return err;
 }
 
@@ -534,6 +1107,9 @@ static int proc_memory_sync(void *hprocessor, void *pmpu_addr,
 	/* Keep STATUS here for future additions to this function */
 	int status = 0;
 	struct proc_object *p_proc_object = (struct proc_object *)hprocessor;
+	struct sync_run run = { .len = 0, .count = 0 };
+	u32 cached = 0;
+	bool whole = false;
 
 	DBC_REQUIRE(refs > 0);
 
@@ -542,22 +1118,141 @@ static int proc_memory_sync(void *hprocessor, void *pmpu_addr,
 		goto err_out;
 	}
 
-	if (ul_flags == 3) {
+	if (ul_flags == SYNC_FLUSH_ALL) {
 		__cpuc_flush_kern_all();
-	} else {
-		down_read(&current->mm->mmap_sem);
-		if (memory_sync_vma((u32) pmpu_addr, ul_size, ul_flags)) {
-			pr_err("%s: InValid address parameters %p %x\n",
-			       __func__, pmpu_addr, ul_size);
-			status = -EFAULT;
-		}
-		up_read(&current->mm->mmap_sem);
+		spin_lock(&sync_stats_lock);
+		sync_stats.whole++;
+		spin_unlock(&sync_stats_lock);
+		goto err_out;
+	}
+
+	if (ul_flags > PROC_WRITEBACK_INVALIDATE_MEM) {
+		status = -EINVAL;
+		goto err_out;
 	}
 
+	down_read(&current->mm->mmap_sem);
+	if (memory_sync_vma((u32) pmpu_addr, ul_size, ul_flags, &cached,
+			    NULL)) {
+		status = -EFAULT;
+	} else if (cached && ul_flags != PROC_INVALIDATE_MEM &&
+		   cached >= sync_whole_size) {
+		__cpuc_flush_kern_all();
+		whole = true;
+	} else if (cached &&
+		   memory_sync_vma((u32) pmpu_addr, ul_size, ul_flags, NULL,
+				   &run)) {
+		status = -EFAULT;
+	}
+	up_read(&current->mm->mmap_sem);
+
+	if (DSP_FAILED(status)) {
+		pr_err("%s: InValid address parameters %p %x\n",
+		       __func__, pmpu_addr, ul_size);
+		goto err_out;
+	}
+
+	spin_lock(&sync_stats_lock);
+	sync_stats.ops[ul_flags]++;
+	sync_stats.bytes[ul_flags] += cached;
+	sync_stats.runs += run.count;
+	if (whole)
+		sync_stats.whole++;
+	if (cached < ul_size) {
+		sync_stats.uncached++;
+		sync_stats.uncached_bytes += ul_size - cached;
+	}
+	spin_unlock(&sync_stats_lock);
+
 err_out:
 	return status;
 }
 
+/*
+ * Time a ranged flush of SYNC_CAL_SIZE dirty bytes against a whole-cache
+ * flush and put the crossover where both cost the same.
+ */
+static void proc_sync_calibrate(void)
+{
+	unsigned long buf;
+	ktime_t t0;
+	u64 t_range, t_all, size;
+
+	buf = __get_free_pages(GFP_KERNEL, get_order(SYNC_CAL_SIZE));
+	if (!buf)
+		return;
+
+	memset((void *)buf, 0xa5, SYNC_CAL_SIZE);
+	t0 = ktime_get();
+	sync_range((void *)buf, __pa(buf), SYNC_CAL_SIZE,
+		   PROC_WRITEBACK_INVALIDATE_MEM);
+	t_range = ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+	memset((void *)buf, 0x5a, SYNC_CAL_SIZE);
+	t0 = ktime_get();
+	__cpuc_flush_kern_all();
+	t_all = ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+	free_pages(buf, get_order(SYNC_CAL_SIZE));
+
+	if (!t_range)
+		return;
+	size = div64_u64(t_all * SYNC_CAL_SIZE, t_range);
+	sync_whole_size = clamp_t(u64, size, SYNC_WHOLE_MIN, SYNC_WHOLE_MAX);
+	pr_debug("%s: range %llu ns/%u bytes, whole %llu ns, crossover %u\n",
+		 __func__, t_range, SYNC_CAL_SIZE, t_all, sync_whole_size);
+}
+
+static int proc_sync_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	spin_lock(&sync_stats_lock);
+	for (i = 0; i <= PROC_WRITEBACK_INVALIDATE_MEM; i++)
+		seq_printf(s, "%-10s %10u ops %12llu bytes\n", sync_names[i],
+			   sync_stats.ops[i], sync_stats.bytes[i]);
+	seq_printf(s, "runs %u whole_cache %u\n", sync_stats.runs,
+		   sync_stats.whole);
+	seq_printf(s, "uncached %u ops %llu bytes skipped\n",
+		   sync_stats.uncached, sync_stats.uncached_bytes);
+	spin_unlock(&sync_stats_lock);
+	seq_printf(s, "whole_cache_threshold %u\n", sync_whole_size);
+
+	return 0;
+}
+
+static int proc_sync_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_sync_show, NULL);
+}
+
+/* Writing a byte count sets the whole-cache crossover */
+static ssize_t proc_sync_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char tmp[16];
+	unsigned long val;
+
+	if (count >= sizeof(tmp))
+		return -EINVAL;
+	if (copy_from_user(tmp, buf, count))
+		return -EFAULT;
+	tmp[count] = '\0';
+	if (strict_strtoul(strstrip(tmp), 0, &val))
+		return -EINVAL;
+
+	sync_whole_size = val;
+	return count;
+}
+
+static const struct file_operations proc_sync_fops = {
+	.open		= proc_sync_open,
+	.read		= seq_read,
+	.write		= proc_sync_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  *  ======== proc_flush_memory ========
  *  Purpose:
@@ -658,6 +1353,16 @@ void proc_exit(void)
 	DBC_REQUIRE(refs > 0);
 
 	refs--;
+	if (!refs) {
+		debugfs_remove(sync_dentry);
+		sync_dentry = NULL;
+	}
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	if (!refs) {
+		debugfs_remove(map_cache_dentry);
+		map_cache_dentry = NULL;
+	}
+#endif
 
 	DBC_ENSURE(refs >= 0);
 }
@@ -782,6 +1487,22 @@ bool proc_init(void)
 	if (ret)
 		refs++;
 
+	if (refs == 1) {
+		proc_sync_calibrate();
+		if (bridge_debugfs_dir)
+			sync_dentry = debugfs_create_file("cache_sync",
+							  S_IRUGO | S_IWUSR,
+							  bridge_debugfs_dir,
+							  NULL,
+							  &proc_sync_fops);
+	}
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	if (refs == 1 && bridge_debugfs_dir)
+		map_cache_dentry = debugfs_create_file("map_cache", S_IRUGO,
+						       bridge_debugfs_dir, NULL,
+						       &map_cache_fops);
+#endif
+
 	DBC_ENSURE((ret && (refs > 0)) || (!ret && (refs >= 0)));
 
 	return ret;
@@ -1010,9 +1731,11 @@ int proc_load(void *hprocessor, IN CONST s32 argc_index,
 					dw_ext_end =
 					    (dw_ext_end + 1) * DSPWORDSIZE;
 					/* DMM memory is from EXT_END */
+					map_cache_flush(p_proc_object);
 					status = dmm_create_tables(dmm_mgr,
 								   dw_ext_end,
 								   DMMPOOLSIZE);
+					map_cache_invalidate_all();
 				} else {
 					status = -EFAULT;
 				}
@@ -1074,6 +1797,10 @@ int proc_map(void *hprocessor, void *pmpu_addr, u32 ul_size,
 	int status = 0;
 	struct proc_object *p_proc_object = (struct proc_object *)hprocessor;
 	struct dmm_map_object *map_obj;
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	bool cached = false;
+	u32 seq = 0;
+#endif
 
 #ifdef CONFIG_BRIDGE_CACHE_LINE_CHECK
 	if ((ul_map_attr & BUFMODE_MASK) != RBUF) {
@@ -1105,12 +1832,28 @@ int proc_map(void *hprocessor, void *pmpu_addr, u32 ul_size,
 		status = -EFAULT;
 
 	/* Add mapping to the page tables. */
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	if (DSP_SUCCEEDED(status) && map_cache_allowed(ul_map_attr)) {
+		cached = true;
+		if (map_cache_lookup(pr_ctxt, p_proc_object, pa_align,
+				     va_align, size_align, ul_map_attr, &seq))
+			goto map_done;
+	}
+#endif
 	if (DSP_SUCCEEDED(status)) {
 
 		status = (*p_proc_object->intf_fxns->pfn_brd_mem_map)
 		    (p_proc_object->hwmd_context, pa_align, va_align,
 		     size_align, ul_map_attr);
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+		if (DSP_SUCCEEDED(status) && cached)
+			map_cache_insert(pr_ctxt, pa_align, va_align,
+					 size_align, ul_map_attr, seq);
+#endif
 	}
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+map_done:
+#endif
 	if (DSP_SUCCEEDED(status)) {
 		/* Mapped address = MSB of VA | LSB of PA */
 		*pp_map_addr = (void *)(va_align | ((u32) pmpu_addr &
@@ -1325,8 +2068,10 @@ int proc_start(void *hprocessor)
 	} else {
 		/* Failed to Create Node Manager and DISP Object
 		 * Stop the Processor from running. Put it in STOPPED State */
+		map_cache_flush(p_proc_object);
 		(void)(*p_proc_object->intf_fxns->
 		       pfn_brd_stop) (p_proc_object->hwmd_context);
+		map_cache_invalidate_all();
 		p_proc_object->proc_state = PROC_STOPPED;
 	}
 func_cont:
@@ -1386,10 +2131,12 @@ int proc_stop(void *hprocessor)
 	}
 	/* Call the bridge_brd_stop */
 	/* It is OK to stop a device that does n't have nodes OR not started */
+	map_cache_flush(p_proc_object);
 	status =
 	    (*p_proc_object->intf_fxns->
 	     pfn_brd_stop) (p_proc_object->hwmd_context);
 	if (DSP_SUCCEEDED(status)) {
+		map_cache_invalidate_all();
 		dev_dbg(bridge, "%s: processor in standby mode\n", __func__);
 		p_proc_object->proc_state = PROC_STOPPED;
 		/* Destory the Node Manager, msg_ctrl Manager */
@@ -1449,11 +2196,19 @@ int proc_un_map(void *hprocessor, void *map_addr,
 	 * This function returns error if the VA is not mapped
 	 */
 	status = dmm_un_map_memory(dmm_mgr, (u32) va_align, &size_align);
-	/* Remove mapping from the page tables. */
+	/* Remove mapping from the page tables, unless it is kept cached. */
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	if (DSP_SUCCEEDED(status) &&
+	    map_cache_put(pr_ctxt, p_proc_object, va_align))
+		goto unmap_done;
+#endif
 	if (DSP_SUCCEEDED(status)) {
 		status = (*p_proc_object->intf_fxns->pfn_brd_mem_un_map)
 		    (p_proc_object->hwmd_context, va_align, size_align);
 	}
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+unmap_done:
+#endif
 	mutex_unlock(&proc_lock);
 	if (DSP_FAILED(status))
 		goto func_end;
@@ -1491,6 +2246,9 @@ int proc_un_reserve_memory(void *hprocessor, void *prsv_addr,
 	int status = 0;
 	struct proc_object *p_proc_object = (struct proc_object *)hprocessor;
 	struct dmm_rsv_object *rsv_obj;
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	u32 rsv_size;
+#endif
 
 	if (!p_proc_object) {
 		status = -EFAULT;
@@ -1503,6 +2261,17 @@ int proc_un_reserve_memory(void *hprocessor, void *prsv_addr,
 		goto func_end;
 	}
 
+#ifdef CONFIG_BRIDGE_MAP_CACHE
+	/* Cached mappings must not outlive the DSP range they live in */
+	if (DSP_SUCCEEDED(dmm_get_reserved_size(dmm_mgr, (u32) prsv_addr,
+						&rsv_size))) {
+		mutex_lock(&proc_lock);
+		map_cache_evict_range(pr_ctxt, p_proc_object, (u32) prsv_addr,
+				      rsv_size);
+		mutex_unlock(&proc_lock);
+	}
+#endif
+
 	status = dmm_un_reserve_memory(dmm_mgr, (u32) prsv_addr);
 	if (status != 0)
 		goto func_end;
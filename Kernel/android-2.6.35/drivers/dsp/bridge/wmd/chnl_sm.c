@@ -79,6 +79,11 @@ static void free_chirp_list(struct lst_list *pList);
 
 static struct chnl_irp *make_new_chirp(void);
 
+static struct page **pin_user_buf(void *pUserBuf, u32 len, bool write,
+				  u32 *pNumPages);
+
+static void unpin_user_buf(struct page **pages, u32 num_pages, bool dirty);
+
 static int search_free_channel(struct chnl_mgr *chnl_mgr_obj,
 				      OUT u32 *pdwChnl);
 
@@ -101,6 +106,8 @@ int bridge_chnl_add_io_req(struct chnl_object *chnl_obj, void *pHostBuf,
 	bool is_eos;
 	struct chnl_mgr *chnl_mgr_obj;
 	u8 *host_sys_buf = NULL;
+	struct page **pages = NULL;
+	u32 num_pages = 0;
 	bool sched_dpc = false;
 	u16 mb_val = 0;
 
@@ -147,22 +154,21 @@ int bridge_chnl_add_io_req(struct chnl_object *chnl_obj, void *pHostBuf,
 			host_sys_buf = pHostBuf;
 			goto func_cont;
 		}
-		/* if addr in user mode, then copy to kernel space */
-		host_sys_buf = kmalloc(buf_size, GFP_KERNEL);
-		if (host_sys_buf == NULL) {
-			status = -ENOMEM;
+		/*
+		 * If addr in user mode, pin it: the DPC copies straight
+		 * between its pages and the shared memory window. Only what
+		 * fits in one shared memory buffer is ever transferred.
+		 */
+		pages = pin_user_buf(pHostBuf,
+				     min(byte_size,
+					 io_buf_size(chnl_mgr_obj->hio_mgr)),
+				     CHNL_IS_INPUT(pchnl->chnl_mode),
+				     &num_pages);
+		if (IS_ERR(pages)) {
+			status = PTR_ERR(pages);
+			pages = NULL;
 			goto func_end;
 		}
-		if (CHNL_IS_OUTPUT(pchnl->chnl_mode)) {
-			status = copy_from_user(host_sys_buf, pHostBuf,
-						buf_size);
-			if (status) {
-				kfree(host_sys_buf);
-				host_sys_buf = NULL;
-				status = -EFAULT;
-				goto func_end;
-			}
-		}
 	}
 func_cont:
 	/* Mailbox IRQ is disabled to avoid race condition with DMA/ZCPY
@@ -200,6 +206,10 @@ func_cont:
 		    pHostBuf;
 		if (pchnl->chnl_type == CHNL_PCPY && pchnl->chnl_id > 1)
 			chnl_packet_obj->host_sys_buf = host_sys_buf;
+		chnl_packet_obj->pages = pages;
+		chnl_packet_obj->num_pages = num_pages;
+		chnl_packet_obj->page_offset = (u32) pHostBuf & ~PAGE_MASK;
+		pages = NULL;
 
 		/*
 		 * Note: for dma chans dw_dsp_addr contains dsp address
@@ -235,8 +245,11 @@ func_cont:
 	}
 	omap_mbox_enable_irq(dev_ctxt->mbox, IRQ_RX);
 	spin_unlock_bh(&chnl_mgr_obj->chnl_mgr_lock);
+	/* Request not queued: release the user buffer */
+	unpin_user_buf(pages, num_pages, false);
+	/* Sent by the DPC, together with whatever else it signals */
 	if (mb_val != 0)
-		io_intr_dsp2(chnl_mgr_obj->hio_mgr, mb_val);
+		io_post_dsp_intr(chnl_mgr_obj->hio_mgr);
 
 	/* Schedule a DPC, to do the actual data transfer: */
 	if (sched_dpc)
@@ -582,7 +595,8 @@ int bridge_chnl_get_ioc(struct chnl_object *chnl_obj, u32 dwTimeOut,
 	int stat_sync;
 	bool dequeue_ioc = true;
 	struct chnl_ioc ioc = { NULL, 0, 0, 0, 0 };
-	u8 *host_sys_buf = NULL;
+	struct page **pages = NULL;
+	u32 num_pages = 0;
 	struct wmd_dev_context *dev_ctxt;
 	struct dev_object *dev_obj;
 
@@ -642,10 +656,11 @@ int bridge_chnl_get_ioc(struct chnl_object *chnl_obj, u32 dwTimeOut,
 			/*  If this is a zero-copy channel, then set IOC's pbuf
 			 *  to the DSP's address. This DSP address will get
 			 *  translated to user's virtual addr later. */
-			{
-				host_sys_buf = chnl_packet_obj->host_sys_buf;
-				ioc.pbuf = chnl_packet_obj->host_user_buf;
-			}
+			ioc.pbuf = chnl_packet_obj->host_user_buf;
+			pages = chnl_packet_obj->pages;
+			num_pages = chnl_packet_obj->num_pages;
+			chnl_packet_obj->pages = NULL;
+			chnl_packet_obj->num_pages = 0;
 			ioc.byte_size = chnl_packet_obj->byte_size;
 			ioc.buf_size = chnl_packet_obj->buf_size;
 			ioc.dw_arg = chnl_packet_obj->dw_arg;
@@ -683,31 +698,13 @@ int bridge_chnl_get_ioc(struct chnl_object *chnl_obj, u32 dwTimeOut,
 	}
 	omap_mbox_enable_irq(dev_ctxt->mbox, IRQ_RX);
 	spin_unlock_bh(&pchnl->chnl_mgr_obj->chnl_mgr_lock);
-	if (dequeue_ioc
-	    && (pchnl->chnl_type == CHNL_PCPY && pchnl->chnl_id > 1)) {
-		if (!(ioc.pbuf < (void *)USERMODE_ADDR))
-			goto func_cont;
+	/*
+	 * The DPC copied straight to/from the user pages; release them now
+	 * the buffer is back with its owner.
+	 */
+	if (dequeue_ioc)
+		unpin_user_buf(pages, num_pages, CHNL_IS_INPUT(pchnl->chnl_mode));
 
-		/* If the addr is in user mode, then copy it */
-		if (!host_sys_buf || !ioc.pbuf) {
-			status = -EFAULT;
-			goto func_cont;
-		}
-		if (!CHNL_IS_INPUT(pchnl->chnl_mode))
-			goto func_cont1;
-
-		/*host_user_buf */
-		status = copy_to_user(ioc.pbuf, host_sys_buf, ioc.byte_size);
-		if (status) {
-			if (current->flags & PF_EXITING)
-				status = 0;
-		}
-		if (status)
-			status = -EFAULT;
-func_cont1:
-		kfree(host_sys_buf);
-	}
-func_cont:
 	/* Update User's IOC block: */
 	*pIOC = ioc;
 func_end:
@@ -976,14 +973,80 @@ static struct lst_list *create_chirp_list(u32 uChirps)
  */
 static void free_chirp_list(struct lst_list *chirp_list)
 {
+	struct chnl_irp *chnl_packet_obj;
+
 	DBC_REQUIRE(chirp_list != NULL);
 
-	while (!LST_IS_EMPTY(chirp_list))
-		kfree(lst_get_head(chirp_list));
+	while (!LST_IS_EMPTY(chirp_list)) {
+		chnl_packet_obj = (struct chnl_irp *)lst_get_head(chirp_list);
+		/* Requests never reclaimed still hold their user pages */
+		unpin_user_buf(chnl_packet_obj->pages,
+			       chnl_packet_obj->num_pages, false);
+		kfree(chnl_packet_obj);
+	}
 
 	kfree(chirp_list);
 }
 
+/*
+ *  ======== pin_user_buf ========
+ *      Pin the pages holding len bytes of a user buffer. Returns NULL with
+ *      *pNumPages 0 for an empty buffer, or an ERR_PTR.
+ */
+static struct page **pin_user_buf(void *pUserBuf, u32 len, bool write,
+				  u32 *pNumPages)
+{
+	unsigned long start = (unsigned long)pUserBuf;
+	struct page **pages;
+	u32 num_pages;
+	int pinned;
+
+	*pNumPages = 0;
+	if (!len)
+		return NULL;
+
+	num_pages = (PAGE_ALIGN(start + len) - (start & PAGE_MASK)) >>
+	    PAGE_SHIFT;
+	pages = kmalloc(num_pages * sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return ERR_PTR(-ENOMEM);
+
+	down_read(&current->mm->mmap_sem);
+	pinned = get_user_pages(current, current->mm, start & PAGE_MASK,
+				num_pages, write, 0, pages, NULL);
+	up_read(&current->mm->mmap_sem);
+
+	if (pinned != num_pages) {
+		unpin_user_buf(pages, pinned > 0 ? pinned : 0, false);
+		return ERR_PTR(-EFAULT);
+	}
+
+	*pNumPages = num_pages;
+	return pages;
+}
+
+/*
+ *  ======== unpin_user_buf ========
+ *      Release pages pinned by pin_user_buf, marking them dirty if the DSP
+ *      data was copied into them.
+ */
+static void unpin_user_buf(struct page **pages, u32 num_pages, bool dirty)
+{
+	u32 i;
+
+	if (!pages)
+		return;
+
+	for (i = 0; i < num_pages; i++) {
+		if (dirty) {
+			flush_dcache_page(pages[i]);
+			set_page_dirty_lock(pages[i]);
+		}
+		page_cache_release(pages[i]);
+	}
+	kfree(pages);
+}
+
 /*
  *  ======== make_new_chirp ========
  *      Allocate the memory for a new channel IRP.
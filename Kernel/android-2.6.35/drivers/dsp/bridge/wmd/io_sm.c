@@ -27,6 +27,9 @@
 /* Host OS */
 #include <dspbridge/host_os.h>
 #include <linux/workqueue.h>
+#include <linux/highmem.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
 #include <dspbridge/std.h>
@@ -128,6 +131,21 @@ struct io_mgr {
 	struct tasklet_struct wdt3_tasklet;
 #endif
 	spinlock_t dpc_lock;
+	/* DSP interrupts requested since the last one was sent */
+	atomic_t dsp_intr_req;
+	struct io_stats {
+		u32 in_bufs;	/* Channel buffers from the DSP */
+		u64 in_bytes;
+		u32 out_bufs;	/* Channel buffers to the DSP */
+		u64 out_bytes;
+		u32 in_msgs;
+		u32 out_msgs;
+		u32 intr_req;	/* DSP interrupts requested */
+		u32 intr_sent;	/* Mailbox messages actually sent */
+		u32 dpcs;
+		ktime_t since;
+	} stats;
+	struct dentry *debugfs;
 
 };
 
@@ -151,6 +169,9 @@ static u32 read_data(struct wmd_dev_context *hDevContext, void *dest,
 		     void *pSrc, u32 usize);
 static u32 write_data(struct wmd_dev_context *hDevContext, void *dest,
 		      void *pSrc, u32 usize);
+static u32 copy_chirp_data(struct io_mgr *pio_mgr, struct chnl_irp *irp,
+			   u8 *shm_buf, u32 usize, bool to_dsp);
+static const struct file_operations io_stats_fops;
 
 #ifndef DSP_TRACEBUF_DISABLED
 void print_dsp_debug_trace(struct io_mgr *hio_mgr);
@@ -238,6 +259,14 @@ int bridge_io_create(OUT struct io_mgr **phIOMgr,
 		pio_mgr->dpc_sched = 0;
 
 		spin_lock_init(&pio_mgr->dpc_lock);
+		atomic_set(&pio_mgr->dsp_intr_req, 0);
+		pio_mgr->stats.since = ktime_get();
+		if (bridge_debugfs_dir)
+			pio_mgr->debugfs = debugfs_create_file("io", S_IRUGO |
+							       S_IWUSR,
+							       bridge_debugfs_dir,
+							       pio_mgr,
+							       &io_stats_fops);
 
 		if (DSP_SUCCEEDED(status))
 			status = dev_get_dev_node(hdev_obj, &dev_node_obj);
@@ -291,6 +320,8 @@ int bridge_io_destroy(struct io_mgr *hio_mgr)
 #ifdef CONFIG_BRIDGE_WDT3
 		free_irq(INT_34XX_WDT3_IRQ, (void *)hio_mgr);
 #endif
+		if (!IS_ERR_OR_NULL(hio_mgr->debugfs))
+			debugfs_remove(hio_mgr->debugfs);
 		/* Free IO DPC object */
 		tasklet_kill(&hio_mgr->dpc_tasklet);
 #ifdef CONFIG_BRIDGE_WDT3
@@ -866,6 +897,7 @@ void io_cancel_chnl(struct io_mgr *hio_mgr, u32 ulChnl)
 		     (~(1 << ulChnl)));
 
 	sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+	pio_mgr->stats.intr_sent++;
 func_end:
 	return;
 }
@@ -1006,9 +1038,23 @@ void io_dpc(IN OUT unsigned long pRefData)
 		}
 #endif
 		serviced++;
+		pio_mgr->stats.dpcs++;
 	} while (serviced != requested);
 	pio_mgr->dpc_sched = requested;
 func_end:
+	/*
+	 * One mailbox message tells the DSP about everything this pass
+	 * changed in shared memory: it rescans all channel and message
+	 * state on each processor-copy interrupt.
+	 */
+	if (pio_mgr) {
+		requested = atomic_xchg(&pio_mgr->dsp_intr_req, 0);
+		if (requested) {
+			sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+			pio_mgr->stats.intr_req += requested;
+			pio_mgr->stats.intr_sent++;
+		}
+	}
 	return;
 }
 
@@ -1201,10 +1247,13 @@ static void input_chnl(struct io_mgr *pio_mgr, struct chnl_object *pchnl,
 				 */
 				bytes = min(bytes, chnl_packet_obj->byte_size);
 				/* Transfer buffer from DSP side */
-				bytes = read_data(pio_mgr->hwmd_context,
-						  chnl_packet_obj->host_sys_buf,
-						  pio_mgr->input, bytes);
+				bytes = copy_chirp_data(pio_mgr,
+							chnl_packet_obj,
+							pio_mgr->input, bytes,
+							false);
 				pchnl->bytes_moved += bytes;
+				pio_mgr->stats.in_bufs++;
+				pio_mgr->stats.in_bytes += bytes;
 				chnl_packet_obj->byte_size = bytes;
 				chnl_packet_obj->dw_arg = dw_arg;
 				chnl_packet_obj->status = CHNL_IOCSTATCOMPLETE;
@@ -1264,7 +1313,7 @@ static void input_chnl(struct io_mgr *pio_mgr, struct chnl_object *pchnl,
 		/* Indicate to the DSP we have read the input */
 		IO_SET_VALUE(pio_mgr->hwmd_context, struct shm, sm, input_full,
 			     0);
-		sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+		io_post_dsp_intr(pio_mgr);
 	}
 	if (notify_client) {
 		/* Notify client with IO completion record */
@@ -1391,7 +1440,8 @@ static void input_msg(struct io_mgr *pio_mgr, struct msg_mgr *hmsg_mgr)
 			     msg_ctr_obj, buf_empty, true);
 		IO_SET_VALUE(pio_mgr->hwmd_context, struct msg_ctrl,
 			     msg_ctr_obj, post_swi, true);
-		sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+		io_post_dsp_intr(pio_mgr);
+		pio_mgr->stats.in_msgs += num_msgs;
 	}
 func_end:
 	return;
@@ -1487,10 +1537,12 @@ static void output_chnl(struct io_mgr *pio_mgr, struct chnl_object *pchnl,
 
 	/* Transfer buffer to DSP side */
 	chnl_packet_obj->byte_size =
-	    write_data(pio_mgr->hwmd_context, pio_mgr->output,
-		       chnl_packet_obj->host_sys_buf, min(pio_mgr->usm_buf_size,
-						  chnl_packet_obj->byte_size));
+	    copy_chirp_data(pio_mgr, chnl_packet_obj, pio_mgr->output,
+			    min(pio_mgr->usm_buf_size,
+				chnl_packet_obj->byte_size), true);
 	pchnl->bytes_moved += chnl_packet_obj->byte_size;
+	pio_mgr->stats.out_bufs++;
+	pio_mgr->stats.out_bytes += chnl_packet_obj->byte_size;
 	/* mem_write all 32 bits of arg */
 	IO_SET_LONG(pio_mgr->hwmd_context, struct shm, sm, arg,
 		    chnl_packet_obj->dw_arg);
@@ -1509,7 +1561,7 @@ static void output_chnl(struct io_mgr *pio_mgr, struct chnl_object *pchnl,
 #endif
 	IO_SET_VALUE(pio_mgr->hwmd_context, struct shm, sm, output_full, 1);
 	/* Indicate to the DSP we have written the output */
-	sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+	io_post_dsp_intr(pio_mgr);
 	/* Notify client with IO completion record (keep EOS) */
 	chnl_packet_obj->status &= CHNL_IOCSTATEOS;
 	notify_chnl_complete(pchnl, chnl_packet_obj);
@@ -1600,7 +1652,8 @@ static void output_msg(struct io_mgr *pio_mgr, struct msg_mgr *hmsg_mgr)
 			IO_SET_VALUE(pio_mgr->hwmd_context, struct msg_ctrl,
 				     msg_ctr_obj, post_swi, true);
 			/* Tell the DSP we have written the output. */
-			sm_interrupt_dsp(pio_mgr->hwmd_context, MBX_PCPY_CLASS);
+			io_post_dsp_intr(pio_mgr);
+			pio_mgr->stats.out_msgs += num_msgs;
 		}
 	}
 func_end:
@@ -1755,12 +1808,108 @@ static u32 write_data(struct wmd_dev_context *hDevContext, void *dest,
 	return usize;
 }
 
+/*
+ *  ======== copy_chirp_data ========
+ *      Copies between a chirp's host buffer and the shared memory window,
+ *      straight from/to the pinned user pages when the buffer has them.
+ */
+static u32 copy_chirp_data(struct io_mgr *pio_mgr, struct chnl_irp *irp,
+			   u8 *shm_buf, u32 usize, bool to_dsp)
+{
+	struct page **page = irp->pages;
+	u32 offset = irp->page_offset;
+	u32 done, len;
+	u8 *kaddr;
+
+	if (!page) {
+		if (to_dsp)
+			return write_data(pio_mgr->hwmd_context, shm_buf,
+					  irp->host_sys_buf, usize);
+		return read_data(pio_mgr->hwmd_context, irp->host_sys_buf,
+				 shm_buf, usize);
+	}
+
+	/* Never go past the pages pinned for the request */
+	usize = min_t(u32, usize, irp->num_pages * PAGE_SIZE - offset);
+	for (done = 0; done < usize; done += len, offset = 0, page++) {
+		len = min_t(u32, PAGE_SIZE - offset, usize - done);
+		kaddr = kmap_atomic(*page, KM_SOFTIRQ0);
+		if (to_dsp)
+			memcpy(shm_buf + done, kaddr + offset, len);
+		else
+			memcpy(kaddr + offset, shm_buf + done, len);
+		kunmap_atomic(kaddr, KM_SOFTIRQ0);
+	}
+
+	return usize;
+}
+
 /* ZCPY IO routines. */
 void io_intr_dsp2(IN struct io_mgr *pio_mgr, IN u16 mb_val)
 {
 	sm_interrupt_dsp(pio_mgr->hwmd_context, mb_val);
+	pio_mgr->stats.intr_sent++;
+}
+
+void io_post_dsp_intr(struct io_mgr *pio_mgr)
+{
+	atomic_inc(&pio_mgr->dsp_intr_req);
+}
+
+/*
+ * /sys/kernel/debug/dspbridge/io: channel and message throughput since
+ * the last reset (any write), and how many DSP interrupts were coalesced.
+ */
+static int io_stats_show(struct seq_file *s, void *unused)
+{
+	struct io_mgr *pio_mgr = s->private;
+	struct io_stats st = pio_mgr->stats;
+	u64 ms = ktime_to_ms(ktime_sub(ktime_get(), st.since));
+
+	if (!ms)
+		ms = 1;
+	seq_printf(s, "elapsed_ms %llu dpcs %u\n", ms, st.dpcs);
+	seq_printf(s, "chnl_in  %u bufs %llu bytes %llu KB/s\n", st.in_bufs,
+		   st.in_bytes, div64_u64(st.in_bytes * 1000, ms * 1024));
+	seq_printf(s, "chnl_out %u bufs %llu bytes %llu KB/s\n", st.out_bufs,
+		   st.out_bytes, div64_u64(st.out_bytes * 1000, ms * 1024));
+	seq_printf(s, "msg_in   %u msgs %llu msgs/s\n", st.in_msgs,
+		   div64_u64((u64) st.in_msgs * 1000, ms));
+	seq_printf(s, "msg_out  %u msgs %llu msgs/s\n", st.out_msgs,
+		   div64_u64((u64) st.out_msgs * 1000, ms));
+	seq_printf(s, "dsp_intr %u requested %u sent\n", st.intr_req,
+		   st.intr_sent);
+
+	return 0;
+}
+
+static int io_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, io_stats_show, inode->i_private);
 }
 
+static ssize_t io_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct io_mgr *pio_mgr =
+	    ((struct seq_file *)file->private_data)->private;
+
+	tasklet_disable(&pio_mgr->dpc_tasklet);
+	memset(&pio_mgr->stats, 0, sizeof(pio_mgr->stats));
+	pio_mgr->stats.since = ktime_get();
+	tasklet_enable(&pio_mgr->dpc_tasklet);
+
+	return count;
+}
+
+static const struct file_operations io_stats_fops = {
+	.open		= io_stats_open,
+	.read		= seq_read,
+	.write		= io_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  *  ======== IO_SHMcontrol ========
  *      Sets the requested shm setting.
@@ -20,6 +20,9 @@
 #include <dspbridge/host_os.h>
 #include <linux/mm.h>
 #include <linux/mmzone.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <plat/control.h>
 
 /*  ----------------------------------- DSP/BIOS Bridge */
@@ -73,6 +76,16 @@
 
 #define MMU_GFLUSH 0x60
 
+/* Pages pinned per get_user_pages() call when mapping a user buffer */
+#define MAP_PIN_BATCH		64
+
+/*
+ * The DSP MMU TLB has 32 entries: a map or unmap that touches more DSP
+ * MMU entries than that drops the whole TLB instead of invalidating the
+ * entries one by one.
+ */
+#define TLB_INVAL_MAX		32
+
 /* Forward Declarations: */
 static int bridge_brd_monitor(struct wmd_dev_context *dev_context);
 static int bridge_brd_read(struct wmd_dev_context *dev_context,
@@ -108,9 +121,11 @@ static int bridge_dev_ctrl(struct wmd_dev_context *dev_context,
 				  u32 dw_cmd, IN OUT void *pargs);
 static int bridge_dev_destroy(struct wmd_dev_context *dev_context);
 static u32 user_va2_pa(struct mm_struct *mm, u32 address);
+struct tlb_inval;
 static int pte_update(struct wmd_dev_context *hDevContext, u32 pa,
 			     u32 va, u32 size,
-			     struct hw_mmu_map_attrs_t *map_attrs);
+			     struct hw_mmu_map_attrs_t *map_attrs,
+			     struct tlb_inval *ti);
 static int pte_set(struct pg_table_attrs *pt, u32 pa, u32 va,
 			  u32 size, struct hw_mmu_map_attrs_t *attrs);
 static int mem_map_vmalloc(struct wmd_dev_context *hDevContext,
@@ -227,15 +242,145 @@ static inline void tlb_flush_all(const void __iomem *base)
 	__raw_writeb(__raw_readb(base + MMU_GFLUSH) | 1, base + MMU_GFLUSH);
 }
 
-static inline void flush_all(struct wmd_dev_context *dev_context)
+static inline void dsp_mmu_wake(struct wmd_dev_context *dev_context)
 {
 	if (dev_context->dw_brd_state == BRD_DSP_HIBERNATION ||
 	    dev_context->dw_brd_state == BRD_HIBERNATION)
 		wake_dsp(dev_context, NULL);
+}
 
+static inline void flush_all(struct wmd_dev_context *dev_context)
+{
+	dsp_mmu_wake(dev_context);
 	tlb_flush_all(dev_context->dw_dsp_mmu_base);
 }
 
+/*
+ * DSP MMU map/unmap statistics, shown in /sys/kernel/debug/dspbridge/mmu.
+ * Map and unmap are serialized by proc_lock in the PROC layer, so the
+ * counters are updated without further locking.
+ */
+struct mmu_stats {
+	u32 map_calls;
+	u32 unmap_calls;
+	u64 map_bytes;
+	u64 unmap_bytes;
+	u64 map_us;
+	u64 unmap_us;
+	u32 map_max_us;
+	u32 unmap_max_us;
+	u32 pin_calls;		/* get_user_pages() invocations */
+	u32 pages_pinned;
+	u32 entries[4];		/* PTEs written: 4 KB, 64 KB, 1 MB, 16 MB */
+	u32 tlb_inval_calls;	/* operations invalidating by address */
+	u32 tlb_inval_entries;
+	u32 tlb_flush_all;	/* operations falling back to a global flush */
+};
+
+static struct mmu_stats mmu_stats;
+static struct dentry *mmu_stats_dentry;
+
+static void mmu_stats_account(bool unmap, ktime_t start, u32 bytes)
+{
+	u32 us = (u32) ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (unmap) {
+		mmu_stats.unmap_calls++;
+		mmu_stats.unmap_bytes += bytes;
+		mmu_stats.unmap_us += us;
+		if (us > mmu_stats.unmap_max_us)
+			mmu_stats.unmap_max_us = us;
+	} else {
+		mmu_stats.map_calls++;
+		mmu_stats.map_bytes += bytes;
+		mmu_stats.map_us += us;
+		if (us > mmu_stats.map_max_us)
+			mmu_stats.map_max_us = us;
+	}
+}
+
+/* DSP MMU entries whose TLB copies must go after a page table update */
+struct tlb_inval {
+	u32 va[TLB_INVAL_MAX];
+	u32 size[TLB_INVAL_MAX];
+	u32 count;		/* may exceed TLB_INVAL_MAX */
+};
+
+static inline void tlb_inval_add(struct tlb_inval *ti, u32 va, u32 size)
+{
+	if (ti->count < TLB_INVAL_MAX) {
+		ti->va[ti->count] = va;
+		ti->size[ti->count] = size;
+	}
+	ti->count++;
+}
+
+/*
+ *  ======== tlb_inval_flush ========
+ *      Invalidate the TLB entries collected in ti by address, or flush the
+ *      whole TLB if too many were collected for that to pay off.
+ */
+static void tlb_inval_flush(struct wmd_dev_context *dev_context,
+			    struct tlb_inval *ti)
+{
+	u32 i;
+
+	if (ti->count > TLB_INVAL_MAX) {
+		flush_all(dev_context);
+		mmu_stats.tlb_flush_all++;
+	} else if (ti->count) {
+		dsp_mmu_wake(dev_context);
+		for (i = 0; i < ti->count; i++)
+			hw_mmu_tlb_flush(dev_context->dw_dsp_mmu_base,
+					 ti->va[i], ti->size[i]);
+		mmu_stats.tlb_inval_calls++;
+		mmu_stats.tlb_inval_entries += ti->count;
+	}
+	ti->count = 0;
+}
+
+static int mmu_stats_show(struct seq_file *s, void *unused)
+{
+	struct mmu_stats st = mmu_stats;
+
+	seq_printf(s, "map:     %u calls, %llu bytes, avg %llu us, max %u us\n",
+		   st.map_calls, st.map_bytes,
+		   st.map_calls ? div_u64(st.map_us, st.map_calls) : 0,
+		   st.map_max_us);
+	seq_printf(s, "unmap:   %u calls, %llu bytes, avg %llu us, max %u us\n",
+		   st.unmap_calls, st.unmap_bytes,
+		   st.unmap_calls ? div_u64(st.unmap_us, st.unmap_calls) : 0,
+		   st.unmap_max_us);
+	seq_printf(s, "pin:     %u calls, %u pages\n", st.pin_calls,
+		   st.pages_pinned);
+	seq_printf(s, "entries: 4K %u, 64K %u, 1M %u, 16M %u\n",
+		   st.entries[0], st.entries[1], st.entries[2], st.entries[3]);
+	seq_printf(s, "tlb:     %u ranges (%u entries), %u global flushes\n",
+		   st.tlb_inval_calls, st.tlb_inval_entries, st.tlb_flush_all);
+	return 0;
+}
+
+static int mmu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmu_stats_show, NULL);
+}
+
+/* Writing anything clears the counters */
+static ssize_t mmu_stats_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	memset(&mmu_stats, 0, sizeof(mmu_stats));
+	return count;
+}
+
+static const struct file_operations mmu_stats_fops = {
+	.open		= mmu_stats_open,
+	.read		= seq_read,
+	.write		= mmu_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void bad_page_dump(u32 pa, struct page *pg)
 {
 	pr_emerg("DSPBRIDGE: MAP function: COUNT 0 FOR PA 0x%x\n", pa);
@@ -1023,6 +1168,9 @@ static int bridge_dev_create(OUT struct wmd_dev_context **ppDevContext,
 		/* Store current board state. */
 		dev_context->dw_brd_state = BRD_STOPPED;
 		dev_context->resources = resources;
+		mmu_stats_dentry = debugfs_create_file("mmu", S_IRUGO | S_IWUSR,
+						       bridge_debugfs_dir, NULL,
+						       &mmu_stats_fops);
 		/* Return ptr to our device state to the WCD for storage */
 		*ppDevContext = dev_context;
 	} else {
@@ -1121,6 +1269,10 @@ static int bridge_dev_destroy(struct wmd_dev_context *hDevContext)
 	if (!hDevContext)
 		return -EFAULT;
 
+	if (!IS_ERR_OR_NULL(mmu_stats_dentry))
+		debugfs_remove(mmu_stats_dentry);
+	mmu_stats_dentry = NULL;
+
 	/* first put the device to stop state */
 	wmd_brd_delete(dev_context);
 	if (dev_context->pt_attrs) {
@@ -1268,11 +1420,112 @@ static int bridge_brd_mem_write(struct wmd_dev_context *hDevContext,
 	return status;
 }
 
+/* A physically contiguous stretch of a user buffer waiting to be mapped */
+struct map_run {
+	u32 pa;
+	u32 va;
+	u32 size;
+	u32 mapped;		/* bytes of the run already in the page table */
+};
+
+/*
+ *  ======== pte_best_size ========
+ *      Largest DSP MMU page size with which both pa and va are aligned and
+ *      that still fits in num_bytes.
+ */
+static u32 pte_best_size(u32 pa, u32 va, u32 num_bytes)
+{
+	static const u32 page_size[] = { HW_PAGE_SIZE16MB, HW_PAGE_SIZE1MB,
+		HW_PAGE_SIZE64KB
+	};
+	u32 all_bits = pa | va;
+	u32 i;
+
+	for (i = 0; i < ARRAY_SIZE(page_size); i++)
+		if (num_bytes >= page_size[i] &&
+		    (all_bits & (page_size[i] - 1)) == 0)
+			return page_size[i];
+
+	return HW_PAGE_SIZE4KB;
+}
+
+/*
+ *  ======== map_run_flush ========
+ *      Write the page table entries for a run, using the largest page sizes
+ *      its alignment allows. On failure run->mapped tells how much of the
+ *      run did make it into the page table.
+ */
+static int map_run_flush(struct wmd_dev_context *dev_context,
+			 struct map_run *run,
+			 struct hw_mmu_map_attrs_t *hw_attrs,
+			 struct tlb_inval *ti)
+{
+	u32 pg_size;
+	int status;
+
+	while (run->mapped < run->size) {
+		pg_size = pte_best_size(run->pa + run->mapped,
+					run->va + run->mapped,
+					run->size - run->mapped);
+		status = pte_set(dev_context->pt_attrs, run->pa + run->mapped,
+				 run->va + run->mapped, pg_size, hw_attrs);
+		if (DSP_FAILED(status))
+			return status;
+
+		tlb_inval_add(ti, run->va + run->mapped, pg_size);
+		run->mapped += pg_size;
+	}
+	run->size = 0;
+	run->mapped = 0;
+
+	return 0;
+}
+
+/*
+ *  ======== map_run_release ========
+ *      Drop the page references held for the part of a run that never got
+ *      into the page table; bridge_brd_mem_un_map() cannot see those.
+ */
+static void map_run_release(struct map_run *run)
+{
+	u32 pa;
+
+	for (pa = run->pa + run->mapped; pa < run->pa + run->size;
+	     pa += HW_PAGE_SIZE4KB)
+		if (pfn_valid(__phys_to_pfn(pa)))
+			page_cache_release(phys_to_page(pa));
+}
+
+/* Append a page to the run, writing out the run first if pa does not
+ * continue it */
+static int map_run_add(struct wmd_dev_context *dev_context,
+		       struct map_run *run, u32 pa, u32 va,
+		       struct hw_mmu_map_attrs_t *hw_attrs,
+		       struct tlb_inval *ti)
+{
+	int status;
+
+	if (run->size && pa != run->pa + run->size) {
+		status = map_run_flush(dev_context, run, hw_attrs, ti);
+		if (DSP_FAILED(status))
+			return status;
+	}
+	if (!run->size) {
+		run->pa = pa;
+		run->va = va;
+	}
+	run->size += HW_PAGE_SIZE4KB;
+
+	return 0;
+}
+
 /*
  *  ======== bridge_brd_mem_map ========
  *      This function maps MPU buffer to the DSP address space. It performs
- *  linear to physical address translation if required. It translates each
- *  page since linear addresses can be physically non-contiguous
+ *  linear to physical address translation if required. User pages are
+ *  pinned MAP_PIN_BATCH at a time and physically contiguous stretches are
+ *  mapped with 64 KB, 1 MB or 16 MB entries where their alignment allows.
+ *  Only the TLB entries covering the new mapping are invalidated.
  *  All address & size arguments are assumed to be page aligned (in proc.c)
  *
  *  TODO: Disable MMU while updating the page tables (but that'll stall DSP)
@@ -1289,12 +1542,17 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 	struct mm_struct *mm = current->mm;
 	u32 write = 0;
 	u32 num_usr_pgs = 0;
-	struct page *mapped_page, *pg;
+	struct page *pages[MAP_PIN_BATCH];
+	struct page *pg;
 	s32 pg_num;
 	u32 va = ulVirtAddr;
 	struct task_struct *curr_task = current;
 	u32 pg_i = 0;
 	u32 mpu_addr, pa;
+	u32 batch, i = 0;
+	struct map_run run = { 0 };
+	struct tlb_inval ti;
+	ktime_t start;
 
 	dev_dbg(bridge,
 		"%s hDevCtxt %p, pa %x, va %x, size %x, ul_map_attr %x\n",
@@ -1303,6 +1561,9 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 	if (ul_num_bytes == 0)
 		return -EINVAL;
 
+	start = ktime_get();
+	ti.count = 0;
+
 	if (ul_map_attr & DSP_MAP_DIR_MASK) {
 		attrs = ul_map_attr;
 	} else {
@@ -1345,8 +1606,10 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 		hw_attrs.donotlockmpupage = 0;
 
 	if (attrs & DSP_MAPVMALLOCADDR) {
-		return mem_map_vmalloc(hDevContext, ul_mpu_addr, ulVirtAddr,
-				       ul_num_bytes, &hw_attrs);
+		status = mem_map_vmalloc(hDevContext, ul_mpu_addr, ulVirtAddr,
+					 ul_num_bytes, &hw_attrs);
+		mmu_stats_account(false, start, ul_num_bytes);
+		return status;
 	}
 	/*
 	 * Do OS-specific user-va to pa translation.
@@ -1355,7 +1618,7 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 	 */
 	if ((attrs & DSP_MAPPHYSICALADDR)) {
 		status = pte_update(dev_context, ul_mpu_addr, ulVirtAddr,
-				    ul_num_bytes, &hw_attrs);
+				    ul_num_bytes, &hw_attrs, &ti);
 		goto func_cont;
 	}
 
@@ -1408,6 +1671,10 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 				       "address is invalid\n");
 				break;
 			}
+			status = map_run_add(dev_context, &run, pa, va,
+					     &hw_attrs, &ti);
+			if (DSP_FAILED(status))
+				break;
 			if (pfn_valid(__phys_to_pfn(pa))) {
 				pg = phys_to_page(pa);
 				get_page(pg);
@@ -1416,40 +1683,20 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 					bad_page_dump(pa, pg);
 				}
 			}
-			status = pte_set(dev_context->pt_attrs, pa,
-					 va, HW_PAGE_SIZE4KB, &hw_attrs);
-			if (DSP_FAILED(status))
-				break;
 
 			va += HW_PAGE_SIZE4KB;
 			mpu_addr += HW_PAGE_SIZE4KB;
-			pa += HW_PAGE_SIZE4KB;
 		}
 	} else {
 		num_usr_pgs = ul_num_bytes / PG_SIZE4K;
 		if (vma->vm_flags & (VM_WRITE | VM_MAYWRITE))
 			write = 1;
 
-		for (pg_i = 0; pg_i < num_usr_pgs; pg_i++) {
-			pg_num = get_user_pages(curr_task, mm, ul_mpu_addr, 1,
-						write, 1, &mapped_page, NULL);
-			if (pg_num > 0) {
-				if (page_count(mapped_page) < 1) {
-					pr_err("Bad page count after doing"
-					       "get_user_pages on"
-					       "user buffer\n");
-					bad_page_dump(page_to_phys(mapped_page),
-						      mapped_page);
-				}
-				status = pte_set(dev_context->pt_attrs,
-						 page_to_phys(mapped_page), va,
-						 HW_PAGE_SIZE4KB, &hw_attrs);
-				if (DSP_FAILED(status))
-					break;
-
-				va += HW_PAGE_SIZE4KB;
-				ul_mpu_addr += HW_PAGE_SIZE4KB;
-			} else {
+		while (pg_i < num_usr_pgs) {
+			batch = min_t(u32, num_usr_pgs - pg_i, MAP_PIN_BATCH);
+			pg_num = get_user_pages(curr_task, mm, ul_mpu_addr,
+						batch, write, 1, pages, NULL);
+			if (pg_num <= 0) {
 				pr_err("DSPBRIDGE: get_user_pages FAILED,"
 				       "MPU addr = 0x%x,"
 				       "vma->vm_flags = 0x%lx,"
@@ -1460,8 +1707,37 @@ static int bridge_brd_mem_map(struct wmd_dev_context *hDevContext,
 				status = -EPERM;
 				break;
 			}
+			mmu_stats.pin_calls++;
+			mmu_stats.pages_pinned += pg_num;
+
+			for (i = 0; i < pg_num; i++) {
+				if (page_count(pages[i]) < 1) {
+					pr_err("Bad page count after doing"
+					       "get_user_pages on"
+					       "user buffer\n");
+					bad_page_dump(page_to_phys(pages[i]),
+						      pages[i]);
+				}
+				status = map_run_add(dev_context, &run,
+						     page_to_phys(pages[i]), va,
+						     &hw_attrs, &ti);
+				if (DSP_FAILED(status))
+					break;
+
+				va += HW_PAGE_SIZE4KB;
+			}
+			if (DSP_FAILED(status)) {
+				/* Pages of this batch not yet in the run */
+				while (i < pg_num)
+					page_cache_release(pages[i++]);
+				break;
+			}
+			pg_i += pg_num;
+			ul_mpu_addr += pg_num * HW_PAGE_SIZE4KB;
 		}
 	}
+	if (DSP_SUCCEEDED(status) && run.size)
+		status = map_run_flush(dev_context, &run, &hw_attrs, &ti);
 	up_read(&mm->mmap_sem);
 func_cont:
 	/* Don't propogate Linux or HW status to upper layers */
@@ -1470,21 +1746,27 @@ func_cont:
 	} else {
 		/*
 		 * Roll out the mapped pages incase it failed in middle of
-		 * mapping
+		 * mapping. Pages still waiting in the run hold a reference
+		 * but no page table entry, so drop those by hand.
 		 */
-		if (pg_i) {
+		if (run.size) {
+			map_run_release(&run);
+			va = run.va + run.mapped;
+		}
+		if (va > ulVirtAddr) {
 			bridge_brd_mem_un_map(dev_context, ulVirtAddr,
-					   (pg_i * PG_SIZE4K));
+					      va - ulVirtAddr);
 		}
 		status = -EPERM;
 	}
 	/*
-	 * In any case, flush the TLB
+	 * In any case, invalidate the TLB entries of the new mapping.
 	 * This is called from here instead from pte_update to avoid unnecessary
 	 * repetition while mapping non-contiguous physical regions of a virtual
 	 * region
 	 */
-	flush_all(dev_context);
+	tlb_inval_flush(dev_context, &ti);
+	mmu_stats_account(false, start, ul_num_bytes);
 	dev_dbg(bridge, "%s status %i\n", __func__, status);
 	return status;
 }
@@ -1519,7 +1801,10 @@ static int bridge_brd_mem_un_map(struct wmd_dev_context *hDevContext,
 	u32 temp;
 	u32 paddr;
 	u32 numof4k_pages = 0;
+	struct tlb_inval ti;
+	ktime_t start = ktime_get();
 
+	ti.count = 0;
 	va_curr = ulVirtAddr;
 	rem_bytes = ul_num_bytes;
 	rem_bytes_l2 = 0;
@@ -1607,6 +1892,7 @@ static int bridge_brd_mem_un_map(struct wmd_dev_context *hDevContext,
 				status = -EPERM;
 				goto EXIT_LOOP;
 			}
+			tlb_inval_add(&ti, va_curr, pte_size);
 
 			status = 0;
 			rem_bytes_l2 -= pte_size;
@@ -1668,6 +1954,7 @@ skip_coarse_page:
 			paddr += HW_PAGE_SIZE4KB;
 		}
 		if (hw_mmu_pte_clear(l1_base_va, va_curr, pte_size) == RET_OK) {
+			tlb_inval_add(&ti, va_curr, pte_size);
 			status = 0;
 			rem_bytes -= pte_size;
 			va_curr += pte_size;
@@ -1677,11 +1964,12 @@ skip_coarse_page:
 		}
 	}
 	/*
-	 * It is better to flush the TLB here, so that any stale old entries
-	 * get flushed
+	 * It is better to invalidate the TLB here, so that any stale old
+	 * entries of the cleared PTEs get dropped
 	 */
 EXIT_LOOP:
-	flush_all(dev_context);
+	tlb_inval_flush(dev_context, &ti);
+	mmu_stats_account(true, start, ul_num_bytes);
 	dev_dbg(bridge,
 		"%s: va_curr %x, pte_addr_l1 %x pte_addr_l2 %x rem_bytes %x,"
 		" rem_bytes_l2 %x status %i\n", __func__, va_curr, pte_addr_l1,
@@ -1724,40 +2012,27 @@ static u32 user_va2_pa(struct mm_struct *mm, u32 address)
  */
 static int pte_update(struct wmd_dev_context *hDevContext, u32 pa,
 			     u32 va, u32 size,
-			     struct hw_mmu_map_attrs_t *map_attrs)
+			     struct hw_mmu_map_attrs_t *map_attrs,
+			     struct tlb_inval *ti)
 {
-	u32 i;
-	u32 all_bits;
+	u32 pg_size;
 	u32 pa_curr = pa;
 	u32 va_curr = va;
 	u32 num_bytes = size;
 	struct wmd_dev_context *dev_context = hDevContext;
 	int status = 0;
-	u32 page_size[] = { HW_PAGE_SIZE16MB, HW_PAGE_SIZE1MB,
-		HW_PAGE_SIZE64KB, HW_PAGE_SIZE4KB
-	};
 
 	while (num_bytes && DSP_SUCCEEDED(status)) {
 		/* To find the max. page size with which both PA & VA are
 		 * aligned */
-		all_bits = pa_curr | va_curr;
-
-		for (i = 0; i < 4; i++) {
-			if ((num_bytes >= page_size[i]) && ((all_bits &
-							     (page_size[i] -
-							      1)) == 0)) {
-				status =
-				    pte_set(dev_context->pt_attrs, pa_curr,
-					    va_curr, page_size[i], map_attrs);
-				pa_curr += page_size[i];
-				va_curr += page_size[i];
-				num_bytes -= page_size[i];
-				/* Don't try smaller sizes. Hopefully we have
-				 * reached an address aligned to a bigger page
-				 * size */
-				break;
-			}
-		}
+		pg_size = pte_best_size(pa_curr, va_curr, num_bytes);
+		status = pte_set(dev_context->pt_attrs, pa_curr, va_curr,
+				 pg_size, map_attrs);
+		if (DSP_SUCCEEDED(status))
+			tlb_inval_add(ti, va_curr, pg_size);
+		pa_curr += pg_size;
+		va_curr += pg_size;
+		num_bytes -= pg_size;
 	}
 
 	return status;
@@ -1855,6 +2130,16 @@ static int pte_set(struct pg_table_attrs *pt, u32 pa, u32 va,
 			attrs->element_size, attrs->mixed_size);
 		status = hw_mmu_pte_set(pg_tbl_va, pa, va, size, attrs);
 	}
+	if (DSP_SUCCEEDED(status)) {
+		if (size == HW_PAGE_SIZE4KB)
+			mmu_stats.entries[0]++;
+		else if (size == HW_PAGE_SIZE64KB)
+			mmu_stats.entries[1]++;
+		else if (size == HW_PAGE_SIZE1MB)
+			mmu_stats.entries[2]++;
+		else
+			mmu_stats.entries[3]++;
+	}
 
 	return status;
 }
@@ -1876,6 +2161,9 @@ static int mem_map_vmalloc(struct wmd_dev_context *dev_context,
 	u32 pa;
 	u32 num_of4k_pages;
 	u32 temp = 0;
+	struct tlb_inval ti;
+
+	ti.count = 0;
 
 	/*
 	 * Do Kernel va to pa translation.
@@ -1922,7 +2210,7 @@ static int mem_map_vmalloc(struct wmd_dev_context *dev_context,
 		}
 		status = pte_update(dev_context, pa_curr, ulVirtAddr +
 				    (va_curr - ul_mpu_addr), size_curr,
-				    hw_attrs);
+				    hw_attrs, &ti);
 		va_curr += size_curr;
 	}
 	/* Don't propogate Linux or HW status to upper layers */
@@ -1932,12 +2220,12 @@ static int mem_map_vmalloc(struct wmd_dev_context *dev_context,
 		status = -EPERM;
 
 	/*
-	 * In any case, flush the TLB
+	 * In any case, invalidate the TLB entries of the new mapping.
 	 * This is called from here instead from pte_update to avoid unnecessary
 	 * repetition while mapping non-contiguous physical regions of a virtual
 	 * region
 	 */
-	flush_all(dev_context);
+	tlb_inval_flush(dev_context, &ti);
 	dev_dbg(bridge, "%s status %i\n", __func__, status);
 	return status;
 }
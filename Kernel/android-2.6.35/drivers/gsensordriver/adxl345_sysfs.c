@@ -1097,6 +1097,8 @@ static int __devinit adxl345_i2c_probe(struct i2c_client *client, const struct i
 		return -ENOMEM;
 
 	i2c_set_clientdata(client, ac);//client->dev.driver_data = ac;
+	/* resume only reprograms the sensor over I2C; nothing depends on it */
+	device_enable_async_suspend(&client->dev);
 
 	ac->client = client;
 	ac->read_block = adxl345_i2c_read_block_data;
@@ -41,7 +41,13 @@
 #include <linux/i2c-omap.h>
 #include <linux/pm_runtime.h>
 #include <linux/notifier.h>
+#include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/hrtimer.h>
 #include <plat/clock.h>
+#include <plat/dma.h>
 
 /* I2C controller revisions */
 #define OMAP_I2C_REV_2			0x20
@@ -54,6 +60,17 @@
 /* timeout waiting for the controller to respond */
 #define OMAP_I2C_TIMEOUT (msecs_to_jiffies(1000))
 
+/* Largest message moved by sDMA, through a coherent bounce buffer */
+#define OMAP_I2C_DMA_BUF_SIZE	256
+
+/*
+ * Messages of at least this many bytes are moved by sDMA instead of one
+ * interrupt per FIFO threshold; 0 disables DMA.
+ */
+static unsigned int dma_threshold = 16;
+module_param(dma_threshold, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dma_threshold, "Minimum message length moved by DMA");
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -127,6 +144,8 @@ enum {
 #define OMAP_I2C_BUF_RXFIF_CLR	(1 << 14)	/* RX FIFO Clear */
 #define OMAP_I2C_BUF_XDMA_EN	(1 << 7)	/* TX DMA channel enable */
 #define OMAP_I2C_BUF_TXFIF_CLR	(1 << 6)	/* TX FIFO Clear */
+#define OMAP_I2C_BUF_RTRSH_MASK	(0x3f << 8)	/* RX FIFO threshold */
+#define OMAP_I2C_BUF_XTRSH_MASK	(0x3f << 0)	/* TX FIFO threshold */
 
 /* I2C Configuration Register (OMAP_I2C_CON): */
 #define OMAP_I2C_CON_EN		(1 << 15)	/* I2C module enable */
@@ -212,6 +231,26 @@ struct omap_i2c_dev {
 	int                     dpll_exit;
 	unsigned long		i2c_fclk_rate;
 	spinlock_t		dpll_lock;
+	/* sDMA, -1 channels when unavailable */
+	int			dma_rx_ch;
+	int			dma_tx_ch;
+	int			dma_rx_req;
+	int			dma_tx_req;
+	bool			dma_tx_ok;	/* TX DMA safe on this IP */
+	u8			*dma_buf;
+	dma_addr_t		dma_buf_phys;
+	dma_addr_t		phys_data;	/* DATA register */
+	struct completion	dma_complete;
+	/* Counters behind the debugfs statistics */
+	u32			stat_msgs;
+	u32			stat_dma_msgs;
+	u32			stat_irqs;
+	u64			stat_bytes;
+	u64			stat_busy_ns;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*debugfs;
+	char			bench[256];
+#endif
 };
 
 const static u8 reg_map[] = {
@@ -583,6 +622,96 @@ static int omap_i2c_wait_for_bb(struct omap_i2c_dev *dev)
 	return 0;
 }
 
+static void omap_i2c_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	complete(&dev->dma_complete);
+}
+
+static bool omap_i2c_use_dma(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	if (dev->dma_rx_ch < 0 || !dma_threshold || msg->len < dma_threshold ||
+	    msg->len > OMAP_I2C_DMA_BUF_SIZE)
+		return false;
+	return (msg->flags & I2C_M_RD) || dev->dma_tx_ok;
+}
+
+/*
+ * Hand the data phase of @msg to sDMA: one DMA request per byte, and the
+ * per-byte data interrupts masked so that only ARDY/NACK/AL reach the
+ * ISR. Returns the BUF register value to restore afterwards.
+ */
+static u16 omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	u16 buf = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+	u16 w = buf & ~(OMAP_I2C_BUF_RTRSH_MASK | OMAP_I2C_BUF_XTRSH_MASK |
+			OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR);
+	int ch;
+
+	INIT_COMPLETION(dev->dma_complete);
+
+	if (msg->flags & I2C_M_RD) {
+		ch = dev->dma_rx_ch;
+		omap_set_dma_transfer_params(ch, OMAP_DMA_DATA_TYPE_S8,
+				msg->len, 1, OMAP_DMA_SYNC_ELEMENT,
+				dev->dma_rx_req, 1);
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+				dev->phys_data, 0, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+				dev->dma_buf_phys, 0, 0);
+		w |= OMAP_I2C_BUF_RDMA_EN;
+	} else {
+		ch = dev->dma_tx_ch;
+		memcpy(dev->dma_buf, msg->buf, msg->len);
+		omap_set_dma_transfer_params(ch, OMAP_DMA_DATA_TYPE_S8,
+				msg->len, 1, OMAP_DMA_SYNC_ELEMENT,
+				dev->dma_tx_req, 0);
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+				dev->dma_buf_phys, 0, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+				dev->phys_data, 0, 0);
+		w |= OMAP_I2C_BUF_XDMA_EN;
+	}
+
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate &
+			~(OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY |
+			  OMAP_I2C_IE_XDR | OMAP_I2C_IE_RDR));
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
+	omap_start_dma(ch);
+
+	return buf;
+}
+
+/*
+ * Called once the controller is done with @msg. A read is only complete
+ * when the DMA has also emptied the RX FIFO. Returns 0 or -ETIMEDOUT.
+ */
+static int omap_i2c_dma_finish(struct omap_i2c_dev *dev, struct i2c_msg *msg,
+			       u16 buf, bool ok)
+{
+	int ch, r = 0;
+
+	if (msg->flags & I2C_M_RD) {
+		ch = dev->dma_rx_ch;
+		if (ok && !wait_for_completion_timeout(&dev->dma_complete,
+						       OMAP_I2C_TIMEOUT)) {
+			dev_err(dev->dev, "RX DMA timed out\n");
+			r = -ETIMEDOUT;
+		}
+	} else {
+		ch = dev->dma_tx_ch;
+	}
+	omap_stop_dma(ch);
+
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+
+	if (ok && !r && (msg->flags & I2C_M_RD))
+		memcpy(msg->buf, dev->dma_buf, msg->len);
+	return r;
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -591,7 +720,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
 	int r;
-	u16 w;
+	u16 w, dma_buf = 0;
+	bool dma;
 	static struct pm_qos_request_list *qos_handle;
 
 	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
@@ -616,6 +746,15 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	init_completion(&dev->cmd_complete);
 	dev->cmd_err = 0;
 
+	dev->stat_msgs++;
+	dev->stat_bytes += msg->len;
+	dma = omap_i2c_use_dma(dev, msg);
+	if (dma) {
+		dev->stat_dma_msgs++;
+		dev->buf_len = 0;
+		dma_buf = omap_i2c_dma_start(dev, msg);
+	}
+
 	w = OMAP_I2C_CON_EN | OMAP_I2C_CON_MST | OMAP_I2C_CON_STT;
 
 	/* High speed configuration */
@@ -645,6 +784,9 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			if (time_after(jiffies, delay)) {
 				dev_err(dev->dev, "controller timed out "
 				"waiting for start condition to finish\n");
+				if (dma)
+					omap_i2c_dma_finish(dev, msg, dma_buf,
+							    false);
 				return -ETIMEDOUT;
 			}
 			cpu_relax();
@@ -666,6 +808,11 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	if (dev->set_mpu_wkup_lat != NULL)
 		dev->set_mpu_wkup_lat(&qos_handle, -1);
 	dev->buf_len = 0;
+	if (dma && omap_i2c_dma_finish(dev, msg, dma_buf,
+				       r > 0 && !dev->cmd_err)) {
+		omap_i2c_init(dev);
+		return -ETIMEDOUT;
+	}
 	if (r < 0)
 		return r;
 	if (r == 0) {
@@ -764,6 +911,7 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	int r;
 	struct platform_device *pdev;
 	struct omap_i2c_bus_platform_data *pdata;
+	ktime_t start = ktime_get();
 
 	pdev = container_of(dev->dev, struct platform_device, dev);
 	pdata = pdev->dev.platform_data;
@@ -812,6 +960,7 @@ out:
 	disable_irq_nosync(dev->irq);
 	omap_i2c_idle(dev);
 	omap_i2c_hwspinlock_unlock(dev);
+	dev->stat_busy_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 	return r;
 }
 
@@ -963,6 +1112,7 @@ omap_i2c_isr(int this_irq, void *dev_id)
 	if (dev->idle)
 		return IRQ_NONE;
 
+	dev->stat_irqs++;
 	bits = omap_i2c_read_reg(dev, OMAP_I2C_IE_REG);
 	while ((stat = (omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG))) & bits) {
 		dev_dbg(dev->dev, "IRQ (ISR = 0x%04x)\n", stat);
@@ -1113,6 +1263,245 @@ static const struct i2c_algorithm omap_i2c_algo = {
 	.functionality	= omap_i2c_func,
 };
 
+static void __devinit omap_i2c_request_dma(struct omap_i2c_dev *dev,
+					   struct platform_device *pdev,
+					   struct resource *mem)
+{
+	struct resource *rx, *tx;
+
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+
+	rx = platform_get_resource_byname(pdev, IORESOURCE_DMA, "rx");
+	tx = platform_get_resource_byname(pdev, IORESOURCE_DMA, "tx");
+	if (!rx || !tx || !dev->fifo_size)
+		return;
+
+	dev->dma_buf = dma_alloc_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+					  &dev->dma_buf_phys, GFP_KERNEL);
+	if (!dev->dma_buf)
+		return;
+
+	if (omap_request_dma(rx->start, "I2C RX", omap_i2c_dma_callback, dev,
+			     &dev->dma_rx_ch))
+		goto err_free_buf;
+	if (omap_request_dma(tx->start, "I2C TX", omap_i2c_dma_callback, dev,
+			     &dev->dma_tx_ch))
+		goto err_free_rx;
+
+	dev->dma_rx_req = rx->start;
+	dev->dma_tx_req = tx->start;
+	dev->phys_data = mem->start +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+	init_completion(&dev->dma_complete);
+	/*
+	 * Errata 1.153 needs XUDF polled before every TX FIFO write, which
+	 * DMA cannot do; only reads are moved by DMA on such controllers.
+	 */
+	dev->dma_tx_ok = !(dev->errata & I2C_OMAP3_1P153);
+	return;
+
+err_free_rx:
+	omap_free_dma(dev->dma_rx_ch);
+	dev->dma_rx_ch = -1;
+err_free_buf:
+	dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE, dev->dma_buf,
+			  dev->dma_buf_phys);
+	dev->dma_buf = NULL;
+	dev_warn(dev->dev, "no DMA channels, using PIO only\n");
+}
+
+static void omap_i2c_free_dma(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_rx_ch < 0)
+		return;
+	omap_free_dma(dev->dma_tx_ch);
+	omap_free_dma(dev->dma_rx_ch);
+	dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE, dev->dma_buf,
+			  dev->dma_buf_phys);
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+}
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * /sys/kernel/debug/i2c-omap.<bus>/stats: traffic since the last reset,
+ * any write resets it.
+ * /sys/kernel/debug/i2c-omap.<bus>/bench: writing "<addr> <reg> <len>
+ * <loops>" reads <len> bytes from register <reg> of client <addr>
+ * <loops> times, once by PIO and once by DMA, and reading the file shows
+ * the throughput and the interrupts taken per transfer.
+ */
+static void omap_i2c_stats_reset(struct omap_i2c_dev *dev)
+{
+	dev->stat_msgs = 0;
+	dev->stat_dma_msgs = 0;
+	dev->stat_irqs = 0;
+	dev->stat_bytes = 0;
+	dev->stat_busy_ns = 0;
+}
+
+static int omap_i2c_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap_i2c_dev *dev = s->private;
+	u64 bps = 0;
+
+	if (dev->stat_busy_ns)
+		bps = div64_u64(dev->stat_bytes * NSEC_PER_SEC,
+				dev->stat_busy_ns);
+
+	seq_printf(s, "messages:   %u (%u by DMA)\n", dev->stat_msgs,
+		   dev->stat_dma_msgs);
+	seq_printf(s, "bytes:      %llu\n", dev->stat_bytes);
+	seq_printf(s, "irqs:       %u\n", dev->stat_irqs);
+	seq_printf(s, "busy:       %llu us\n",
+		   div_u64(dev->stat_busy_ns, 1000));
+	seq_printf(s, "throughput: %llu bytes/s\n", bps);
+	seq_printf(s, "dma:        %s\n", dev->dma_rx_ch < 0 ? "none" :
+		   dev->dma_tx_ok ? "rx/tx" : "rx");
+	return 0;
+}
+
+static int omap_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_i2c_stats_show, inode->i_private);
+}
+
+static ssize_t omap_i2c_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+
+	omap_i2c_stats_reset(s->private);
+	return count;
+}
+
+static const struct file_operations omap_i2c_stats_fops = {
+	.open		= omap_i2c_stats_open,
+	.read		= seq_read,
+	.write		= omap_i2c_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int omap_i2c_bench_run(struct omap_i2c_dev *dev, const char *mode,
+			      struct i2c_msg *msgs, unsigned loops, char *out,
+			      size_t size)
+{
+	unsigned i, msgs_before = dev->stat_msgs;
+	u32 irqs_before = dev->stat_irqs;
+	ktime_t start = ktime_get();
+	u64 ns, bps;
+	int r;
+
+	for (i = 0; i < loops; i++) {
+		r = i2c_transfer(&dev->adapter, msgs, 2);
+		if (r != 2)
+			return scnprintf(out, size, "%s: transfer %u failed: %d\n",
+					 mode, i, r);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bps = ns ? div64_u64((u64)msgs[1].len * loops * NSEC_PER_SEC, ns) : 0;
+
+	return scnprintf(out, size, "%s: %llu bytes/s, %u.%02u irqs/transfer, "
+			 "%u messages\n", mode, bps,
+			 (dev->stat_irqs - irqs_before) / loops,
+			 (dev->stat_irqs - irqs_before) * 100 / loops % 100,
+			 dev->stat_msgs - msgs_before);
+}
+
+static ssize_t omap_i2c_bench_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct omap_i2c_dev *dev = file->private_data;
+	unsigned addr, reg, len, loops, threshold = dma_threshold;
+	struct i2c_msg msgs[2];
+	char buf[32], *out = dev->bench;
+	size_t size = sizeof(dev->bench);
+	u8 regbuf, *data;
+	int n;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	if (sscanf(buf, "%x %x %u %u", &addr, &reg, &len, &loops) != 4 ||
+	    !len || len > OMAP_I2C_DMA_BUF_SIZE || !loops)
+		return -EINVAL;
+
+	data = kmalloc(len, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	regbuf = reg;
+	msgs[0].addr = addr;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &regbuf;
+	msgs[1].addr = addr;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = len;
+	msgs[1].buf = data;
+
+	/* Other traffic on the bus follows the forced mode meanwhile */
+	dma_threshold = 0;
+	n = omap_i2c_bench_run(dev, "pio", msgs, loops, out, size);
+	if (dev->dma_rx_ch >= 0) {
+		dma_threshold = 1;
+		n += omap_i2c_bench_run(dev, "dma", msgs, loops, out + n,
+					size - n);
+	}
+	dma_threshold = threshold;
+
+	kfree(data);
+	return count;
+}
+
+static ssize_t omap_i2c_bench_read(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct omap_i2c_dev *dev = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, dev->bench,
+				       strlen(dev->bench));
+}
+
+static int omap_i2c_bench_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations omap_i2c_bench_fops = {
+	.open		= omap_i2c_bench_open,
+	.read		= omap_i2c_bench_read,
+	.write		= omap_i2c_bench_write,
+};
+
+static void omap_i2c_debugfs_init(struct omap_i2c_dev *dev, int id)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "i2c-omap.%d", id);
+	dev->debugfs = debugfs_create_dir(name, NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs))
+		return;
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, dev->debugfs, dev,
+			    &omap_i2c_stats_fops);
+	debugfs_create_file("bench", S_IRUSR | S_IWUSR, dev->debugfs, dev,
+			    &omap_i2c_bench_fops);
+}
+
+static void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev)
+{
+	debugfs_remove_recursive(dev->debugfs);
+}
+#else
+static inline void omap_i2c_debugfs_init(struct omap_i2c_dev *dev, int id) {}
+static inline void omap_i2c_debugfs_exit(struct omap_i2c_dev *dev) {}
+#endif
+
 static int __devinit
 omap_i2c_probe(struct platform_device *pdev)
 {
@@ -1228,6 +1617,8 @@ omap_i2c_probe(struct platform_device *pdev)
 	/* reset ASAP, clearing any IRQs */
 	omap_i2c_init(dev);
 
+	omap_i2c_request_dma(dev, pdev, mem);
+
 	isr = (dev->rev < OMAP_I2C_REV_2) ? omap_i2c_rev1_isr : omap_i2c_isr;
 	r = request_irq(dev->irq, isr, 0, pdev->name, dev);
 
@@ -1262,11 +1653,14 @@ omap_i2c_probe(struct platform_device *pdev)
 		goto err_free_irq;
 	}
 
+	omap_i2c_debugfs_init(dev, pdev->id);
+
 	return 0;
 
 err_free_irq:
 	free_irq(dev->irq, dev);
 err_unuse_clocks:
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	omap_i2c_idle(dev);
 	iounmap(dev->base);
@@ -1287,8 +1681,10 @@ omap_i2c_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 
+	omap_i2c_debugfs_exit(dev);
 	free_irq(dev->irq, dev);
 	i2c_del_adapter(&dev->adapter);
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	iounmap(dev->base);
 	kfree(dev);
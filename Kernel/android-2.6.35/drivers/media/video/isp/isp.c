@@ -36,6 +36,9 @@
 #include <linux/platform_device.h>
 #include <linux/device.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "isp.h"
 #include "ispreg.h"
@@ -892,6 +895,7 @@ void isp_hist_dma_done(struct device *dev)
 }
 
 static void isp_buf_process(struct device *dev, struct isp_bufs *bufs);
+static void isp_pool_first_frame(struct isp_device *isp);
 
 /**
  * isp_isr - Interrupt Service Routine for Camera ISP module.
@@ -1382,8 +1386,15 @@ static u32 isp_tmp_buf_alloc(struct device *dev, struct isp_pipeline *pipe)
 				 isp->pipeline.prv.out.image.height *
 				 ISP_BYTES_PER_PIXEL);
 
-	if (isp->tmp_buf_size >= size)
-		return 0;
+	/*
+	 * The buffer outlives the session that allocated it, so a camera
+	 * reopened with the same (or a smaller) preview size skips the
+	 * allocation and ISP MMU mapping entirely.
+	 */
+	if (isp->tmp_buf_size >= size) {
+		isp->pool.tmp_buf_reuse++;
+		goto set_addr;
+	}
 
 	isp_tmp_buf_free(dev);
 
@@ -1394,7 +1405,9 @@ static u32 isp_tmp_buf_alloc(struct device *dev, struct isp_pipeline *pipe)
 	}
 	isp->tmp_buf = da;
 	isp->tmp_buf_size = size;
+	isp->pool.tmp_buf_alloc++;
 
+set_addr:
 	isppreview_set_outaddr(&isp->isp_prev, isp->tmp_buf);
 	ispresizer_set_inaddr(&isp->isp_res, isp->tmp_buf, NULL);
 
@@ -2118,6 +2131,9 @@ printk("<%s>[%d]\n", __func__, __LINE__);		//&*&*&*CJ_20110811_mod: follow TI MM
 	/* Mark the current buffer as done. */
 	ISP_BUF_MARK_DONE(bufs);
 
+	if (isp->pool.first_frame_pending && buf->vb_state == VIDEOBUF_DONE)
+		isp_pool_first_frame(isp);
+
 	DPRINTK_ISPCTRL(KERN_ALERT "%s: finish %d mmu %p\n", __func__,
 			(bufs->done - 1 + NUM_BUFS) % NUM_BUFS,
 			(bufs->buf+((bufs->done - 1 + NUM_BUFS)
@@ -2276,16 +2292,18 @@ int isp_vbq_setup(struct device *dev, struct videobuf_queue *vbq,
 EXPORT_SYMBOL(isp_vbq_setup);
 
 /**
- * ispmmu_vmap - Wrapper for Virtual memory mapping of a scatter gather list
+ * __ispmmu_vmap - Map a scatter gather list into the ISP MMU
  * @dev: Device pointer specific to the OMAP3 ISP.
  * @sglist: Pointer to source Scatter gather list to allocate.
  * @sglen: Number of elements of the scatter-gatter list.
+ * @sgtp: Returns the scatter-gather table backing the mapping, if not NULL.
  *
  * Returns a resulting mapped device address by the ISP MMU, or -ENOMEM if
  * we ran out of memory.
  **/
-dma_addr_t ispmmu_vmap(struct device *dev, const struct scatterlist *sglist,
-		       int sglen)
+static dma_addr_t __ispmmu_vmap(struct device *dev,
+				const struct scatterlist *sglist, int sglen,
+				struct sg_table **sgtp)
 {
 	struct isp_device *isp = dev_get_drvdata(dev);
 	int err;
@@ -2313,6 +2331,8 @@ dma_addr_t ispmmu_vmap(struct device *dev, const struct scatterlist *sglist,
 	if (IS_ERR_VALUE(da))
 		goto err_vmap;
 
+	if (sgtp)
+		*sgtp = sgt;
 	return (dma_addr_t)da;
 
 err_vmap:
@@ -2321,6 +2341,21 @@ err_sg_alloc:
 	kfree(sgt);
 	return -ENOMEM;
 }
+
+/**
+ * ispmmu_vmap - Wrapper for Virtual memory mapping of a scatter gather list
+ * @dev: Device pointer specific to the OMAP3 ISP.
+ * @sglist: Pointer to source Scatter gather list to allocate.
+ * @sglen: Number of elements of the scatter-gatter list.
+ *
+ * Returns a resulting mapped device address by the ISP MMU, or -ENOMEM if
+ * we ran out of memory.
+ **/
+dma_addr_t ispmmu_vmap(struct device *dev, const struct scatterlist *sglist,
+		       int sglen)
+{
+	return __ispmmu_vmap(dev, sglist, sglen, NULL);
+}
 EXPORT_SYMBOL_GPL(ispmmu_vmap);
 
 /**
@@ -2341,6 +2376,243 @@ void ispmmu_vunmap(struct device *dev, dma_addr_t da)
 }
 EXPORT_SYMBOL_GPL(ispmmu_vunmap);
 
+/**
+ * isp_pool_match - Check if a cached mapping covers a scatter gather list.
+ * @map: Cached ISP MMU mapping.
+ * @sglist: DMA mapped scatter gather list of the video buffer.
+ * @sglen: Number of elements of the scatter-gatter list.
+ *
+ * Returns 1 if @map maps exactly the same physical chunks, in the same
+ * order, as @sglist.
+ **/
+static int isp_pool_match(struct isp_map *map,
+			  const struct scatterlist *sglist, int sglen)
+{
+	struct scatterlist *sg;
+	unsigned int i;
+
+	if (map->sgt->nents != sglen)
+		return 0;
+
+	for_each_sg(map->sgt->sgl, sg, map->sgt->nents, i) {
+		if (sg_phys(sg) != sg_dma_address(sglist + i) ||
+		    sg->length != sg_dma_len(sglist + i))
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * isp_pool_hold_pages - Take or drop a reference on the pages of a mapping.
+ * @map: Cached ISP MMU mapping.
+ * @hold: Non-zero to take a reference, zero to drop it.
+ *
+ * A cached mapping outlives the video buffer it was created for: videobuf
+ * unpins user pages or vfree()s its own buffer once the buffer is released,
+ * while the ISP MMU still points at them. Holding a page reference for as
+ * long as the mapping exists keeps those pages from being reused, so a late
+ * ISP write after a stream stop cannot land in someone else's memory.
+ **/
+static void isp_pool_hold_pages(struct isp_map *map, int hold)
+{
+	struct scatterlist *sg;
+	unsigned long pfn, last;
+	unsigned int i;
+
+	for_each_sg(map->sgt->sgl, sg, map->sgt->nents, i) {
+		pfn = page_to_pfn(sg_page(sg));
+		last = pfn + (PAGE_ALIGN(sg->offset + sg->length) >> PAGE_SHIFT);
+		for (; pfn < last; pfn++) {
+			if (!pfn_valid(pfn))
+				continue;
+			if (hold)
+				get_page(pfn_to_page(pfn));
+			else
+				put_page(pfn_to_page(pfn));
+		}
+	}
+}
+
+/**
+ * isp_pool_trim - Drop idle cached mappings, least recently used first.
+ * @dev: Device pointer specific to the OMAP3 ISP.
+ * @keep: Number of idle mappings to keep.
+ *
+ * Must be called with the pool lock held.
+ **/
+static void isp_pool_trim(struct device *dev, unsigned int keep)
+{
+	struct isp_device *isp = dev_get_drvdata(dev);
+	struct isp_pool *pool = &isp->pool;
+	struct isp_map *map, *tmp;
+
+	list_for_each_entry_safe_reverse(map, tmp, &pool->maps, list) {
+		if (pool->nr_idle <= keep)
+			break;
+		if (map->in_use)
+			continue;
+		list_del(&map->list);
+		isp_pool_hold_pages(map, 0);
+		ispmmu_vunmap(dev, map->da);
+		kfree(map);
+		pool->nr_maps--;
+		pool->nr_idle--;
+		pool->evictions++;
+	}
+}
+
+/**
+ * isp_pool_get - Get an ISP MMU mapping for a video buffer.
+ * @dev: Device pointer specific to the OMAP3 ISP.
+ * @sglist: DMA mapped scatter gather list of the video buffer.
+ * @sglen: Number of elements of the scatter-gatter list.
+ *
+ * Reuses an idle mapping of the same pages when one is cached, so that
+ * re-queueing a user pointer buffer or restarting the stream does not go
+ * through the ISP MMU again. Otherwise a new mapping is created and added
+ * to the pool.
+ *
+ * Returns the ISP MMU device address, or a negative error code.
+ **/
+static dma_addr_t isp_pool_get(struct device *dev,
+			       const struct scatterlist *sglist, int sglen)
+{
+	struct isp_device *isp = dev_get_drvdata(dev);
+	struct isp_pool *pool = &isp->pool;
+	struct isp_map *map;
+	dma_addr_t da;
+
+	mutex_lock(&pool->lock);
+	list_for_each_entry(map, &pool->maps, list) {
+		if (map->in_use || !isp_pool_match(map, sglist, sglen))
+			continue;
+		map->in_use = 1;
+		list_move(&map->list, &pool->maps);
+		pool->nr_idle--;
+		pool->hits++;
+		da = map->da;
+		goto out;
+	}
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map) {
+		da = -ENOMEM;
+		goto out;
+	}
+
+	da = __ispmmu_vmap(dev, sglist, sglen, &map->sgt);
+	if (IS_ERR_VALUE(da)) {
+		kfree(map);
+		goto out;
+	}
+	map->da = da;
+	map->in_use = 1;
+	isp_pool_hold_pages(map, 1);
+	list_add(&map->list, &pool->maps);
+	pool->nr_maps++;
+	pool->misses++;
+out:
+	mutex_unlock(&pool->lock);
+	return da;
+}
+
+/**
+ * isp_pool_put - Release an ISP MMU mapping obtained from isp_pool_get.
+ * @dev: Device pointer specific to the OMAP3 ISP.
+ * @da: ISP MMU device address of the mapping.
+ *
+ * The mapping stays cached for reuse, and it can only be handed out again
+ * for the very same pages. The pool keeps its own reference on those pages
+ * until the mapping is evicted, so they are not reused while the ISP MMU
+ * still maps them.
+ **/
+static void isp_pool_put(struct device *dev, dma_addr_t da)
+{
+	struct isp_device *isp = dev_get_drvdata(dev);
+	struct isp_pool *pool = &isp->pool;
+	struct isp_map *map;
+
+	mutex_lock(&pool->lock);
+	list_for_each_entry(map, &pool->maps, list) {
+		if (map->in_use && map->da == da) {
+			map->in_use = 0;
+			pool->nr_idle++;
+			break;
+		}
+	}
+	isp_pool_trim(dev, ISP_MAP_CACHE_SIZE);
+	mutex_unlock(&pool->lock);
+}
+
+/**
+ * isp_pool_first_frame - Account the open-to-first-frame latency.
+ * @isp: Pointer to ISP device structure.
+ *
+ * Called from the ISP interrupt handler when the first buffer of a session
+ * is completed.
+ **/
+static void isp_pool_first_frame(struct isp_device *isp)
+{
+	struct isp_pool *pool = &isp->pool;
+	s64 us = ktime_to_us(ktime_sub(ktime_get(), pool->open_time));
+
+	pool->first_frame_pending = 0;
+	pool->latency_last_us = us;
+	if (!pool->sessions || us < pool->latency_min_us)
+		pool->latency_min_us = us;
+	if (us > pool->latency_max_us)
+		pool->latency_max_us = us;
+	pool->latency_total_us += us;
+	pool->sessions++;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int isp_pool_show(struct seq_file *s, void *unused)
+{
+	struct isp_device *isp = s->private;
+	struct isp_pool *pool = &isp->pool;
+
+	mutex_lock(&pool->lock);
+	seq_printf(s, "mappings:       %u (%u idle, %u idle max)\n",
+		   pool->nr_maps, pool->nr_idle, ISP_MAP_CACHE_SIZE);
+	seq_printf(s, "map hits:       %lu\n", pool->hits);
+	seq_printf(s, "map misses:     %lu\n", pool->misses);
+	seq_printf(s, "map evictions:  %lu\n", pool->evictions);
+	mutex_unlock(&pool->lock);
+
+	mutex_lock(&isp->isp_mutex);
+	seq_printf(s, "tmp_buf:        %zu bytes (reused %lu, allocated %lu)\n",
+		   isp->tmp_buf_size, pool->tmp_buf_reuse, pool->tmp_buf_alloc);
+	mutex_unlock(&isp->isp_mutex);
+
+	if (!pool->sessions) {
+		seq_printf(s, "open to first frame: no frame yet\n");
+		return 0;
+	}
+	seq_printf(s, "open to first frame (us): last %lld min %lld "
+		   "max %lld avg %lld (%lu sessions)\n",
+		   pool->latency_last_us, pool->latency_min_us,
+		   pool->latency_max_us,
+		   div_s64(pool->latency_total_us, pool->sessions),
+		   pool->sessions);
+
+	return 0;
+}
+
+static int isp_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, isp_pool_show, inode->i_private);
+}
+
+static const struct file_operations isp_pool_fops = {
+	.open		= isp_pool_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 /**
  * isp_vbq_prepare - Videobuffer queue prepare.
  * @dev: Device pointer specific to the OMAP3 ISP.
@@ -2363,7 +2635,7 @@ int isp_vbq_prepare(struct device *dev, struct videobuf_queue *vbq,
 
 	vdma = videobuf_to_dma(vb);
 
-	isp_addr = ispmmu_vmap(dev, vdma->sglist, vdma->sglen);
+	isp_addr = isp_pool_get(dev, vdma->sglist, vdma->sglen);
 
 	if (IS_ERR_VALUE(isp_addr))
 		err = -EIO;
@@ -2386,12 +2658,86 @@ void isp_vbq_release(struct device *dev, struct videobuf_queue *vbq,
 	struct isp_device *isp = dev_get_drvdata(dev);
 	struct isp_bufs *bufs = &isp->bufs;
 
-	ispmmu_vunmap(dev, bufs->isp_addr_capture[vb->i]);
+	isp_pool_put(dev, bufs->isp_addr_capture[vb->i]);
 	bufs->isp_addr_capture[vb->i] = (dma_addr_t)NULL;
 	return;
 }
 EXPORT_SYMBOL(isp_vbq_release);
 
+/**
+ * isp_frame_bytes - Bytes of memory one frame of a format occupies.
+ * @pix: Image format.
+ **/
+static u64 isp_frame_bytes(const struct v4l2_pix_format *pix)
+{
+	if (pix->bytesperline)
+		return (u64)pix->bytesperline * pix->height;
+
+	return (u64)pix->width * pix->height * ISP_BYTES_PER_PIXEL;
+}
+
+/**
+ * isp_tput - Turn bytes moved per frame into an L3 throughput.
+ * @bytes: Bytes read and written per frame.
+ * @tpf: Frame interval, ISP_M2M_FRAME_RATE is used if it is not set.
+ *
+ * Returns the throughput in KiB/s, as omap_pm_set_min_bus_tput() wants it.
+ **/
+static unsigned long isp_tput(u64 bytes, const struct v4l2_fract *tpf)
+{
+	u32 num = 1, den = ISP_M2M_FRAME_RATE;
+
+	if (tpf && tpf->numerator && tpf->denominator) {
+		num = tpf->numerator;
+		den = tpf->denominator;
+	}
+
+	bytes *= den;
+	do_div(bytes, num);
+	do_div(bytes, 1024);
+
+	return bytes ? (unsigned long)bytes : 1;
+}
+
+/**
+ * isp_node_bus_tput - L3 throughput of a memory to memory ISP job.
+ * @node: Input and output formats of the job.
+ * @tpf: Frame interval, ISP_M2M_FRAME_RATE is used if NULL.
+ *
+ * The engine reads the input frame and writes the output frame once per
+ * job. Returns the demand in KiB/s.
+ **/
+unsigned long isp_node_bus_tput(const struct isp_node *node,
+				const struct v4l2_fract *tpf)
+{
+	return isp_tput(isp_frame_bytes(&node->in.image) +
+			isp_frame_bytes(&node->out.image), tpf);
+}
+EXPORT_SYMBOL(isp_node_bus_tput);
+
+/**
+ * isp_capture_bus_tput - L3 throughput of the configured capture pipeline.
+ * @dev: Device pointer specific to the OMAP3 ISP.
+ * @tpf: Sensor frame interval.
+ *
+ * The sensor data arrives over the camera interface, so only the frames
+ * the ISP writes to memory count, plus the write and read back of the
+ * temporary buffer on ISP revisions that need the CCDC->PRV->RSZ
+ * workaround. Returns the demand in KiB/s.
+ **/
+unsigned long isp_capture_bus_tput(struct device *dev,
+				   const struct v4l2_fract *tpf)
+{
+	struct isp_device *isp = dev_get_drvdata(dev);
+	u64 bytes = isp_frame_bytes(&isp->pipeline.out_pix);
+
+	if (CCDC_PREV_RESZ_CAPTURE(isp) && isp->revision <= ISP_REVISION_2_0)
+		bytes += 2 * isp_frame_bytes(&isp->pipeline.prv.out.image);
+
+	return isp_tput(bytes, tpf);
+}
+EXPORT_SYMBOL(isp_capture_bus_tput);
+
 /**
  * isp_queryctrl - Query V4L2 control from existing controls in ISP.
  * @a: Pointer to v4l2_queryctrl structure. It only needs the id field filled.
@@ -2995,6 +3341,8 @@ struct device *isp_get(void)
 			isp_restore_ctx(&pdev->dev);
 		else
 			has_context = 1;
+		isp->pool.open_time = ktime_get();
+		isp->pool.first_frame_pending = 1;
 		/* HACK: Allow multiple opens meanwhile a better solution is
 		 *       found for the case of different devices sharing ISP
 		 *       settings. */
@@ -3036,8 +3384,7 @@ int isp_put(void)
 	if (isp->ref_count) {
 		if (--isp->ref_count == 0) {
 			isp_save_ctx(&pdev->dev);
-			if (isp->revision <= ISP_REVISION_2_0)
-				isp_tmp_buf_free(&pdev->dev);
+			isp->pool.first_frame_pending = 0;
 			isp_release_resources(&pdev->dev);
 			isp_disable_clocks(&pdev->dev);
 		}
@@ -3097,9 +3444,17 @@ static int isp_remove(struct platform_device *pdev)
 	isp_af_exit(&pdev->dev);
 	isp_resizer_cleanup(&pdev->dev);
 	isp_preview_cleanup(&pdev->dev);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(isp->pool.dfs_pool);
+#endif
 	isp_get();
-	if (isp->iommu)
+	if (isp->iommu) {
+		mutex_lock(&isp->pool.lock);
+		isp_pool_trim(&pdev->dev, 0);
+		mutex_unlock(&isp->pool.lock);
+		isp_tmp_buf_free(&pdev->dev);
 		iommu_put(isp->iommu);
+	}
 	isp_put();
 	isph3a_aewb_cleanup(&pdev->dev);
 	isp_hist_cleanup(&pdev->dev);
@@ -3344,6 +3699,8 @@ printk("\n\n [%s] INIT \n\n"
 	mutex_init(&(isp->isp_mutex));
 	spin_lock_init(&isp->lock);
 	spin_lock_init(&isp->h3a_lock);
+	mutex_init(&isp->pool.lock);
+	INIT_LIST_HEAD(&isp->pool.maps);
 
 	isp->dev->dma_mask = &raw_dmamask;
 	isp->dev->coherent_dma_mask = DMA_BIT_MASK(32);
@@ -3380,6 +3737,11 @@ printk("\n\n [%s] INIT \n\n"
 	isp_power_settings(&pdev->dev, 1);
 	isp_put();
 
+#ifdef CONFIG_DEBUG_FS
+	isp->pool.dfs_pool = debugfs_create_file("isp_pool", S_IRUGO, NULL,
+						 isp, &isp_pool_fops);
+#endif
+
 	return 0;
 
 out_iommu_get:
@@ -30,6 +30,8 @@
 #include <media/videobuf-dma-sg.h>
 #include <linux/device.h>
 #include <linux/videodev2.h>
+#include <linux/list.h>
+#include <linux/ktime.h>
 
 #include <asm/io.h>
 
@@ -65,11 +67,20 @@ struct isp_pipeline;
 						 */
 #define NUM_BUFS		VIDEO_MAX_FRAME
 
+/* Idle ISP MMU mappings kept around for reuse by later sessions */
+#define ISP_MAP_CACHE_SIZE	16
+
 #define ISP_REVISION_2_0            0x20
 #define ISP_REVISION_2_1            0x21
 #define ISP_REVISION_RAPXXX         0xF0
 
 #define ISP_BYTES_PER_PIXEL		2
+
+/*
+ * Frame rate assumed for memory to memory jobs when sizing their L3
+ * throughput constraint, since the user interface carries no rate
+ */
+#define ISP_M2M_FRAME_RATE		30
 #define NUM_ISP_CAPTURE_FORMATS 	(sizeof(isp_formats) /		\
 					 sizeof(isp_formats[0]))
 
@@ -260,6 +271,60 @@ struct isp_bufs {
 	int wait_hs_vs;
 };
 
+/**
+ * struct isp_map - Cached ISP MMU mapping of a video buffer.
+ * @list: Entry in the ISP mapping pool, most recently used first.
+ * @sgt: Scatter-gather table owned by the IOMMU mapping.
+ * @da: ISP MMU device address of the mapping.
+ * @in_use: Set while a video buffer is using the mapping.
+ */
+struct isp_map {
+	struct list_head list;
+	struct sg_table *sgt;
+	dma_addr_t da;
+	int in_use;
+};
+
+/**
+ * struct isp_pool - Persistent ISP buffer mapping pool.
+ * @lock: Serializes access to the pool.
+ * @maps: List of struct isp_map, most recently used first.
+ * @nr_maps: Number of entries in @maps.
+ * @nr_idle: Number of entries in @maps not used by any video buffer.
+ * @hits: Buffer preparations that reused a cached mapping.
+ * @misses: Buffer preparations that created a new mapping.
+ * @evictions: Idle mappings dropped to keep the pool bounded.
+ * @tmp_buf_reuse: Sessions that reused the CCDC->PRV->RSZ temporary buffer.
+ * @tmp_buf_alloc: Sessions that had to (re)allocate the temporary buffer.
+ * @open_time: Time of the first ISP acquire of the current session.
+ * @first_frame_pending: Set until the session's first frame completes.
+ * @latency_last_us: Open-to-first-frame latency of the last session.
+ * @latency_min_us: Smallest open-to-first-frame latency seen.
+ * @latency_max_us: Largest open-to-first-frame latency seen.
+ * @latency_total_us: Sum of all measured latencies.
+ * @sessions: Number of sessions with a measured latency.
+ * @dfs_pool: Debugfs entry reporting the pool statistics.
+ */
+struct isp_pool {
+	struct mutex lock;
+	struct list_head maps;
+	unsigned int nr_maps;
+	unsigned int nr_idle;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long tmp_buf_reuse;
+	unsigned long tmp_buf_alloc;
+	ktime_t open_time;
+	int first_frame_pending;
+	s64 latency_last_us;
+	s64 latency_min_us;
+	s64 latency_max_us;
+	s64 latency_total_us;
+	unsigned long sessions;
+	struct dentry *dfs_pool;
+};
+
 /**
  * struct ispirq - Structure for containing callbacks to be called in ISP ISR.
  * @isp_callbk: Array which stores callback functions, indexed by the type of
@@ -368,6 +433,7 @@ struct isp_pipeline {
  * @tmp_buf_offset: ISP MMU mapped temporary buffer line offset used for 34xx
  *                  Workaround for CCDC->PRV->RSZ datapath errata.
  * @bufs: Internal ISP buffer queue list.
+ * @pool: Cached ISP MMU mappings of video buffers and session statistics.
  * @irq: Currently attached ISP ISR callbacks information structure.
  * @pipeline: Currently used internal ISP pipeline information.
  * @interrupts: ISP interrupts staged for deferred enabling.
@@ -421,6 +487,7 @@ struct isp_device {
 	size_t tmp_buf_size;
 	unsigned long tmp_buf_offset;
 	struct isp_bufs bufs;
+	struct isp_pool pool;
 	struct isp_irq irq;
 	struct isp_pipeline pipeline;
 	u32 interrupts;
@@ -494,6 +561,12 @@ int isp_vbq_prepare(struct device *dev, struct videobuf_queue *vbq,
 void isp_vbq_release(struct device *dev, struct videobuf_queue *vbq,
 		    struct videobuf_buffer *vb);
 
+unsigned long isp_node_bus_tput(const struct isp_node *node,
+				const struct v4l2_fract *tpf);
+
+unsigned long isp_capture_bus_tput(struct device *dev,
+				   const struct v4l2_fract *tpf);
+
 int isp_set_callback(struct device *dev, enum isp_callback_type type,
 		     isp_callback_t callback, isp_vbq_callback_ptr arg1,
 		     void *arg2);
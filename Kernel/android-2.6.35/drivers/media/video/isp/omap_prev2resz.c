@@ -22,15 +22,25 @@
 #include <linux/platform_device.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/poll.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+#include <linux/dma-mapping.h>
 #include <plat/omap-pm.h>
 #include "isp.h"
 #include <linux/omap_prev2resz.h>
 
 #define OMAP_PREV2RESZ_NAME	"omap-prev2resz"
 
+/* Jobs a file handle may have queued, running and not yet dequeued */
+#define PREV2RESZ_MAX_JOBS	VIDEO_MAX_FRAME
+#define PREV2RESZ_JOB_TIMEOUT	msecs_to_jiffies(1000)
+
 static struct device 		*p2r_device;
 static struct class		*p2r_class;
 static int			 p2r_major = -1;
+/* Protects the engine ownership in p2r_ctx */
+static DEFINE_SPINLOCK(p2r_lock);
 
 static struct isp_interface_config p2r_interface = {
 	.ccdc_par_ser		= ISP_NONE,
@@ -50,12 +60,44 @@ static struct {
 	struct prev2resz_status	status;		/* engines status */
 	struct completion	resz_complete;	/* completion for interrupt */
 
+	/*
+	 * Configuration currently programmed into the engines by the job
+	 * queue. Valid while a batch of jobs is running.
+	 */
+	int			hw_valid;
+	struct isp_node		hw_prev;
+	struct isp_node		hw_resz;
+
+	/*
+	 * File handle the engines belong to: the one whose job batch is
+	 * queued or running, or the one in PREV2RESZ_RUN_ENGINE (owner_sync
+	 * set). The engines, hw_* and the RESZ_DONE callback are shared by
+	 * every open, so nobody else may touch them meanwhile.
+	 */
+	struct prev2resz_fhdl	*owner;
+	int			owner_sync;
+
 	/*
 	 * Videobuf queue operations
 	 */
 	struct videobuf_queue_ops	vbq_ops;
 } p2r_ctx;
 
+/*
+ * Queued previewer/resizer job
+ */
+struct p2r_job {
+	struct list_head	list;
+	struct prev2resz_job	job;		/* user visible part */
+	u32			src_addr;	/* Input address */
+	u32			dst_addr;	/* Output address */
+	struct videobuf_dmabuf	*src_dma;	/* Input pages */
+	struct videobuf_dmabuf	*dst_dma;	/* Output pages */
+	struct isp_node		pipe;		/* User pipe configuration */
+	struct isp_node		prev;		/* Preview pipe node */
+	struct isp_node		resz;		/* Resizer pipe node */
+};
+
 /*
  * File handle data structure
  */
@@ -68,6 +110,10 @@ struct prev2resz_fhdl {
 	u32 src_buff_addr;	/* Input address */
 	int dst_buff_index;
 	u32 dst_buff_addr;	/* Output address */
+	u32 src_addrs[VIDEO_MAX_FRAME];	/* Input address per buffer */
+	u32 dst_addrs[VIDEO_MAX_FRAME];	/* Output address per buffer */
+	struct videobuf_dmabuf *src_dmas[VIDEO_MAX_FRAME];
+	struct videobuf_dmabuf *dst_dmas[VIDEO_MAX_FRAME];
 
 	struct device		*isp;
 	struct isp_device	*isp_dev;
@@ -78,6 +124,21 @@ struct prev2resz_fhdl {
 	spinlock_t		src_vbq_lock; /* spinlock for input queues. */
 	struct videobuf_queue	dst_vbq;
 	spinlock_t		dst_vbq_lock; /* spinlock for output queues. */
+
+	/*
+	 * Asynchronous job queue
+	 */
+	spinlock_t		job_lock;	/* protects the job state */
+	struct list_head	job_queue;	/* jobs waiting for the engines */
+	struct list_head	job_done;	/* finished jobs to dequeue */
+	struct p2r_job		*job_cur;	/* job in the engines */
+	unsigned int		job_count;	/* queued, running and done */
+	int			job_active;	/* callback and tput are held */
+	unsigned int		job_chained;	/* jobs started from the ISR */
+	unsigned int		job_loads;	/* full engine configurations */
+	wait_queue_head_t	job_wait;	/* woken when a job finishes */
+	struct work_struct	job_work;	/* (re)configures the engines */
+	struct timer_list	job_timer;	/* resizer interrupt watchdog */
 };
 
 /*
@@ -158,21 +219,35 @@ static int prev2resz_ioc_set_config(struct prev2resz_fhdl *fh)
 	return 0;
 }
 
-static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
+/*
+ * prev2resz_config_engines - Program previewer and resizer for one frame
+ *
+ *	@fh: File handle
+ *	@pipe: User pipe configuration
+ *	@prev: Preview pipe node
+ *	@resz: Resizer pipe node
+ *	@src_addr: ISP MMU address of the input buffer
+ *	@dst_addr: ISP MMU address of the output buffer
+ */
+static int prev2resz_config_engines(struct prev2resz_fhdl *fh,
+				    struct isp_node *pipe,
+				    struct isp_node *prev,
+				    struct isp_node *resz,
+				    u32 src_addr, u32 dst_addr)
 {
 	struct isp_freq_devider *fdiv;
 	int rval;
 
-	rval = isppreview_s_pipeline(fh->isp_prev, &fh->prev);
+	rval = isppreview_s_pipeline(fh->isp_prev, prev);
 	if (rval != 0)
 		return rval;
 
-	rval = isppreview_set_inaddr(fh->isp_prev, fh->src_buff_addr);
+	rval = isppreview_set_inaddr(fh->isp_prev, src_addr);
 	if (rval != 0)
 		return rval;
 
 	rval = isppreview_config_inlineoffset(fh->isp_prev,
-				fh->prev.in.image.bytesperline);
+				prev->in.image.bytesperline);
 	if (rval != 0)
 		return rval;
 
@@ -186,37 +261,73 @@ static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
 	if (rval != 0)
 		return rval;
 
-	isppreview_set_size(fh->isp_prev, fh->prev.in.image.width,
-			    fh->prev.in.image.height);
+	isppreview_set_size(fh->isp_prev, prev->in.image.width,
+			    prev->in.image.height);
 
 	/* Set resizer input and output size */
-	rval = ispresizer_s_pipeline(fh->isp_resz, &fh->resz);
+	rval = ispresizer_s_pipeline(fh->isp_resz, resz);
 	if (rval != 0)
 		return rval;
 
-	rval = ispresizer_set_outaddr(fh->isp_resz, fh->dst_buff_addr);
+	rval = ispresizer_set_outaddr(fh->isp_resz, dst_addr);
 	if (rval != 0)
 		return rval;
 
 	isp_configure_interface(fh->isp, &p2r_interface);
-	/*
-	 * Through-put requirement:
-	 * Set max OCP freq for 3630 is 200 MHz through-put
-	 * is in KByte/s so 200000 KHz * 4 = 800000 KByte/s
-	 */
-	omap_pm_set_min_bus_tput(fh->isp, OCP_INITIATOR_AGENT, 800000);
 
 	/* Reduces memory bandwidth */
-	fdiv = isp_get_upscale_ratio(fh->pipe.in.image.width,
-				     fh->pipe.in.image.height,
-				     fh->pipe.out.image.width,
-				     fh->pipe.out.image.height);
+	fdiv = isp_get_upscale_ratio(pipe->in.image.width,
+				     pipe->in.image.height,
+				     pipe->out.image.width,
+				     pipe->out.image.height);
 	dev_dbg(p2r_device, "Set the REQ_EXP register = %d.\n",
 		fdiv->prev_exp);
 	isp_reg_and_or(fh->isp, OMAP3_ISP_IOMEM_SBL, ISPSBL_SDR_REQ_EXP,
 		       ~(ISPSBL_SDR_REQ_PRV_EXP_MASK |
 		         ISPSBL_SDR_REQ_RSZ_EXP_MASK),
 		         fdiv->prev_exp << ISPSBL_SDR_REQ_PRV_EXP_SHIFT);
+
+	return 0;
+}
+
+static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
+{
+	unsigned long flags;
+	int rval;
+
+	/*
+	 * A job batch that just drained releases the callback, the
+	 * throughput and the engines from the job work; let that finish
+	 * before installing our own callback
+	 */
+	flush_work(&fh->job_work);
+
+	spin_lock_irqsave(&p2r_lock, flags);
+	spin_lock(&fh->job_lock);
+	if (p2r_ctx.owner || fh->job_count) {
+		spin_unlock(&fh->job_lock);
+		spin_unlock_irqrestore(&p2r_lock, flags);
+		return -EBUSY;
+	}
+	p2r_ctx.owner = fh;
+	p2r_ctx.owner_sync = 1;
+	p2r_ctx.hw_valid = 0;
+	spin_unlock(&fh->job_lock);
+	spin_unlock_irqrestore(&p2r_lock, flags);
+
+	rval = prev2resz_config_engines(fh, &fh->pipe, &fh->prev, &fh->resz,
+					fh->src_buff_addr, fh->dst_buff_addr);
+	if (rval != 0)
+		goto out;
+
+	/*
+	 * Through-put requirement: the previewer input and resizer output
+	 * frames moved at ISP_M2M_FRAME_RATE, the data between the two
+	 * engines does not go through memory
+	 */
+	omap_pm_set_min_bus_tput(p2r_device, OCP_INITIATOR_AGENT,
+				 isp_node_bus_tput(&fh->pipe, NULL));
+
 	isp_start(fh->isp);
 
 	init_completion(&p2r_ctx.resz_complete);
@@ -225,7 +336,8 @@ static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
 	if (rval) {
 		dev_err(p2r_device, "%s: setting resizer callback failed\n",
 			__func__);
-		return rval;
+		omap_pm_set_min_bus_tput(p2r_device, OCP_INITIATOR_AGENT, 0);
+		goto out;
 	}
 
 	ispresizer_enable(fh->isp_resz, 1);
@@ -238,7 +350,7 @@ static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
 	isp_unset_callback(fh->isp, CBK_RESZ_DONE);
 
 	/* Reset Through-put requirement */
-	omap_pm_set_min_bus_tput(fh->isp, OCP_INITIATOR_AGENT, 0);
+	omap_pm_set_min_bus_tput(p2r_device, OCP_INITIATOR_AGENT, 0);
 
 	/* This will flushes the queue */
 	if (&fh->src_vbq)
@@ -246,9 +358,360 @@ static int prev2resz_ioc_run_engine(struct prev2resz_fhdl *fh)
 	if (&fh->dst_vbq)
 		videobuf_queue_cancel(&fh->dst_vbq);
 
+	rval = 0;
+out:
+	spin_lock_irqsave(&p2r_lock, flags);
+	p2r_ctx.owner = NULL;
+	p2r_ctx.owner_sync = 0;
+	spin_unlock_irqrestore(&p2r_lock, flags);
+
+	return rval;
+}
+
+/*
+ * prev2resz_job_same_config - Check if a job can reuse the engine setup
+ *
+ *	@job: Job to check
+ *
+ * Must be called with the job lock held.
+ */
+static int prev2resz_job_same_config(struct p2r_job *job)
+{
+	return p2r_ctx.hw_valid &&
+	       !memcmp(&job->prev, &p2r_ctx.hw_prev, sizeof(job->prev)) &&
+	       !memcmp(&job->resz, &p2r_ctx.hw_resz, sizeof(job->resz));
+}
+
+/*
+ * prev2resz_job_finish - Move the running job to the done list
+ *
+ *	@fh: File handle
+ *	@status: Result of the job
+ *
+ * Must be called with the job lock held.
+ */
+static void prev2resz_job_finish(struct prev2resz_fhdl *fh, int status)
+{
+	struct p2r_job *job = fh->job_cur;
+
+	job->job.status = status;
+	list_add_tail(&job->list, &fh->job_done);
+	fh->job_cur = NULL;
+	wake_up(&fh->job_wait);
+}
+
+/*
+ * prev2resz_job_callback - Resizer done interrupt for the job queue
+ *
+ *	@status: ISP IRQ0STATUS register value
+ *	@arg1: Currently not used
+ *	@arg2: File handle owning the running job
+ *
+ * Completes the running job and, when the next one uses the same
+ * configuration, starts it right away by only reprogramming the buffer
+ * addresses. Anything else is left to the job work.
+ */
+static void prev2resz_job_callback(unsigned long status,
+				   isp_vbq_callback_ptr arg1, void *arg2)
+{
+	struct prev2resz_fhdl *fh = arg2;
+	struct p2r_job *next;
+
+	if ((status & RESZ_DONE) != RESZ_DONE)
+		return;
+
+	spin_lock(&fh->job_lock);
+	if (!fh->job_cur)
+		goto out;
+
+	prev2resz_job_finish(fh, 0);
+
+	if (list_empty(&fh->job_queue))
+		goto out_work;
+
+	next = list_first_entry(&fh->job_queue, struct p2r_job, list);
+	if (!prev2resz_job_same_config(next) ||
+	    isppreview_set_inaddr(fh->isp_prev, next->src_addr) ||
+	    ispresizer_set_outaddr(fh->isp_resz, next->dst_addr))
+		goto out_work;
+
+	list_del(&next->list);
+	fh->job_cur = next;
+	fh->job_chained++;
+	mod_timer(&fh->job_timer, jiffies + PREV2RESZ_JOB_TIMEOUT);
+	ispresizer_enable(fh->isp_resz, 1);
+	isppreview_enable(fh->isp_prev, 1);
+	goto out;
+
+out_work:
+	del_timer(&fh->job_timer);
+	schedule_work(&fh->job_work);
+out:
+	spin_unlock(&fh->job_lock);
+}
+
+/*
+ * prev2resz_job_timeout - Fail a job whose resizer interrupt never came
+ */
+static void prev2resz_job_timeout(unsigned long data)
+{
+	struct prev2resz_fhdl *fh = (struct prev2resz_fhdl *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fh->job_lock, flags);
+	if (fh->job_cur) {
+		dev_crit(p2r_device, "Resizer interrupt timeout exit\n");
+		isppreview_enable(fh->isp_prev, 0);
+		ispresizer_enable(fh->isp_resz, 0);
+		p2r_ctx.hw_valid = 0;
+		prev2resz_job_finish(fh, -ETIMEDOUT);
+		schedule_work(&fh->job_work);
+	}
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+}
+
+/*
+ * prev2resz_job_idle - Release what a batch of jobs held on the ISP
+ */
+static void prev2resz_job_idle(struct prev2resz_fhdl *fh)
+{
+	unsigned long flags;
+
+	if (fh->job_active) {
+		spin_lock_irqsave(&fh->job_lock, flags);
+		p2r_ctx.hw_valid = 0;
+		spin_unlock_irqrestore(&fh->job_lock, flags);
+
+		isp_unset_callback(fh->isp, CBK_RESZ_DONE);
+		/* Reset Through-put requirement */
+		omap_pm_set_min_bus_tput(p2r_device, OCP_INITIATOR_AGENT, 0);
+		fh->job_active = 0;
+
+		dev_dbg(p2r_device, "job batch done: %u configured, "
+			"%u chained\n", fh->job_loads, fh->job_chained);
+		fh->job_loads = 0;
+		fh->job_chained = 0;
+	}
+
+	/* Hand the engines back, unless a new job came in meanwhile */
+	spin_lock_irqsave(&p2r_lock, flags);
+	spin_lock(&fh->job_lock);
+	if (p2r_ctx.owner == fh && !p2r_ctx.owner_sync && !fh->job_cur &&
+	    list_empty(&fh->job_queue))
+		p2r_ctx.owner = NULL;
+	spin_unlock(&fh->job_lock);
+	spin_unlock_irqrestore(&p2r_lock, flags);
+}
+
+/*
+ * prev2resz_job_work - Start the next job that needs a full engine setup
+ */
+static void prev2resz_job_work(struct work_struct *work)
+{
+	struct prev2resz_fhdl *fh =
+		container_of(work, struct prev2resz_fhdl, job_work);
+	struct p2r_job *job;
+	unsigned long flags;
+	int rval;
+
+	spin_lock_irqsave(&fh->job_lock, flags);
+	if (fh->job_cur) {
+		spin_unlock_irqrestore(&fh->job_lock, flags);
+		return;
+	}
+	if (list_empty(&fh->job_queue)) {
+		spin_unlock_irqrestore(&fh->job_lock, flags);
+		prev2resz_job_idle(fh);
+		return;
+	}
+	job = list_first_entry(&fh->job_queue, struct p2r_job, list);
+	list_del(&job->list);
+	fh->job_cur = job;
+	p2r_ctx.hw_valid = 0;
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+
+	if (!fh->job_active) {
+		rval = isp_set_callback(fh->isp, CBK_RESZ_DONE,
+					prev2resz_job_callback,
+					(void *) NULL, fh);
+		if (rval) {
+			dev_err(p2r_device, "%s: setting resizer callback "
+				"failed\n", __func__);
+			goto err;
+		}
+		isp_start(fh->isp);
+		fh->job_active = 1;
+	}
+
+	/* Through-put requirement of the configuration being loaded */
+	omap_pm_set_min_bus_tput(p2r_device, OCP_INITIATOR_AGENT,
+				 isp_node_bus_tput(&job->pipe, NULL));
+
+	rval = prev2resz_config_engines(fh, &job->pipe, &job->prev,
+					&job->resz, job->src_addr,
+					job->dst_addr);
+	if (rval)
+		goto err;
+	fh->job_loads++;
+
+	spin_lock_irqsave(&fh->job_lock, flags);
+	p2r_ctx.hw_prev = job->prev;
+	p2r_ctx.hw_resz = job->resz;
+	p2r_ctx.hw_valid = 1;
+	mod_timer(&fh->job_timer, jiffies + PREV2RESZ_JOB_TIMEOUT);
+	ispresizer_enable(fh->isp_resz, 1);
+	isppreview_enable(fh->isp_prev, 1);
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+	return;
+
+err:
+	spin_lock_irqsave(&fh->job_lock, flags);
+	prev2resz_job_finish(fh, rval);
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+	schedule_work(&fh->job_work);
+}
+
+/*
+ * prev2resz_ioc_queue_job - Queue a job for the engines
+ *
+ *	@fh: File handle
+ *	@ujob: Job description from the caller
+ */
+static int prev2resz_ioc_queue_job(struct prev2resz_fhdl *fh,
+				   struct prev2resz_job *ujob)
+{
+	struct p2r_job *job;
+	unsigned long flags;
+
+	if (ujob->src_index >= VIDEO_MAX_FRAME ||
+	    ujob->dst_index >= VIDEO_MAX_FRAME ||
+	    !fh->src_addrs[ujob->src_index] ||
+	    !fh->dst_addrs[ujob->dst_index]) {
+		dev_err(p2r_device, "%s: job buffers are not queued\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	if (!fh->resz.out.image.width || !fh->resz.out.image.height) {
+		dev_err(p2r_device, "%s: no configuration set\n", __func__);
+		return -EINVAL;
+	}
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	job->job = *ujob;
+	job->job.status = 0;
+	job->src_addr = fh->src_addrs[ujob->src_index];
+	job->dst_addr = fh->dst_addrs[ujob->dst_index];
+	job->src_dma = fh->src_dmas[ujob->src_index];
+	job->dst_dma = fh->dst_dmas[ujob->dst_index];
+	job->pipe = fh->pipe;
+	job->prev = fh->prev;
+	job->resz = fh->resz;
+
+	/*
+	 * The buffers stay mapped across jobs, so what the CPU wrote to
+	 * them since the last job has to reach memory now
+	 */
+	dma_sync_sg_for_device(fh->src_vbq.dev, job->src_dma->sglist,
+			       job->src_dma->sglen, job->src_dma->direction);
+	dma_sync_sg_for_device(fh->dst_vbq.dev, job->dst_dma->sglist,
+			       job->dst_dma->sglen, job->dst_dma->direction);
+
+	spin_lock_irqsave(&p2r_lock, flags);
+	spin_lock(&fh->job_lock);
+	if ((p2r_ctx.owner && (p2r_ctx.owner != fh || p2r_ctx.owner_sync)) ||
+	    fh->job_count >= PREV2RESZ_MAX_JOBS) {
+		spin_unlock(&fh->job_lock);
+		spin_unlock_irqrestore(&p2r_lock, flags);
+		kfree(job);
+		return -EBUSY;
+	}
+	p2r_ctx.owner = fh;
+	list_add_tail(&job->list, &fh->job_queue);
+	fh->job_count++;
+	if (!fh->job_cur)
+		schedule_work(&fh->job_work);
+	spin_unlock(&fh->job_lock);
+	spin_unlock_irqrestore(&p2r_lock, flags);
+
+	return 0;
+}
+
+/*
+ * prev2resz_ioc_dequeue_job - Return the oldest finished job
+ *
+ *	@fh: File handle
+ *	@ujob: Returns the finished job
+ *	@nonblock: Return -EAGAIN instead of waiting for a job to finish
+ */
+static int prev2resz_ioc_dequeue_job(struct prev2resz_fhdl *fh,
+				     struct prev2resz_job *ujob, int nonblock)
+{
+	struct p2r_job *job;
+	unsigned long flags;
+	int rval;
+
+	for (;;) {
+		spin_lock_irqsave(&fh->job_lock, flags);
+		if (!list_empty(&fh->job_done))
+			break;
+		rval = fh->job_count ? -EAGAIN : -EINVAL;
+		spin_unlock_irqrestore(&fh->job_lock, flags);
+
+		if (rval != -EAGAIN || nonblock)
+			return rval;
+
+		rval = wait_event_interruptible(fh->job_wait,
+						!list_empty(&fh->job_done));
+		if (rval)
+			return rval;
+	}
+
+	job = list_first_entry(&fh->job_done, struct p2r_job, list);
+	list_del(&job->list);
+	fh->job_count--;
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+
+	/* Drop lines the CPU may have speculatively loaded meanwhile */
+	dma_sync_sg_for_cpu(fh->dst_vbq.dev, job->dst_dma->sglist,
+			    job->dst_dma->sglen, job->dst_dma->direction);
+	*ujob = job->job;
+	kfree(job);
+
 	return 0;
 }
 
+/*
+ * prev2resz_job_flush - Drop queued jobs and wait for the running one
+ */
+static void prev2resz_job_flush(struct prev2resz_fhdl *fh)
+{
+	struct p2r_job *job, *tmp;
+	unsigned long flags;
+	LIST_HEAD(jobs);
+
+	spin_lock_irqsave(&fh->job_lock, flags);
+	list_splice_init(&fh->job_queue, &jobs);
+	spin_unlock_irqrestore(&fh->job_lock, flags);
+
+	cancel_work_sync(&fh->job_work);
+	/* The watchdog finishes the running job if the interrupt is lost */
+	wait_event(fh->job_wait, !fh->job_cur);
+	del_timer_sync(&fh->job_timer);
+	cancel_work_sync(&fh->job_work);
+	prev2resz_job_idle(fh);
+
+	list_splice_init(&fh->job_done, &jobs);
+	list_for_each_entry_safe(job, tmp, &jobs, list) {
+		list_del(&job->list);
+		kfree(job);
+	}
+	fh->job_count = 0;
+}
+
 /**
  * prev2resz_vbq_setup - Sets up the videobuffer size and validates count.
  */
@@ -302,14 +765,24 @@ static void prev2resz_vbq_release(struct videobuf_queue *q,
 	struct prev2resz_fhdl *fhdl = q->priv_data;
 
 	if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE) {
-		ispmmu_vunmap(fhdl->isp, fhdl->dst_buff_addr);
-		fhdl->dst_buff_addr = 0;
+		if (fhdl->dst_addrs[vb->i]) {
+			ispmmu_vunmap(fhdl->isp, fhdl->dst_addrs[vb->i]);
+			if (fhdl->dst_buff_addr == fhdl->dst_addrs[vb->i])
+				fhdl->dst_buff_addr = 0;
+			fhdl->dst_addrs[vb->i] = 0;
+			fhdl->dst_dmas[vb->i] = NULL;
+		}
 		spin_lock(&fhdl->dst_vbq_lock);
 		vb->state = VIDEOBUF_NEEDS_INIT;
 		spin_unlock(&fhdl->dst_vbq_lock);
 	} else if (q->type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
-		ispmmu_vunmap(fhdl->isp, fhdl->src_buff_addr);
-		fhdl->src_buff_addr = 0;
+		if (fhdl->src_addrs[vb->i]) {
+			ispmmu_vunmap(fhdl->isp, fhdl->src_addrs[vb->i]);
+			if (fhdl->src_buff_addr == fhdl->src_addrs[vb->i])
+				fhdl->src_buff_addr = 0;
+			fhdl->src_addrs[vb->i] = 0;
+			fhdl->src_dmas[vb->i] = NULL;
+		}
 		spin_lock(&fhdl->src_vbq_lock);
 		vb->state = VIDEOBUF_NEEDS_INIT;
 		spin_unlock(&fhdl->src_vbq_lock);
@@ -379,15 +852,21 @@ static int prev2resz_vbq_prepare(struct videobuf_queue *q,
 		if (!err) {
 			isp_addr = ispmmu_vmap(fhdl->isp, dma->sglist,
 					       dma->sglen);
-			if (!isp_addr) {
+			if (IS_ERR_VALUE(isp_addr)) {
 				err = -EIO;
 			} else {
-				if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+				if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE) {
 					fhdl->dst_buff_addr = isp_addr;
-				else if (q->type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+					fhdl->dst_addrs[vb->i] = isp_addr;
+					fhdl->dst_dmas[vb->i] = dma;
+				} else if (q->type ==
+					   V4L2_BUF_TYPE_VIDEO_OUTPUT) {
 					fhdl->src_buff_addr = isp_addr;
-				else
+					fhdl->src_addrs[vb->i] = isp_addr;
+					fhdl->src_dmas[vb->i] = dma;
+				} else {
 					return -EINVAL;
+				}
 			}
 		}
 	}
@@ -468,6 +947,13 @@ static int prev2resz_open(struct inode *inode, struct file *fp)
 			       fh);
 	spin_lock_init(&fh->dst_vbq_lock);
 
+	spin_lock_init(&fh->job_lock);
+	INIT_LIST_HEAD(&fh->job_queue);
+	INIT_LIST_HEAD(&fh->job_done);
+	init_waitqueue_head(&fh->job_wait);
+	INIT_WORK(&fh->job_work, prev2resz_job_work);
+	setup_timer(&fh->job_timer, prev2resz_job_timeout, (unsigned long)fh);
+
 	return 0;
 
 err_isp:
@@ -509,6 +995,9 @@ static int prev2resz_ioctl(struct inode *inode, struct file *file,
 		if (copy_from_user(&v4l2_req, (void *)arg,
 				   sizeof(struct v4l2_requestbuffers)))
 			return -EIO;
+		/* Queued jobs still point to the current buffers */
+		if (fh->job_count)
+			return -EBUSY;
 		if (v4l2_req.type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
 			if (videobuf_reqbufs(&fh->src_vbq, &v4l2_req) < 0)
 				return -EINVAL;
@@ -581,10 +1070,32 @@ static int prev2resz_ioctl(struct inode *inode, struct file *file,
 			if (ispresizer_busy(fh->isp_resz))
 				return -EBUSY;
 		}
-		if (prev2resz_ioc_run_engine(fh) < 0)
+		rval = prev2resz_ioc_run_engine(fh);
+		if (rval == -EBUSY)
+			return rval;
+		if (rval < 0)
 			return -EINVAL;
 		break;
 
+	case PREV2RESZ_QUEUE_JOB:
+	{
+		struct prev2resz_job job;
+		if (copy_from_user(&job, (void *)arg, sizeof(job)))
+			return -EIO;
+		return prev2resz_ioc_queue_job(fh, &job);
+	}
+	case PREV2RESZ_DEQUEUE_JOB:
+	{
+		struct prev2resz_job job;
+		rval = prev2resz_ioc_dequeue_job(fh, &job,
+						 file->f_flags & O_NONBLOCK);
+		if (rval)
+			return rval;
+		if (copy_to_user((void *)arg, &job, sizeof(job)))
+			return -EIO;
+		break;
+	}
+
 	case PREV2RESZ_GET_STATUS:
 	{
 		struct prev2resz_status *status =
@@ -612,9 +1123,32 @@ static int prev2resz_ioctl(struct inode *inode, struct file *file,
 		break;
 	}
 	case VIDIOC_PRIVATE_ISP_PRV_CFG:
+	{
+		unsigned long flags;
+		int busy;
+
+		/*
+		 * The preview features are programmed straight into the
+		 * previewer and are not part of a job, so they cannot change
+		 * under jobs already queued
+		 */
+		spin_lock_irqsave(&p2r_lock, flags);
+		spin_lock(&fh->job_lock);
+		busy = fh->job_cur || !list_empty(&fh->job_queue) ||
+		       (p2r_ctx.owner && p2r_ctx.owner != fh);
+		spin_unlock(&fh->job_lock);
+		spin_unlock_irqrestore(&p2r_lock, flags);
+		if (busy)
+			return -EBUSY;
+
 		if (isppreview_config(fh->isp_prev, (void *)arg))
 			return -EIO;
+		/* The next job reprograms the features */
+		spin_lock_irqsave(&fh->job_lock, flags);
+		p2r_ctx.hw_valid = 0;
+		spin_unlock_irqrestore(&fh->job_lock, flags);
 		break;
+	}
 
 	default:
 		dev_err(p2r_device, "IOC: Invalid Command Value!\n");
@@ -624,6 +1158,20 @@ static int prev2resz_ioctl(struct inode *inode, struct file *file,
 	return 0;
 }
 
+/**
+ * prev2resz_poll - Reports finished jobs ready to be dequeued
+ */
+static unsigned int prev2resz_poll(struct file *file, poll_table *wait)
+{
+	struct prev2resz_fhdl *fh = file->private_data;
+
+	poll_wait(file, &fh->job_wait, wait);
+	if (!list_empty(&fh->job_done))
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
 /**
  * prev2resz_release - Releases device resources
  */
@@ -642,6 +1190,7 @@ static int prev2resz_release(struct inode *inode, struct file *fp)
 	p2r_ctx.status.rsz_busy = PREV2RESZ_FREE;
 	p2r_ctx.opened--;
 
+	prev2resz_job_flush(fh);
 
 	/* This will Free memory allocated to the buffers,
 	 * and flushes the queue
@@ -666,6 +1215,7 @@ static const struct file_operations dev_fops = {
 	.owner		= THIS_MODULE,
 	.open		= prev2resz_open,
 	.ioctl		= prev2resz_ioctl,
+	.poll		= prev2resz_poll,
 	.release	= prev2resz_release
 };
 
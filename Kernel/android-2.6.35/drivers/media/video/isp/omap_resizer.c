@@ -181,11 +181,11 @@ int rsz_ioc_run_engine(struct rsz_fhdl *fhdl)
 		return -EINVAL;
 	}
 	/*
-	 * Through-put requirement:
-	 * Set max OCP freq for 3630 is 200 MHz through-put
-	 * is in KByte/s so 200000 KHz * 4 = 800000 KByte/s
+	 * Through-put requirement: the input and output frames moved at
+	 * ISP_M2M_FRAME_RATE, so small resizes do not pin L3 at its max
 	 */
-	omap_pm_set_min_bus_tput(fhdl->isp, OCP_INITIATOR_AGENT, 800000);
+	omap_pm_set_min_bus_tput(rsz_device, OCP_INITIATOR_AGENT,
+				 isp_node_bus_tput(&fhdl->pipe, NULL));
 	isp_start(fhdl->isp);
 	ispresizer_enable(&fhdl->isp_dev->isp_res, 1);
 
@@ -232,7 +232,7 @@ int rsz_ioc_run_engine(struct rsz_fhdl *fhdl)
 	isp_unset_callback(fhdl->isp, CBK_RESZ_DONE);
 
 	/* Reset Through-put requirement */
-	omap_pm_set_min_bus_tput(fhdl->isp, OCP_INITIATOR_AGENT, 0);
+	omap_pm_set_min_bus_tput(rsz_device, OCP_INITIATOR_AGENT, 0);
 
 	/* This will flushes the queue */
 	if (&fhdl->src_vbq)
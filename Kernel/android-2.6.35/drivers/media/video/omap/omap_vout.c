@@ -39,6 +39,8 @@
 #include <linux/irq.h>
 #include <linux/videodev2.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #ifndef CONFIG_ARCH_OMAP4
 #include <media/videobuf-dma-sg.h>
@@ -132,6 +134,8 @@ static u32 video3_bufsize = OMAP_VOUT_MAX_BUF_SIZE;
 #endif //&*&*&*JJ2 20110811_page allocation failure
 static u32 vid1_static_vrfb_alloc=1;
 static u32 vid2_static_vrfb_alloc=1;
+static int vrfb_bypass = 1;
+static int vrfb_direct;
 static int debug;
 
 static int vidioc_streamoff(struct file *file, void *fh, enum v4l2_buf_type i);
@@ -170,6 +174,14 @@ module_param(vid2_static_vrfb_alloc, bool, S_IRUGO);
 MODULE_PARM_DESC(vid2_static_vrfb_alloc,
 	"Static allocation of the VRFB buffer for video2 device");
 
+module_param(vrfb_bypass, bool, S_IRUGO);
+MODULE_PARM_DESC(vrfb_bypass,
+	"Scan out unrotated, unmirrored frames without copying them to VRFB");
+
+module_param(vrfb_direct, bool, S_IRUGO);
+MODULE_PARM_DESC(vrfb_direct,
+	"Map buffers through their VRFB view when rotating, instead of DMA copies");
+
 module_param(debug, bool, S_IRUGO);
 MODULE_PARM_DESC(debug, "Debug level (0-1)");
 
@@ -366,10 +378,38 @@ void omap_vout_isp_rsz_dma_tx_callback(void *arg)
 	wake_up_interruptible(&vout->vrfb_dma_tx.wait);
 }
 
-static void __enable_isp_rsz(struct omap_vout_device *vout, int line)
+/*
+ * Return true if DISPC can downscale the frame into the window by itself.
+ * Beyond that the ISP resizer is needed: for scaling 1/4x~1/8x and, for
+ * width > 1024, for scaling 1/2x~1/8x.
+ */
+static int omap_vout_dispc_can_scale(const struct omap_vout_device *vout)
 {
 	int src_w, src_h, dst_w, dst_h, scale;
 
+	/* Check for vertical scale */
+	src_h = vout->pix.height; //vout->crop->height
+	dst_h = vout->win.w.height;
+	if (dst_h) {
+		scale = (1024 * src_h)/dst_h;
+		if (scale > 4096)
+			return 0;
+	}
+
+	/* Check for horizontal scale */
+	src_w = vout->pix.width; //vout->crop->width
+	dst_w = vout->win.w.width;
+	if (dst_w) {
+		scale = (1024 * src_w)/dst_w;
+		if (scale > 4096 || (scale > 2048 && src_w > 1024))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void __enable_isp_rsz(struct omap_vout_device *vout, int line)
+{
     //printk(" [%s] \n", __func__);
 
 	if (vout->isprsz & ISPRSZ_ENABLE)
@@ -378,32 +418,18 @@ static void __enable_isp_rsz(struct omap_vout_device *vout, int line)
 	if (vout->isprsz & ISPRSZ_MANUALMODE)
 		return;
 
+	/* Frames go to DISPC without VRFB, which the ISP resizer needs */
+	if (vout->vrfb_bypass)
+		return;
+
 	/* Check for 720p format */
 //	if (vout->pix.height * vout->pix.width == VID_MAX_WIDTH * 720) {
 	if (vout->pix.height * vout->pix.width >= 480 * 360) {
 		goto enable_and_exit;
 	}
 
-
-	/* ISP resizer used for scaling 1/4x~1/8x and,
-	 * for width > 1024 and scaling 1/2x~1/8x
-	 */
-
-	/* Check for vertical scale */
-	src_h = vout->pix.height; //vout->crop->height
-	dst_h = vout->win.w.height;
-	scale = (1024 * src_h)/dst_h;
-	if (scale > 4096) {
-		goto enable_and_exit;
-	}
-
-	/* Check for horizontal scale */
-	src_w = vout->pix.width; //vout->crop->width
-	dst_w = vout->win.w.width;
-	scale = (1024 * src_w)/dst_w;
-	if (scale > 4096 || (scale > 2048 && src_w > 1024)) {
+	if (!omap_vout_dispc_can_scale(vout))
 		goto enable_and_exit;
-	}
 
 	return;
 
@@ -571,9 +597,11 @@ int omap_vout_try_format(struct v4l2_pix_format *pix)
 #ifndef CONFIG_ARCH_OMAP4
 /*
  * omap_vout_uservirt_to_phys: This inline function is used to convert user
- * space virtual address to physical address.
+ * space virtual address to physical address. DISPC and the VRFB DMA read
+ * the buffer linearly, so 0 is returned if the @size bytes at @virtp are
+ * not physically contiguous.
  */
-static u32 omap_vout_uservirt_to_phys(u32 virtp)
+static u32 omap_vout_uservirt_to_phys(u32 virtp, u32 size)
 {
 	unsigned long physp = 0;
 	struct vm_area_struct *vma;
@@ -586,25 +614,45 @@ static u32 omap_vout_uservirt_to_phys(u32 virtp)
 	} else if (vma && (vma->vm_flags & VM_IO) && vma->vm_pgoff) {
 		/* this will catch, kernel-allocated, mmaped-to-usermode
 		   addresses */
+		if (virtp + size > vma->vm_end)
+			return 0;
 		physp = (vma->vm_pgoff << PAGE_SHIFT) + (virtp - vma->vm_start);
 	} else {
 		/* otherwise, use get_user_pages() for general userland pages */
-		int res, nr_pages = 1;
-		struct page *pages;
-		down_read(&current->mm->mmap_sem);
+		int res, i, nr_pages;
+		struct page **pages;
+
+		nr_pages = (PAGE_ALIGN(virtp + size) - (virtp & PAGE_MASK)) >>
+			PAGE_SHIFT;
+		pages = kmalloc(nr_pages * sizeof(*pages), GFP_KERNEL);
+		if (!pages)
+			return 0;
 
+		down_read(&current->mm->mmap_sem);
 		res = get_user_pages(current, current->mm, virtp, nr_pages, 1,
-				0, &pages, NULL);
+				0, pages, NULL);
 		up_read(&current->mm->mmap_sem);
 
 		if (res == nr_pages) {
-			physp =  __pa(page_address(&pages[0]) +
-					(virtp & ~PAGE_MASK));
+			physp = page_to_phys(pages[0]) + (virtp & ~PAGE_MASK);
+			for (i = 1; i < nr_pages; i++) {
+				if (page_to_pfn(pages[i]) !=
+				    page_to_pfn(pages[0]) + i) {
+					printk(KERN_WARNING VOUT_NAME
+						"user buffer is not physically "
+						"contiguous\n");
+					physp = 0;
+					break;
+				}
+			}
 		} else {
 			printk(KERN_WARNING VOUT_NAME
 					"get_user_pages failed\n");
-			return 0;
 		}
+
+		for (i = 0; i < res; i++)
+			put_page(pages[i]);
+		kfree(pages);
 	}
 
 	return physp;
@@ -650,17 +698,105 @@ static inline int rotate_90_or_270(const struct omap_vout_device *vout)
  */
 static inline int rotation_enabled(const struct omap_vout_device *vout)
 {
-	/* Rotation needs to be enabled by default for OMAP3 in order
-	 * to use VRFB. ISP resizer also requires VRFB to be used for all
-	 * rotation angles including 0 degree. for OMAP3 this function needs
-	 * to return true even for 0 degree rotation
+	/* On OMAP3 every frame goes through VRFB, even at 0 degree, unless
+	 * VIDIOC_REQBUFS found that the buffers can bypass it: no rotation
+	 * or mirroring, and no ISP resizer, which writes into VRFB. So this
+	 * is true for 0 degree rotation too unless VRFB is bypassed.
 	 */
 	if (cpu_is_omap34xx())
-		return 1;
+		return !vout->vrfb_bypass;
 	else
 		return vout->rotation || vout->mirror;
 }
 
+#ifndef CONFIG_ARCH_OMAP4
+/*
+ * Return true if the ISP resizer writes the frames into VRFB
+ */
+static inline int isp_rsz_enabled(const struct omap_vout_device *vout)
+{
+#ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
+	return vout->isprsz & ISPRSZ_ENABLE;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Return true if the frames have to go through the ISP resizer: it was
+ * switched on by hand, or DISPC cannot do the scaling alone
+ */
+static inline int isp_rsz_needed(const struct omap_vout_device *vout)
+{
+#ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
+	if (vout->isprsz & ISPRSZ_MANUALMODE)
+		return vout->isprsz & ISPRSZ_ENABLE;
+	return !omap_vout_dispc_can_scale(vout);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Return true if the frames can be handed to DISPC as they are. This is
+ * latched at VIDIOC_REQBUFS time since the buffers are set up for it,
+ * before the ISP resizer is considered: in auto mode it is only used when
+ * VRFB is needed anyway or DISPC cannot scale the frame.
+ */
+static inline int omap_vout_can_bypass_vrfb(const struct omap_vout_device *vout)
+{
+	return vrfb_bypass && cpu_is_omap34xx() && !vout->rotation &&
+		!vout->mirror && !isp_rsz_needed(vout) &&
+		vout->pix.pixelformat != V4L2_PIX_FMT_NV12;
+}
+
+/*
+ * Return true if MMAP buffers are mapped through their VRFB 0 degree view,
+ * so that the application writes straight into rotation space.
+ */
+static inline int omap_vout_vrfb_direct(const struct omap_vout_device *vout)
+{
+	return vrfb_direct && rotation_enabled(vout) &&
+		V4L2_MEMORY_MMAP == vout->memory && !isp_rsz_enabled(vout);
+}
+
+/*
+ * Line length in bytes of a VRFB view as seen by its writer
+ */
+static inline u32 omap_vout_vrfb_stride(const struct omap_vout_device *vout)
+{
+	return MAX_PIXELS_PER_LINE * vout->bpp * vout->vrfb_bpp;
+}
+#endif
+
+#ifdef CONFIG_PM
+/*
+ * L3 throughput (KiB/s) needed to show this video pipeline: DISPC
+ * fetches the source frame once per panel refresh and, with VRFB, the
+ * rotation DMA reads and writes each frame once more.
+ */
+static long omap_vout_bus_tput(struct omap_vout_device *vout)
+{
+	struct omap_overlay *ovl = vout->vid_info.overlays[0];
+	struct omap_video_timings *t;
+	unsigned long frame, htot, vtot, fps;
+
+	if (cpu_is_omap44xx() || !ovl->manager || !ovl->manager->device)
+		return 200 * 1000 * 4;
+
+	t = &ovl->manager->device->panel.timings;
+	htot = t->x_res + t->hfp + t->hsw + t->hbp;
+	vtot = t->y_res + t->vfp + t->vsw + t->vbp;
+	if (!htot || !vtot)
+		return 200 * 1000 * 4;
+	fps = DIV_ROUND_UP(t->pixel_clock * 1000, htot * vtot);
+
+	frame = vout->pix.width * vout->pix.height * vout->bpp / 1024;
+
+	return frame * fps * (rotation_enabled(vout) ? 3 : 1);
+}
+#endif
+
 /*
  * Reverse the rotation degree if mirroring is enabled
  */
@@ -820,6 +956,28 @@ static int omap_vout_vrfb_buffer_setup(struct omap_vout_device *vout,
 	}
 	return 0;
 }
+
+/*
+ * Rotation or mirroring was asked for after the buffers were set up to
+ * bypass VRFB. Bring VRFB back in if the queue allows it.
+ */
+static int omap_vout_vrfb_resume(struct omap_vout_device *vout)
+{
+	unsigned int count = vout->buffer_allocated;
+
+	if (!vout->vrfb_bypass)
+		return 0;
+	if (vout->streaming || !list_empty(&vout->dma_queue) ||
+	    count > VRFB_NUM_BUFS)
+		return -EBUSY;
+
+	vout->vrfb_bypass = 0;
+	if (omap_vout_vrfb_buffer_setup(vout, &count, 0)) {
+		vout->vrfb_bypass = 1;
+		return -ENOMEM;
+	}
+	return 0;
+}
 #else /* ifndef CONFIG_ARCH_OMAP4 */
 static void omap_vout_tiler_buffer_free(struct omap_vout_device *vout,
 					unsigned int count,
@@ -1700,6 +1858,11 @@ static int omap_vout_buffer_setup(struct videobuf_queue *q, unsigned int *count,
 	}
 	*count = vout->buffer_allocated = i;
 
+	/* Buffers are mapped through VRFB, with the VRFB line length */
+	if (omap_vout_vrfb_direct(vout))
+		*size = PAGE_ALIGN(omap_vout_vrfb_stride(vout) *
+				   vout->pix.height);
+
 #else
 
 	if (V4L2_MEMORY_MMAP != vout->memory)
@@ -1811,6 +1974,8 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 	u32 dest_element_index = 0, src_frame_index = 0;
 	u32 elem_count = 0, frame_count = 0, pixsize = 2;
 	struct videobuf_dmabuf *dmabuf = NULL;
+	ktime_t start;
+	u32 us;
 #else
 	dma_addr_t dmabuf;
 #endif
@@ -1839,14 +2004,35 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 		 * pointer to videobuf_dmabuf, which is member of
 		 * videobuf_pci_sg_memory */
 		dmabuf = videobuf_to_dma(q->bufs[vb->i]);
+
+		/*
+		 * No page references are kept, so the pages behind the
+		 * pointer may have changed since the last QBUF: translate
+		 * it every time.
+		 */
 		dmabuf->vmalloc = (void *) vb->baddr;
 
 		/* Physical address */
-		dmabuf->bus_addr = (dma_addr_t) omap_vout_uservirt_to_phys(vb->baddr);
+		dmabuf->bus_addr = (dma_addr_t)
+			omap_vout_uservirt_to_phys(vb->baddr, vb->size);
+		if (!dmabuf->bus_addr) {
+			dmabuf->vmalloc = NULL;
+			return -EINVAL;
+		}
 	}
 
 	rotation = calc_rotation(vout);
 
+	/* The application already wrote the frame into VRFB */
+	if (vout->vrfb_mapped[vb->i]) {
+		if (!rotation_enabled(vout) || isp_rsz_enabled(vout))
+			return -EINVAL;
+		vout->queued_buf_addr[vb->i] = (u8 *)
+			vout->vrfb_context[vb->i].paddr[rotation];
+		vout->frames_direct++;
+		return 0;
+	}
+
 #ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
 	if (vout->isprsz & ISPRSZ_ENABLE) {
 		int ret = 0;
@@ -1877,6 +2063,7 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 
 	if (!rotation_enabled(vout)) {
 		vout->queued_buf_addr[vb->i] = (u8 *) dmabuf->bus_addr;
+		vout->frames_direct++;
 		return 0;
 	}
 
@@ -1921,26 +2108,29 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 	omap_dma_set_global_params(DMA_DEFAULT_ARB_RATE, 0x20, 0);
 
 #ifdef CONFIG_PM
-	if (!cpu_is_omap44xx() && pdata->set_min_bus_tput) {
-		if (cpu_is_omap3630()) {
-			pdata->set_min_bus_tput(
-				((vout->vid_dev)->v4l2_dev).dev,
-					OCP_INITIATOR_AGENT, 200 * 1000 * 4);
-		} else {
-			pdata->set_min_bus_tput(
-				((vout->vid_dev)->v4l2_dev).dev,
-					OCP_INITIATOR_AGENT, 166 * 1000 * 4);
-		}
-	}
+	if (!cpu_is_omap44xx() && pdata->set_min_bus_tput)
+		pdata->set_min_bus_tput(((vout->vid_dev)->v4l2_dev).dev,
+				OCP_INITIATOR_AGENT, omap_vout_bus_tput(vout));
 #endif
 
+	start = ktime_get();
 	omap_start_dma(tx->dma_ch);
 	interruptible_sleep_on_timeout(&tx->wait, VRFB_TX_TIMEOUT);
 
 	if (tx->tx_status == 0) {
 		omap_stop_dma(tx->dma_ch);
+		vout->copy_timeouts++;
 		return -EINVAL;
 	}
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	vout->frames_copied++;
+	vout->copy_us_last = us;
+	vout->copy_us_total += us;
+	if (us > vout->copy_us_max)
+		vout->copy_us_max = us;
+	v4l2_dbg(1, debug, &vout->vid_dev->v4l2_dev,
+		"VRFB copy of buffer %d took %u us\n", vb->i, us);
 	/* Store buffers physical address into an array. Addresses
 	 * from this array will be used to configure DSS */
 	vout->queued_buf_addr[vb->i] = (u8 *)
@@ -2000,6 +2190,16 @@ static void omap_vout_buffer_release(struct videobuf_queue *q,
 
 	vb->state = VIDEOBUF_NEEDS_INIT;
 
+#ifndef CONFIG_ARCH_OMAP4
+	/* Forget the translation of a user pointer that is going away */
+	if (V4L2_MEMORY_USERPTR == vb->memory) {
+		struct videobuf_dmabuf *dmabuf = videobuf_to_dma(vb);
+
+		dmabuf->vmalloc = NULL;
+		dmabuf->bus_addr = 0;
+	}
+#endif
+
 	if (V4L2_MEMORY_MMAP != vout->memory)
 		return;
 }
@@ -2072,6 +2272,17 @@ static int omap_vout_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_ops = &omap_vout_vm_ops;
 	vma->vm_private_data = (void *) vout;
 #ifndef CONFIG_ARCH_OMAP4
+	if (omap_vout_vrfb_direct(vout)) {
+		/* Writes land in the rotation engine, no copy at QBUF */
+		if (io_remap_pfn_range(vma, start,
+				vout->vrfb_context[i].paddr[0] >> PAGE_SHIFT,
+				size, vma->vm_page_prot))
+			return -EAGAIN;
+		vout->vrfb_mapped[i] = 1;
+		vout->mmap_count++;
+		return 0;
+	}
+
 	dmabuf = videobuf_to_dma(q->bufs[i]);
 	pos = (void *)(dmabuf->bus_addr);
 
@@ -2343,6 +2554,13 @@ static int vidioc_g_fmt_vid_out(struct file *file, void *fh,
 	struct omap_vout_device *vout = fh;
 
 	f->fmt.pix = vout->pix;
+#ifndef CONFIG_ARCH_OMAP4
+	if (omap_vout_vrfb_direct(vout)) {
+		f->fmt.pix.bytesperline = omap_vout_vrfb_stride(vout);
+		f->fmt.pix.sizeimage = f->fmt.pix.bytesperline *
+				       f->fmt.pix.height;
+	}
+#endif
 	return 0;
 
 }
@@ -2844,6 +3062,13 @@ static int vidioc_s_ctrl(struct file *file, void *fh, struct v4l2_control *a)
 			break;
 		}
 
+#ifndef CONFIG_ARCH_OMAP4
+		if (rotation && omap_vout_vrfb_resume(vout)) {
+			mutex_unlock(&vout->lock);
+			ret = -EBUSY;
+			break;
+		}
+#endif
 		if (v4l2_rot_to_dss_rot(rotation, &vout->rotation,
 							vout->mirror)) {
 			mutex_unlock(&vout->lock);
@@ -2898,6 +3123,13 @@ static int vidioc_s_ctrl(struct file *file, void *fh, struct v4l2_control *a)
 			ret = -EINVAL;
 			break;
 		}
+#ifndef CONFIG_ARCH_OMAP4
+		if (mirror && omap_vout_vrfb_resume(vout)) {
+			mutex_unlock(&vout->lock);
+			ret = -EBUSY;
+			break;
+		}
+#endif
 		vout->mirror = mirror;
 		vout->control[2].value = mirror;
 		mutex_unlock(&vout->lock);
@@ -2952,10 +3184,6 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 		goto reqbuf_err;
 	}
 
-#ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
-	enable_isp_rsz(vout);
-	vout->isprsz &= ~ISPRSZ_CONFIGURED;
-#endif
 	/* If buffers are already allocated free them */
 	if (q->bufs[0] && (V4L2_MEMORY_MMAP == q->bufs[0]->memory)) {
 		if (vout->mmap_count) {
@@ -2963,6 +3191,7 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 			goto reqbuf_err;
 		}
 #ifndef CONFIG_ARCH_OMAP4
+		memset(vout->vrfb_mapped, 0, sizeof(vout->vrfb_mapped));
 		num_buffers = (vout->vid == OMAP_VIDEO1) ?
 			video1_numbuffers : video2_numbuffers;
 		for (i = num_buffers; i < vout->buffer_allocated; i++) {
@@ -2992,6 +3221,19 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 	/*store the memory type in data structure */
 	vout->memory = req->memory;
 
+#ifndef CONFIG_ARCH_OMAP4
+	/* Decide once for the new buffers whether VRFB is needed at all */
+	vout->vrfb_bypass = omap_vout_can_bypass_vrfb(vout);
+#endif
+#ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
+	/* An earlier format may have turned the ISP resizer on */
+	if (vout->vrfb_bypass)
+		disable_isp_rsz(vout);
+	else
+		enable_isp_rsz(vout);
+	vout->isprsz &= ~ISPRSZ_CONFIGURED;
+#endif
+
 	INIT_LIST_HEAD(&vout->dma_queue);
 
 	/* call videobuf_reqbufs api */
@@ -3245,17 +3487,9 @@ static int vidioc_streamon(struct file *file, void *fh, enum v4l2_buf_type i)
 	omap_dispc_register_isr(omap_vout_isr, vout, mask);
 
 #ifdef CONFIG_PM
-	if (pdata->set_min_bus_tput) {
-		if (cpu_is_omap3630() || cpu_is_omap44xx()) {
-			pdata->set_min_bus_tput(
-				((vout->vid_dev)->v4l2_dev).dev ,
-					OCP_INITIATOR_AGENT, 200 * 1000 * 4);
-		} else {
-			pdata->set_min_bus_tput(
-				((vout->vid_dev)->v4l2_dev).dev ,
-					OCP_INITIATOR_AGENT, 166 * 1000 * 4);
-		}
-	}
+	if (pdata->set_min_bus_tput)
+		pdata->set_min_bus_tput(((vout->vid_dev)->v4l2_dev).dev,
+				OCP_INITIATOR_AGENT, omap_vout_bus_tput(vout));
 #endif
 
 	for (j = 0; j < ovid->num_overlays; j++) {
@@ -3816,6 +4050,46 @@ static DEVICE_ATTR(isprsz_mode, S_IRUGO|S_IWUGO,
 		isprsz_mode_show, isprsz_mode_store);
 #endif
 
+#ifndef CONFIG_ARCH_OMAP4
+/* 'dma_stats' shows how queued frames reached DISPC: directly, or through
+ * a VRFB DMA copy and how long the copies took. Writing resets it.
+ */
+static ssize_t dma_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct video_device *vdev = to_video_device(dev);
+	struct omap_vout_device *vout = video_get_drvdata(vdev);
+	u32 avg = 0;
+
+	if (vout->frames_copied)
+		avg = div_u64(vout->copy_us_total, vout->frames_copied);
+
+	return sprintf(buf, "vrfb_bypass %d\ndirect %u\ncopied %u\n"
+			"copy_timeouts %u\ncopy_us last %u avg %u max %u\n",
+			vout->vrfb_bypass, vout->frames_direct,
+			vout->frames_copied, vout->copy_timeouts,
+			vout->copy_us_last, avg, vout->copy_us_max);
+}
+
+static ssize_t dma_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct video_device *vdev = to_video_device(dev);
+	struct omap_vout_device *vout = video_get_drvdata(vdev);
+
+	mutex_lock(&vout->lock);
+	vout->frames_direct = vout->frames_copied = vout->copy_timeouts = 0;
+	vout->copy_us_last = vout->copy_us_max = 0;
+	vout->copy_us_total = 0;
+	mutex_unlock(&vout->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(dma_stats, S_IRUGO|S_IWUSR,
+		dma_stats_show, dma_stats_store);
+#endif
+
 /* Create video out devices */
 static int __init omap_vout_create_video_devices(struct platform_device *pdev)
 {
@@ -3919,6 +4193,9 @@ success:
 #ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
 		device_create_file(&vfd->dev, &dev_attr_isprsz_enable);
 		device_create_file(&vfd->dev, &dev_attr_isprsz_mode);
+#endif
+#ifndef CONFIG_ARCH_OMAP4
+		device_create_file(&vfd->dev, &dev_attr_dma_stats);
 #endif
 		dev_info(&pdev->dev, ": registered and initialized"
 				" video device %d\n", vfd->minor);
@@ -3954,6 +4231,9 @@ static void omap_vout_cleanup_device(struct omap_vout_device *vout)
 #ifdef CONFIG_OMAP3_ISP_RESIZER_ON_OVERLAY
 		device_remove_file(&vfd->dev, &dev_attr_isprsz_enable);
 		device_remove_file(&vfd->dev, &dev_attr_isprsz_mode);
+#endif
+#ifndef CONFIG_ARCH_OMAP4
+		device_remove_file(&vfd->dev, &dev_attr_dma_stats);
 #endif
 	}
 
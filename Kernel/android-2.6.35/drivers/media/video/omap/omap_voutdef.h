@@ -165,6 +165,15 @@ struct omap_vout_device {
 	bool vrfb_static_allocation;
 	unsigned int smsshado_size;
 	unsigned char pos;
+	/* frames go to DISPC without VRFB, latched at VIDIOC_REQBUFS */
+	bool vrfb_bypass;
+	/* buffer is mmaped through its VRFB view, no copy at QBUF */
+	bool vrfb_mapped[VIDEO_MAX_FRAME];
+
+	/* frame path statistics, see the dma_stats sysfs attribute */
+	u32 frames_direct, frames_copied, copy_timeouts;
+	u32 copy_us_last, copy_us_max;
+	u64 copy_us_total;
 
 	int ps, vr_ps, line_length, first_int, field_id;
 	enum v4l2_memory memory;
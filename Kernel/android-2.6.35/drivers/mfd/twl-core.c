@@ -408,6 +408,74 @@ int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes)
 }
 EXPORT_SYMBOL(twl_i2c_write);
 
+/* Register writes sent per i2c_transfer() by twl_i2c_write_regs() */
+#define TWL_WRITE_BATCH		16
+
+/**
+ * twl_i2c_write_regs - Writes several registers in one bus transaction
+ * @mod_no: module number
+ * @regs: register/value pairs, written in order
+ * @count: number of entries in @regs
+ *
+ * All the writes of a batch go out as one i2c_transfer(), so the bus is
+ * acquired and the controller woken only once, with repeated starts in
+ * between; runs of consecutive registers are merged into a single
+ * auto-incremented message.
+ *
+ * Returns the result of operation - 0 is success
+ */
+int twl_i2c_write_regs(u8 mod_no, const struct twl_i2c_reg *regs,
+		       unsigned count)
+{
+	struct i2c_msg msgs[TWL_WRITE_BATCH];
+	u8 buf[2 * TWL_WRITE_BATCH], *p;
+	struct twl_client *twl;
+	unsigned n, nmsg;
+	int ret, sid;
+
+	if (unlikely(mod_no > TWL_MODULE_LAST)) {
+		pr_err("%s: invalid module number %d\n", DRIVER_NAME, mod_no);
+		return -EPERM;
+	}
+	sid = twl_map[mod_no].sid;
+	twl = &twl_modules[sid];
+
+	if (unlikely(!inuse)) {
+		pr_err("%s: client %d is not initialized\n", DRIVER_NAME, sid);
+		return -EPERM;
+	}
+
+	while (count) {
+		p = buf;
+		nmsg = 0;
+		for (n = 0; n < count && n < TWL_WRITE_BATCH; n++) {
+			/* a new message carries the address and this value */
+			if (nmsg && regs[n].reg == regs[n - 1].reg + 1) {
+				msgs[nmsg - 1].len++;
+			} else {
+				msgs[nmsg].addr = twl->address;
+				msgs[nmsg].flags = 0;
+				msgs[nmsg].len = 2;
+				msgs[nmsg].buf = p;
+				*p++ = twl_map[mod_no].base + regs[n].reg;
+				nmsg++;
+			}
+			*p++ = regs[n].val;
+		}
+
+		ret = i2c_transfer(twl->client->adapter, msgs, nmsg);
+		if (ret != nmsg) {
+			pr_err("%s: i2c_write failed to transfer all messages\n",
+				DRIVER_NAME);
+			return ret < 0 ? ret : -EIO;
+		}
+		regs += n;
+		count -= n;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(twl_i2c_write_regs);
+
 /**
  * twl_i2c_read - Reads a n bit register in TWL4030/TWL5030/TWL60X0
  * @mod_no: module number
@@ -520,6 +588,12 @@ add_numbered_child(unsigned chip, const char *name, int num,
 
 	device_init_wakeup(&pdev->dev, can_wakeup);
 	pdev->dev.parent = &twl->client->dev;
+	/*
+	 * Subdrivers only share the I2C link, which twl_i2c_{read,write}
+	 * serialise; the PM core still resumes the TWL client (and thus
+	 * its adapter) before any of them, so they may run in parallel.
+	 */
+	device_enable_async_suspend(&pdev->dev);
 
 	if (pdata) {
 		status = platform_device_add_data(pdev, pdata, pdata_len);
@@ -175,38 +175,23 @@ static struct notifier_block twl4030_reboot_notifier = {
 };
 //&*&*&*BC2_110616: fix the issue that system can not reboot
 
-static int __init twl4030_write_script_byte(u8 address, u8 byte)
-{
-	int err;
-
-	err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, address,
-				R_MEMORY_ADDRESS);
-	if (err)
-		goto out;
-	err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, byte,
-				R_MEMORY_DATA);
-out:
-	return err;
-}
-
 static int __init twl4030_write_script_ins(u8 address, u16 pmb_message,
 					   u8 delay, u8 next)
 {
-	int err = 0;
+	u8 data[4] = { pmb_message >> 8, pmb_message & 0xff, delay, next };
+	struct twl_i2c_reg regs[8];
+	int i;
 
+	/* Set the memory address, then write the byte, for each byte */
 	address *= 4;
-	err = twl4030_write_script_byte(address++, pmb_message >> 8);
-	if (err)
-		goto out;
-	err = twl4030_write_script_byte(address++, pmb_message & 0xff);
-	if (err)
-		goto out;
-	err = twl4030_write_script_byte(address++, delay);
-	if (err)
-		goto out;
-	err = twl4030_write_script_byte(address++, next);
-out:
-	return err;
+	for (i = 0; i < 4; i++) {
+		regs[2 * i].reg = R_MEMORY_ADDRESS;
+		regs[2 * i].val = address + i;
+		regs[2 * i + 1].reg = R_MEMORY_DATA;
+		regs[2 * i + 1].val = data[i];
+	}
+	return twl_i2c_write_regs(TWL4030_MODULE_PM_MASTER, regs,
+				  ARRAY_SIZE(regs));
 }
 
 static int __init twl4030_write_script(u8 address, struct twl4030_ins *script,
@@ -514,50 +499,37 @@ out:
 
 int twl4030_remove_script(u8 flags)
 {
-	int err = 0;
-
-	err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, R_KEY_1,
-			R_PROTECT_KEY);
-	if (err) {
-		pr_err("twl4030: unable to unlock PROTECT_KEY\n");
-		return err;
-	}
-
-	err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, R_KEY_2,
-			R_PROTECT_KEY);
-	if (err) {
-		pr_err("twl4030: unable to unlock PROTECT_KEY\n");
-		return err;
-	}
+	struct twl_i2c_reg regs[7];
+	unsigned n = 0;
+	int err;
 
+	/* Unlock, end the selected scripts and relock in one transfer */
+	regs[n].reg = R_PROTECT_KEY;
+	regs[n++].val = R_KEY_1;
+	regs[n].reg = R_PROTECT_KEY;
+	regs[n++].val = R_KEY_2;
 	if (flags & TWL4030_WRST_SCRIPT) {
-		err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, END_OF_SCRIPT,
-				R_SEQ_ADD_WARM);
-		if (err)
-			return err;
+		regs[n].reg = R_SEQ_ADD_WARM;
+		regs[n++].val = END_OF_SCRIPT;
 	}
 	if (flags & TWL4030_WAKEUP12_SCRIPT) {
-		if (err)
-		err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, END_OF_SCRIPT,
-				R_SEQ_ADD_S2A12);
-			return err;
+		regs[n].reg = R_SEQ_ADD_S2A12;
+		regs[n++].val = END_OF_SCRIPT;
 	}
 	if (flags & TWL4030_WAKEUP3_SCRIPT) {
-		err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, END_OF_SCRIPT,
-				R_SEQ_ADD_S2A3);
-		if (err)
-			return err;
+		regs[n].reg = R_SEQ_ADD_S2A3;
+		regs[n++].val = END_OF_SCRIPT;
 	}
 	if (flags & TWL4030_SLEEP_SCRIPT) {
-		err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, END_OF_SCRIPT,
-				R_SEQ_ADD_A2S);
-		if (err)
-			return err;
+		regs[n].reg = R_SEQ_ADD_A2S;
+		regs[n++].val = END_OF_SCRIPT;
 	}
+	regs[n].reg = R_PROTECT_KEY;
+	regs[n++].val = 0;
 
-	err = twl_i2c_write_u8(TWL4030_MODULE_PM_MASTER, 0, R_PROTECT_KEY);
+	err = twl_i2c_write_regs(TWL4030_MODULE_PM_MASTER, regs, n);
 	if (err)
-		pr_err("TWL4030 Unable to relock registers\n");
+		pr_err("twl4030: unable to remove scripts\n");
 
 	return err;
 }
@@ -231,6 +231,7 @@ struct omap_hsmmc_host {
 	int			use_reg;
 	int			req_in_progress;
 	int			tput_constraint;
+	long			bus_tput;
 	int			dpll_entry;
 	int			dpll_exit;
 	spinlock_t		dpll_lock;
@@ -1974,6 +1975,22 @@ static void omap_hsmmc_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 				OCP_INITIATOR_AGENT, 200*1000*4);
 			host->tput_constraint = 1;
 		}
+	} else if (!(mmc_slot(host).features & HSMMC_DVFS_24MHZ_CONST) &&
+					host->pdata->set_min_bus_tput) {
+		/*
+		 * Otherwise ask for what the card interface can move at
+		 * the current clock and bus width while it is powered.
+		 */
+		long tput = 0;
+
+		if (ios->clock && host->power_mode != MMC_POWER_OFF)
+			tput = ((ios->clock / 8) << ios->bus_width <<
+				(ios->ddr ? 1 : 0)) / 1024;
+		if (tput != host->bus_tput) {
+			host->pdata->set_min_bus_tput(host->dev,
+				OCP_INITIATOR_AGENT, tput ? tput : -1);
+			host->bus_tput = tput;
+		}
 	}
 #endif
 
@@ -2810,6 +2827,14 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 		host->use_reg = 1;
 	}
 
+	/*
+	 * The controllers are independent of each other, so let the PM
+	 * core resume them (and re-initialise the SD card, eMMC and SDIO
+	 * WLAN behind them) in parallel.  omap_hsmmc_resume() waits for
+	 * the supply regulators, which covers the TWL I2C bus as well.
+	 */
+	device_enable_async_suspend(host->dev);
+
 	mmc->ocr_avail = mmc_slot(host).ocr_mask;
 
 	printk("before register in mmc%d\n", host->id);
@@ -3055,6 +3080,10 @@ static int omap_hsmmc_resume(struct device *dev)
 		return 0;
 
 	if (host) {
+		if (host->vcc)
+			regulator_pm_wait(dev, host->vcc);
+		if (host->vcc_aux)
+			regulator_pm_wait(dev, host->vcc_aux);
 //&*&*&*BC1_110630: fix mmc read register crash when system resume		
 		host->mmc->nesting_cnt = 0;
 //&*&*&*BC2_110630: fix mmc read register crash when system resume		
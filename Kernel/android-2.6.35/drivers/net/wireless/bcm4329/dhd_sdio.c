@@ -82,6 +82,13 @@
 
 #define DHD_TXMINMAX	1	/* Max tx frames if rx still pending */
 
+#define DHD_BOUND_SCALE	4	/* Adaptive rx/tx bounds grow up to this x base */
+
+#define DHD_TXBATCH	8	/* Max tx frames dequeued per txq lock */
+
+#define DHD_RXPOOL_DEPTH	32	/* Preallocated rx packets kept by the DPC */
+#define DHD_RXPOOL_MINSZ	256	/* Smaller rx frames are allocated inline */
+
 #define MEMBLOCK	2048		/* Block size used for downloading of dongle image */
 #define MAX_DATA_BUF	(32 * 1024)	/* Must be large enough to hold biggest possible glom */
 
@@ -118,6 +125,9 @@
 
 #define MAX_RX_DATASZ	2048
 
+/* Size of rx pool packets: any non-glom frame fits (see dhdsdio_readframes) */
+#define DHD_RXPOOL_PKTSZ	(MAX_RX_DATASZ + DHD_SDALIGN)
+
 /* Maximum milliseconds to wait for F2 to come up */
 #define DHD_WAIT_F2RDY	3000
 
@@ -292,6 +302,18 @@ typedef struct dhd_bus {
 	uint		f2txdata;		/* Number of f2 frame writes */
 	uint		f1regdata;		/* Number of f1 register accesses */
 
+	void		*rxpool;		/* Preallocated rx packets (PKTLINK chain) */
+	uint		rxpool_cnt;		/* Packets currently in rxpool */
+	uint		rxpool_hits;		/* Rx packets taken from rxpool */
+	uint		rxpool_misses;		/* Rx packets allocated inline */
+	uint		rxbound;		/* Current (adaptive) rx frames per DPC */
+	uint		txbound;		/* Current (adaptive) tx frames per DPC */
+	bool		txbatch;		/* txpkt defers completions to txdone */
+	void		*txdone;		/* Sent packets awaiting dhd_txcomplete */
+	void		*txdone_tail;
+	uint		txbatches;		/* Number of txq dequeue batches */
+	uint		txbatchpkts;		/* Number of packets sent in batches */
+
 	uint8		*ctrl_frame_buf;
 	uint32		ctrl_frame_len;
 	bool		ctrl_frame_stat;
@@ -886,6 +908,83 @@ dhd_enable_oob_intr(struct dhd_bus *bus, bool enable)
 	} while (0);
 
 
+/* Rx packet pool: large rx frames are read into packets preallocated by the
+ * DPC between bursts, so the receive loop does not allocate per frame.
+ * Only touched with the sdlock held.
+ */
+static void *
+dhdsdio_rxpool_get(dhd_bus_t *bus, osl_t *osh, uint len)
+{
+	void *pkt;
+
+	if (len <= DHD_RXPOOL_MINSZ)
+		return PKTGET(osh, len, FALSE);
+
+	if ((len <= DHD_RXPOOL_PKTSZ) && (pkt = bus->rxpool)) {
+		bus->rxpool = PKTLINK(pkt);
+		PKTSETLINK(pkt, NULL);
+		bus->rxpool_cnt--;
+		bus->rxpool_hits++;
+		PKTSETLEN(osh, pkt, len);
+		return pkt;
+	}
+
+	bus->rxpool_misses++;
+	return PKTGET(osh, len, FALSE);
+}
+
+static void
+dhdsdio_rxpool_fill(dhd_bus_t *bus)
+{
+	osl_t *osh = bus->dhd->osh;
+	void *pkt;
+
+	while (bus->rxpool_cnt < DHD_RXPOOL_DEPTH) {
+		if (!(pkt = PKTGET(osh, DHD_RXPOOL_PKTSZ, FALSE)))
+			break;
+		PKTSETLINK(pkt, bus->rxpool);
+		bus->rxpool = pkt;
+		bus->rxpool_cnt++;
+	}
+}
+
+static void
+dhdsdio_rxpool_free(dhd_bus_t *bus)
+{
+	osl_t *osh = bus->dhd->osh;
+	void *pkt;
+
+	while ((pkt = bus->rxpool)) {
+		bus->rxpool = PKTLINK(pkt);
+		PKTSETLINK(pkt, NULL);
+		PKTFREE(osh, pkt, FALSE);
+	}
+	bus->rxpool_cnt = 0;
+}
+
+/* Complete packets deferred by dhdsdio_txpkt() in batch mode, dropping the
+ * sdlock once for the whole batch rather than once per packet.
+ */
+static void
+dhdsdio_txdone_flush(dhd_bus_t *bus)
+{
+	osl_t *osh = bus->dhd->osh;
+	void *pkt, *next;
+
+	if (!(pkt = bus->txdone))
+		return;
+	bus->txdone = bus->txdone_tail = NULL;
+
+	dhd_os_sdunlock(bus->dhd);
+	for (; pkt; pkt = next) {
+		next = PKTLINK(pkt);
+		PKTSETLINK(pkt, NULL);
+		dhd_txcomplete(bus->dhd, pkt, FALSE);
+		PKTFREE(osh, pkt, TRUE);
+	}
+	dhd_os_sdlock(bus->dhd);
+}
+
 /* Writes a HW/SW header into the packet and sends it. */
 /* Assumes: (a) header space already there, (b) caller holds lock */
 static int
@@ -1030,6 +1129,18 @@ dhdsdio_txpkt(dhd_bus_t *bus, void *pkt, uint chan, bool free_pkt)
 done:
 	/* restore pkt buffer pointer before calling tx complete routine */
 	PKTPULL(osh, pkt, SDPCM_HDRLEN + pad);
+
+	/* Batched senders complete successful frames in dhdsdio_txdone_flush() */
+	if (bus->txbatch && free_pkt && (ret == 0)) {
+		ASSERT(!PKTLINK(pkt));
+		if (bus->txdone_tail)
+			PKTSETLINK(bus->txdone_tail, pkt);
+		else
+			bus->txdone = pkt;
+		bus->txdone_tail = pkt;
+		return ret;
+	}
+
 	dhd_os_sdunlock(bus->dhd);
 	dhd_txcomplete(bus->dhd, pkt, ret != 0);
 	dhd_os_sdlock(bus->dhd);
@@ -1143,12 +1254,16 @@ static uint
 dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 {
 	void *pkt;
+	void *batch[DHD_TXBATCH];
+	int bprec[DHD_TXBATCH];
 	uint32 intstatus = 0;
 	uint retries = 0;
 	int ret = 0, prec_out;
 	uint cnt = 0;
 	uint datalen;
 	uint8 tx_prec_map;
+	uint nbatch, window, i;
+	bool stop = FALSE;
 
 	dhd_pub_t *dhd = bus->dhd;
 	sdpcmd_regs_t *regs = bus->regs;
@@ -1158,36 +1273,66 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 	tx_prec_map = ~bus->flowcontrol;
 
 	/* Send frames until the limit or some other event */
-	for (cnt = 0; (cnt < maxframes) && DATAOK(bus); cnt++) {
+	while (!stop && (cnt < maxframes) && DATAOK(bus)) {
+		/* Dequeue as many frames as the dongle window allows in one go */
+		window = (uint8)(bus->tx_max - bus->tx_seq);
+		nbatch = MIN(MIN(maxframes - cnt, window), DHD_TXBATCH);
+
 		dhd_os_sdlock_txq(bus->dhd);
-		if ((pkt = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL) {
-			dhd_os_sdunlock_txq(bus->dhd);
-			break;
+		for (i = 0; i < nbatch; i++) {
+			if ((pkt = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL)
+				break;
+			batch[i] = pkt;
+			bprec[i] = prec_out;
 		}
 		dhd_os_sdunlock_txq(bus->dhd);
-		datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
+
+		if (!(nbatch = i))
+			break;
+		bus->txbatches++;
+
+		bus->txbatch = TRUE;
+		for (i = 0; i < nbatch; i++) {
+			pkt = batch[i];
+			datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
 
 #ifndef SDTEST
-		ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
+			ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
 #else
-		ret = dhdsdio_txpkt(bus, pkt,
-		        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
+			ret = dhdsdio_txpkt(bus, pkt,
+			        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
 #endif
-		if (ret)
-			bus->dhd->tx_errors++;
-		else
-			bus->dhd->dstats.tx_bytes += datalen;
+			if (ret)
+				bus->dhd->tx_errors++;
+			else
+				bus->dhd->dstats.tx_bytes += datalen;
+			bus->txbatchpkts++;
+			cnt++;
+
+			/* In poll mode, need to check for other events */
+			if (!bus->intr && (cnt > 1))
+			{
+				/* Check device status, signal pending interrupt */
+				R_SDREG(intstatus, &regs->intstatus, retries);
+				bus->f2txdata++;
+				if (bcmsdh_regfail(bus->sdh)) {
+					stop = TRUE;
+					i++;
+					break;
+				}
+				if (intstatus & bus->hostintmask)
+					bus->ipend = TRUE;
+			}
+		}
+		bus->txbatch = FALSE;
+		dhdsdio_txdone_flush(bus);
 
-		/* In poll mode, need to check for other events */
-		if (!bus->intr && cnt)
-		{
-			/* Check device status, signal pending interrupt */
-			R_SDREG(intstatus, &regs->intstatus, retries);
-			bus->f2txdata++;
-			if (bcmsdh_regfail(bus->sdh))
-				break;
-			if (intstatus & bus->hostintmask)
-				bus->ipend = TRUE;
+		/* Put back anything left unsent, preserving order */
+		if (i < nbatch) {
+			dhd_os_sdlock_txq(bus->dhd);
+			while (nbatch-- > i)
+				pktq_penq_head(&bus->txq, bprec[nbatch], batch[nbatch]);
+			dhd_os_sdunlock_txq(bus->dhd);
 		}
 	}
 
@@ -1510,6 +1655,11 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
 	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d\n",
 	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxpool %d/%d hits %d misses %d, txbatches %d txbatchpkts %d\n",
+	            bus->rxpool_cnt, DHD_RXPOOL_DEPTH, bus->rxpool_hits, bus->rxpool_misses,
+	            bus->txbatches, bus->txbatchpkts);
+	bcm_bprintf(strbuf, "rxbound %d (base %d), txbound %d (base %d)\n",
+	            bus->rxbound, dhd_rxbound, bus->txbound, dhd_txbound);
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -1525,6 +1675,11 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhd_dump_pct(strbuf, "Rx: glom pct", (100 * bus->rxglompkts),
 		             bus->dhd->rx_packets);
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
+		dhd_dump_pct(strbuf, ", pool pct", (100 * bus->rxpool_hits),
+		             (bus->rxpool_hits + bus->rxpool_misses));
+		bcm_bprintf(strbuf, "\n");
+
+		dhd_dump_pct(strbuf, "Tx: pkts/batch", bus->txbatchpkts, bus->txbatches);
 		bcm_bprintf(strbuf, "\n");
 
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
@@ -1576,6 +1731,8 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxpool_hits = bus->rxpool_misses = 0;
+	bus->txbatches = bus->txbatchpkts = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -2767,6 +2924,9 @@ dhd_bus_stop(struct dhd_bus *bus, bool enforce_mutex)
 
 	bus->glom = bus->glomd = NULL;
 
+	/* Release the preallocated rx packets */
+	dhdsdio_rxpool_free(bus);
+
 	/* Clear rx control and wake any waiters */
 	bus->rxlen = 0;
 	dhd_os_ioctl_resp_wake(bus->dhd);
@@ -3106,7 +3266,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 
 			/* Allocate/chain packet for next subframe */
-			if ((pnext = PKTGET(osh, sublen + DHD_SDALIGN, FALSE)) == NULL) {
+			if ((pnext = dhdsdio_rxpool_get(bus, osh, sublen + DHD_SDALIGN)) == NULL) {
 				DHD_ERROR(("%s: PKTGET failed, num %d len %d\n",
 				           __FUNCTION__, num, sublen));
 				break;
@@ -3517,7 +3677,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 			 */
 			/* Allocate a packet buffer */
 			dhd_os_sdlock_rxq(bus->dhd);
-			if (!(pkt = PKTGET(osh, rdlen + DHD_SDALIGN, FALSE))) {
+			if (!(pkt = dhdsdio_rxpool_get(bus, osh, rdlen + DHD_SDALIGN))) {
 				if (bus->bus == SPI_BUS) {
 					bus->usebufpool = FALSE;
 					bus->rxctl = bus->rxbuf;
@@ -3891,7 +4051,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 		}
 
 		dhd_os_sdlock_rxq(bus->dhd);
-		if (!(pkt = PKTGET(osh, (rdlen + firstread + DHD_SDALIGN), FALSE))) {
+		if (!(pkt = dhdsdio_rxpool_get(bus, osh, (rdlen + firstread + DHD_SDALIGN)))) {
 			/* Give up on data, request rtx of events */
 			DHD_ERROR(("%s: PKTGET failed: rdlen %d chan %d\n",
 			           __FUNCTION__, rdlen, chan));
@@ -4076,6 +4236,22 @@ dhdsdio_hostmail(dhd_bus_t *bus)
 	return intstatus;
 }
 
+/* Grow a per-DPC frame bound when a pass used all of it with work left over,
+ * shrink it back toward the configured base once passes finish early.
+ */
+static uint
+dhdsdio_adapt_bound(uint cur, uint base, uint used, bool done)
+{
+	if ((cur < base) || (cur > base * DHD_BOUND_SCALE))
+		return base;
+
+	if (!done && (used >= cur))
+		return MIN(cur * 2, base * DHD_BOUND_SCALE);
+	if (done && (used < cur / 2))
+		return MAX(cur / 2, base);
+	return cur;
+}
+
 bool
 dhdsdio_dpc(dhd_bus_t *bus)
 {
@@ -4083,8 +4259,8 @@ dhdsdio_dpc(dhd_bus_t *bus)
 	sdpcmd_regs_t *regs = bus->regs;
 	uint32 intstatus, newstatus = 0;
 	uint retries = 0;
-	uint rxlimit = dhd_rxbound; /* Rx frames to read before resched */
-	uint txlimit = dhd_txbound; /* Tx frames to send before resched */
+	uint rxlimit;			  /* Rx frames to read before resched */
+	uint txlimit;			  /* Tx frames to send before resched */
 	uint framecnt = 0;		  /* Temporary counter of tx/rx frames */
 	bool rxdone = TRUE;		  /* Flag for no more read data */
 	bool resched = FALSE;	  /* Flag indicating resched wanted */
@@ -4096,6 +4272,17 @@ dhdsdio_dpc(dhd_bus_t *bus)
 
 	dhd_os_sdlock(bus->dhd);
 
+	/* Bounds start from the current adaptive values (re-based if the
+	 * txbound/rxbound iovars changed); rx gets only its base share while
+	 * the tx queue is backed up, so tx is not starved by a long rx burst.
+	 */
+	bus->rxbound = dhdsdio_adapt_bound(bus->rxbound, dhd_rxbound, 0, FALSE);
+	bus->txbound = dhdsdio_adapt_bound(bus->txbound, dhd_txbound, 0, FALSE);
+	rxlimit = bus->rxbound;
+	txlimit = bus->txbound;
+	if (pktq_len(&bus->txq) >= FCLOW)
+		rxlimit = dhd_rxbound;
+
 	/* If waiting for HTAVAIL, check status */
 	if (bus->clkstate == CLK_PENDING) {
 		int err;
@@ -4217,6 +4404,9 @@ dhdsdio_dpc(dhd_bus_t *bus)
 		framecnt = dhdsdio_readframes(bus, rxlimit, &rxdone);
 		if (rxdone || bus->rxskip)
 			intstatus &= ~I_HMB_FRAME_IND;
+		if (rxlimit == bus->rxbound)
+			bus->rxbound = dhdsdio_adapt_bound(bus->rxbound, dhd_rxbound,
+			                                   framecnt, rxdone);
 		rxlimit -= MIN(framecnt, rxlimit);
 	}
 
@@ -4283,6 +4473,9 @@ clkwait:
 	    pktq_mlen(&bus->txq, ~bus->flowcontrol) && txlimit && DATAOK(bus)) {
 		framecnt = rxdone ? txlimit : MIN(txlimit, dhd_txminmax);
 		framecnt = dhdsdio_sendfromq(bus, framecnt);
+		if (rxdone)
+			bus->txbound = dhdsdio_adapt_bound(bus->txbound, dhd_txbound, framecnt,
+				!pktq_mlen(&bus->txq, ~bus->flowcontrol) || !DATAOK(bus));
 		txlimit -= framecnt;
 	}
 
@@ -4306,6 +4499,10 @@ clkwait:
 
 	bus->dpc_sched = resched;
 
+	/* Top up the rx pool between bursts, outside the frame loops */
+	if (bus->dhd->busstate == DHD_BUS_DATA)
+		dhdsdio_rxpool_fill(bus);
+
 	/* If we're done for now, turn off clock request. */
 	if ((bus->clkstate != CLK_PENDING) && bus->idletime == DHD_IDLE_IMMEDIATE) {
 		bus->activity = FALSE;
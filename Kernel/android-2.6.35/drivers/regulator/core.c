@@ -2544,6 +2544,22 @@ void regulator_set_drvdata(struct regulator *regulator, void *data)
 }
 EXPORT_SYMBOL_GPL(regulator_set_drvdata);
 
+/**
+ * regulator_pm_wait - order a consumer's resume after its regulator
+ * @dev: consumer device being resumed
+ * @regulator: regulator source
+ *
+ * A consumer whose device has async suspend enabled is no longer
+ * ordered behind the regulator device and the bus the regulator is
+ * controlled over.  Calling this from its resume callback blocks until
+ * the regulator device, and therefore its parents, have resumed.
+ */
+void regulator_pm_wait(struct device *dev, struct regulator *regulator)
+{
+	device_pm_wait_for_dev(dev, &regulator->rdev->dev);
+}
+EXPORT_SYMBOL_GPL(regulator_pm_wait);
+
 /**
  * regulator_get_id - get regulator ID
  * @rdev: regulator
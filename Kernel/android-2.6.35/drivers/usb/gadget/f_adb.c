@@ -29,16 +29,53 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/usb/android_composite.h>
 
 #define BULK_BUFFER_SIZE           4096
+#define BULK_BUFFER_SIZE_MAX       (128 * 1024)
+
+/* upper bound on the number of IN requests kept in flight */
+#define REQ_MAX 16
+
+/*
+ * Requests are allocated once at bind time.  Large multi-page requests
+ * let the controller move a whole adb packet per DMA transfer instead of
+ * taking an interrupt and a round trip through userspace every 4 KB.
+ */
+static unsigned int bulk_buffer_size = 64 * 1024;
+module_param(bulk_buffer_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bulk_buffer_size, "Size of each bulk request buffer");
+
+static unsigned int tx_req_count = 4;
+module_param(tx_req_count, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tx_req_count, "Number of IN requests to keep in flight");
 
-/* number of tx requests to allocate */
-#define TX_REQ_MAX 4
 
 static const char shortname[] = "android_adb";
 
+enum {
+	ADB_RX,
+	ADB_TX,
+};
+
+/* per-direction transfer accounting, reported in debugfs */
+struct adb_stats {
+	u64 bytes;
+	u32 reqs;
+	u32 errors;
+	u64 lat_total_us;	/* queue to completion */
+	u32 lat_max_us;
+};
+
+/* kept in req->context */
+struct adb_req_ctx {
+	ktime_t queued;
+};
+
 struct adb_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -55,11 +92,17 @@ struct adb_dev {
 	atomic_t open_excl;
 
 	struct list_head tx_idle;
+	struct list_head rx_idle;	/* allocated, not queued */
+	struct list_head rx_done;	/* completed, holding data */
+	unsigned rx_offset;		/* consumed part of rx_done head */
+
+	unsigned buffer_size;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+
+	struct adb_stats stats[2];
+	struct dentry *debugfs_root;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -141,17 +184,51 @@ static struct usb_request *adb_request_new(struct usb_ep *ep, int buffer_size)
 		return NULL;
 	}
 
+	req->context = kzalloc(sizeof(struct adb_req_ctx), GFP_KERNEL);
+	if (!req->context) {
+		kfree(req->buf);
+		usb_ep_free_request(ep, req);
+		return NULL;
+	}
+
 	return req;
 }
 
 static void adb_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		kfree(req->context);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
 }
 
+/* stamp a request just before handing it to the controller */
+static inline void adb_req_queued(struct usb_request *req)
+{
+	struct adb_req_ctx *ctx = req->context;
+
+	ctx->queued = ktime_get();
+}
+
+/* called from completion context with the request's final status */
+static void adb_account(struct adb_dev *dev, int dir, struct usb_request *req)
+{
+	struct adb_req_ctx *ctx = req->context;
+	struct adb_stats *st = &dev->stats[dir];
+	u32 us = (u32)ktime_us_delta(ktime_get(), ctx->queued);
+
+	if (req->status != 0) {
+		st->errors++;
+		return;
+	}
+	st->bytes += req->actual;
+	st->reqs++;
+	st->lat_total_us += us;
+	if (us > st->lat_max_us)
+		st->lat_max_us = us;
+}
+
 static inline int _lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -199,6 +276,7 @@ static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
+	adb_account(dev, ADB_TX, req);
 	if (req->status != 0)
 		dev->error = 1;
 
@@ -211,13 +289,45 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	adb_account(dev, ADB_RX, req);
+	if (req->status != 0) {
 		dev->error = 1;
+		req_put(dev, &dev->rx_idle, req);
+	} else {
+		req_put(dev, &dev->rx_done, req);
+	}
 
 	wake_up(&dev->read_wq);
 }
 
+/*
+ * Queue the OUT request for a read of @length bytes, unless it is already
+ * queued or still holds data. The host does not send a zero length packet
+ * after a transfer that is a multiple of maxpacket, so the request must
+ * not be longer than what the reader asked for or it would never complete.
+ */
+static int adb_queue_rx(struct adb_dev *dev, unsigned length)
+{
+	struct usb_request *req;
+	int ret;
+
+	req = req_get(dev, &dev->rx_idle);
+	if (!req)
+		return 0;
+
+	req->length = min(length, dev->buffer_size);
+	adb_req_queued(req);
+	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+	if (ret < 0) {
+		DBG(dev->cdev, "adb_read: failed to queue req %p (%d)\n",
+				req, ret);
+		req_put(dev, &dev->rx_idle, req);
+		return ret;
+	}
+	DBG(dev->cdev, "rx %p queue\n", req);
+	return 0;
+}
+
 static int __init create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -247,15 +357,21 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	ep->driver_data = dev;		/* claim the endpoint */
 	dev->ep_out = ep;
 
-	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
+	/* now allocate requests for our endpoints; buffers must stay a
+	 * multiple of the packet size so OUT requests never overflow */
+	dev->buffer_size = clamp_t(unsigned, bulk_buffer_size,
+			BULK_BUFFER_SIZE, BULK_BUFFER_SIZE_MAX);
+	dev->buffer_size &= ~(BULK_BUFFER_SIZE - 1);
+
+	/* a single OUT request, sized by each read (see adb_queue_rx) */
+	req = adb_request_new(dev->ep_out, dev->buffer_size);
 	if (!req)
 		goto fail;
 	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	req_put(dev, &dev->rx_idle, req);
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < clamp_t(unsigned, tx_req_count, 1, REQ_MAX); i++) {
+		req = adb_request_new(dev->ep_in, dev->buffer_size);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
@@ -275,13 +391,14 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 	struct adb_dev *dev = fp->private_data;
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
+	unsigned long flags;
 	int r = count, xfer;
 	int ret;
 
 	DBG(cdev, "adb_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
-		return -EINVAL;
+	if (!count)
+		return 0;
 
 	if (_lock(&dev->read_excl))
 		return -EBUSY;
@@ -301,39 +418,63 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		goto done;
 	}
 
-requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+next_req:
+	ret = adb_queue_rx(dev, count);
 	if (ret < 0) {
-		DBG(cdev, "adb_read: failed to queue req %p (%d)\n", req, ret);
 		r = -EIO;
 		dev->error = 1;
 		goto done;
-	} else {
-		DBG(cdev, "rx %p queue\n", req);
 	}
 
 	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
+	ret = wait_event_interruptible(dev->read_wq,
+			!list_empty(&dev->rx_done) || dev->error);
 	if (ret < 0) {
-		dev->error = 1;
 		r = ret;
 		goto done;
 	}
-	if (!dev->error) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
-
-		DBG(cdev, "rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
-			r = -EFAULT;
-	} else
+	if (dev->error) {
 		r = -EIO;
+		goto done;
+	}
+
+	/* take the request off rx_done so that adb_function_disable()
+	 * cannot recycle it while we copy from it */
+	spin_lock_irqsave(&dev->lock, flags);
+	if (list_empty(&dev->rx_done)) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		r = -EIO;
+		goto done;
+	}
+	req = list_first_entry(&dev->rx_done, struct usb_request, list);
+	list_del_init(&req->list);
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	/* If we got a 0-len packet, throw it back and try again. */
+	if (req->actual == 0) {
+		req_put(dev, &dev->rx_idle, req);
+		goto next_req;
+	}
+
+	/* A read interrupted by a signal may leave a request sized for a
+	 * larger read; hand it out in pieces until it has been drained. */
+	DBG(cdev, "rx %p %d @ %u\n", req, req->actual, dev->rx_offset);
+	xfer = min_t(unsigned, req->actual - dev->rx_offset, count);
+	if (copy_to_user(buf, req->buf + dev->rx_offset, xfer))
+		r = -EFAULT;
+	else
+		r = xfer;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (r > 0)
+		dev->rx_offset += xfer;
+	if (dev->rx_offset == req->actual || dev->error) {
+		dev->rx_offset = 0;
+		list_add_tail(&req->list, &dev->rx_idle);
+	} else {
+		list_add(&req->list, &dev->rx_done);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
 
 done:
 	_unlock(&dev->read_excl);
@@ -373,8 +514,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
+			if (count > dev->buffer_size)
+				xfer = dev->buffer_size;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -383,6 +524,7 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 			}
 
 			req->length = xfer;
+			adb_req_queued(req);
 			ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
 			if (ret < 0) {
 				DBG(cdev, "adb_write: xfer error %d\n", ret);
@@ -421,6 +563,72 @@ static int adb_open(struct inode *ip, struct file *fp)
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int adb_stats_show(struct seq_file *s, void *unused)
+{
+	struct adb_dev *dev = s->private;
+	static const char *names[] = { "rx", "tx" };
+	int i;
+
+	seq_printf(s, "buffer_size %u\n", dev->buffer_size);
+	for (i = 0; i < ARRAY_SIZE(dev->stats); i++) {
+		struct adb_stats st = dev->stats[i];
+
+		seq_printf(s, "%s: bytes %llu reqs %u errors %u "
+				"lat_avg_us %u lat_max_us %u\n",
+			   names[i], (unsigned long long)st.bytes, st.reqs,
+			   st.errors,
+			   st.reqs ? (u32)div_u64(st.lat_total_us, st.reqs) : 0,
+			   st.lat_max_us);
+	}
+	return 0;
+}
+
+static int adb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, adb_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t adb_stats_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct adb_dev *dev = ((struct seq_file *)file->private_data)->private;
+
+	memset(dev->stats, 0, sizeof(dev->stats));
+	return count;
+}
+
+static const struct file_operations adb_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= adb_stats_open,
+	.read		= seq_read,
+	.write		= adb_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void adb_debugfs_init(struct adb_dev *dev)
+{
+	dev->debugfs_root = debugfs_create_dir("adb", NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs_root)) {
+		dev->debugfs_root = NULL;
+		return;
+	}
+	debugfs_create_file("stats", 0644, dev->debugfs_root, dev,
+			&adb_stats_fops);
+}
+
+static void adb_debugfs_exit(struct adb_dev *dev)
+{
+	debugfs_remove_recursive(dev->debugfs_root);
+	dev->debugfs_root = NULL;
+}
+#else
+static inline void adb_debugfs_init(struct adb_dev *dev) { }
+static inline void adb_debugfs_exit(struct adb_dev *dev) { }
+#endif
+
 static int adb_release(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_release\n");
@@ -521,7 +729,10 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	spin_lock_irq(&dev->lock);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	while ((req = req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
+	while ((req = req_get(dev, &dev->rx_done)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 
@@ -529,6 +740,7 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	dev->error = 1;
 	spin_unlock_irq(&dev->lock);
 
+	adb_debugfs_exit(dev);
 	misc_deregister(&adb_device);
 	misc_deregister(&adb_enable_device);
 	kfree(_adb_dev);
@@ -568,6 +780,8 @@ static void adb_function_disable(struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_dev(f);
 	struct usb_composite_dev	*cdev = dev->cdev;
+	struct usb_request *req;
+	unsigned long flags;
 
 	DBG(cdev, "adb_function_disable\n");
 	dev->online = 0;
@@ -575,6 +789,15 @@ static void adb_function_disable(struct usb_function *f)
 	usb_ep_disable(dev->ep_in);
 	usb_ep_disable(dev->ep_out);
 
+	/* data from this session must not leak into the next one */
+	spin_lock_irqsave(&dev->lock, flags);
+	while (!list_empty(&dev->rx_done)) {
+		req = list_first_entry(&dev->rx_done, struct usb_request, list);
+		list_move_tail(&req->list, &dev->rx_idle);
+	}
+	dev->rx_offset = 0;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
 	/* readers may be blocked waiting for us to go online */
 	wake_up(&dev->read_wq);
 
@@ -602,6 +825,8 @@ static int adb_bind_config(struct usb_configuration *c)
 	atomic_set(&dev->write_excl, 0);
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_done);
 
 	dev->cdev = c->cdev;
 	dev->function.name = "adb";
@@ -629,6 +854,7 @@ static int adb_bind_config(struct usb_configuration *c)
 	if (ret)
 		goto err3;
 
+	adb_debugfs_init(dev);
 	return 0;
 
 err3:
@@ -138,6 +138,19 @@
  *				boolean to permit the driver to halt
  *				bulk endpoints.
  *
+ * Independently of the prefixed parameters above, the size of the
+ * buffer pipeline is always tunable:
+ *
+ *	num_buffers=N	Number of pipeline buffers (2 to 8).
+ *	buflen=N	Size of each pipeline buffer in bytes, a
+ *				multiple of PAGE_SIZE.
+ *	readahead_kb=N	Size of the explicit readahead issued past
+ *				the end of sequential READ commands, 0 to
+ *				disable.
+ *
+ * Both buffer settings take effect the next time the function is
+ * bound.
+ *
  * The module parameters may be prefixed with some string.  You need
  * to consult gadget's documentation or source to verify whether it is
  * using those module parameters and if it does what are the prefixes
@@ -167,6 +180,10 @@
  * ro setting are not allowed when the medium is loaded or if CD-ROM
  * emulation is being used.
  *
+ * Each LUN also has a "stats" attribute reporting the amount of data
+ * moved and the time spent in file I/O; writing to it clears the
+ * counters.
+ *
  * When a LUN receive an "eject" SCSI request (Start/Stop Unit),
  * if the LUN is removable, the backing file is released to simulate
  * ejection.
@@ -219,14 +236,15 @@
  * a callback functions is needed.
  *
  * To provide maximum throughput, the driver uses a circular pipeline of
- * buffer heads (struct fsg_buffhd).  In principle the pipeline can be
- * arbitrarily long; in practice the benefits don't justify having more
- * than 2 stages (i.e., double buffering).  But it helps to think of the
- * pipeline as being a long one.  Each buffer head contains a bulk-in and
- * a bulk-out request pointer (since the buffer can be used for both
- * output and input -- directions always are given from the host's
- * point of view) as well as a pointer to the buffer and various state
- * variables.
+ * buffer heads (struct fsg_buffhd).  The pipeline length and buffer size
+ * are set when the common structure is initialised (see the num_buffers
+ * and buflen module parameters).  Two stages give plain double
+ * buffering; more stages let the controller's DMA keep running while
+ * the thread is blocked in file I/O.  Each buffer head contains a
+ * bulk-in and a bulk-out request pointer (since the buffer can be used
+ * for both output and input -- directions always are given from the
+ * host's point of view) as well as a pointer to the buffer and various
+ * state variables.
  *
  * Use of the pipeline follows a simple protocol.  There is a variable
  * (fsg->next_buffhd_to_fill) that points to the next buffer head to use.
@@ -239,6 +257,13 @@
  * (again possibly by USB I/O, during which it is marked BUSY) and
  * finally marked EMPTY again (possibly by a completion routine).
  *
+ * When writing, all buffers which are already FULL at the time the
+ * thread gets around to draining them are handed to the backing file
+ * in a single vfs_writev() call.  FUA writes are not issued with O_SYNC;
+ * instead the written range is synced once, before the status is sent.
+ * Sequential READ commands additionally trigger readahead past the end
+ * of the command, so the next one finds its data in the page cache.
+ *
  * A module parameter tells the driver to avoid stalling the bulk
  * endpoints wherever the transport specification allows.  This is
  * necessary for some UDCs like the SuperH, which cannot reliably clear a
@@ -294,6 +319,10 @@
 #include <linux/switch.h>
 #include <linux/freezer.h>
 #include <linux/utsname.h>
+#include <linux/uio.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/backing-dev.h>
 
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
@@ -322,6 +351,31 @@ static const char fsg_string_interface[] = "Mass Storage";
 
 #include "storage_common.c"
 
+#ifdef CONFIG_USB_ANDROID_MASS_STORAGE
+#define FSG_DEFAULT_NUM_BUFFERS	CONFIG_USB_ANDROID_MASS_STORAGE_NUM_BUFFERS
+#define FSG_DEFAULT_BUFLEN	((u32)CONFIG_USB_ANDROID_MASS_STORAGE_BUFLEN * 1024)
+#else
+#define FSG_DEFAULT_NUM_BUFFERS	FSG_NUM_BUFFERS
+#define FSG_DEFAULT_BUFLEN	FSG_BUFLEN
+#endif
+
+/* Upper bound on the pipeline length; also bounds the writev vector */
+#define FSG_MAX_NUM_BUFFERS	8
+/* Same upper bound as the Kconfig range, for the buflen parameter */
+#define FSG_MAX_BUFLEN		(128 * 1024)
+
+static unsigned int fsg_num_buffers = FSG_DEFAULT_NUM_BUFFERS;
+module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers (2-8)");
+
+static unsigned int fsg_buflen = FSG_DEFAULT_BUFLEN;
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer in bytes (max 128 KiB)");
+
+static unsigned int fsg_readahead_kb = 512;
+module_param_named(readahead_kb, fsg_readahead_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(readahead_kb, "Readahead for sequential reads, in KiB");
+
 
 /*-------------------------------------------------------------------------*/
 
@@ -368,7 +422,9 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
+	unsigned int		num_buffers;
+	u32			buflen;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -745,6 +801,51 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Called after a READ command has been fully read from the backing file.
+ * If the command continued where the previous one ended, widen the file's
+ * readahead window and start reading the area that follows, so the I/O
+ * overlaps with the USB transfer of the data we already have.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t file_offset,
+			      u32 length)
+{
+	struct file		*filp = curlun->filp;
+	struct address_space	*mapping = filp->f_mapping;
+	unsigned long		bdi_pages = mapping->backing_dev_info->ra_pages;
+	unsigned long		ra_pages;
+	pgoff_t			index, last;
+	int			sequential;
+
+	sequential = file_offset == curlun->ra_next_offset;
+	curlun->ra_next_offset = file_offset + length;
+
+	ra_pages = fsg_readahead_kb >> (PAGE_CACHE_SHIFT - 10);
+	if (!sequential || !ra_pages) {
+		if (curlun->ra_sequential) {
+			curlun->ra_sequential = 0;
+			filp->f_ra.ra_pages = bdi_pages;
+		}
+		return;
+	}
+
+	if (!curlun->ra_sequential) {
+		curlun->ra_sequential = 1;
+		filp->f_ra.ra_pages = max(ra_pages, bdi_pages);
+	}
+
+	file_offset += length;
+	if (file_offset >= curlun->file_length)
+		return;
+	index = file_offset >> PAGE_CACHE_SHIFT;
+	last = (curlun->file_length - 1) >> PAGE_CACHE_SHIFT;
+	ra_pages = min_t(unsigned long, ra_pages, last - index + 1);
+
+	page_cache_sync_readahead(mapping, &filp->f_ra, filp, index, ra_pages);
+	blk_run_address_space(mapping);
+	curlun->stats.readaheads++;
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -756,6 +857,7 @@ static int do_read(struct fsg_common *common)
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nread;
+	ktime_t			start;
 
 	/* Get the starting Logical Block Address and check that it's
 	 * not too big */
@@ -782,6 +884,7 @@ static int do_read(struct fsg_common *common)
 	amount_left = common->data_size_from_cmnd;
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
+	curlun->stats.read_cmds++;
 
 	for (;;) {
 
@@ -793,7 +896,7 @@ static int do_read(struct fsg_common *common)
 		 *	the next page.
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
@@ -823,9 +926,12 @@ static int do_read(struct fsg_common *common)
 
 		/* Perform the read */
 		file_offset_tmp = file_offset;
+		start = ktime_get();
 		nread = vfs_read(curlun->filp,
 				(char __user *) bh->buf,
 				amount, &file_offset_tmp);
+		curlun->stats.read_usecs +=
+				ktime_us_delta(ktime_get(), start);
 		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
 				(unsigned long long) file_offset,
 				(int) nread);
@@ -844,6 +950,7 @@ static int do_read(struct fsg_common *common)
 		file_offset  += nread;
 		amount_left  -= nread;
 		common->residue -= nread;
+		curlun->stats.read_bytes += nread;
 		bh->inreq->length = nread;
 		bh->state = BUF_STATE_FULL;
 
@@ -855,8 +962,12 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		if (amount_left == 0)
-			break;		/* No more left to read */
+		if (amount_left == 0) {
+			/* No more left to read; prepare for the next one */
+			fsg_lun_readahead(curlun, ((loff_t) lba) << 9,
+					  common->data_size_from_cmnd);
+			break;
+		}
 
 		/* Send this buffer and go read some more */
 		bh->inreq->zero = 0;
@@ -882,10 +993,17 @@ static int do_write(struct fsg_common *common)
 	int			get_some_more;
 	u32			amount_left_to_req, amount_left_to_write;
 	loff_t			usb_offset, file_offset, file_offset_tmp;
+	loff_t			fua_offset;
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nwritten;
 	int			rc;
+	int			fua = 0;
+	int			nbufs, i;
+	int			short_packet;
+	size_t			left;
+	struct iovec		iov[FSG_MAX_NUM_BUFFERS];
+	ktime_t			start;
 
 	if (curlun->ro) {
 		curlun->sense_data = SS_WRITE_PROTECTED;
@@ -905,16 +1023,13 @@ static int do_write(struct fsg_common *common)
 		/* We allow DPO (Disable Page Out = don't save data in the
 		 * cache) and FUA (Force Unit Access = write directly to the
 		 * medium).  We don't implement DPO; we implement FUA by
-		 * performing synchronous output. */
+		 * syncing the written range before reporting status. */
 		if (common->cmnd[1] & ~0x18) {
 			curlun->sense_data = SS_INVALID_FIELD_IN_CDB;
 			return -EINVAL;
 		}
-		if (!curlun->nofua && (common->cmnd[1] & 0x08)) { /* FUA */
-			spin_lock(&curlun->filp->f_lock);
-			curlun->filp->f_flags |= O_SYNC;
-			spin_unlock(&curlun->filp->f_lock);
-		}
+		if (!curlun->nofua && (common->cmnd[1] & 0x08)) /* FUA */
+			fua = 1;
 	}
 	if (lba >= curlun->num_sectors) {
 		curlun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
@@ -923,9 +1038,10 @@ static int do_write(struct fsg_common *common)
 
 	/* Carry out the file writes */
 	get_some_more = 1;
-	file_offset = usb_offset = ((loff_t) lba) << 9;
+	file_offset = usb_offset = fua_offset = ((loff_t) lba) << 9;
 	amount_left_to_req = common->data_size_from_cmnd;
 	amount_left_to_write = common->data_size_from_cmnd;
+	curlun->stats.write_cmds++;
 
 	while (amount_left_to_write > 0) {
 
@@ -942,7 +1058,7 @@ static int do_write(struct fsg_common *common)
 			 * If this means getting 0, then we were asked
 			 *	to write past the end of file.
 			 * Finally, round down to a block boundary. */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 			amount = min((loff_t) amount, curlun->file_length -
 					usb_offset);
 			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
@@ -994,34 +1110,78 @@ static int do_write(struct fsg_common *common)
 			break;			/* We stopped early */
 		if (bh->state == BUF_STATE_FULL) {
 			smp_rmb();
-			common->next_buffhd_to_drain = bh->next;
-			bh->state = BUF_STATE_EMPTY;
 
 			/* Did something go wrong with the transfer? */
 			if (bh->outreq->status != 0) {
+				common->next_buffhd_to_drain = bh->next;
+				bh->state = BUF_STATE_EMPTY;
 				curlun->sense_data = SS_COMMUNICATION_FAILURE;
 				curlun->sense_data_info = file_offset >> 9;
 				curlun->info_valid = 1;
 				break;
 			}
 
-			amount = bh->outreq->actual;
+			/* Gather every buffer that has already arrived
+			 * into a single write.  A failed or short transfer
+			 * ends the run; failures are reported when the
+			 * thread gets to that buffer on its own. */
+			nbufs = 0;
+			amount = 0;
+			short_packet = 0;
+			do {
+				iov[nbufs].iov_base = bh->buf;
+				iov[nbufs].iov_len = bh->outreq->actual;
+				amount += bh->outreq->actual;
+				short_packet = bh->outreq->actual !=
+						bh->outreq->length;
+				++nbufs;
+				bh = bh->next;
+				if (bh->state != BUF_STATE_FULL)
+					break;
+				smp_rmb();
+			} while (!short_packet && bh->outreq->status == 0 &&
+				 nbufs < common->num_buffers);
+
+			/* Release the buffers; nobody but us refills them */
+			bh = common->next_buffhd_to_drain;
+			for (i = 0; i < nbufs; ++i) {
+				bh->state = BUF_STATE_EMPTY;
+				bh = bh->next;
+			}
+			common->next_buffhd_to_drain = bh;
+
 			if (curlun->file_length - file_offset < amount) {
 				LERROR(curlun,
 	"write %u @ %llu beyond end %llu\n",
 	amount, (unsigned long long) file_offset,
 	(unsigned long long) curlun->file_length);
 				amount = curlun->file_length - file_offset;
+
+				/* Trim the vector to match */
+				for (i = 0, left = amount; i < nbufs; ++i) {
+					iov[i].iov_len = min(iov[i].iov_len,
+							     left);
+					left -= iov[i].iov_len;
+				}
 			}
 
 			/* Perform the write */
 			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					(char __user *) bh->buf,
+			start = ktime_get();
+			if (nbufs == 1)
+				nwritten = vfs_write(curlun->filp,
+					(char __user *) iov[0].iov_base,
 					amount, &file_offset_tmp);
-			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
-					(unsigned long long) file_offset,
-					(int) nwritten);
+			else
+				nwritten = vfs_writev(curlun->filp,
+					(const struct iovec __user *) iov,
+					nbufs, &file_offset_tmp);
+			curlun->stats.write_usecs +=
+					ktime_us_delta(ktime_get(), start);
+			curlun->stats.write_calls++;
+			VLDBG(curlun, "file write %u @ %llu (%d bufs) -> %d\n",
+					amount, (unsigned long long) file_offset,
+					nbufs, (int) nwritten);
 			if (signal_pending(current))
 				return -EINTR;		/* Interrupted! */
 
@@ -1038,6 +1198,7 @@ static int do_write(struct fsg_common *common)
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
+			curlun->stats.write_bytes += nwritten;
 
 			/* If an error occurred, report it and its position */
 			if (nwritten < amount) {
@@ -1048,7 +1209,7 @@ static int do_write(struct fsg_common *common)
 			}
 
 			/* Did the host decide to stop early? */
-			if (bh->outreq->actual != bh->outreq->length) {
+			if (short_packet) {
 				common->short_packet_received = 1;
 				break;
 			}
@@ -1061,6 +1222,18 @@ static int do_write(struct fsg_common *common)
 			return rc;
 	}
 
+	/* Deferred FUA: push out everything this command wrote at once */
+	if (fua && file_offset > fua_offset) {
+		rc = vfs_fsync_range(curlun->filp, fua_offset,
+				     file_offset - 1, 1);
+		curlun->stats.fua_syncs++;
+		if (rc && curlun->sense_data == SS_NO_SENSE) {
+			curlun->sense_data = SS_WRITE_ERROR;
+			curlun->sense_data_info = fua_offset >> 9;
+			curlun->info_valid = 1;
+		}
+	}
+
 	return -EIO;		/* No default reply */
 }
 
@@ -1145,7 +1318,7 @@ static int do_verify(struct fsg_common *common)
 		 * And don't try to read past the end of the file.
 		 * If this means reading 0 then we were asked to read
 		 * past the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1396,7 +1569,7 @@ static int do_mode_sense(struct fsg_common *common, struct fsg_buffhd *bh)
 	} else {			/* SC_MODE_SENSE_10 */
 		buf[3] = (curlun->ro ? 0x80 : 0x00);		/* WP, DPOFUA */
 		buf += 8;
-		limit = 65535;		/* Should really be FSG_BUFLEN */
+		limit = min(65535u, common->buflen);
 	}
 
 	/* No block descriptors */
@@ -1622,7 +1795,7 @@ static int pad_with_zeros(struct fsg_dev *fsg)
 				return rc;
 		}
 
-		nsend = min(fsg->common->usb_amount_left, FSG_BUFLEN);
+		nsend = min(fsg->common->usb_amount_left, fsg->common->buflen);
 		memset(bh->buf + nkeep, 0, nsend - nkeep);
 		bh->inreq->length = nsend;
 		bh->inreq->zero = 0;
@@ -1665,7 +1838,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, common->buflen);
 
 			/* amount is always divisible by 512, hence by
 			 * the bulk-out maxpacket size */
@@ -2385,7 +2558,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2437,7 +2610,7 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2505,7 +2678,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2517,7 +2690,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < common->num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2538,7 +2711,7 @@ static void handle_exception(struct fsg_common *common)
 	 * state, and the exception.  Then invoke the handler. */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -2710,6 +2883,48 @@ static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
 static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
 
+static ssize_t fsg_show_stats(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct fsg_lun		*curlun = fsg_lun_from_dev(dev);
+	struct fsg_lun_stats	st = curlun->stats;
+	u64			read_kbps = 0, write_kbps = 0;
+
+	/* Throughput of the file I/O alone, in KiB/s */
+	if (st.read_usecs)
+		read_kbps = div64_u64(st.read_bytes * 1000000 >> 10,
+				      st.read_usecs);
+	if (st.write_usecs)
+		write_kbps = div64_u64(st.write_bytes * 1000000 >> 10,
+				       st.write_usecs);
+
+	return sprintf(buf,
+		       "read_cmds %u\nread_bytes %llu\nread_usecs %llu\n"
+		       "read_kbps %llu\nreadaheads %u\n"
+		       "write_cmds %u\nwrite_bytes %llu\nwrite_usecs %llu\n"
+		       "write_kbps %llu\nwrite_calls %u\nfua_syncs %u\n",
+		       st.read_cmds, (unsigned long long) st.read_bytes,
+		       (unsigned long long) st.read_usecs,
+		       (unsigned long long) read_kbps, st.readaheads,
+		       st.write_cmds, (unsigned long long) st.write_bytes,
+		       (unsigned long long) st.write_usecs,
+		       (unsigned long long) write_kbps, st.write_calls,
+		       st.fua_syncs);
+}
+
+/* Any write clears the counters */
+static ssize_t fsg_store_stats(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+
+	memset(&curlun->stats, 0, sizeof curlun->stats);
+	return count;
+}
+
+static DEVICE_ATTR(stats, 0644, fsg_show_stats, fsg_store_stats);
+
 
 /****************************** FSG COMMON ******************************/
 
@@ -2846,6 +3061,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		if (rc)
 			goto error_luns;
 		rc = device_create_file(&curlun->dev, &dev_attr_nofua);
+		if (rc)
+			goto error_luns;
+		rc = device_create_file(&curlun->dev, &dev_attr_stats);
 		if (rc)
 			goto error_luns;
 
@@ -2863,14 +3081,25 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 
 
 	/* Data buffers cyclic list */
+	common->num_buffers = clamp_t(unsigned int, fsg_num_buffers,
+				      2, FSG_MAX_NUM_BUFFERS);
+	common->buflen = clamp_t(u32, PAGE_ALIGN(fsg_buflen), FSG_BUFLEN,
+				 FSG_MAX_BUFLEN);
+	common->buffhds = kcalloc(common->num_buffers,
+				  sizeof *common->buffhds, GFP_KERNEL);
+	if (unlikely(!common->buffhds)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+
 	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
+	i = common->num_buffers;
 	goto buffhds_first_it;
 	do {
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
+		bh->buf = kmalloc(common->buflen, GFP_KERNEL);
 		if (unlikely(!bh->buf)) {
 			rc = -ENOMEM;
 			goto error_release;
@@ -2931,6 +3160,8 @@ buffhds_first_it:
 	/* Information */
 	INFO(common, FSG_DRIVER_DESC ", version: " FSG_DRIVER_VERSION "\n");
 	INFO(common, "Number of LUNs=%d\n", common->nluns);
+	INFO(common, "Pipeline: %u buffers of %u bytes\n",
+	     common->num_buffers, common->buflen);
 
 	pathbuf = kmalloc(PATH_MAX, GFP_KERNEL);
 	for (i = 0, nluns = common->nluns, curlun = common->luns;
@@ -2992,6 +3223,7 @@ static void fsg_common_release(struct kref *ref)
 
 		/* In error recovery common->nluns may be zero. */
 		for (; i; --i, ++lun) {
+			device_remove_file(&lun->dev, &dev_attr_stats);
 			device_remove_file(&lun->dev, &dev_attr_nofua);
 			device_remove_file(&lun->dev, &dev_attr_ro);
 			device_remove_file(&lun->dev, &dev_attr_file);
@@ -3002,12 +3234,13 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
+	if (likely(common->buffhds)) {
 		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
+		unsigned i = common->num_buffers;
 		do {
 			kfree(bh->buf);
 		} while (++bh, --i);
+		kfree(common->buffhds);
 	}
 
 	if (common->free_storage_on_release)
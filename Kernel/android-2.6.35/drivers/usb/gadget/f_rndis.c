@@ -316,6 +316,24 @@ static struct usb_gadget_strings *rndis_strings[] = {
 static struct usb_ether_platform_data *rndis_pdata;
 #endif
 
+/*
+ * RNDIS lets either side pack several packet messages into one bulk
+ * transfer.  We advertise ul_max_pkts_per_xfer to the host at init time
+ * (it may then batch its OUT transfers) and gather up to
+ * dl_max_pkts_per_xfer frames into each IN transfer, within the host's
+ * MaxTransferSize.  One disables aggregation in that direction.
+ */
+#define RNDIS_MAX_PKTS_PER_XFER	10
+
+static unsigned int ul_max_pkts_per_xfer = 3;
+module_param(ul_max_pkts_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(ul_max_pkts_per_xfer,
+		"max frames per OUT transfer offered to the host");
+
+static unsigned int dl_max_pkts_per_xfer = 3;
+module_param(dl_max_pkts_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(dl_max_pkts_per_xfer, "max frames per IN transfer");
+
 /*-------------------------------------------------------------------------*/
 
 static struct sk_buff *rndis_add_header(struct gether *port,
@@ -716,6 +734,7 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 		goto fail;
 	rndis->config = status;
 
+	rndis_set_param_port(rndis->config, &rndis->port);
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
@@ -853,6 +872,10 @@ rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.ul_max_pkts_per_xfer = clamp_t(unsigned,
+			ul_max_pkts_per_xfer, 1, RNDIS_MAX_PKTS_PER_XFER);
+	rndis->port.dl_max_pkts_per_xfer = clamp_t(unsigned,
+			dl_max_pkts_per_xfer, 1, RNDIS_MAX_PKTS_PER_XFER);
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
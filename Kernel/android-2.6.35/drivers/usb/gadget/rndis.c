@@ -567,10 +567,14 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	rndis_init_cmplt_type	*resp;
 	rndis_resp_t            *r;
 	struct rndis_params	*params = rndis_per_dev_params + configNr;
+	u32			max_pkts = 1;
 
 	if (!params->dev)
 		return -ENOTSUPP;
 
+	if (params->port && params->port->ul_max_pkts_per_xfer > 1)
+		max_pkts = params->port->ul_max_pkts_per_xfer;
+
 	r = rndis_add_response (configNr, sizeof (rndis_init_cmplt_type));
 	if (!r)
 		return -ENOMEM;
@@ -585,16 +589,21 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
-	resp->MaxTransferSize = cpu_to_le32 (
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (max_pkts);
+	resp->MaxTransferSize = cpu_to_le32 (max_pkts * (
 		  params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32 (0);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
+	/* the host's MaxTransferSize bounds what we may send it at once */
+	if (params->port)
+		params->port->dl_max_xfer_size =
+				le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -919,6 +928,7 @@ void rndis_deregister (int configNr)
 
 	if (configNr >= RNDIS_MAX_CONFIGS) return;
 	rndis_per_dev_params [configNr].used = 0;
+	rndis_per_dev_params [configNr].port = NULL;
 
 	return;
 }
@@ -959,6 +969,16 @@ int rndis_set_param_medium (u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+int rndis_set_param_port(u8 configNr, struct gether *port)
+{
+	pr_debug("%s:\n", __func__);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].port = port;
+
+	return 0;
+}
+
 void rndis_add_hdr (struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type	*header;
@@ -1027,30 +1047,79 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
+/*
+ * One transfer may carry several packet messages (up to the
+ * MaxPacketsPerTransfer we reported at init time), each starting where
+ * the previous one's MessageLength ends.  All but the last become clones
+ * sharing the transfer buffer, so nothing is copied.  Anything too short
+ * to be another message header is end-of-transfer padding.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	unsigned	pkts = 0;
+	int		status = 0;
+
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32		*tmp = (void *) skb->data;
+		u32		msg_len, data_offset, data_len;
+		struct sk_buff	*skb2;
+
+		/* MessageType, MessageLength */
+		if (skb->len < sizeof(struct rndis_packet_msg_type)
+				|| cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+					!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			status = -EINVAL;
+			break;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (data_offset > skb->len
+				|| data_len > skb->len - data_offset) {
+			dev_kfree_skb_any(skb);
+			status = -EOVERFLOW;
+			break;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* last (or only) message in this transfer? */
+		if (msg_len < sizeof(struct rndis_packet_msg_type)
+				|| msg_len > skb->len - sizeof(struct
+					rndis_packet_msg_type)
+				|| get_unaligned((__le32 *)(skb->data + msg_len))
+					!= cpu_to_le32(REMOTE_NDIS_PACKET_MSG)) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			pkts++;
+			break;
+		}
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			status = -ENOMEM;
+			break;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+		pkts++;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	port->stats.rx_xfers++;
+	port->stats.rx_pkts += pkts;
+	if (pkts > 1)
+		port->stats.rx_aggr++;
+
+	return status;
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -1058,6 +1127,7 @@ int rndis_rm_hdr(struct gether *port,
 static int rndis_proc_show(struct seq_file *m, void *v)
 {
 	rndis_params *param = m->private;
+	struct gether *port = param->port;
 
 	seq_printf(m,
 			 "Config Nr. %d\n"
@@ -1067,7 +1137,11 @@ static int rndis_proc_show(struct seq_file *m, void *v)
 			 "speed     : %d\n"
 			 "cable     : %s\n"
 			 "vendor ID : 0x%08X\n"
-			 "vendor    : %s\n",
+			 "vendor    : %s\n"
+			 "max pkts  : ul %u dl %u\n"
+			 "dl xfer   : %u bytes\n"
+			 "rx xfers  : %lu (%lu pkts, %lu aggregated)\n"
+			 "tx xfers  : %lu (%lu pkts, %lu aggregated)\n",
 			 param->confignr, (param->used) ? "y" : "n",
 			 ({ char *s = "?";
 			 switch (param->state) {
@@ -1081,7 +1155,16 @@ static int rndis_proc_show(struct seq_file *m, void *v)
 			 param->medium,
 			 (param->media_state) ? 0 : param->speed*100,
 			 (param->media_state) ? "disconnected" : "connected",
-			 param->vendorID, param->vendorDescr);
+			 param->vendorID, param->vendorDescr,
+			 port ? port->ul_max_pkts_per_xfer : 0,
+			 port ? port->dl_max_pkts_per_xfer : 0,
+			 port ? port->dl_max_xfer_size : 0,
+			 port ? port->stats.rx_xfers : 0,
+			 port ? port->stats.rx_pkts : 0,
+			 port ? port->stats.rx_aggr : 0,
+			 port ? port->stats.tx_xfers : 0,
+			 port ? port->stats.tx_pkts : 0,
+			 port ? port->stats.tx_aggr : 0);
 	return 0;
 }
 
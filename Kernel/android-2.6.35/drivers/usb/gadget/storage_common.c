@@ -291,6 +291,23 @@ struct fsg_lun {
 	u32		sense_data_info;
 	u32		unit_attention_data;
 
+	/* Sequential read detection for explicit readahead */
+	loff_t		ra_next_offset;
+	unsigned int	ra_sequential:1;
+
+	/* Throughput statistics, exported through sysfs */
+	struct fsg_lun_stats {
+		u64	read_bytes;
+		u64	write_bytes;
+		u64	read_usecs;	/* Time spent in vfs_read() */
+		u64	write_usecs;	/* Time spent in vfs_write[v]() */
+		u32	read_cmds;
+		u32	write_cmds;
+		u32	write_calls;	/* vfs_write[v]() invocations */
+		u32	readaheads;
+		u32	fua_syncs;
+	} stats;
+
 	struct device	dev;
 };
 
@@ -650,6 +667,8 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 	curlun->filp = filp;
 	curlun->file_length = size;
 	curlun->num_sectors = num_sectors;
+	curlun->ra_next_offset = 0;
+	curlun->ra_sequential = 0;
 	LDBG(curlun, "open backing file: %s\n", filename);
 	//printk("open backing file: %s\n", filename);
 	rc = 0;
@@ -670,6 +689,9 @@ static void fsg_lun_close(struct fsg_lun *curlun)
 		//printk("close backing file\n");
 		fput(curlun->filp);
 		curlun->filp = NULL;
+		/* the readahead state belonged to the old backing file */
+		curlun->ra_next_offset = 0;
+		curlun->ra_sequential = 0;
 //&*&*&*BC1_110720: fix issue that cpu can not run 300 Mhz issue		
 		/* Release MPU freq constarint */
 //		omap_pm_set_min_mpu_freq((struct device *) curlun, -1);
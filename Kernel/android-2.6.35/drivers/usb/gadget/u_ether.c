@@ -24,6 +24,7 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
@@ -70,6 +71,16 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
+
+	/* multi-packet IN transfers copy frames into per-request buffers
+	 * of tx_buf_len bytes (zero: one skb per request).  The request
+	 * being filled sits at the head of tx_reqs with a nonzero length.
+	 */
+	unsigned		tx_buf_len;
+	unsigned		tx_max_pkts;
+	unsigned		tx_hold_count;
+	unsigned		ul_max_pkts;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -92,6 +103,8 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define RX_NAPI_WEIGHT	64
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -237,6 +250,11 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+
+	/* multi-packet framing: room for a full transfer, plus padding */
+	if (dev->ul_max_pkts > 1)
+		size = size * dev->ul_max_pkts + out->maxpacket;
+
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -279,7 +297,7 @@ enomem:
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -313,28 +331,16 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+		/* frames unwrapped before a framing error are still good */
+		if (status < 0) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
 		}
+
+		/* hand frames to the stack in batches from eth_poll() */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -375,6 +381,46 @@ clean:
 		rx_submit(dev, req, GFP_ATOMIC);
 }
 
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&dev->rx_frames);
+		if (!skb)
+			break;
+		work++;
+
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		netif_receive_skb(skb);
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+
+		/* rx_complete() may have queued more after we looked */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
 {
 	unsigned		i;
@@ -433,6 +479,49 @@ done:
 	return status;
 }
 
+/*
+ * Multi-packet IN transfers need a buffer per request to gather frames
+ * into; without them (or on allocation failure) each skb goes out in
+ * its own transfer.
+ */
+static void alloc_tx_buffers(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req, *failed;
+
+	dev->tx_buf_len = 0;
+	dev->tx_hold_count = 0;
+	dev->tx_max_pkts = link->dl_max_pkts_per_xfer;
+	if (dev->tx_max_pkts <= 1)
+		return;
+
+	/* one spare byte so a transfer can avoid ending in a ZLP */
+	dev->tx_buf_len = dev->tx_max_pkts
+		* (ETH_HLEN + dev->net->mtu + link->header_len) + 1;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(dev->tx_buf_len, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+		req->length = 0;
+		req->context = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+	return;
+
+fail:
+	DBG(dev, "no tx buffers, one frame per transfer\n");
+	failed = req;
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		if (req == failed)
+			break;
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	dev->tx_buf_len = 0;
+	spin_unlock(&dev->req_lock);
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -471,8 +560,10 @@ static void eth_work(struct work_struct *work)
 
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*held = NULL;
+	unsigned		pkts = 0;
 
 	switch (req->status) {
 	default:
@@ -483,16 +574,64 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* gathered frames were counted as they were copied */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
 
-	spin_lock(&dev->req_lock);
-	list_add(&req->list, &dev->tx_reqs);
-	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb) {
+		dev->net->stats.tx_packets++;
+
+		spin_lock(&dev->req_lock);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock(&dev->req_lock);
+		dev_kfree_skb_any(skb);
+
+		atomic_dec(&dev->tx_qlen);
+	} else {
+		/* the request being filled stays at the head of the list,
+		 * and is sent now rather than waiting on more frames:
+		 * this completion may be the last one for a while.
+		 */
+		spin_lock(&dev->req_lock);
+		req->length = 0;
+		list_add_tail(&req->list, &dev->tx_reqs);
+		atomic_dec(&dev->tx_qlen);
+
+		held = list_first_entry(&dev->tx_reqs, struct usb_request,
+				list);
+		if (held->length && req->status != -ESHUTDOWN) {
+			list_del(&held->list);
+			pkts = dev->tx_hold_count;
+			dev->tx_hold_count = 0;
+			atomic_inc(&dev->tx_qlen);
+		} else {
+			held = NULL;
+		}
+		spin_unlock(&dev->req_lock);
+	}
+
+	if (held) {
+		struct gether	*port = dev->port_usb;
+
+		if (!dev->zlp && (held->length % ep->maxpacket) == 0)
+			held->length++;
+
+		if (usb_ep_queue(ep, held, GFP_ATOMIC)) {
+			dev->net->stats.tx_dropped += pkts;
+			spin_lock(&dev->req_lock);
+			held->length = 0;
+			list_add_tail(&held->list, &dev->tx_reqs);
+			atomic_dec(&dev->tx_qlen);
+			spin_unlock(&dev->req_lock);
+		} else if (port) {
+			port->stats.tx_xfers++;
+			port->stats.tx_pkts += pkts;
+			if (pkts > 1)
+				port->stats.tx_aggr++;
+		}
+	}
 
-	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -512,11 +651,17 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	struct gether		*port;
+	unsigned		dl_max_xfer = 0;
+	unsigned		pkts = 1;
 
 	spin_lock_irqsave(&dev->lock, flags);
-	if (dev->port_usb) {
-		in = dev->port_usb->in_ep;
-		cdc_filter = dev->port_usb->cdc_filter;
+	port = dev->port_usb;
+	if (port) {
+		in = port->in_ep;
+		cdc_filter = port->cdc_filter;
+		dl_max_xfer = min_t(unsigned, port->dl_max_xfer_size,
+				dev->tx_buf_len - 1);
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -603,8 +748,46 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		}
 	}
 
-	req->buf = skb->data;
-	req->context = skb;
+	/*
+	 * Multi-packet framing: gather this frame into the request's
+	 * buffer.  While enough transfers are already in flight to keep
+	 * the link busy, leave the request at the head of the free list
+	 * for the next frame; tx_complete() sends it if nothing else does.
+	 */
+	if (dev->tx_buf_len) {
+		unsigned	max_frame = ETH_HLEN + net->mtu
+					+ dev->header_len;
+
+		if (WARN_ON(req->length + skb->len > dev->tx_buf_len - 1)) {
+			dev_kfree_skb_any(skb);
+			goto drop;
+		}
+		memcpy(req->buf + req->length, skb->data, skb->len);
+		req->length += skb->len;
+		dev->net->stats.tx_packets++;
+		dev->net->stats.tx_bytes += skb->len;
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+
+		spin_lock_irqsave(&dev->req_lock, flags);
+		pkts = ++dev->tx_hold_count;
+		if (pkts < dev->tx_max_pkts
+				&& req->length + max_frame <= dl_max_xfer
+				&& atomic_read(&dev->tx_qlen)
+					>= qlen(dev->gadget) / 2) {
+			list_add(&req->list, &dev->tx_reqs);
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			return NETDEV_TX_OK;
+		}
+		dev->tx_hold_count = 0;
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+
+		length = req->length;
+		req->context = NULL;
+	} else {
+		req->buf = skb->data;
+		req->context = skb;
+	}
 	req->complete = tx_complete;
 
 	/* use zlp framing on tx for strict CDC-Ether conformance,
@@ -631,10 +814,19 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	case 0:
 		net->trans_start = jiffies;
 		atomic_inc(&dev->tx_qlen);
+		if (port) {
+			port->stats.tx_xfers++;
+			port->stats.tx_pkts += pkts;
+			if (pkts > 1)
+				port->stats.tx_aggr++;
+		}
 	}
 
 	if (retval) {
-		dev_kfree_skb_any(skb);
+		if (skb)
+			dev_kfree_skb_any(skb);
+		else
+			req->length = 0;
 drop:
 		dev->net->stats.tx_dropped++;
 		spin_lock_irqsave(&dev->req_lock, flags);
@@ -666,6 +858,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -685,6 +878,8 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_frames);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -806,6 +1001,7 @@ int gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 
 	/* network device setup */
 	dev->net = net;
+	netif_napi_add(net, &dev->napi, eth_poll, RX_NAPI_WEIGHT);
 	strcpy(net->name, "usb%d");
 
 	if (get_ether_addr(dev_addr, net->dev_addr))
@@ -912,6 +1108,9 @@ struct net_device *gether_connect(struct gether *link)
 		result = alloc_requests(dev, link, qlen(dev->gadget));
 
 	if (result == 0) {
+		alloc_tx_buffers(dev, link);
+		dev->ul_max_pkts = link->ul_max_pkts_per_xfer;
+
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
 
@@ -985,9 +1184,13 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_buf_len)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_buf_len = 0;
+	dev->tx_hold_count = 0;
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in = NULL;
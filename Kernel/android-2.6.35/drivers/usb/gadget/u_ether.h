@@ -31,6 +31,16 @@
 #include "gadget_chips.h"
 
 
+/* multi-packet transfer accounting, reported by the function driver */
+struct gether_xfer_stats {
+	unsigned long			rx_xfers;
+	unsigned long			rx_pkts;
+	unsigned long			rx_aggr;	/* xfers with >1 pkt */
+	unsigned long			tx_xfers;
+	unsigned long			tx_pkts;
+	unsigned long			tx_aggr;
+};
+
 /*
  * This represents the USB side of an "ethernet" link, managed by a USB
  * function which provides control and (maybe) framing.  Two functions
@@ -68,6 +78,15 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* framings like RNDIS may carry several frames per transfer;
+	 * zero or one means one frame each.  dl_max_xfer_size is the
+	 * host's limit on a single IN transfer, zero until it's known.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+	struct gether_xfer_stats	stats;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -250,6 +250,84 @@ static const struct file_operations musb_test_mode_fops = {
 	.release		= single_release,
 };
 
+#ifdef CONFIG_USB_GADGET_MUSB_HDRC
+static void musb_ep_stats_show_one(struct seq_file *s, struct musb_ep *ep)
+{
+	struct musb_ep_stats	*st = &ep->stats;
+
+	if (!st->irqs && !st->requests)
+		return;
+
+	seq_printf(s, "  %-10s irqs %u dma %u (mode0 %u mode1 %u) pio %u "
+			"short %u reqs %u bytes %llu\n",
+			ep->name, st->irqs, st->dma_done,
+			st->dma_mode0, st->dma_mode1, st->pio,
+			st->short_abort, st->requests,
+			(unsigned long long) st->bytes);
+}
+
+static int musb_ep_stats_show(struct seq_file *s, void *unused)
+{
+	struct musb		*musb = s->private;
+	unsigned long		flags;
+	unsigned		i;
+
+	spin_lock_irqsave(&musb->lock, flags);
+	for (i = 1; i < musb->nr_endpoints; i++) {
+		struct musb_hw_ep	*hw_ep = &musb->endpoints[i];
+
+		if (!hw_ep->max_packet_sz_tx && !hw_ep->max_packet_sz_rx)
+			continue;
+
+		seq_printf(s, "hw_ep%-2u tx %4u%s rx %4u%s%s\n", i,
+				hw_ep->max_packet_sz_tx,
+				hw_ep->tx_double_buffered ? " (dpb)" : "",
+				hw_ep->max_packet_sz_rx,
+				hw_ep->rx_double_buffered ? " (dpb)" : "",
+				hw_ep->is_shared_fifo ? " shared" : "");
+		musb_ep_stats_show_one(s, &hw_ep->ep_in);
+		musb_ep_stats_show_one(s, &hw_ep->ep_out);
+	}
+	spin_unlock_irqrestore(&musb->lock, flags);
+
+	return 0;
+}
+
+static int musb_ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, musb_ep_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t musb_ep_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file		*s = file->private_data;
+	struct musb		*musb = s->private;
+	unsigned long		flags;
+	unsigned		i;
+
+	spin_lock_irqsave(&musb->lock, flags);
+	for (i = 0; i < musb->nr_endpoints; i++) {
+		memset(&musb->endpoints[i].ep_in.stats, 0,
+				sizeof(struct musb_ep_stats));
+		memset(&musb->endpoints[i].ep_out.stats, 0,
+				sizeof(struct musb_ep_stats));
+	}
+	spin_unlock_irqrestore(&musb->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations musb_ep_stats_fops = {
+	.open			= musb_ep_stats_open,
+	.write			= musb_ep_stats_write,
+	.read			= seq_read,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+#endif
+
 int __init musb_init_debugfs(struct musb *musb)
 {
 	struct dentry		*root;
@@ -276,6 +354,15 @@ int __init musb_init_debugfs(struct musb *musb)
 		goto err1;
 	}
 
+#ifdef CONFIG_USB_GADGET_MUSB_HDRC
+	file = debugfs_create_file("ep_stats", S_IRUGO | S_IWUSR,
+			root, musb, &musb_ep_stats_fops);
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto err1;
+	}
+#endif
+
 	musb_debugfs_root = root;
 
 	return 0;
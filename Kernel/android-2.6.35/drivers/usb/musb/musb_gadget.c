@@ -92,6 +92,19 @@
 
 /* ----------------------------------------------------------------------- */
 
+/*
+ * Bulk OUT endpoints may run Inventra DMA in mode 1 (one DMA completion
+ * per multi-packet transfer instead of one per packet) for any gadget
+ * driver, not just those setting short_not_ok.  A short packet ending the
+ * transfer early raises an endpoint irq with the channel still busy;
+ * musb_g_rx() then aborts the channel and finishes the packet in mode 0.
+ */
+static int rx_mode1_bulk = 1;
+module_param(rx_mode1_bulk, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_mode1_bulk, "use DMA mode 1 for all bulk OUT transfers");
+
+/* ----------------------------------------------------------------------- */
+
 /* Maps the buffer to dma  */
 
 static inline void map_dma_buffer(struct musb_request *request,
@@ -174,6 +187,9 @@ __acquires(ep->musb->lock)
 		req->request.status = status;
 	musb = req->musb;
 
+	ep->stats.requests++;
+	ep->stats.bytes += request->actual;
+
 	ep->busy = 1;
 	spin_unlock(&musb->lock);
 	if (is_dma_capable() && ep->dma) {
@@ -381,6 +397,11 @@ static void txstate(struct musb *musb, struct musb_request *req)
 					musb_ep->dma->desired_mode,
 					request->dma + request->actual, request_size);
 			if (use_dma) {
+				if (musb_ep->dma->desired_mode == 0)
+					musb_ep->stats.dma_mode0++;
+				else
+					musb_ep->stats.dma_mode1++;
+
 				if (musb_ep->dma->desired_mode == 0) {
 					/*
 					 * We must not clear the DMAMODE bit
@@ -462,6 +483,7 @@ static void txstate(struct musb *musb, struct musb_request *req)
 		musb_write_fifo(musb_ep->hw_ep, fifo_count,
 				(u8 *) (request->buf + request->actual));
 		request->actual += fifo_count;
+		musb_ep->stats.pio++;
 		csr |= MUSB_TXCSR_TXPKTRDY;
 		csr &= ~MUSB_TXCSR_P_UNDERRUN;
 		musb_writew(epio, MUSB_TXCSR, csr);
@@ -491,6 +513,7 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 
 	musb_ep_select(mbase, epnum);
 	request = next_request(musb_ep);
+	musb_ep->stats.irqs++;
 
 	csr = musb_readw(epio, MUSB_TXCSR);
 	DBG(4, "<== %s, txcsr %04x\n", musb_ep->end_point.name, csr);
@@ -537,6 +560,7 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 			/* Ensure writebuffer is empty. */
 			csr = musb_readw(epio, MUSB_TXCSR);
 			request->actual += musb_ep->dma->actual_len;
+			musb_ep->stats.dma_done++;
 			DBG(4, "TXCSR%d %04x, DMA off, len %zu, req %p\n",
 				epnum, csr, musb_ep->dma->actual_len, request);
 		}
@@ -573,13 +597,15 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 			/*
 			 * Kickstart next transfer if appropriate;
 			 * the packet that just completed might not
-			 * be transmitted for hours or days.
-			 * REVISIT for double buffering...
+			 * be transmitted for hours or days.  With a
+			 * double buffered FIFO the other half may
+			 * still be free; txstate() checks TXPKTRDY.
 			 * FIXME revisit for stalls too...
 			 */
 			musb_ep_select(mbase, epnum);
 			csr = musb_readw(epio, MUSB_TXCSR);
-			if (csr & MUSB_TXCSR_FIFONOTEMPTY)
+			if ((csr & MUSB_TXCSR_FIFONOTEMPTY)
+					&& !musb_ep->hw_ep->tx_double_buffered)
 				return;
 
 			request = musb_ep->desc ? next_request(musb_ep) : NULL;
@@ -599,7 +625,8 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 #ifdef CONFIG_USB_INVENTRA_DMA
 
 /* Peripheral rx (OUT) using Mentor DMA works as follows:
-	- Only mode 0 is used.
+	- Mode 1 is used for bulk transfers of at least one full packet
+	  (see rx_mode1_bulk); everything else uses mode 0, shown here.
 
 	- Request is queued by the gadget class driver.
 		-> if queue was previously empty, rxstate()
@@ -707,7 +734,11 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 		 * from file_storage and f_mass_storage drivers
 		 */
 
-		if (request->short_not_ok && len == musb_ep->packet_sz)
+		if ((request->short_not_ok || (rx_mode1_bulk &&
+				musb_ep->type == USB_ENDPOINT_XFER_BULK))
+				&& len == musb_ep->packet_sz
+				&& request->length - request->actual
+					>= musb_ep->packet_sz)
 			use_mode_1 = 1;
 		else
 			use_mode_1 = 0;
@@ -767,8 +798,16 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 				if (request->actual < request->length) {
 					int transfer_size = 0;
 		if (use_mode_1) {
-					transfer_size = min(request->length,
+					/*
+					 * Whole packets only; a trailing
+					 * partial packet is picked up in
+					 * mode 0 once this completes.
+					 */
+					transfer_size = min(request->length
+							- request->actual,
 							channel->max_len);
+					transfer_size -= transfer_size
+							% musb_ep->packet_sz;
 					musb_ep->dma->desired_mode = 1;
 		} else {
 					transfer_size = len;
@@ -784,8 +823,13 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 							transfer_size);
 				}
 
-				if (use_dma)
+				if (use_dma) {
+					if (use_mode_1)
+						musb_ep->stats.dma_mode1++;
+					else
+						musb_ep->stats.dma_mode0++;
 					return;
+				}
 			}
 #endif	/* Mentor's DMA */
 
@@ -824,6 +868,7 @@ static void rxstate(struct musb *musb, struct musb_request *req)
 			musb_read_fifo(musb_ep->hw_ep, fifo_count, (u8 *)
 					(request->buf + request->actual));
 			request->actual += fifo_count;
+			musb_ep->stats.pio++;
 
 			/* REVISIT if we left anything in the fifo, flush
 			 * it and report -EOVERFLOW
@@ -858,6 +903,7 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 	request = next_request(musb_ep);
 	if (!request)
 		return;
+	musb_ep->stats.irqs++;
 
 	csr = musb_readw(epio, MUSB_RXCSR);
 	dma = is_dma_capable() ? musb_ep->dma : NULL;
@@ -887,6 +933,29 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 	}
 
 	if (dma_channel_status(dma) == MUSB_DMA_STATUS_BUSY) {
+#ifdef CONFIG_USB_INVENTRA_DMA
+		/*
+		 * Mode 1 only raises DMA requests for full packets, so a
+		 * short packet ending the transfer early lands here with
+		 * the channel still armed.  Stop it, keep what it already
+		 * moved, and let rxstate() take the short packet.
+		 */
+		if (dma->desired_mode == 1 && (csr & MUSB_RXCSR_RXPKTRDY)
+				&& musb_readw(epio, MUSB_RXCOUNT)
+					< musb_ep->packet_sz) {
+			struct dma_controller	*c = musb->dma_controller;
+
+			c->channel_abort(dma);
+			request->actual += dma->actual_len;
+			musb_ep->stats.short_abort++;
+
+			DBG(4, "%s mode 1 cut short after %zu bytes\n",
+				musb_ep->end_point.name, dma->actual_len);
+
+			rxstate(musb, to_musb_request(request));
+			return;
+		}
+#endif
 		/* "should not happen"; likely RXPKTRDY pending for DMA */
 		DBG((csr & MUSB_RXCSR_DMAENAB) ? 4 : 1,
 			"%s busy, csr %04x\n",
@@ -902,6 +971,7 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 			MUSB_RXCSR_P_WZC_BITS | csr);
 
 		request->actual += musb_ep->dma->actual_len;
+		musb_ep->stats.dma_done++;
 
 		DBG(4, "RXCSR%d %04x, dma off, %04x, len %zu, req %p\n",
 			epnum, csr,
@@ -923,6 +993,19 @@ void musb_g_rx(struct musb *musb, u8 epnum)
 				&& (musb_ep->dma->actual_len
 					== musb_ep->packet_sz))
 			return;
+
+		/*
+		 * A mode 1 transfer only covers whole packets; if it ended
+		 * on a packet boundary short of the request length, the
+		 * rest (possibly already in the FIFO) goes through rxstate.
+		 */
+		if (dma->desired_mode == 1
+				&& request->actual < request->length
+				&& dma->actual_len
+				&& !(dma->actual_len % musb_ep->packet_sz)) {
+			rxstate(musb, to_musb_request(request));
+			return;
+		}
 #endif
 		musb_g_giveback(musb_ep, request, 0);
 
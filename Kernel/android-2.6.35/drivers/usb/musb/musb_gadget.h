@@ -57,6 +57,18 @@ extern void musb_free_request(struct usb_ep *ep, struct usb_request *req);
 /*
  * struct musb_ep - peripheral side view of endpoint rx or tx side
  */
+/* per-endpoint datapath counters, reported through debugfs */
+struct musb_ep_stats {
+	u32				irqs;		/* endpoint irqs */
+	u32				dma_done;	/* DMA completions */
+	u32				dma_mode0;	/* single packet DMA */
+	u32				dma_mode1;	/* multi packet DMA */
+	u32				pio;		/* packets moved by PIO */
+	u32				short_abort;	/* mode 1 RX cut short */
+	u32				requests;	/* requests given back */
+	u64				bytes;
+};
+
 struct musb_ep {
 	/* stuff towards the head is basically write-once. */
 	struct usb_ep			end_point;
@@ -79,6 +91,8 @@ struct musb_ep {
 
 	/* true if lock must be dropped but req_list may not be advanced */
 	u8				busy;
+
+	struct musb_ep_stats		stats;
 };
 
 static inline struct musb_ep *to_musb_ep(struct usb_ep *ep)
@@ -197,6 +197,14 @@ static int dma_channel_abort(struct dma_channel *channel)
 	u16 csr;
 
 	if (channel->status == MUSB_DMA_STATUS_BUSY) {
+		/*
+		 * Record how far the channel got before stopping it, so
+		 * callers can account for data already in memory (e.g. a
+		 * mode 1 RX transfer cut short by a short packet).
+		 */
+		channel->actual_len = musb_read_hsdma_addr(mbase, bchannel)
+					- musb_channel->start_addr;
+
 		if (musb_channel->transmit) {
 			offset = MUSB_EP_OFFSET(musb_channel->epnum,
 						MUSB_TXCSR);
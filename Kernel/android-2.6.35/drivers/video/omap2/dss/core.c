@@ -1296,6 +1296,8 @@ static int omap_dss_bus_register(void)
 	core.dss_early_suspend_info.suspend = dss_early_suspend;
 	core.dss_early_suspend_info.resume = dss_late_resume;
 	core.dss_early_suspend_info.level = EARLY_SUSPEND_LEVEL_DISABLE_FB;
+	/* The SGX display class handler of this level drives the panel too */
+	core.dss_early_suspend_info.flags = EARLY_SUSPEND_SERIAL;
 	register_early_suspend(&core.dss_early_suspend_info);
 #endif
 
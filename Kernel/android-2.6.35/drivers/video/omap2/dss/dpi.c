@@ -32,6 +32,9 @@
 
 #include <plat/display.h>
 #include <plat/cpu.h>
+#ifdef CONFIG_OMAP_PM
+#include <plat/omap-pm.h>
+#endif
 
 #include "dss.h"
 
@@ -169,6 +172,24 @@ static int dpi_set_mode(struct omap_dss_device *dssdev)
 	return 0;
 }
 
+/*
+ * While the panel is scanned out DISPC fetches up to 32 bits per pixel
+ * clock, so hold an L3 throughput constraint for it.
+ */
+static void dpi_set_bus_tput(struct omap_dss_device *dssdev, bool enable)
+{
+#ifdef CONFIG_OMAP_PM
+	long tput = -1;
+
+	if (enable)
+		tput = dssdev->panel.timings.pixel_clock * 4 * 1000 / 1024;
+
+	if (omap_pm_set_min_bus_tput(&dssdev->dev, OCP_INITIATOR_AGENT, tput))
+		DSSWARN("unable to %s L3 throughput constraint\n",
+			enable ? "set" : "release");
+#endif
+}
+
 static void dpi_basic_init(struct omap_dss_device *dssdev)
 {
 	bool is_tft;
@@ -239,6 +260,8 @@ int omapdss_dpi_display_enable(struct omap_dss_device *dssdev)
 	if (r)
 		goto err2;
 
+	dpi_set_bus_tput(dssdev, true);
+
 	mdelay(2);
 
 	if (dssdev->manager) {
@@ -272,6 +295,8 @@ void omapdss_dpi_display_disable(struct omap_dss_device *dssdev)
 	if (dssdev->manager)
 		dssdev->manager->disable(dssdev->manager);
 
+	dpi_set_bus_tput(dssdev, false);
+
 #ifdef HWMOD
 #ifdef CONFIG_OMAP2_DSS_USE_DSI_PLL
 	{
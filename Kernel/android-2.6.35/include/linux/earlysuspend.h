@@ -29,16 +29,25 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * Handlers of the same level may run concurrently with each other. A handler
+ * that depends on another one of its level sets EARLY_SUSPEND_SERIAL in flags,
+ * and is then only called once the handlers before it have all returned, and
+ * before the ones after it are started.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
 	EARLY_SUSPEND_LEVEL_STOP_DRAWING = 100,
 	EARLY_SUSPEND_LEVEL_DISABLE_FB = 150,
 };
+
+/* early_suspend.flags */
+#define EARLY_SUSPEND_SERIAL	(1U << 0)
+
 struct early_suspend {
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct list_head link;
 	int level;
+	unsigned int flags;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
 #endif
@@ -196,6 +196,17 @@ int twl_i2c_read_u8(u8 mod_no, u8 *val, u8 reg);
 int twl_i2c_write(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 int twl_i2c_read(u8 mod_no, u8 *value, u8 reg, unsigned num_bytes);
 
+/*
+ * Write a list of (not necessarily consecutive) 8-bit registers of one
+ * module in a single bus transaction.
+ */
+struct twl_i2c_reg {
+	u8 reg;
+	u8 val;
+};
+int twl_i2c_write_regs(u8 mod_no, const struct twl_i2c_reg *regs,
+		       unsigned count);
+
 int twl6030_interrupt_unmask(u8 bit_mask, u8 offset);
 int twl6030_interrupt_mask(u8 bit_mask, u8 offset);
 int twl6030_init_irq(int irq_num, unsigned irq_base, unsigned irq_end);
@@ -37,6 +37,38 @@ struct prev2resz_status {
 	enum prev2resz_state rsz_busy;
 };
 
+/**
+ * struct prev2resz_job - Asynchronous previewer/resizer job
+ * @id: Caller cookie, returned unchanged by PREV2RESZ_DEQUEUE_JOB.
+ * @src_index: Index of a queued V4L2_BUF_TYPE_VIDEO_OUTPUT buffer.
+ * @dst_index: Index of a queued V4L2_BUF_TYPE_VIDEO_CAPTURE buffer.
+ * @status: Result of the job, 0 or a negative error code. Filled in by
+ *          PREV2RESZ_DEQUEUE_JOB.
+ *
+ * A job is run with the configuration set by the last PREV2RESZ_SET_CONFIG
+ * before it was queued. Consecutive jobs with the same configuration are
+ * started straight from the resizer interrupt. The buffers must have been
+ * queued with PREV2RESZ_QUEUEBUF, and they stay mapped across jobs; the
+ * caches are synced for the device when the job is queued and for the CPU
+ * when it is dequeued.
+ *
+ * Preview features (VIDIOC_PRIVATE_ISP_PRV_CFG) are not part of the job:
+ * they apply to the previewer itself and are refused with -EBUSY while
+ * jobs are queued or running.
+ *
+ * The engines belong to one open file at a time. While a file has jobs
+ * queued or running, PREV2RESZ_QUEUE_JOB, PREV2RESZ_RUN_ENGINE and
+ * VIDIOC_PRIVATE_ISP_PRV_CFG from any other open file fail with -EBUSY,
+ * and so does anything but PREV2RESZ_RUN_ENGINE's own caller while it
+ * runs.
+ */
+struct prev2resz_job {
+	__u32 id;
+	__u32 src_index;
+	__u32 dst_index;
+	__s32 status;
+};
+
 #define PREV2RESZ_IOC_BASE	'M'
 
 #define PREV2RESZ_REQBUF	_IOWR(PREV2RESZ_IOC_BASE, 1,\
@@ -53,6 +85,10 @@ struct prev2resz_status {
 
 #define PREV2RESZ_GET_STATUS	_IOWR(PREV2RESZ_IOC_BASE, 7,\
 						struct prev2resz_status)
-#define PREV2RESZ_IOC_MAXNUM	7
+#define PREV2RESZ_QUEUE_JOB	_IOW(PREV2RESZ_IOC_BASE, 8,\
+						struct prev2resz_job)
+#define PREV2RESZ_DEQUEUE_JOB	_IOR(PREV2RESZ_IOC_BASE, 9,\
+						struct prev2resz_job)
+#define PREV2RESZ_IOC_MAXNUM	9
 
 #endif
@@ -172,6 +172,8 @@ int regulator_unregister_notifier(struct regulator *regulator,
 void *regulator_get_drvdata(struct regulator *regulator);
 void regulator_set_drvdata(struct regulator *regulator, void *data);
 
+void regulator_pm_wait(struct device *dev, struct regulator *regulator);
+
 #else
 
 /*
@@ -295,6 +297,11 @@ static inline void regulator_set_drvdata(struct regulator *regulator,
 {
 }
 
+static inline void regulator_pm_wait(struct device *dev,
+	struct regulator *regulator)
+{
+}
+
 #endif
 
 #endif
@@ -47,6 +47,8 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		ktime_t         sole_time;
+		ktime_t         sole_cpu_time;
 	} stat;
 #endif
 #endif
@@ -0,0 +1,57 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_interactive
+
+#if !defined(_TRACE_CPUFREQ_INTERACTIVE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_INTERACTIVE_H
+
+#include <linux/tracepoint.h>
+
+/* Why the interactive governor picked a new target frequency */
+#define CPUFREQ_INTERACTIVE_IDLE_EXIT	0	/* load right after idle exit */
+#define CPUFREQ_INTERACTIVE_INPUT	1	/* touch/input event boost */
+#define CPUFREQ_INTERACTIVE_BOOST	2	/* boost_cpufreq sysfs request */
+#define CPUFREQ_INTERACTIVE_RAMP_UP	3	/* sampled load above target */
+#define CPUFREQ_INTERACTIVE_RAMP_DOWN	4	/* load dropped, hold expired */
+#define CPUFREQ_INTERACTIVE_HOLD	5	/* lower target held back */
+
+#define show_interactive_reason(reason)					\
+	__print_symbolic(reason,					\
+		{ CPUFREQ_INTERACTIVE_IDLE_EXIT,	"idle_exit" },	\
+		{ CPUFREQ_INTERACTIVE_INPUT,		"input" },	\
+		{ CPUFREQ_INTERACTIVE_BOOST,		"boost" },	\
+		{ CPUFREQ_INTERACTIVE_RAMP_UP,		"ramp_up" },	\
+		{ CPUFREQ_INTERACTIVE_RAMP_DOWN,	"ramp_down" },	\
+		{ CPUFREQ_INTERACTIVE_HOLD,		"hold" })
+
+TRACE_EVENT(cpufreq_interactive_target,
+
+	TP_PROTO(unsigned int cpu, unsigned int load, unsigned int cur_freq,
+		 unsigned int target_freq, unsigned int reason),
+
+	TP_ARGS(cpu, load, cur_freq, target_freq, reason),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu		)
+		__field(	unsigned int,	load		)
+		__field(	unsigned int,	cur_freq	)
+		__field(	unsigned int,	target_freq	)
+		__field(	unsigned int,	reason		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->load		= load;
+		__entry->cur_freq	= cur_freq;
+		__entry->target_freq	= target_freq;
+		__entry->reason		= reason;
+	),
+
+	TP_printk("cpu=%u load=%u cur=%u target=%u reason=%s",
+		  __entry->cpu, __entry->load, __entry->cur_freq,
+		  __entry->target_freq, show_interactive_reason(__entry->reason))
+);
+
+#endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
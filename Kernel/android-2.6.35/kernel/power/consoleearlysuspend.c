@@ -58,6 +58,7 @@ static void console_late_resume(struct early_suspend *h)
 
 static struct early_suspend console_early_suspend_desc = {
 	.level = EARLY_SUSPEND_LEVEL_STOP_DRAWING,
+	.flags = EARLY_SUSPEND_SERIAL,
 	.suspend = console_early_suspend,
 	.resume = console_late_resume,
 };
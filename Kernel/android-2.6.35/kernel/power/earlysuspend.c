@@ -13,10 +13,15 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -30,6 +35,10 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Run handlers of the same level concurrently unless they are serial */
+static int early_suspend_async = 1;
+module_param_named(async, early_suspend_async, bool, S_IRUGO | S_IWUSR);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -46,6 +55,138 @@ static int state;
 //&*&*&*BC1_110817: fix the issue that user can see screen switch when device resume
 extern void LCD_3V3_enable(int enable);
 //&*&*&*BC2_110817: fix the issue that user can see screen switch when device resume
+
+/*
+ * The last few early suspend / late resume transitions are kept with the
+ * start time and duration of every handler called, and are shown in
+ * /sys/kernel/debug/earlysuspend.  Everything below is protected by
+ * early_suspend_lock, except that a handler running asynchronously
+ * fills in its own call entry.
+ */
+#define EARLY_SUSPEND_HISTORY		8
+#define EARLY_SUSPEND_HISTORY_CALLS	32
+
+struct early_suspend_call {
+	struct early_suspend *handler;
+	void (*fn)(struct early_suspend *h);
+	int level;
+	u32 start_us;
+	u32 dur_us;
+	bool async;
+};
+
+struct early_suspend_transition {
+	const char *name;
+	ktime_t start;
+	u32 total_us;
+	unsigned int ncalls;
+	unsigned int dropped;
+	struct early_suspend_call calls[EARLY_SUSPEND_HISTORY_CALLS];
+};
+
+static struct early_suspend_transition early_suspend_history[EARLY_SUSPEND_HISTORY];
+static unsigned int early_suspend_history_next;
+static struct early_suspend_transition *early_suspend_cur;
+static struct early_suspend_call *early_suspend_deferred;
+static int early_suspend_level;
+static LIST_HEAD(early_suspend_domain);
+
+static void early_suspend_run(struct early_suspend_call *c)
+{
+	ktime_t start = ktime_get();
+
+	c->fn(c->handler);
+	c->start_us = ktime_us_delta(start, early_suspend_cur->start);
+	c->dur_us = ktime_us_delta(ktime_get(), start);
+}
+
+static void early_suspend_run_async(void *data, async_cookie_t cookie)
+{
+	early_suspend_run(data);
+}
+
+/*
+ * Wait for every handler started so far.  The last handler queued is
+ * run here rather than handed to an async thread, so a level with a
+ * single handler costs nothing extra.
+ */
+static void early_suspend_sync(void)
+{
+	if (early_suspend_deferred) {
+		early_suspend_run(early_suspend_deferred);
+		early_suspend_deferred = NULL;
+	}
+	async_synchronize_full_domain(&early_suspend_domain);
+}
+
+static void early_suspend_begin(const char *name)
+{
+	struct early_suspend_transition *t;
+
+	t = &early_suspend_history[early_suspend_history_next];
+	early_suspend_history_next = (early_suspend_history_next + 1) %
+				     EARLY_SUSPEND_HISTORY;
+	t->name = name;
+	t->start = ktime_get();
+	t->total_us = 0;
+	t->ncalls = 0;
+	t->dropped = 0;
+	early_suspend_cur = t;
+	early_suspend_deferred = NULL;
+}
+
+static void early_suspend_end(void)
+{
+	struct early_suspend_transition *t = early_suspend_cur;
+
+	early_suspend_sync();
+	t->total_us = ktime_us_delta(ktime_get(), t->start);
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("%s: handlers took %u us\n", t->name, t->total_us);
+}
+
+/*
+ * Call @fn for @h.  Handlers of one level are started together and
+ * waited for before the next level, or a serial handler, is called.
+ */
+static void early_suspend_call(struct early_suspend *h,
+			       void (*fn)(struct early_suspend *h))
+{
+	struct early_suspend_transition *t = early_suspend_cur;
+	struct early_suspend_call *c;
+	bool serial = !early_suspend_async || (h->flags & EARLY_SUSPEND_SERIAL);
+
+	if (!t->ncalls || h->level != early_suspend_level || serial)
+		early_suspend_sync();
+	early_suspend_level = h->level;
+
+	if (t->ncalls >= EARLY_SUSPEND_HISTORY_CALLS) {
+		/* No room to track it: call it on its own, untimed */
+		t->dropped++;
+		early_suspend_sync();
+		fn(h);
+		return;
+	}
+
+	c = &t->calls[t->ncalls++];
+	c->handler = h;
+	c->fn = fn;
+	c->level = h->level;
+	c->async = false;
+
+	if (serial) {
+		early_suspend_run(c);
+		return;
+	}
+	if (early_suspend_deferred) {
+		early_suspend_deferred->async = true;
+		async_schedule_domain(early_suspend_run_async,
+				      early_suspend_deferred,
+				      &early_suspend_domain);
+	}
+	early_suspend_deferred = c;
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -95,10 +236,12 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	early_suspend_begin("early_suspend");
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
 		if (pos->suspend != NULL)
-			pos->suspend(pos);
+			early_suspend_call(pos, pos->suspend);
 	}
+	early_suspend_end();
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -133,9 +276,11 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	early_suspend_begin("late_resume");
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
 		if (pos->resume != NULL)
-			pos->resume(pos);
+			early_suspend_call(pos, pos->resume);
+	early_suspend_end();
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -181,3 +326,56 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_history_show(struct seq_file *s, void *unused)
+{
+	struct early_suspend_transition *t;
+	struct early_suspend_call *c;
+	unsigned int i, n;
+
+	mutex_lock(&early_suspend_lock);
+	for (i = 0; i < EARLY_SUSPEND_HISTORY; i++) {
+		n = (early_suspend_history_next + i) % EARLY_SUSPEND_HISTORY;
+		t = &early_suspend_history[n];
+		if (!t->name)
+			continue;
+
+		seq_printf(s, "%s at %lld us: %u us, %u handlers",
+			   t->name, ktime_to_us(t->start), t->total_us,
+			   t->ncalls + t->dropped);
+		if (t->dropped)
+			seq_printf(s, " (%u untimed)", t->dropped);
+		seq_printf(s, "\n%6s %10s %8s %5s %s\n",
+			   "level", "start(us)", "dur(us)", "async", "handler");
+		for (c = t->calls; c < t->calls + t->ncalls; c++)
+			seq_printf(s, "%6d %10u %8u %5c %pf\n", c->level,
+				   c->start_us, c->dur_us,
+				   c->async ? 'y' : 'n', c->fn);
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&early_suspend_lock);
+
+	return 0;
+}
+
+static int early_suspend_history_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_history_show, NULL);
+}
+
+static const struct file_operations early_suspend_history_fops = {
+	.open		= early_suspend_history_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("earlysuspend", S_IRUGO, NULL, NULL,
+			    &early_suspend_history_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
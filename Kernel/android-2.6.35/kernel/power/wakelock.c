@@ -21,6 +21,7 @@
 #include <linux/wakelock.h>
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
+#include <linux/tick.h>
 #endif
 #include "power.h"
 
@@ -48,7 +49,13 @@ int g_wakeup_reason = 0;
 
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
+/*
+ * Active locks without a timeout, in no particular order, and active
+ * locks with a timeout, sorted by expiry so that only the head needs to
+ * be looked at to expire them and only the tail to find the longest.
+ */
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static struct list_head timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -60,6 +67,70 @@ static struct wake_lock deleted_wake_locks;
 static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Number of active locks per type, and the suspend lock that is
+ * currently the only one held (if any).  While a lock is the sole
+ * blocker, the wall time and the non-idle CPU time that elapse are
+ * charged to it: that is the battery it costs on its own.
+ */
+static int active_count[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *sole_blocker;
+static ktime_t sole_blocker_since;
+static u64 sole_blocker_idle_since;
+
+/* Total idle time of all online cpus in us, or -1 without NO_HZ */
+static u64 wakelock_idle_time_us(void)
+{
+	u64 idle = 0, t;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		t = get_cpu_idle_time_us(cpu, NULL);
+		if (t == -1ULL)
+			return t;
+		idle += t;
+	}
+	return idle;
+}
+
+static void sole_blocker_update_locked(void)
+{
+	struct wake_lock *lock = NULL;
+	ktime_t now, wall;
+	u64 idle;
+	s64 busy_us;
+
+	if (active_count[WAKE_LOCK_SUSPEND] == 1) {
+		if (!list_empty(&active_wake_locks[WAKE_LOCK_SUSPEND]))
+			lock = list_first_entry(
+				&active_wake_locks[WAKE_LOCK_SUSPEND],
+				struct wake_lock, link);
+		else
+			lock = list_first_entry(
+				&timed_wake_locks[WAKE_LOCK_SUSPEND],
+				struct wake_lock, link);
+	}
+	if (lock == sole_blocker)
+		return;
+
+	now = ktime_get();
+	idle = wakelock_idle_time_us();
+	if (sole_blocker) {
+		wall = ktime_sub(now, sole_blocker_since);
+		sole_blocker->stat.sole_time =
+			ktime_add(sole_blocker->stat.sole_time, wall);
+		busy_us = ktime_to_us(wall);
+		if (idle != -1ULL && sole_blocker_idle_since != -1ULL)
+			busy_us -= idle - sole_blocker_idle_since;
+		if (busy_us > 0)
+			sole_blocker->stat.sole_cpu_time = ktime_add_us(
+				sole_blocker->stat.sole_cpu_time, busy_us);
+	}
+	sole_blocker = lock;
+	sole_blocker_since = now;
+	sole_blocker_idle_since = idle;
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -96,6 +167,11 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 	ktime_t max_time = lock->stat.max_time;
 
 	ktime_t prevent_suspend_time = lock->stat.prevent_suspend_time;
+	ktime_t sole_time = lock->stat.sole_time;
+
+	if (lock == sole_blocker)
+		sole_time = ktime_add(sole_time,
+				ktime_sub(ktime_get(), sole_blocker_since));
 	if (lock->flags & WAKE_LOCK_ACTIVE) {
 		ktime_t now, add_time;
 		int expired = get_expired_time(lock, &now);
@@ -116,12 +192,14 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 	}
 
 	return seq_printf(m,
-		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
+		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld"
+		     "\t%lld\t%lld\n",
 		     lock->name, lock_count, expire_count,
 		     lock->stat.wakeup_count, ktime_to_ns(active_time),
 		     ktime_to_ns(total_time),
 		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     ktime_to_ns(lock->stat.last_time), ktime_to_ns(sole_time),
+		     ktime_to_ns(lock->stat.sole_cpu_time));
 }
 
 static int wakelock_stats_show(struct seq_file *m, void *unused)
@@ -134,12 +212,15 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
-			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
+			"\ttotal_time\tsleep_time\tmax_time\tlast_change"
+			"\tsole_time\tsole_cpu_time\n");
 	list_for_each_entry(lock, &inactive_locks, link)
 		ret = print_lock_stat(m, lock);
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
 		list_for_each_entry(lock, &active_wake_locks[type], link)
 			ret = print_lock_stat(m, lock);
+		list_for_each_entry(lock, &timed_wake_locks[type], link)
+			ret = print_lock_stat(m, lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
@@ -171,15 +252,14 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void update_sleep_wait_stats_list(struct list_head *head,
+					ktime_t elapsed, int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
+	ktime_t etime, add;
 	int expired;
 
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
+	list_for_each_entry(lock, head, link) {
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 			if (expired)
@@ -194,19 +274,58 @@ static void update_sleep_wait_stats_locked(int done)
 		else
 			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
 	}
+}
+
+static void update_sleep_wait_stats_locked(int done)
+{
+	ktime_t now, elapsed;
+
+	now = ktime_get();
+	elapsed = ktime_sub(now, last_sleep_time_update);
+	update_sleep_wait_stats_list(&active_wake_locks[WAKE_LOCK_SUSPEND],
+				     elapsed, done);
+	update_sleep_wait_stats_list(&timed_wake_locks[WAKE_LOCK_SUSPEND],
+				     elapsed, done);
 	last_sleep_time_update = now;
 }
 #endif
 
+/* Move an active lock back to the inactive list */
+static void deactivate_wake_lock_locked(struct wake_lock *lock)
+{
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
+	list_move(&lock->link, &inactive_locks);
+#ifdef CONFIG_WAKELOCK_STAT
+	active_count[type]--;
+	if (type == WAKE_LOCK_SUSPEND)
+		sole_blocker_update_locked();
+#endif
+}
+
+/* Insert into the timed list, keeping it sorted by expiry */
+static void add_timed_wake_lock_locked(struct wake_lock *lock, int type)
+{
+	struct list_head *pos;
+	struct wake_lock *l;
+
+	/* a new timeout usually expires last, so search from the tail */
+	list_for_each_prev(pos, &timed_wake_locks[type]) {
+		l = list_entry(pos, struct wake_lock, link);
+		if ((long)(l->expires - lock->expires) <= 0)
+			break;
+	}
+	list_add(&lock->link, pos);
+}
+
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	deactivate_wake_lock_locked(lock);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
@@ -219,38 +338,36 @@ static void print_active_locks(int type)
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			print_expired = false;
+	}
+	list_for_each_entry(lock, &timed_wake_locks[type], link) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
 static long has_wake_lock_locked(int type)
 {
 	struct wake_lock *lock, *n;
-	long max_timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	list_for_each_entry_safe(lock, n, &timed_wake_locks[type], link) {
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	if (!list_empty(&active_wake_locks[type]))
+		return -1;
+	if (list_empty(&timed_wake_locks[type]))
+		return 0;
+	lock = list_entry(timed_wake_locks[type].prev, struct wake_lock, link);
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
@@ -414,6 +531,8 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	lock->stat.sole_time = ktime_set(0, 0);
+	lock->stat.sole_cpu_time = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
@@ -430,6 +549,8 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		deactivate_wake_lock_locked(lock);
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
@@ -444,6 +565,12 @@ void wake_lock_destroy(struct wake_lock *lock)
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
+		deleted_wake_locks.stat.sole_time =
+			ktime_add(deleted_wake_locks.stat.sole_time,
+				  lock->stat.sole_time);
+		deleted_wake_locks.stat.sole_cpu_time =
+			ktime_add(deleted_wake_locks.stat.sole_cpu_time,
+				  lock->stat.sole_cpu_time);
 	}
 #endif
 	list_del(&lock->link);
@@ -479,6 +606,7 @@ static void wake_lock_internal(
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
+		active_count[type]++;
 #endif
 	}
 	list_del(&lock->link);
@@ -489,7 +617,7 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		add_timed_wake_lock_locked(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -500,6 +628,7 @@ static void wake_lock_internal(
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
+		sole_blocker_update_locked();
 		if (lock == &main_wake_lock)
 			update_sleep_wait_stats_locked(1);
 		else if (!wake_lock_active(&main_wake_lock))
@@ -549,9 +678,8 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		deactivate_wake_lock_locked(lock);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
 		if (has_lock > 0) {
@@ -603,8 +731,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		INIT_LIST_HEAD(&timed_wake_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
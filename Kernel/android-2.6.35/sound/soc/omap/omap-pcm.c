@@ -24,14 +24,32 @@
 
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
 #include <sound/soc.h>
+#include <sound/info.h>
 
 #include <plat/dma.h>
+#include <plat/sram.h>
+#include <plat/omap-pm.h>
 #include "omap-pcm.h"
 
+/*
+ * Playback buffers that fit are served from on-chip SRAM, so the DMA
+ * does not wake up SDRAM at every McBSP request. Only one stream can
+ * own it at a time; the others fall back to SDRAM.
+ */
+static unsigned int sram_size = 8 * 1024;
+module_param(sram_size, uint, S_IRUGO);
+MODULE_PARM_DESC(sram_size, "Bytes of SRAM for low latency playback (0 = off)");
+
+/* SRAM is lost in CORE OFF (C7), so keep the MPU out of it meanwhile */
+#define OMAP_PCM_SRAM_MAX_LAT	20000
+
 static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.info			= SNDRV_PCM_INFO_MMAP |
 				  SNDRV_PCM_INFO_MMAP_VALID |
@@ -47,13 +65,125 @@ static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.buffer_bytes_max	= 128 * 1024,
 };
 
+struct omap_pcm_stats {
+	struct snd_info_entry	*entry;
+	unsigned int		in_sram;
+	unsigned int		periods;
+	unsigned int		late;		/* IRQ over half a period late */
+	unsigned int		xruns;
+	unsigned int		start_us;	/* trigger to first period IRQ */
+	unsigned int		start_us_max;
+	unsigned int		period_us;
+	unsigned int		interval_us_max;
+	ktime_t			last;
+	bool			started;
+};
+
 struct omap_runtime_data {
 	spinlock_t			lock;
 	struct omap_pcm_dma_data	*dma_data;
 	int				dma_ch;
 	int				period_index;
+	struct omap_pcm_stats		*stats;
 };
 
+#ifdef CONFIG_ARCH_OMAP3
+static struct {
+	struct snd_dma_buffer		buf;
+	struct snd_pcm_substream	*owner;
+	struct pm_qos_request_list	*qos;
+} omap_pcm_sram;
+static DEFINE_MUTEX(omap_pcm_sram_lock);
+
+static struct snd_dma_buffer *
+omap_pcm_sram_claim(struct snd_pcm_substream *substream, size_t bytes)
+{
+	struct snd_dma_buffer *buf = NULL;
+
+	if (substream->stream != SNDRV_PCM_STREAM_PLAYBACK ||
+	    bytes > omap_pcm_sram.buf.bytes)
+		return NULL;
+
+	mutex_lock(&omap_pcm_sram_lock);
+	if (!omap_pcm_sram.owner) {
+		omap_pcm_sram.owner = substream;
+		omap_pm_set_max_mpu_wakeup_lat(&omap_pcm_sram.qos,
+					       OMAP_PCM_SRAM_MAX_LAT);
+	}
+	if (omap_pcm_sram.owner == substream)
+		buf = &omap_pcm_sram.buf;
+	mutex_unlock(&omap_pcm_sram_lock);
+
+	return buf;
+}
+
+static void omap_pcm_sram_release(struct snd_pcm_substream *substream)
+{
+	mutex_lock(&omap_pcm_sram_lock);
+	if (omap_pcm_sram.owner == substream) {
+		omap_pcm_sram.owner = NULL;
+		omap_pm_set_max_mpu_wakeup_lat(&omap_pcm_sram.qos, -1);
+	}
+	mutex_unlock(&omap_pcm_sram_lock);
+}
+
+static inline int omap_pcm_in_sram(struct snd_pcm_runtime *runtime)
+{
+	return runtime->dma_buffer_p == &omap_pcm_sram.buf;
+}
+
+static void __init omap_pcm_sram_init(void)
+{
+	struct snd_dma_buffer *buf = &omap_pcm_sram.buf;
+	unsigned long phys;
+
+	if (!cpu_is_omap34xx() || !sram_size)
+		return;
+
+	buf->area = omap_sram_alloc(PAGE_ALIGN(sram_size), &phys);
+	if (!buf->area)
+		return;
+	buf->dev.type = SNDRV_DMA_TYPE_CONTINUOUS;
+	buf->addr = phys;
+	buf->bytes = PAGE_ALIGN(sram_size);
+}
+#else
+static inline struct snd_dma_buffer *
+omap_pcm_sram_claim(struct snd_pcm_substream *substream, size_t bytes)
+{
+	return NULL;
+}
+static inline void omap_pcm_sram_release(struct snd_pcm_substream *substream)
+{ }
+static inline int omap_pcm_in_sram(struct snd_pcm_runtime *runtime)
+{
+	return 0;
+}
+static inline void omap_pcm_sram_init(void) { }
+#endif
+
+/* called from the DMA IRQ with the period that just completed */
+static void omap_pcm_stats_period(struct omap_pcm_stats *stats)
+{
+	ktime_t now = ktime_get();
+	unsigned int us = ktime_to_us(ktime_sub(now, stats->last));
+
+	stats->last = now;
+	stats->periods++;
+	if (!stats->started) {
+		/* first period, DMA start up and filling the McBSP FIFO */
+		stats->started = true;
+		stats->start_us = us;
+		if (us > stats->start_us_max)
+			stats->start_us_max = us;
+		return;
+	}
+	if (us > stats->interval_us_max)
+		stats->interval_us_max = us;
+	if (us > stats->period_us + stats->period_us / 2)
+		stats->late++;
+}
+
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
 {
 	struct snd_pcm_substream *substream = data;
@@ -90,6 +220,9 @@ static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
 		spin_unlock_irqrestore(&prtd->lock, flags);
 	}
 
+	if (prtd->stats)
+		omap_pcm_stats_period(prtd->stats);
+
 	snd_pcm_period_elapsed(substream);
 }
 
@@ -101,6 +234,7 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct omap_runtime_data *prtd = runtime->private_data;
 	struct omap_pcm_dma_data *dma_data;
+	struct snd_dma_buffer *buf;
 
 	int err = 0;
 
@@ -111,8 +245,19 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	if (!dma_data)
 		return 0;
 
-	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
+	/* Small playback buffers go to SRAM when it is free */
+	buf = omap_pcm_sram_claim(substream, params_buffer_bytes(params));
+	if (!buf) {
+		omap_pcm_sram_release(substream);
+		buf = &substream->dma_buffer;
+	}
+	snd_pcm_set_runtime_buffer(substream, buf);
 	runtime->dma_bytes = params_buffer_bytes(params);
+	if (prtd->stats) {
+		prtd->stats->in_sram = omap_pcm_in_sram(runtime);
+		prtd->stats->period_us = div_u64((u64)params_period_size(params)
+					* USEC_PER_SEC, params_rate(params));
+	}
 
 	if (prtd->dma_data)
 		return 0;
@@ -143,6 +288,7 @@ static int omap_pcm_hw_free(struct snd_pcm_substream *substream)
 	prtd->dma_data = NULL;
 
 	snd_pcm_set_runtime_buffer(substream, NULL);
+	omap_pcm_sram_release(substream);
 
 	return 0;
 }
@@ -160,6 +306,10 @@ static int omap_pcm_prepare(struct snd_pcm_substream *substream)
 	if (!prtd->dma_data)
 		return 0;
 
+	/* the application is recovering from an under/overrun */
+	if (prtd->stats && runtime->status->state == SNDRV_PCM_STATE_XRUN)
+		prtd->stats->xruns++;
+
 	memset(&dma_params, 0, sizeof(dma_params));
 	dma_params.data_type			= dma_data->data_type;
 	dma_params.trigger			= dma_data->dma_req;
@@ -226,6 +376,14 @@ static int omap_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		if (dma_data->set_threshold)
 			dma_data->set_threshold(substream);
 
+		/* SRAM did not survive the suspend, play silence instead */
+		if (cmd == SNDRV_PCM_TRIGGER_RESUME && omap_pcm_in_sram(runtime))
+			memset(runtime->dma_area, 0, runtime->dma_bytes);
+
+		if (prtd->stats) {
+			prtd->stats->started = false;
+			prtd->stats->last = ktime_get();
+		}
 		omap_start_dma(prtd->dma_ch);
 		break;
 
@@ -303,6 +461,13 @@ static int omap_pcm_open(struct snd_pcm_substream *substream)
 		goto out;
 	}
 	spin_lock_init(&prtd->lock);
+	prtd->stats = substream->dma_buffer.private_data;
+	if (prtd->stats) {
+		struct snd_info_entry *entry = prtd->stats->entry;
+
+		memset(prtd->stats, 0, sizeof(*prtd->stats));
+		prtd->stats->entry = entry;
+	}
 	runtime->private_data = prtd;
 
 out:
@@ -322,6 +487,14 @@ static int omap_pcm_mmap(struct snd_pcm_substream *substream,
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
+	if (omap_pcm_in_sram(runtime)) {
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+		return remap_pfn_range(vma, vma->vm_start,
+				       runtime->dma_addr >> PAGE_SHIFT,
+				       vma->vm_end - vma->vm_start,
+				       vma->vm_page_prot);
+	}
+
 	return dma_mmap_writecombine(substream->pcm->card->dev, vma,
 				     runtime->dma_area,
 				     runtime->dma_addr,
@@ -342,6 +515,45 @@ static struct snd_pcm_ops omap_pcm_ops = {
 
 static u64 omap_pcm_dmamask = DMA_BIT_MASK(64);
 
+static void omap_pcm_proc_read(struct snd_info_entry *entry,
+			       struct snd_info_buffer *buffer)
+{
+	struct omap_pcm_stats *stats = entry->private_data;
+
+	snd_iprintf(buffer, "buffer: %s\n", stats->in_sram ? "sram" : "sdram");
+	snd_iprintf(buffer, "period_us: %u\n", stats->period_us);
+	snd_iprintf(buffer, "periods: %u\n", stats->periods);
+	snd_iprintf(buffer, "late_periods: %u\n", stats->late);
+	snd_iprintf(buffer, "interval_us_max: %u\n", stats->interval_us_max);
+	snd_iprintf(buffer, "xruns: %u\n", stats->xruns);
+	snd_iprintf(buffer, "start_us: %u (max %u)\n", stats->start_us,
+		    stats->start_us_max);
+}
+
+/*
+ * Period timing and xrun counts of a stream since it was last opened,
+ * in /proc/asound/cardN/pcmDD{p,c}-omap
+ */
+static void omap_pcm_stats_new(struct snd_pcm *pcm, int stream)
+{
+	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
+	struct omap_pcm_stats *stats;
+	char name[16];
+
+	stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return;
+
+	snprintf(name, sizeof(name), "pcm%02d%c-omap", pcm->device,
+		 stream == SNDRV_PCM_STREAM_PLAYBACK ? 'p' : 'c');
+	if (!snd_card_proc_new(pcm->card, name, &stats->entry))
+		snd_info_set_text_ops(stats->entry, stats, omap_pcm_proc_read);
+	else
+		stats->entry = NULL;
+
+	substream->dma_buffer.private_data = stats;
+}
+
 static int omap_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
 	int stream)
 {
@@ -358,6 +570,7 @@ static int omap_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
 		return -ENOMEM;
 
 	buf->bytes = size;
+	omap_pcm_stats_new(pcm, stream);
 	return 0;
 }
 
@@ -373,6 +586,14 @@ static void omap_pcm_free_dma_buffers(struct snd_pcm *pcm)
 			continue;
 
 		buf = &substream->dma_buffer;
+		if (buf->private_data) {
+			struct omap_pcm_stats *stats = buf->private_data;
+
+			if (stats->entry)
+				snd_device_free(pcm->card, stats->entry);
+			kfree(stats);
+			buf->private_data = NULL;
+		}
 		if (!buf->area)
 			continue;
 
@@ -441,6 +662,7 @@ static struct platform_driver omap_pcm_driver = {
 
 static int __init snd_omap_pcm_init(void)
 {
+	omap_pcm_sram_init();
 	return platform_driver_register(&omap_pcm_driver);
 }
 module_init(snd_omap_pcm_init);
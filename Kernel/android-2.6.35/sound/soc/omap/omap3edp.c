@@ -182,6 +182,15 @@ static int __init omap3edp_init(void)
 	ret = platform_device_add(omap3edp_snd_device);
 	if (ret)
 		goto err1;
+
+	/*
+	 * In element mode McBSP2 asks the sDMA for every sample, which keeps
+	 * SDRAM out of self-refresh for as long as audio plays. Threshold
+	 * mode moves a whole period (or packet) per request instead.
+	 */
+	if (omap_mcbsp_set_dma_op_mode(MCBSP2_ID, MCBSP_DMA_MODE_THRESHOLD))
+		printk(KERN_WARNING "omap3edp-sound: McBSP2 stays in element "
+				"DMA mode\n");
 #if 1
 	dev = &omap3edp_snd_device->dev;
 